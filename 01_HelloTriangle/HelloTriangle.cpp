@@ -36,7 +36,7 @@ void HelloTriangle::OnDestroy()
     m_device->DestroyBuffer(m_shaderBindingTable);
 
     auto device = m_device->GetDevice();
-    vkFreeDescriptorSets(device, m_device->GetDescriptorPool(), 1, &m_descriptorSet);
+    m_device->DeallocateDescriptorSet(m_descriptorSet);
     vkDestroyPipeline(device, m_raytracePipeline, nullptr);
     vkDestroyDescriptorSetLayout(device, m_dsLayout, nullptr);
     vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
@@ -49,7 +49,6 @@ void HelloTriangle::OnUpdate()
 void HelloTriangle::OnRender()
 {
     m_device->WaitAvailableFrame();
-    auto frameIndex = m_device->GetCurrentFrameIndex();
     auto command = m_device->GetCurrentFrameCommandBuffer();
     VkCommandBufferBeginInfo commandBI{
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -75,7 +74,8 @@ void HelloTriangle::OnRender()
     );
 
     // Cg[VOʉ摜obNobt@փRs[.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -90,7 +90,7 @@ void HelloTriangle::OnRender()
         1, &region);
 
     m_raytracedImage.BarrierToGeneral(command);
-    backbuffer.BarrierToPresentSrc(command);
+    backbuffer.BarrierToLayout(command, m_device->GetPresentLayout());
 
     vkEndCommandBuffer(command);
     m_device->SubmitCurrentFrameCommandBuffer();
@@ -425,9 +425,7 @@ void HelloTriangle::CreateRaytracePipeline()
     rtPipelineCI.pGroups = m_shaderGroups.data();
     rtPipelineCI.maxPipelineRayRecursionDepth = 1;
     rtPipelineCI.layout = m_pipelineLayout;
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE, 
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
     
     // ÎŃVF[_[W[͉Ă܂.
     for (auto& v : stages) {
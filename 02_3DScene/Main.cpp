@@ -15,10 +15,14 @@
 int APIENTRY wWinMain(
     _In_ HINSTANCE hInstance,
     _In_opt_ HINSTANCE /*hPrevInstance*/,
-    _In_ LPWSTR /*cmdline*/,
+    _In_ LPWSTR cmdline,
     _In_ int /*nCmdShow*/)
 {
     SimpleScene theApp;
+    BookFramework::HeadlessOptions options;
+    if (BookFramework::ParseHeadlessOptions(cmdline, options)) {
+        theApp.SetHeadless(options);
+    }
     return theApp.Run();
 }
 
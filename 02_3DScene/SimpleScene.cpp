@@ -79,7 +79,7 @@ void SimpleScene::OnDestroy()
     vkDestroyPipeline(device, m_raytracePipeline, nullptr);
     vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(device, m_dsLayout, nullptr);
-    vkFreeDescriptorSets(device, m_device->GetDescriptorPool(), 1, &m_descriptorSet);
+    m_device->DeallocateDescriptorSet(m_descriptorSet);
 }
 
 void SimpleScene::OnUpdate()
@@ -130,7 +130,8 @@ void SimpleScene::OnRender()
     );
 
     // Cg[VOʉ摜obNobt@փRs[.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -155,7 +156,7 @@ void SimpleScene::OnRender()
       VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       nullptr,
       m_renderPass,
-      m_framebuffers[frameIndex],
+      m_framebuffers[backBufferIndex],
       m_device->GetRenderArea(),
       1, &clearValue
     };
@@ -426,9 +427,7 @@ void SimpleScene::CreateRaytracePipeline()
     rtPipelineCI.pGroups = m_shaderGroups.data();
     rtPipelineCI.maxPipelineRayRecursionDepth = 1;
     rtPipelineCI.layout = m_pipelineLayout;
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE,
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
 
     // ÎŃVF[_[W[͉Ă܂.
     for (auto& v : stages) {
@@ -638,7 +637,7 @@ void SimpleScene::InitializeImGui()
         colorTarget.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorTarget.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorTarget.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        colorTarget.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorTarget.finalLayout = m_device->GetPresentLayout();
 
         VkAttachmentReference colorRef{
           0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -691,14 +690,17 @@ void SimpleScene::InitializeImGui()
     initInfo.Device = m_device->GetDevice();
     initInfo.QueueFamily = m_device->GetGraphicsQueueFamily();
     initInfo.Queue = m_device->GetDefaultQueue();
+    initInfo.PipelineCache = m_device->GetPipelineCache();
     initInfo.DescriptorPool = m_device->GetDescriptorPool();
     initInfo.Subpass = 0;
     initInfo.MinImageCount = m_device->GetBackBufferCount();
-    initInfo.ImageCount = m_device->GetBackBufferCount();
+    initInfo.ImageCount = (std::max)(m_device->GetBackBufferCount(), m_device->GetFramesInFlight());
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&initInfo, m_renderPass);
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    if (m_window) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    }
 
     // tHgeNX`̏.
     auto command = m_device->CreateCommandBuffer();
@@ -710,7 +712,9 @@ void SimpleScene::InitializeImGui()
 
 void SimpleScene::DestroyImGui()
 { 
-    ImGui_ImplGlfw_Shutdown();
+    if (m_window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui_ImplVulkan_Shutdown();
     ImGui::DestroyContext();
 
@@ -725,7 +729,14 @@ void SimpleScene::UpdateHUD()
 {
     // ImGui
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (m_window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        // wbhXsł̓EBhÊŕ\TCY𒼐ڐݒ肷.
+        auto& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(GetWidth()), float(GetHeight()));
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 
     ImGui::Begin("Information");
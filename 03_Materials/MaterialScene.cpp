@@ -154,7 +154,8 @@ void MaterialScene::OnRender()
     );
 
     // Cg[VOʉ摜obNobt@փRs[.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -179,7 +180,7 @@ void MaterialScene::OnRender()
       VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       nullptr,
       m_renderPass,
-      m_framebuffers[frameIndex],
+      m_framebuffers[backBufferIndex],
       m_device->GetRenderArea(),
       1, &clearValue
     };
@@ -494,9 +495,7 @@ void MaterialScene::CreateRaytracePipeline()
     rtPipelineCI.maxPipelineRayRecursionDepth = useNoRecursiveRaytrace ? 1 : 5;
     rtPipelineCI.layout = m_pipelineLayout;
 
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE,
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
 
     // ÎŃVF[_[W[͉Ă܂.
     for (auto& v : stages) {
@@ -785,7 +784,7 @@ void MaterialScene::InitializeImGui()
         colorTarget.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorTarget.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorTarget.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        colorTarget.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorTarget.finalLayout = m_device->GetPresentLayout();
 
         VkAttachmentReference colorRef{
           0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -838,14 +837,17 @@ void MaterialScene::InitializeImGui()
     initInfo.Device = m_device->GetDevice();
     initInfo.QueueFamily = m_device->GetGraphicsQueueFamily();
     initInfo.Queue = m_device->GetDefaultQueue();
+    initInfo.PipelineCache = m_device->GetPipelineCache();
     initInfo.DescriptorPool = m_device->GetDescriptorPool();
     initInfo.Subpass = 0;
     initInfo.MinImageCount = m_device->GetBackBufferCount();
-    initInfo.ImageCount = m_device->GetBackBufferCount();
+    initInfo.ImageCount = (std::max)(m_device->GetBackBufferCount(), m_device->GetFramesInFlight());
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&initInfo, m_renderPass);
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    if (m_window) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    }
 
     // tHgeNX`̏.
     auto command = m_device->CreateCommandBuffer();
@@ -857,7 +859,9 @@ void MaterialScene::InitializeImGui()
 
 void MaterialScene::DestroyImGui()
 {
-    ImGui_ImplGlfw_Shutdown();
+    if (m_window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui_ImplVulkan_Shutdown();
     ImGui::DestroyContext();
 
@@ -872,7 +876,14 @@ void MaterialScene::UpdateHUD()
 {
     // ImGui
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (m_window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        // wbhXsł̓EBhÊŕ\TCY𒼐ڐݒ肷.
+        auto& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(GetWidth()), float(GetHeight()));
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 
     ImGui::Begin("Information");
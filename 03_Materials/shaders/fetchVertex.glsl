@@ -25,6 +25,28 @@ mat4 GetObjectToWorld(uint64_t blasMatrixAddr, uint blasMatrixIndex) {
 }
 
 
+//*****************************************
+// Texture LOD (Ray Cones)
+//*****************************************
+// Op`̃eNX`Wƃ[hԂł̖ʐϔ䂩, ƂȂ LOD ߂.
+float ComputeTriangleLodBase(vec3 p0, vec3 p1, vec3 p2, vec2 t0, vec2 t1, vec2 t2) {
+  vec2 uv1 = t1 - t0;
+  vec2 uv2 = t2 - t0;
+  float texArea = abs(uv1.x * uv2.y - uv2.x * uv1.y);
+  float posArea = length(cross(p1 - p0, p2 - p0));
+  return 0.5 * log2(max(texArea, 1e-12) / max(posArea, 1e-12));
+}
+
+// qbgʒuł̃CR[̕Ɩʂ̌X, eNX`̃~bvx߂.
+float ComputeTextureLod(float triangleLodBase, float coneWidth, vec3 worldNormal, vec3 rayDirection, ivec2 texSize) {
+  float lod = triangleLodBase;
+  lod += log2(max(abs(coneWidth), 1e-8));
+  lod -= log2(max(abs(dot(normalize(worldNormal), rayDirection)), 1e-4));
+  lod += 0.5 * log2(float(texSize.x) * float(texSize.y));
+  return lod;
+}
+
+
 //*****************************************
 // Interleaved vertices.
 //*****************************************
@@ -75,6 +97,29 @@ VertexPNT FetchVertexInterleavedPNT(
   return v;
 }
 
+// _ɉ, eNX` LOD vZpɎOp`̊ LOD ߂.
+//  mtxObjectToWorld ̓[hԂł̖ʐς߂邽߂Ɏgp.
+VertexPNT FetchVertexInterleavedPNT(
+  vec3 barys,
+  uint64_t indexBuffer,
+  uint64_t vertexBufferPNT,
+  mat3 mtxObjectToWorld,
+  out float triangleLodBase)
+{
+  Indices indices = Indices(indexBuffer);
+  VerticesPNT verts = VerticesPNT(vertexBufferPNT);
+
+  const uvec3 idx = indices.i[gl_PrimitiveID];
+  VertexPNT v0 = verts.v[idx.x];
+  VertexPNT v1 = verts.v[idx.y];
+  VertexPNT v2 = verts.v[idx.z];
+  triangleLodBase = ComputeTriangleLodBase(
+    mtxObjectToWorld * v0.Position, mtxObjectToWorld * v1.Position, mtxObjectToWorld * v2.Position,
+    v0.Texcoord, v1.Texcoord, v2.Texcoord);
+
+  return FetchVertexInterleavedPNT(barys, indexBuffer, vertexBufferPNT);
+}
+
 //*****************************************
 // Separated VertexStreams
 //*****************************************
@@ -118,4 +163,29 @@ VertexPNT FetchVertexPNT(
   v.Texcoord += vbTex.t[idx.z] * barys.z;
 
   return v;
+}
+
+// _ɉ, eNX` LOD vZpɎOp`̊ LOD ߂.
+//  mtxObjectToWorld ̓[hԂł̖ʐς߂邽߂Ɏgp.
+VertexPNT FetchVertexPNT(
+  vec3 barys,
+  uint64_t indexBuffer,
+  uint64_t vertexBufferPos,
+  uint64_t vertexBufferNormal,
+  uint64_t vertexBufferTexcoord,
+  mat3 mtxObjectToWorld,
+  out float triangleLodBase
+  )
+{
+  Indices indices = Indices(indexBuffer);
+  VertexPos vbPos = VertexPos(vertexBufferPos);
+  VertexTexcoord vbTex = VertexTexcoord(vertexBufferTexcoord);
+
+  const uvec3 idx = indices.i[gl_PrimitiveID];
+  triangleLodBase = ComputeTriangleLodBase(
+    mtxObjectToWorld * vbPos.v[idx.x], mtxObjectToWorld * vbPos.v[idx.y], mtxObjectToWorld * vbPos.v[idx.z],
+    vbTex.t[idx.x], vbTex.t[idx.y], vbTex.t[idx.z]);
+
+  return FetchVertexPNT(
+    barys, indexBuffer, vertexBufferPos, vertexBufferNormal, vertexBufferTexcoord);
 }
\ No newline at end of file
@@ -22,6 +22,8 @@
 struct MyHitPayload {
   vec3 hitValue;
   int  recursive;
+  float coneWidth;   // CR[̕(eNX` LOD ̌vZp).
+  float coneSpread;  // CR[̍Lp.
 };
 
 struct ObjectParameters {
@@ -165,7 +165,8 @@ void ShadowScene::OnRender()
     );
 
     // Cg[VOʉ摜obNobt@փRs[.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -190,7 +191,7 @@ void ShadowScene::OnRender()
       VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       nullptr,
       m_renderPass,
-      m_framebuffers[frameIndex],
+      m_framebuffers[backBufferIndex],
       m_device->GetRenderArea(),
       1, &clearValue
     };
@@ -353,16 +354,21 @@ void ShadowScene::CreateSceneBLAS()
     VkBuildAccelerationStructureFlagsKHR buildFlags = 0;
     buildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
 
+    // e BLAS ̍\zv܂Ƃ߂, 1̑Mō\z.
+    AccelerationStructureBuilder builder;
+
     // Plane BLAS ̐.
-    m_meshPlane->BuildAS(m_device, buildFlags);
+    m_meshPlane->BuildAS(m_device, builder, buildFlags);
 
     // LightSphere BLAS ̐.
-    m_meshLightSphere->BuildAS(m_device, buildFlags);
+    m_meshLightSphere->BuildAS(m_device, builder, buildFlags);
 
     // Spheres BLAS ̐.
     for (const auto& v : m_meshSpheres) {
-        v->BuildAS(m_device, buildFlags);
+        v->BuildAS(m_device, builder, buildFlags);
     }
+
+    builder.Build(m_device);
 }
 
 void ShadowScene::CreateSceneTLAS()
@@ -473,9 +479,7 @@ void ShadowScene::CreateRaytracePipeline()
     rtPipelineCI.maxPipelineRayRecursionDepth = m_useNoRecursiveRaytrace ? 1 : 2;
     rtPipelineCI.layout = m_pipelineLayout;
 
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE,
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
 }
 
 void ShadowScene::CreateShaderBindingTable()
@@ -699,7 +703,7 @@ void ShadowScene::InitializeImGui()
         colorTarget.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorTarget.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorTarget.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        colorTarget.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorTarget.finalLayout = m_device->GetPresentLayout();
 
         VkAttachmentReference colorRef{
           0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -752,14 +756,17 @@ void ShadowScene::InitializeImGui()
     initInfo.Device = m_device->GetDevice();
     initInfo.QueueFamily = m_device->GetGraphicsQueueFamily();
     initInfo.Queue = m_device->GetDefaultQueue();
+    initInfo.PipelineCache = m_device->GetPipelineCache();
     initInfo.DescriptorPool = m_device->GetDescriptorPool();
     initInfo.Subpass = 0;
     initInfo.MinImageCount = m_device->GetBackBufferCount();
-    initInfo.ImageCount = m_device->GetBackBufferCount();
+    initInfo.ImageCount = (std::max)(m_device->GetBackBufferCount(), m_device->GetFramesInFlight());
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&initInfo, m_renderPass);
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    if (m_window) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    }
 
     // tHgeNX`̏.
     auto command = m_device->CreateCommandBuffer();
@@ -771,7 +778,9 @@ void ShadowScene::InitializeImGui()
 
 void ShadowScene::DestroyImGui()
 {
-    ImGui_ImplGlfw_Shutdown();
+    if (m_window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui_ImplVulkan_Shutdown();
     ImGui::DestroyContext();
 
@@ -786,7 +795,14 @@ void ShadowScene::UpdateHUD()
 {
     // ImGui
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (m_window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        // wbhXsł̓EBhÊŕ\TCY𒼐ڐݒ肷.
+        auto& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(GetWidth()), float(GetHeight()));
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 
     ImGui::Begin("Information");
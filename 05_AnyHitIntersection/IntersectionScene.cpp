@@ -182,7 +182,8 @@ void IntersectionScene::OnRender()
     );
 
     // レイトレーシング結果画像をバックバッファへコピー.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
@@ -207,7 +208,7 @@ void IntersectionScene::OnRender()
       VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       nullptr,
       m_renderPass,
-      m_framebuffers[frameIndex],
+      m_framebuffers[backBufferIndex],
       m_device->GetRenderArea(),
       1, &clearValue
     };
@@ -380,18 +381,23 @@ void IntersectionScene::CreateSceneBLAS()
     VkBuildAccelerationStructureFlagsKHR buildFlags = 0;
     buildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
 
+    // 各 BLAS の構築要求をまとめて, 1回の送信で構築する.
+    AccelerationStructureBuilder builder;
+
     // Plane BLAS の生成.
-    m_meshPlane->BuildAS(m_device, buildFlags);
+    m_meshPlane->BuildAS(m_device, builder, buildFlags);
         
     // Fence BLAS の生成.
     m_meshFence->SetGometryFlags(0); // AnyHitシェーダーを起動するため VK_GEOMETRY_OPAQUE_BIT_KHR を設定しない.
-    m_meshFence->BuildAS(m_device, buildFlags);
+    m_meshFence->BuildAS(m_device, builder, buildFlags);
 
     // AABB BLAS の生成.
-    m_meshAABB->BuildAS(m_device, buildFlags);
+    m_meshAABB->BuildAS(m_device, builder, buildFlags);
 
     // AABB-SDF BLAS の生成.
-    m_meshAABBSDF->BuildAS(m_device, buildFlags);
+    m_meshAABBSDF->BuildAS(m_device, builder, buildFlags);
+
+    builder.Build(m_device);
 }
 
 void IntersectionScene::CreateSceneTLAS()
@@ -493,9 +499,7 @@ void IntersectionScene::CreateRaytracePipeline()
     rtPipelineCI.maxPipelineRayRecursionDepth = APP_RAYTRACE_RECURSIVE;
     rtPipelineCI.layout = m_pipelineLayout;
 
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE,
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
 
 }
 
@@ -761,7 +765,7 @@ void IntersectionScene::InitializeImGui()
         colorTarget.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorTarget.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorTarget.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        colorTarget.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorTarget.finalLayout = m_device->GetPresentLayout();
 
         VkAttachmentReference colorRef{
           0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -814,14 +818,17 @@ void IntersectionScene::InitializeImGui()
     initInfo.Device = m_device->GetDevice();
     initInfo.QueueFamily = m_device->GetGraphicsQueueFamily();
     initInfo.Queue = m_device->GetDefaultQueue();
+    initInfo.PipelineCache = m_device->GetPipelineCache();
     initInfo.DescriptorPool = m_device->GetDescriptorPool();
     initInfo.Subpass = 0;
     initInfo.MinImageCount = m_device->GetBackBufferCount();
-    initInfo.ImageCount = m_device->GetBackBufferCount();
+    initInfo.ImageCount = (std::max)(m_device->GetBackBufferCount(), m_device->GetFramesInFlight());
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&initInfo, m_renderPass);
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    if (m_window) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    }
 
     // フォントテクスチャの準備.
     auto command = m_device->CreateCommandBuffer();
@@ -833,7 +840,9 @@ void IntersectionScene::InitializeImGui()
 
 void IntersectionScene::DestroyImGui()
 {
-    ImGui_ImplGlfw_Shutdown();
+    if (m_window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui_ImplVulkan_Shutdown();
     ImGui::DestroyContext();
 
@@ -848,7 +857,14 @@ void IntersectionScene::UpdateHUD()
 {
     // ImGui
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (m_window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        // ヘッドレス実行ではウィンドウが無いので表示サイズを直接設定する.
+        auto& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(GetWidth()), float(GetHeight()));
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 
     ImGui::Begin("Information");
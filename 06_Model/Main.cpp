@@ -15,10 +15,18 @@
 int APIENTRY wWinMain(
     _In_ HINSTANCE hInstance,
     _In_opt_ HINSTANCE /*hPrevInstance*/,
-    _In_ LPWSTR /*cmdline*/,
+    _In_ LPWSTR cmdline,
     _In_ int /*nCmdShow*/)
 {
     ModelScene theApp;
+    BookFramework::HeadlessOptions options;
+    if (BookFramework::ParseHeadlessOptions(cmdline, options)) {
+        theApp.SetHeadless(options);
+    }
+    ModelScene::BenchmarkOptions benchmark;
+    if (ModelScene::ParseBenchmarkOptions(cmdline, benchmark)) {
+        theApp.SetBenchmark(benchmark);
+    }
     return theApp.Run();
 }
 
@@ -1,16 +1,67 @@
 ﻿#include "ModelScene.h"
+#include "CpuProfiler.h"
+#include "DescriptorBuffer.h"
+#include "util/ThreadPool.h"
 #include <glm/gtx/transform.hpp>
+#include <chrono>
+#include <fstream>
 #include <random>
 #include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef WIN32_LEAN_AND_MEAN
+# define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+# define NOMINMAX
+#endif
+#include <Windows.h>
 
 // For ImGui
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
 
+namespace {
+    // 記録時間の平均をとるフレーム数.
+    const uint32_t RecordSampleFrames = 60;
+    // スイープで各スレッド数について計測を始めるまでに捨てるフレーム数.
+    const uint32_t RecordSweepWarmupFrames = 10;
+}
+
+ModelScene::ModelScene() : BookFramework("Model Scene")
+{
+    // 共有スレッドプールのワーカーと, 呼び出し元のスレッドで記録する.
+    m_commandRecordingThreads = util::ThreadPool::GetShared().GetThreadCount() + 1;
+}
+
+bool ModelScene::ParseBenchmarkOptions(const std::wstring& commandLine, BenchmarkOptions& options)
+{
+    std::wistringstream ss(commandLine);
+    std::wstring arg;
+    bool found = false;
+    while (ss >> arg) {
+        if (arg == L"--actors") {
+            ss >> options.actorCount;
+            found = true;
+        } else if (arg == L"--record-sweep") {
+            options.recordSweep = true;
+            found = true;
+        } else if (arg == L"--no-descriptor-buffer") {
+            options.descriptorBuffer = false;
+            found = true;
+        }
+    }
+    return found;
+}
+
 void ModelScene::OnInit()
 {
     m_materialManager.Create(m_device);
+    if (m_materialManager.UsesDescriptorBuffer()) {
+        m_descriptorBuffer = m_device->GetDescriptorBuffer();
+    }
 
     // シーンに配置するジオメトリを準備します.
     CreateSceneGeometries();
@@ -38,7 +89,7 @@ void ModelScene::OnInit()
 
     // 各UniformBufferを生成.
     m_sceneUBO.Initialize(m_device, sizeof(SceneParam),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 
     // レイトレーシングパイプラインを構築する.
     CreateRaytracePipeline();
@@ -56,6 +107,20 @@ void ModelScene::OnInit()
     // ImGui の初期化.
     InitializeImGui();
 
+    // CPU 区間計測の負荷を測っておく(HUD に表示).
+    m_cpuScopeOverhead = CpuProfiler::MeasureScopeOverhead();
+    m_cpuTimestampCost = CpuProfiler::MeasureTimestampCost();
+
+    // スイープでは 1 スレッドから倍々に, 最後は使用できるすべてのスレッドで計測する.
+    if (m_benchmark.recordSweep) {
+        auto maxThreads = m_device->GetCommandRecordingThreadCount();
+        for (uint32_t count = 1; count < maxThreads; count *= 2) {
+            m_recordStats.sweepThreadCounts.push_back(count);
+        }
+        m_recordStats.sweepThreadCounts.push_back(maxThreads);
+        m_commandRecorder.SetMaxThreadCount(m_recordStats.sweepThreadCounts[0]);
+    }
+
     // 初期パラメータ設定.
     auto eye = glm::vec3(0.0f, 2.0f, 3.0f);
     auto target = glm::vec3(0.0f, 1.4f, 0.0f);
@@ -78,7 +143,6 @@ void ModelScene::OnDestroy()
 {
     m_sceneUBO.Destroy(m_device);
     m_device->DestroyBuffer(m_objectsSBO);
-    m_device->DestroyBuffer(m_materialsSBO);
     m_instancesBuffer.Destroy(m_device);
     m_topLevelAS.Destroy(m_device);
 
@@ -86,6 +150,10 @@ void ModelScene::OnDestroy()
     m_actorTeapot0->Destroy(m_device);
     m_actorTeapot1->Destroy(m_device);
     m_actorChara->Destroy(m_device);
+    for (auto& actor : m_benchmarkActors) {
+        actor->Destroy(m_device);
+    }
+    m_benchmarkActors.clear();
     
     m_meshPlane->Destroy(m_device);
 
@@ -98,8 +166,16 @@ void ModelScene::OnDestroy()
     m_device->DestroyBuffer(m_shaderBindingTable);
     m_materialManager.Destroy(m_device);
 
-    m_device->DeallocateDescriptorSet(m_descriptorSet);
-    m_device->DeallocateDescriptorSet(m_descriptorSetCompute);
+    if (m_descriptorSet != VK_NULL_HANDLE) {
+        m_device->DeallocateDescriptorSet(m_descriptorSet);
+    }
+    for (auto& actor : m_skinnedActors) {
+        for (auto descriptorSet : actor.descriptorSets) {
+            m_device->DeallocateDescriptorSet(descriptorSet);
+        }
+    }
+    m_skinnedActors.clear();
+    m_dynamicActors.clear();
 
     m_shaderGroupHelper.Destroy(m_device);
 
@@ -141,6 +217,22 @@ void ModelScene::OnUpdate()
         }
     }
 
+    // ベンチマーク用のキャラクターは時間で動かす(先頭は m_actorChara).
+    m_benchmarkTime += 1.0f / 60.0f;
+    for (size_t i = 1; i < m_skinnedActors.size(); ++i) {
+        auto& actor = m_skinnedActors[i];
+        auto t = m_benchmarkTime * 2.0f + float(i) * 0.37f;
+        if (actor.elbowL) {
+            actor.elbowL->SetRotation(glm::angleAxis(glm::radians(75.0f + 75.0f * sinf(t)), glm::vec3(0, 0, 1)));
+        }
+        if (actor.elbowR) {
+            actor.elbowR->SetRotation(glm::angleAxis(glm::radians(75.0f + 75.0f * cosf(t)), glm::vec3(0, 0, 1)));
+        }
+        if (actor.neck) {
+            actor.neck->SetRotation(glm::angleAxis(glm::radians(15.0f + 30.0f * sinf(t * 0.5f)), glm::vec3(1, 0, 0)));
+        }
+    }
+
     // 配置情報更新.
     DeployObjects();
 }
@@ -156,6 +248,11 @@ void ModelScene::OnRender()
     if (p) {
         memcpy(p, &m_sceneParam, sizeof(m_sceneParam));
     }
+    // 変更のあったマテリアルだけをこのフレームの領域へ反映.
+    m_materialManager.UpdateMaterialBuffer(frameIndex);
+    if (m_materialBufferVersion != m_materialManager.GetMaterialBufferVersion()) {
+        UpdateMaterialDescriptors();
+    }
 
 
     VkCommandBufferBeginInfo commandBI{
@@ -163,72 +260,123 @@ void ModelScene::OnRender()
         nullptr, 0, nullptr
     };
     vkBeginCommandBuffer(command, &commandBI);
+    auto& profiler = m_device->GetGpuProfiler();
+    auto recordStart = std::chrono::steady_clock::now();
 
     // 行列の更新.
-    m_actorTable->ApplyTransform(m_device);
+    //  毎フレーム BLAS を更新するモデルは, 下の記録処理の中で行う.
     m_actorTeapot0->ApplyTransform(m_device);
     m_actorTeapot1->ApplyTransform(m_device);
-    m_actorChara->ApplyTransform(m_device);
 
     // スキニングによる頂点変形.
-    if (m_actorChara) {
-        std::vector<uint32_t> offsets = {
-            uint32_t(m_actorChara->GetJointMatricesBuffer().GetBlockSize()) * frameIndex
-        };
-
-        // Graphics キューを使ってComputeのパイプラインを実行する.
-        vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_COMPUTE, m_computeSkiningPipeline);
-        vkCmdBindDescriptorSets(
-            command, VK_PIPELINE_BIND_POINT_COMPUTE,
-            m_pipelineLayoutSkinned, 0, 
-            1, &m_descriptorSetCompute,
-            uint32_t(offsets.size()),
-            offsets.data()
-        );
-
-        // スキニング計算をコンピュートシェーダーで実行.
-        // * この実装の並列性はよくない 
-        auto vertexCount = m_actorChara->GetSkinnedVertexCount();
-        vkCmdDispatch(command, vertexCount, 1, 1);
+    //  変形後の頂点と BLAS はフレームごとにあるので, 前のフレームのレイトレースと並行して
+    //  コンピュートキューで計算と BLAS 更新を行う. 専用のキューが無ければ Graphics キューで実行される.
+    //  モデルごとの行列の反映と記録はワーカースレッドで分担し, セカンダリコマンドバッファから実行する.
+    std::vector<vk::GraphicsDevice::QueueWait> frameWaits;
+    if (!m_skinnedActors.empty()) {
+        auto computeCommand = m_device->AllocateFrameCommandBuffer(vk::GraphicsDevice::QueueCompute, 0);
+        vkBeginCommandBuffer(computeCommand, &commandBI);
+        auto skinningScope = profiler.BeginScope(computeCommand, "Skinning", vk::GraphicsDevice::QueueCompute);
+
+        auto dispatchScope = profiler.BeginScope(computeCommand, "SkinningDispatch", vk::GraphicsDevice::QueueCompute);
+        m_commandRecorder.Record(m_device, vk::GraphicsDevice::QueueCompute, computeCommand, m_skinnedActors.size(),
+            [&](VkCommandBuffer recordCommand, size_t begin, size_t end) {
+            vkCmdBindPipeline(recordCommand, VK_PIPELINE_BIND_POINT_COMPUTE, m_computeSkiningPipeline);
+            for (size_t i = begin; i < end; ++i) {
+                auto& actor = m_skinnedActors[i];
+                actor.mesh->ApplyTransform(m_device);
+
+                uint32_t offsets[] = {
+                    uint32_t(actor.mesh->GetJointMatricesBuffer().GetBlockSize()) * frameIndex
+                };
+                vkCmdBindDescriptorSets(
+                    recordCommand, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    m_pipelineLayoutSkinned, 0,
+                    1, &actor.descriptorSets[frameIndex],
+                    _countof(offsets), offsets
+                );
+
+                // スキニング計算をコンピュートシェーダーで実行.
+                // * この実装の並列性はよくない 
+                vkCmdDispatch(recordCommand, actor.mesh->GetSkinnedVertexCount(), 1, 1);
+            }
+        });
+        profiler.EndScope(computeCommand, dispatchScope);
 
         // この計算結果で BLAS 更新をするため、バリアを設定する.
         VkMemoryBarrier barrier{
             VK_STRUCTURE_TYPE_MEMORY_BARRIER,
         };
-        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
         vkCmdPipelineBarrier(
-            command,
-            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            computeCommand,
             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
             0, 1, &barrier,
             0, nullptr,
             0, nullptr
         );
+        auto blasScope = profiler.BeginScope(computeCommand, "UpdateBlas(Skinned)", vk::GraphicsDevice::QueueCompute);
+        m_commandRecorder.Record(m_device, vk::GraphicsDevice::QueueCompute, computeCommand, m_skinnedActors.size(),
+            [&](VkCommandBuffer recordCommand, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                m_skinnedActors[i].mesh->UpdateBlas(recordCommand, frameIndex);
+            }
+        });
+        profiler.EndScope(computeCommand, blasScope);
+        profiler.EndScope(computeCommand, skinningScope);
+        vkEndCommandBuffer(computeCommand);
+
+        // このフレームの TLAS 構築とレイトレースは計算の完了を待つ.
+        auto computeValue = m_device->Submit(vk::GraphicsDevice::QueueCompute, computeCommand);
+        frameWaits.push_back({
+            vk::GraphicsDevice::QueueCompute, computeValue,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR });
     }
 
-    // BLAS 更新.
-    m_actorTable->UpdateBlas(command);
-    m_actorChara->UpdateBlas(command);
-
-    // TLAS を更新する.
-    UpdateSceneTLAS();
+    // BLAS と TLAS を更新する.
+    //  TLAS は最後の要素として記録するので, 実行はすべての BLAS 更新の後になる.
+    auto asScope = profiler.BeginScope(command, "UpdateBlas+TLAS");
+    m_commandRecorder.Record(m_device, vk::GraphicsDevice::QueueGraphics, command, m_dynamicActors.size() + 1,
+        [&](VkCommandBuffer recordCommand, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (i < m_dynamicActors.size()) {
+                m_dynamicActors[i]->ApplyTransform(m_device);
+                m_dynamicActors[i]->UpdateBlas(recordCommand, frameIndex);
+            } else {
+                UpdateSceneTLAS(recordCommand);
+            }
+        }
+    });
+    profiler.EndScope(command, asScope);
+    UpdateRecordStats(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count());
 
     // レイトレーシングを行う.
-    uint32_t offsets[] = {
-        uint32_t(m_sceneUBO.GetBlockSize() * frameIndex),
-    };
-    std::vector<VkDescriptorSet> descriptorSets = {
-        m_descriptorSet
-    };
-
     vkCmdBindPipeline(command, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_raytracePipeline);
-    vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0,
-        uint32_t(descriptorSets.size()), descriptorSets.data(),
-        _countof(offsets), offsets);
+    if (m_descriptorBuffer) {
+        std::vector<VkDeviceSize> setOffsets = {
+            m_sceneSetOffsets[frameIndex],
+            m_materialManager.GetTextureSetOffset(),
+        };
+        m_descriptorBuffer->Bind(command, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0, setOffsets);
+    } else {
+        uint32_t offsets[] = {
+            uint32_t(m_sceneUBO.GetBlockSize() * frameIndex),
+            uint32_t(m_materialManager.GetMaterialBufferBlockSize() * frameIndex),
+        };
+        std::vector<VkDescriptorSet> descriptorSets = {
+            m_descriptorSet,
+            m_materialManager.GetTextureSet(),
+        };
+        vkCmdBindDescriptorSets(command, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_pipelineLayout, 0,
+            uint32_t(descriptorSets.size()), descriptorSets.data(),
+            _countof(offsets), offsets);
+    }
 
     auto area = m_device->GetRenderArea().extent;
     VkStridedDeviceAddressRegionKHR callable_shader_sbt_entry{};
+    auto traceScope = profiler.BeginScope(command, "TraceRays");
     vkCmdTraceRaysKHR(
         command,
         m_sbtHelper.GetRaygenRegion(),
@@ -237,14 +385,17 @@ void ModelScene::OnRender()
         &callable_shader_sbt_entry,
         area.width, area.height, 1
     );
+    profiler.EndScope(command, traceScope);
 
     // レイトレーシング結果画像をバックバッファへコピー.
-    auto backbuffer = m_device->GetRenderTarget(frameIndex);
+    auto backBufferIndex = m_device->GetCurrentBackBufferIndex();
+    auto backbuffer = m_device->GetRenderTarget(backBufferIndex);
     VkImageCopy region{};
     region.extent = { area.width, area.height, 1 };
     region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
     region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
 
+    auto copyScope = profiler.BeginScope(command, "CopyToBackBuffer");
     m_raytracedImage.BarrierToSrc(command);
     backbuffer.BarrierToDst(command);
 
@@ -255,6 +406,7 @@ void ModelScene::OnRender()
 
     // 次回の書き込みに備えて状態遷移.
     m_raytracedImage.BarrierToGeneral(command);
+    profiler.EndScope(command, copyScope);
 
     // ImGui によるラスタライズ描画パスを実行.
     VkClearValue clearValue = {
@@ -264,10 +416,11 @@ void ModelScene::OnRender()
       VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
       nullptr,
       m_renderPass,
-      m_framebuffers[frameIndex],
+      m_framebuffers[backBufferIndex],
       m_device->GetRenderArea(),
       1, &clearValue
     };
+    auto imguiScope = profiler.BeginScope(command, "ImGui");
     vkCmdBeginRenderPass(command, &rpBI, VK_SUBPASS_CONTENTS_INLINE);
 
     // ImGui の描画はここで行う.
@@ -277,11 +430,12 @@ void ModelScene::OnRender()
     // レンダーパスが終了するとバックバッファは
     // TRANSFER_DST_OPTIMAL->PRESENT_SRC_KHR へレイアウト変更が適用される.
     vkCmdEndRenderPass(command);
+    profiler.EndScope(command, imguiScope);
 
     vkEndCommandBuffer(command);
 
     // コマンドを実行して画面表示.
-    m_device->SubmitCurrentFrameCommandBuffer();
+    m_device->SubmitCurrentFrameCommandBuffer(frameWaits);
     m_device->Present();
 }
 
@@ -387,6 +541,14 @@ void ModelScene::CreateSceneGeometries()
         ci.model = &m_modelChara;
         m_actorChara->Create(m_device, ci, m_materialManager);
         m_actorChara->SetHitShader(AppHitShaderGroups::GroupHitModel);
+
+        // 記録の並列化の評価用に, 同じキャラクターを追加で配置する.
+        for (uint32_t i = 0; i < m_benchmark.actorCount; ++i) {
+            auto actor = std::make_shared<ModelMesh>();
+            actor->Create(m_device, ci, m_materialManager);
+            actor->SetHitShader(AppHitShaderGroups::GroupHitModel);
+            m_benchmarkActors.push_back(actor);
+        }
     }
 
 }
@@ -397,18 +559,36 @@ void ModelScene::CreateSceneBLAS()
     buildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
     buildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
 
+    // 更新しない BLAS はコンパクションしてメモリを節約する.
+    VkBuildAccelerationStructureFlagsKHR staticBuildFlags = 0;
+    staticBuildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    staticBuildFlags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+
+    // 各 BLAS の構築要求をまとめて, 1回の送信で構築する.
+    //  前回の起動で保存したものがあればキャッシュから復元する.
+    AccelerationStructureBuilder builder;
+    if (m_asCache.Initialize(m_device, L"cache/as")) {
+        builder.SetCache(&m_asCache);
+    }
+
     // Plane BLAS の生成.
-    m_meshPlane->BuildAS(m_device, buildFlags);
+    m_meshPlane->BuildAS(m_device, builder, staticBuildFlags);
    
     // Table BLAS
-    m_actorTable->BuildAS(m_device, buildFlags);
+    m_actorTable->BuildAS(m_device, builder, buildFlags);
 
     // Teapot BLAS
-    m_actorTeapot0->BuildAS(m_device, buildFlags);
-    m_actorTeapot1->BuildAS(m_device, buildFlags);
+    m_actorTeapot0->BuildAS(m_device, builder, staticBuildFlags);
+    m_actorTeapot1->BuildAS(m_device, builder, staticBuildFlags);
 
     // Character BLAS
-    m_actorChara->BuildAS(m_device, buildFlags);
+    m_actorChara->BuildAS(m_device, builder, buildFlags);
+    for (auto& actor : m_benchmarkActors) {
+        actor->BuildAS(m_device, builder, buildFlags);
+    }
+
+    builder.Build(m_device);
+    m_blasCompactionResults = builder.GetCompactionResults();
 }
 
 void ModelScene::CreateSceneTLAS()
@@ -499,10 +679,11 @@ void ModelScene::CreateRaytracePipeline()
     rtPipelineCI.pGroups = m_shaderGroupHelper.GetShaderGroups();
     rtPipelineCI.maxPipelineRayRecursionDepth = 1;
     rtPipelineCI.layout = m_pipelineLayout;
+    if (m_descriptorBuffer) {
+        rtPipelineCI.flags |= vk::DescriptorBuffer::GetPipelineCreateFlags();
+    }
 
-    vkCreateRayTracingPipelinesKHR(
-        m_device->GetDevice(), VK_NULL_HANDLE, VK_NULL_HANDLE,
-        1, &rtPipelineCI, nullptr, &m_raytracePipeline);
+    m_raytracePipeline = m_device->CreateRayTracingPipeline(rtPipelineCI, "raytrace");
 }
 
 void ModelScene::CreateComputeSkinningPipeline()
@@ -516,7 +697,7 @@ void ModelScene::CreateComputeSkinningPipeline()
     compPipelineCI.layout = m_pipelineLayoutSkinned;
     compPipelineCI.stage = shaderStage;
 
-    vkCreateComputePipelines(m_device->GetDevice(), VK_NULL_HANDLE, 1, &compPipelineCI, nullptr, &m_computeSkiningPipeline);
+    m_computeSkiningPipeline = m_device->CreateComputePipeline(compPipelineCI, "computeSkinning");
     vkDestroyShaderModule(m_device->GetDevice(), shaderStage.module, nullptr);
 }
 
@@ -541,19 +722,22 @@ void ModelScene::CreateShaderBindingTable()
     for( auto& obj : m_sceneObjects) {
         auto name = obj->GetHitShader();
         obj->SetHitShaderOffset(recordOffset);
-        auto count = obj->GetSceneObjectParameters().size();
-        for (const auto& v : obj->GetSceneObjectParameters()) {
-            std::vector<uint64_t> recordData{
-                v.indexBuffer,
-                v.vertexPosition,
-                v.vertexNormal,
-                v.vertexTexcoord,
-                v.blasTransformMatrices,
-            };
-            m_sbtHelper.AddHitShader(name.c_str(),recordData);
-        }
 
-        recordOffset += uint32_t(count);
+        // フレームごとに BLAS を持つオブジェクトは, フレームの数だけレコードを並べる.
+        for (int frame = 0; frame < obj->GetBlasFrameCount(); ++frame) {
+            auto objParams = obj->GetSceneObjectParameters(frame);
+            for (const auto& v : objParams) {
+                std::vector<uint64_t> recordData{
+                    v.indexBuffer,
+                    v.vertexPosition,
+                    v.vertexNormal,
+                    v.vertexTexcoord,
+                    v.blasTransformMatrices,
+                };
+                m_sbtHelper.AddHitShader(name.c_str(),recordData);
+            }
+            recordOffset += uint32_t(objParams.size());
+        }
     }
 
     auto sbtSize = m_sbtHelper.ComputeShaderBindingTableSize();
@@ -583,9 +767,11 @@ void ModelScene::CreateLayouts()
     layoutRtImage.descriptorCount = 1;
     layoutRtImage.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
 
+    // ディスクリプタバッファでは動的オフセットが使えないため, フレームごとのセットで UBO の位置を変える.
     VkDescriptorSetLayoutBinding layoutSceneUBO{};
     layoutSceneUBO.binding = 2;
-    layoutSceneUBO.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layoutSceneUBO.descriptorType = m_descriptorBuffer ?
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layoutSceneUBO.descriptorCount = 1;
     layoutSceneUBO.stageFlags = VK_SHADER_STAGE_ALL;
 
@@ -597,19 +783,15 @@ void ModelScene::CreateLayouts()
 
     VkDescriptorSetLayoutBinding layoutMaterialSBO{};
     layoutMaterialSBO.binding = 4;
-    layoutMaterialSBO.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutMaterialSBO.descriptorType = m_descriptorBuffer ?
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     layoutMaterialSBO.descriptorCount = 1;
     layoutMaterialSBO.stageFlags = VK_SHADER_STAGE_ALL;
 
-    VkDescriptorSetLayoutBinding layoutTextures{};
-    layoutTextures.binding = 5;
-    layoutTextures.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    layoutTextures.descriptorCount = m_materialManager.GetTextureCount();
-    layoutTextures.stageFlags = VK_SHADER_STAGE_ALL;
-
+    // テクスチャ配列は MaterialManager のセット(set=1)を使う.
     std::vector<VkDescriptorSetLayoutBinding> bindings({
         layoutAS, layoutRtImage, layoutSceneUBO, 
-        layoutObjectParamSBO, layoutMaterialSBO, layoutTextures
+        layoutObjectParamSBO, layoutMaterialSBO,
     });
 
     VkDescriptorSetLayoutCreateInfo dsLayoutCI{
@@ -617,8 +799,12 @@ void ModelScene::CreateLayouts()
     };
     dsLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
     dsLayoutCI.pBindings = bindings.data();
+    if (m_descriptorBuffer) {
+        dsLayoutCI.flags = vk::DescriptorBuffer::GetSetLayoutCreateFlags();
+    }
     vkCreateDescriptorSetLayout(
         m_device->GetDevice(), &dsLayoutCI, nullptr, &m_dsLayout);
+    dsLayoutCI.flags = 0;   // スキニング用はディスクリプタセットのまま.
 
     // Pipeline Layout
 
@@ -626,7 +812,8 @@ void ModelScene::CreateLayouts()
         VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO
     };
     std::vector<VkDescriptorSetLayout> layouts = {
-        m_dsLayout
+        m_dsLayout,
+        m_materialManager.GetTextureSetLayout(),
     };
     pipelineLayoutCI.setLayoutCount = uint32_t(layouts.size());
     pipelineLayoutCI.pSetLayouts = layouts.data();
@@ -669,6 +856,12 @@ void ModelScene::CreateLayouts()
 
 void ModelScene::CreateDescriptorSets()
 {
+    CPU_PROFILE_SCOPE("ModelScene::CreateDescriptorSets");
+    m_materialBufferVersion = m_materialManager.GetMaterialBufferVersion();
+    if (m_descriptorBuffer) {
+        CreateSceneDescriptorBuffer();
+        return;
+    }
     m_descriptorSet = m_device->AllocateDescriptorSet(m_dsLayout);
 
     std::vector<VkAccelerationStructureKHR> asHandles = {
@@ -726,9 +919,7 @@ void ModelScene::CreateDescriptorSets()
     objectInfoWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
     objectInfoWrite.pBufferInfo = &objectInfoDescriptor;
 
-    VkDescriptorBufferInfo materialInfoDescriptor{};
-    materialInfoDescriptor.buffer = m_materialsSBO.GetBuffer();
-    materialInfoDescriptor.range = VK_WHOLE_SIZE;
+    auto materialInfoDescriptor = m_materialManager.GetMaterialBufferDescriptor();
 
     VkWriteDescriptorSet materialInfoWrite{
         VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET
@@ -736,7 +927,7 @@ void ModelScene::CreateDescriptorSets()
     materialInfoWrite.dstSet = m_descriptorSet;
     materialInfoWrite.dstBinding = 4;
     materialInfoWrite.descriptorCount = 1;
-    materialInfoWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    materialInfoWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     materialInfoWrite.pBufferInfo = &materialInfoDescriptor;
 
     std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
@@ -750,33 +941,58 @@ void ModelScene::CreateDescriptorSets()
         0,
         nullptr);
 
-    // 各モデル用のテクスチャをディスクリプタに書き込む.
-    auto textureDescriptors = m_materialManager.GetTextureDescriptors();
-    VkWriteDescriptorSet texturesImageWrite{
+    // 各モデル用のテクスチャは MaterialManager が登録時にセットへ書き込んでいる.
+}
+
+void ModelScene::CreateSceneDescriptorBuffer()
+{
+    // 動的オフセットの代わりに, フレームごとに UBO とマテリアルの位置だけが異なるセットを用意する.
+    const auto framesInFlight = m_device->GetFramesInFlight();
+    m_sceneSetOffsets.clear();
+    for (uint32_t frame = 0; frame < framesInFlight; ++frame) {
+        auto setOffset = m_descriptorBuffer->AllocateSet(m_dsLayout);
+        if (setOffset == vk::DescriptorBuffer::InvalidOffset) {
+            throw std::runtime_error("failed to allocate the scene descriptors.");
+        }
+        m_descriptorBuffer->WriteAccelerationStructure(m_dsLayout, setOffset, 0, m_topLevelAS.GetDeviceAddress());
+        m_descriptorBuffer->WriteImage(m_dsLayout, setOffset, 1, 0,
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, *m_raytracedImage.GetDescriptor());
+        m_descriptorBuffer->WriteBuffer(m_dsLayout, setOffset, 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            m_sceneUBO.GetDeviceAddress(frame), m_sceneUBO.GetBlockSize());
+        m_descriptorBuffer->WriteBuffer(m_dsLayout, setOffset, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            m_objectsSBO.GetDeviceAddress(), m_objectsSBO.GetSize());
+        m_descriptorBuffer->WriteBuffer(m_dsLayout, setOffset, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            m_materialManager.GetMaterialBufferAddress(frame), m_materialManager.GetMaterialBufferBlockSize());
+        m_sceneSetOffsets.push_back(setOffset);
+    }
+}
+
+void ModelScene::UpdateMaterialDescriptors()
+{
+    // MaterialManager は GPU の処理の完了を待ってから作り直しているので, すぐに書き換えてよい.
+    m_materialBufferVersion = m_materialManager.GetMaterialBufferVersion();
+    if (m_descriptorBuffer) {
+        for (uint32_t frame = 0; frame < uint32_t(m_sceneSetOffsets.size()); ++frame) {
+            m_descriptorBuffer->WriteBuffer(m_dsLayout, m_sceneSetOffsets[frame], 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                m_materialManager.GetMaterialBufferAddress(frame), m_materialManager.GetMaterialBufferBlockSize());
+        }
+        return;
+    }
+    auto materialInfoDescriptor = m_materialManager.GetMaterialBufferDescriptor();
+    VkWriteDescriptorSet materialInfoWrite{
         VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET
     };
-    texturesImageWrite.dstSet = m_descriptorSet;
-    texturesImageWrite.dstBinding = 5;
-    texturesImageWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    texturesImageWrite.descriptorCount = uint32_t(textureDescriptors.size());
-    texturesImageWrite.pImageInfo = textureDescriptors.data();
-
-    vkUpdateDescriptorSets(
-        m_device->GetDevice(),
-        1, &texturesImageWrite, 0, nullptr);
+    materialInfoWrite.dstSet = m_descriptorSet;
+    materialInfoWrite.dstBinding = 4;
+    materialInfoWrite.descriptorCount = 1;
+    materialInfoWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    materialInfoWrite.pBufferInfo = &materialInfoDescriptor;
+    vkUpdateDescriptorSets(m_device->GetDevice(), 1, &materialInfoWrite, 0, nullptr);
 }
 
 void ModelScene::CreateDescriptorSetsSkinned()
 {
-    m_descriptorSetCompute = m_device->AllocateDescriptorSet(m_dsLayoutSkinned);
-    auto srcPosDescriptor = m_actorChara->GetPositionBufferSrc().GetDescriptor();
-    auto srcNormalDescriptor = m_actorChara->GetNormalBufferSrc().GetDescriptor();
-    auto srcJointWeightsDescriptor = m_actorChara->GetJointWeightsBuffer().GetDescriptor();
-    auto srcJointIndicesDescriptor = m_actorChara->GetJointIndicesBuffer().GetDescriptor();
-    auto srcJointMatricesDescriptor = m_actorChara->GetJointMatricesBuffer().GetDescriptor();
-    auto dstPosDescriptor = m_actorChara->GetPositionTransformedBuffer().GetDescriptor();
-    auto dstNormalDescriptor = m_actorChara->GetNormalTransformedBuffer().GetDescriptor();
-
+    CPU_PROFILE_SCOPE("ModelScene::CreateDescriptorSetsSkinned");
     auto makeWriteDescriptorSet = [](
         VkDescriptorSet dstSet, int binding, const VkDescriptorBufferInfo* pBufferInfo, VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
     {
@@ -790,18 +1006,40 @@ void ModelScene::CreateDescriptorSetsSkinned()
         write.pBufferInfo = pBufferInfo;
         return write;
     };
-    auto dstDS = m_descriptorSetCompute;
-    std::vector<VkWriteDescriptorSet> writes = {
-        makeWriteDescriptorSet(dstDS, 0, &srcPosDescriptor),
-        makeWriteDescriptorSet(dstDS, 1, &srcNormalDescriptor),
-        makeWriteDescriptorSet(dstDS, 2, &srcJointWeightsDescriptor),
-        makeWriteDescriptorSet(dstDS, 3, &srcJointIndicesDescriptor),
-        makeWriteDescriptorSet(
-            dstDS, 4, &srcJointMatricesDescriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC),
-        makeWriteDescriptorSet(dstDS, 5, &dstPosDescriptor),
-        makeWriteDescriptorSet(dstDS, 6, &dstNormalDescriptor),
-    };
-    vkUpdateDescriptorSets(m_device->GetDevice(), uint32_t(writes.size()), writes.data(), 0, nullptr);
+
+    // 変形後の書き込み先はフレームごとの領域を指すようにする.
+    const auto framesInFlight = m_device->GetFramesInFlight();
+    for (auto& actor : m_skinnedActors) {
+        const auto& mesh = actor.mesh;
+        auto srcPosDescriptor = mesh->GetPositionBufferSrc().GetDescriptor();
+        auto srcNormalDescriptor = mesh->GetNormalBufferSrc().GetDescriptor();
+        auto srcJointWeightsDescriptor = mesh->GetJointWeightsBuffer().GetDescriptor();
+        auto srcJointIndicesDescriptor = mesh->GetJointIndicesBuffer().GetDescriptor();
+        auto srcJointMatricesDescriptor = mesh->GetJointMatricesBuffer().GetDescriptor();
+        auto dstPosBuffer = mesh->GetPositionTransformedBuffer().GetBuffer();
+        auto dstNormalBuffer = mesh->GetNormalTransformedBuffer().GetBuffer();
+
+        for (uint32_t frame = 0; frame < framesInFlight; ++frame) {
+            auto dstDS = m_device->AllocateDescriptorSet(m_dsLayoutSkinned);
+            auto offset = mesh->GetTransformedFrameOffset(frame);
+            auto range = mesh->GetTransformedFrameSize();
+            VkDescriptorBufferInfo dstPosDescriptor{ dstPosBuffer, offset, range };
+            VkDescriptorBufferInfo dstNormalDescriptor{ dstNormalBuffer, offset, range };
+
+            std::vector<VkWriteDescriptorSet> writes = {
+                makeWriteDescriptorSet(dstDS, 0, &srcPosDescriptor),
+                makeWriteDescriptorSet(dstDS, 1, &srcNormalDescriptor),
+                makeWriteDescriptorSet(dstDS, 2, &srcJointWeightsDescriptor),
+                makeWriteDescriptorSet(dstDS, 3, &srcJointIndicesDescriptor),
+                makeWriteDescriptorSet(
+                    dstDS, 4, &srcJointMatricesDescriptor, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC),
+                makeWriteDescriptorSet(dstDS, 5, &dstPosDescriptor),
+                makeWriteDescriptorSet(dstDS, 6, &dstNormalDescriptor),
+            };
+            vkUpdateDescriptorSets(m_device->GetDevice(), uint32_t(writes.size()), writes.data(), 0, nullptr);
+            actor.descriptorSets.push_back(dstDS);
+        }
+    }
 }
 
 void ModelScene::InitializeImGui()
@@ -819,7 +1057,7 @@ void ModelScene::InitializeImGui()
         colorTarget.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorTarget.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorTarget.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        colorTarget.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorTarget.finalLayout = m_device->GetPresentLayout();
 
         VkAttachmentReference colorRef{
           0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
@@ -872,14 +1110,17 @@ void ModelScene::InitializeImGui()
     initInfo.Device = m_device->GetDevice();
     initInfo.QueueFamily = m_device->GetGraphicsQueueFamily();
     initInfo.Queue = m_device->GetDefaultQueue();
+    initInfo.PipelineCache = m_device->GetPipelineCache();
     initInfo.DescriptorPool = m_device->GetDescriptorPool();
     initInfo.Subpass = 0;
     initInfo.MinImageCount = m_device->GetBackBufferCount();
-    initInfo.ImageCount = m_device->GetBackBufferCount();
+    initInfo.ImageCount = (std::max)(m_device->GetBackBufferCount(), m_device->GetFramesInFlight());
     initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
     ImGui_ImplVulkan_Init(&initInfo, m_renderPass);
-    ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    if (m_window) {
+        ImGui_ImplGlfw_InitForVulkan(m_window, true);
+    }
 
     // フォントテクスチャの準備.
     auto command = m_device->CreateCommandBuffer();
@@ -891,7 +1132,9 @@ void ModelScene::InitializeImGui()
 
 void ModelScene::DestroyImGui()
 {
-    ImGui_ImplGlfw_Shutdown();
+    if (m_window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui_ImplVulkan_Shutdown();
     ImGui::DestroyContext();
 
@@ -906,27 +1149,140 @@ void ModelScene::UpdateHUD()
 {
     // ImGui
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (m_window) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        // ヘッドレス実行ではウィンドウが無いので表示サイズを直接設定する.
+        auto& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(float(GetWidth()), float(GetHeight()));
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
 
     ImGui::Begin("Information");
     ImGui::Text("%s", m_device->GetDeviceName());
     auto framerate = ImGui::GetIO().Framerate;
     ImGui::Text("frametime %.3f ms", 1000.0f / framerate);
+    ImGui::Text("Queue: compute %s, transfer %s",
+        m_device->HasDedicatedQueue(vk::GraphicsDevice::QueueCompute) ? "async" : "graphics",
+        m_device->HasDedicatedQueue(vk::GraphicsDevice::QueueTransfer) ? "dedicated" : "graphics");
 
     ImGui::SliderFloat("Elbow L", &m_guiParams.elbowL, 0.0f, 150.0f, "%.1f");
     ImGui::SliderFloat("Elbow R", &m_guiParams.elbowR, 0.0f, 150.0f, "%.1f");
     ImGui::SliderFloat("Neck", &m_guiParams.neck, -30.0f, 60.0f, "%.1f");
+
+    // メモリアロケータの使用状況.
+    if (ImGui::CollapsingHeader("Device Memory")) {
+        const auto memStats = m_device->GetMemoryAllocator().GetStatistics();
+        for (int i = 0; i < int(memStats.size()); ++i) {
+            const auto& heap = memStats[i];
+            if (heap.blockCount == 0) {
+                continue;
+            }
+            ImGui::Text("Heap%d: blocks %u, in use %.2f / %.2f MB, frag %.1f%%",
+                i, heap.blockCount,
+                heap.bytesInUse / (1024.0 * 1024.0),
+                heap.bytesReserved / (1024.0 * 1024.0),
+                heap.fragmentation * 100.0f);
+        }
+    }
+    // テクスチャのメモリ使用量(圧縮による削減量).
+    if (ImGui::CollapsingHeader("Textures")) {
+        const auto texStats = m_materialManager.GetTextureStatistics();
+        ImGui::Text("Count: %d (compressed %d)", texStats.textureCount, texStats.compressedCount);
+        ImGui::Text("VRAM: %.2f MB (RGBA8: %.2f MB)",
+            texStats.dataBytes / (1024.0 * 1024.0),
+            texStats.uncompressedBytes / (1024.0 * 1024.0));
+        ImGui::Text("Saved: %.2f MB",
+            (texStats.uncompressedBytes - texStats.dataBytes) / (1024.0 * 1024.0));
+        ImGui::Text("Shared: %d images (file %.2f MB, VRAM %.2f MB)", texStats.sharedCount,
+            texStats.sharedEncodedBytes / (1024.0 * 1024.0),
+            texStats.sharedDataBytes / (1024.0 * 1024.0));
+        ImGui::Text("Materials: %d (uploaded %u)",
+            m_materialManager.GetMaterialCount(), m_materialManager.GetMaterialUploadCount());
+    }
+    // BLAS コンパクションの結果.
+    if (ImGui::CollapsingHeader("BLAS Compaction")) {
+        VkDeviceSize totalBefore = 0, totalAfter = 0;
+        for (int i = 0; i < int(m_blasCompactionResults.size()); ++i) {
+            const auto& result = m_blasCompactionResults[i];
+            ImGui::Text("BLAS%d: %.1f KB -> %.1f KB", i,
+                result.originalSize / 1024.0, result.compactedSize / 1024.0);
+            totalBefore += result.originalSize;
+            totalAfter += result.compactedSize;
+        }
+        ImGui::Text("Total: %.1f KB -> %.1f KB", totalBefore / 1024.0, totalAfter / 1024.0);
+        ImGui::Text("Cache: hit %u, miss %u", m_asCache.GetHitCount(), m_asCache.GetMissCount());
+    }
+    // コマンド記録の並列化.
+    if (ImGui::CollapsingHeader("Command Recording")) {
+        ImGui::Text("Skinned actors: %d", int(m_skinnedActors.size()));
+        const auto& descriptors = m_device->GetDescriptorAllocator();
+        ImGui::Text("Descriptor sets: %u (%u pools)",
+            descriptors.GetAllocatedSetCount(), descriptors.GetPoolCount());
+        if (m_descriptorBuffer) {
+            ImGui::Text("Descriptor buffer: %.1f / %.1f KB",
+                m_descriptorBuffer->GetUsedSize() / 1024.0, m_descriptorBuffer->GetSize() / 1024.0);
+        } else {
+            ImGui::Text("Descriptor buffer: not available");
+        }
+        ImGui::Text("Record %7.3f ms (avg of %u frames)", m_recordStats.averageTime, RecordSampleFrames);
+        auto threadCount = int(m_commandRecorder.GetThreadCount(m_device));
+        auto maxThreads = int(m_device->GetCommandRecordingThreadCount());
+        if (ImGui::SliderInt("Threads", &threadCount, 1, maxThreads)) {
+            m_commandRecorder.SetMaxThreadCount(uint32_t(threadCount));
+        }
+        const auto& sweep = m_recordStats;
+        for (size_t i = 0; i < sweep.sweepResults.size(); ++i) {
+            ImGui::Text("%2u threads: %7.3f ms (x%.2f)", sweep.sweepThreadCounts[i],
+                sweep.sweepResults[i], sweep.sweepResults[0] / sweep.sweepResults[i]);
+        }
+    }
+    // CPU の区間ごとの処理時間(直前のフレームの結果).
+    if (ImGui::CollapsingHeader("CPU Profiler")) {
+        auto& profiler = CpuProfiler::Get();
+        ImGui::Text("Frame %7.3f ms, scope overhead %.1f ns (timestamp %.1f ns x2)",
+            profiler.GetFrameTime(), m_cpuScopeOverhead, m_cpuTimestampCost);
+#if !VKRAY_CPU_PROFILER
+        ImGui::Text("Disabled at compile time (VKRAY_CPU_PROFILER=0).");
+#endif
+        for (const auto& summary : profiler.GetFrameSummary()) {
+            ImGui::Text("%-40s %7.3f ms x%u (avg %7.3f)",
+                summary.name, summary.totalTime, summary.count, summary.averageTime);
+        }
+        if (profiler.IsCapturingTrace()) {
+            ImGui::Text("Capturing trace...");
+        } else if (ImGui::Button("Save CPU trace (120 frames)")) {
+            profiler.CaptureTrace(120, L"cpu_trace.json");
+        }
+    }
+    // GPU の区間ごとの処理時間(数フレーム前の結果).
+    if (ImGui::CollapsingHeader("GPU Profiler")) {
+        auto& profiler = m_device->GetGpuProfiler();
+        if (!profiler.IsEnabled()) {
+            ImGui::Text("Timestamp queries are not supported.");
+        }
+        for (const auto& result : profiler.GetResults()) {
+            ImGui::Text("%*s%-*s %7.3f ms (avg %7.3f)",
+                int(result.depth * 2), "", 24 - int(result.depth * 2), result.name,
+                result.duration, result.averageDuration);
+        }
+        if (profiler.IsCapturingTrace()) {
+            ImGui::Text("Capturing trace...");
+        } else if (ImGui::Button("Save trace (120 frames)")) {
+            profiler.CaptureTrace(120, L"gpu_trace.json");
+        }
+    }
     ImGui::End();
 }
 
-void ModelScene::UpdateSceneTLAS()
+void ModelScene::UpdateSceneTLAS(VkCommandBuffer command)
 {
-    auto command = m_device->GetCurrentFrameCommandBuffer();
+    CPU_PROFILE_SCOPE("ModelScene::UpdateSceneTLAS");
     auto frameIndex = m_device->GetCurrentFrameIndex();
 
     // VkAccelerationStructureInstanceKHR 配列を取得して書き込む.
-    auto asInstances = CreateAccelerationStructureIncenceFromSceneObjects();
+    auto asInstances = CreateAccelerationStructureIncenceFromSceneObjects(frameIndex);
     auto instancesBufferSize = sizeof(VkAccelerationStructureInstanceKHR) * asInstances.size();
     memcpy(m_instancesBuffer.Map(frameIndex), asInstances.data(), instancesBufferSize);
 
@@ -990,6 +1346,15 @@ void ModelScene::DeployObjects()
     m_actorChara->SetWorldMatrix(glm::translate(trans));
     m_actorChara->UpdateMatrices();
     count++;
+
+    // ベンチマーク用のキャラクターは床の奥に並べる.
+    const int columns = 16;
+    util::ThreadPool::GetShared().ParallelFor(m_benchmarkActors.size(), [&](size_t i) {
+        auto x = (int(i % columns) - (columns - 1) * 0.5f) * 0.6f;
+        auto z = -2.0f - int(i / columns) * 0.8f;
+        m_benchmarkActors[i]->SetWorldMatrix(glm::translate(glm::vec3(x, 0.0f, z)));
+        m_benchmarkActors[i]->UpdateMatrices();
+    });
 }
 
 void ModelScene::CreateSceneList()
@@ -1004,6 +1369,25 @@ void ModelScene::CreateSceneList()
     m_sceneObjects.push_back(m_actorTeapot1);
 
     m_sceneObjects.push_back(m_actorChara);
+    for (auto& actor : m_benchmarkActors) {
+        m_sceneObjects.push_back(actor);
+    }
+
+    // 毎フレーム更新するモデルの一覧.
+    m_dynamicActors = { m_actorTable };
+    m_skinnedActors.clear();
+    auto addSkinnedActor = [&](const std::shared_ptr<ModelMesh>& mesh) {
+        SkinnedActor actor;
+        actor.mesh = mesh;
+        actor.elbowL = mesh->SearchNode(L"ひじ.L");
+        actor.elbowR = mesh->SearchNode(L"ひじ.R");
+        actor.neck = mesh->SearchNode(L"首");
+        m_skinnedActors.push_back(actor);
+    };
+    addSkinnedActor(m_actorChara);
+    for (auto& actor : m_benchmarkActors) {
+        addSkinnedActor(actor);
+    }
 }
 
 void ModelScene::CreateSceneBuffers()
@@ -1025,12 +1409,10 @@ void ModelScene::CreateSceneBuffers()
     auto usage = \
         VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | \
         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-    auto materialData = m_materialManager.GetMaterialData();
-    auto materialBufSize = materialData.size() * sizeof(Material::DataBlock);
-    m_materialsSBO = m_device->CreateBuffer(
-        materialBufSize, usage, devMemProps
-    );
-    m_device->WriteToBuffer(m_materialsSBO, materialData.data(), materialBufSize);
+    // マテリアルは編集されるため, MaterialManager がフレームごとの領域を持つバッファに置く.
+    if (!m_materialManager.CreateMaterialBuffer(m_device)) {
+        throw std::runtime_error("failed to create the material buffer.");
+    }
 
     auto objectBufSize = sizeof(ObjectParam) * objParameters.size();
     m_objectsSBO = m_device->CreateBuffer(
@@ -1038,14 +1420,14 @@ void ModelScene::CreateSceneBuffers()
     m_device->WriteToBuffer(m_objectsSBO, objParameters.data(), objectBufSize);
 }
 
-std::vector<VkAccelerationStructureInstanceKHR> ModelScene::CreateAccelerationStructureIncenceFromSceneObjects()
+std::vector<VkAccelerationStructureInstanceKHR> ModelScene::CreateAccelerationStructureIncenceFromSceneObjects(int frameIndex)
 {
     std::vector<VkAccelerationStructureInstanceKHR> asInstances;
 
     int customIndex = 0;
     for (auto& obj : m_sceneObjects) {
         asInstances.emplace_back(
-            obj->GetAccelerationStructureInstance()
+            obj->GetAccelerationStructureInstance(frameIndex)
         );
         auto& asInstance = asInstances.back();
         asInstance.instanceCustomIndex = customIndex;
@@ -1054,3 +1436,52 @@ std::vector<VkAccelerationStructureInstanceKHR> ModelScene::CreateAccelerationSt
     }
     return asInstances;
 }
+
+void ModelScene::UpdateRecordStats(double recordTime)
+{
+    auto& stats = m_recordStats;
+    stats.totalTime += recordTime;
+    stats.frameCount++;
+
+    auto sweeping = stats.sweepStep < stats.sweepThreadCounts.size();
+    if (sweeping && stats.frameCount == RecordSweepWarmupFrames) {
+        // 切り替え直後のフレームは集計しない.
+        stats.totalTime = 0.0;
+    }
+    auto sampleFrames = sweeping ? RecordSweepWarmupFrames + RecordSampleFrames : RecordSampleFrames;
+    if (stats.frameCount < sampleFrames) {
+        return;
+    }
+    stats.averageTime = stats.totalTime / RecordSampleFrames;
+    stats.totalTime = 0.0;
+    stats.frameCount = 0;
+    if (!sweeping) {
+        return;
+    }
+
+    // 計測が終わったら次のスレッド数へ進む.
+    auto threadCount = stats.sweepThreadCounts[stats.sweepStep];
+    stats.sweepResults.push_back(stats.averageTime);
+    char text[128];
+    snprintf(text, sizeof(text), "Record sweep: %u actors, %u threads, %.3f ms (x%.2f)\n",
+        uint32_t(m_skinnedActors.size()), threadCount, stats.averageTime, stats.sweepResults[0] / stats.averageTime);
+    OutputDebugStringA(text);
+
+    stats.sweepStep++;
+    if (stats.sweepStep < stats.sweepThreadCounts.size()) {
+        m_commandRecorder.SetMaxThreadCount(stats.sweepThreadCounts[stats.sweepStep]);
+        return;
+    }
+
+    // すべて計測したら結果を CSV に書き出す.
+    std::ofstream outfile("record_benchmark.csv");
+    if (!outfile) {
+        OutputDebugStringA("Failed to write record_benchmark.csv.\n");
+        return;
+    }
+    outfile << "actors,threads,record_ms,speedup\n";
+    for (size_t i = 0; i < stats.sweepResults.size(); ++i) {
+        outfile << m_skinnedActors.size() << "," << stats.sweepThreadCounts[i] << ","
+            << stats.sweepResults[i] << "," << stats.sweepResults[0] / stats.sweepResults[i] << "\n";
+    }
+}
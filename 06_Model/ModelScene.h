@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include "AccelerationStructure.h"
+#include "AccelerationStructureCache.h"
 #include "Camera.h"
 
 #include "ShaderGroupHelper.h"
@@ -11,6 +12,7 @@
 #include "util/VkrModel.h"
 
 #include "MaterialManager.h"
+#include "ParallelCommandRecorder.h"
 #include "scene/SimplePolygonMesh.h"
 #include "scene/ModelMesh.h"
 
@@ -25,7 +27,24 @@ namespace AppHitShaderGroups {
 
 class ModelScene : public BookFramework {
 public:
-    ModelScene() : BookFramework("Model Scene") {}
+    ModelScene();
+
+    // コマンド記録の並列化を評価するための設定.
+    struct BenchmarkOptions {
+        uint32_t actorCount = 0;    // 追加で配置するスキニングモデルの数.
+        bool recordSweep = false;   // 記録に使うスレッド数を順に変えて記録時間を計測する.
+        bool descriptorBuffer = true; // VK_EXT_descriptor_buffer が使えれば使う(false で従来のディスクリプタセット).
+    };
+    // Run より前に設定する.
+    void SetBenchmark(const BenchmarkOptions& options)
+    {
+        m_benchmark = options;
+        m_useDescriptorBuffer = options.descriptorBuffer;
+    }
+
+    // コマンドライン引数からベンチマークの設定を読み取る. 指定が無ければ false.
+    //  [--actors N] [--record-sweep] [--no-descriptor-buffer]
+    static bool ParseBenchmarkOptions(const std::wstring& commandLine, BenchmarkOptions& options);
 
 protected:
     void OnInit() override;
@@ -66,6 +85,12 @@ private:
     // ディスクリプタセットの準備・書き込み.
     void CreateDescriptorSets();
 
+    // ディスクリプタバッファを使う場合のセット 0 の準備・書き込み.
+    void CreateSceneDescriptorBuffer();
+
+    // マテリアルバッファが作り直された場合に, 参照するディスクリプタを書き直す.
+    void UpdateMaterialDescriptors();
+
     // スキニングモデル用のディスクリプタセットの準備・書き込み.
     void CreateDescriptorSetsSkinned();
 
@@ -74,7 +99,10 @@ private:
     void DestroyImGui();
 
     void UpdateHUD();
-    void UpdateSceneTLAS();
+    void UpdateSceneTLAS(VkCommandBuffer command);
+
+    // コマンド記録時間を集計する. スイープ中は記録に使うスレッド数を切り替える.
+    void UpdateRecordStats(double recordTime);
 
     struct SceneParam
     {
@@ -107,7 +135,8 @@ private:
 
     // シーンに配置したオブジェクト情報から,
     // TLAS に必要な VkAccelerationStructureInstanceKHR配列を生成する.
-    std::vector<VkAccelerationStructureInstanceKHR> CreateAccelerationStructureIncenceFromSceneObjects();
+    //  frameIndex はフレームごとに BLAS を持つオブジェクトの参照先を選ぶのに使う.
+    std::vector<VkAccelerationStructureInstanceKHR> CreateAccelerationStructureIncenceFromSceneObjects(int frameIndex = 0);
 
     enum class MaterialType {
         LAMBERT = 0,
@@ -125,15 +154,20 @@ private:
 
     VkPipeline m_raytracePipeline;
     VkPipeline m_computeSkiningPipeline;
-    VkDescriptorSet m_descriptorSet;
-    VkDescriptorSet m_descriptorSetCompute;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    // VK_EXT_descriptor_buffer を使う場合はセット 0 をフレームごとにバッファへ置く(使わない場合は nullptr).
+    //  パイプラインではディスクリプタセットと混在できないため, MaterialManager のテクスチャに合わせて決める.
+    vk::DescriptorBuffer* m_descriptorBuffer = nullptr;
+    std::vector<VkDeviceSize> m_sceneSetOffsets;
+    // ディスクリプタに書き込んだマテリアルバッファの版.
+    uint32_t m_materialBufferVersion = 0;
 
     vk::BufferResource  m_shaderBindingTable;
 
     SceneParam m_sceneParam;
 
     util::DynamicBuffer m_sceneUBO;
-    vk::BufferResource  m_materialsSBO;
     vk::BufferResource  m_objectsSBO;
 
     Camera m_camera;
@@ -155,6 +189,49 @@ private:
     std::shared_ptr<ModelMesh> m_actorTeapot0;
     std::shared_ptr<ModelMesh> m_actorTeapot1;
     std::shared_ptr<ModelMesh> m_actorChara;
+    std::vector<std::shared_ptr<ModelMesh>> m_benchmarkActors;  // ベンチマーク用に追加したキャラクター.
+
+    // スキニング計算を行うモデル (m_actorChara と m_benchmarkActors).
+    struct SkinnedActor {
+        std::shared_ptr<ModelMesh> mesh;
+        std::vector<VkDescriptorSet> descriptorSets;    // スキニング計算用 (フレームごと).
+        std::shared_ptr<ModelMesh::ModelNode> elbowL;   // アニメーションで動かすノード.
+        std::shared_ptr<ModelMesh::ModelNode> elbowR;
+        std::shared_ptr<ModelMesh::ModelNode> neck;
+    };
+    std::vector<SkinnedActor> m_skinnedActors;
+
+    // 毎フレーム BLAS を更新する(スキニングしない)モデル.
+    std::vector<std::shared_ptr<ModelMesh>> m_dynamicActors;
+
+    // スキニング計算・BLAS/TLAS 更新のコマンドをワーカースレッドで記録する.
+    vk::ParallelCommandRecorder m_commandRecorder;
+
+    BenchmarkOptions m_benchmark;
+    float m_benchmarkTime = 0.0f;
+
+    // コマンド記録時間の集計.
+    struct RecordStats {
+        double averageTime = 0.0;   // 直近 SampleFrames フレームの平均(ミリ秒).
+        double totalTime = 0.0;
+        uint32_t frameCount = 0;
+
+        // スイープの状態と結果.
+        std::vector<uint32_t> sweepThreadCounts;
+        size_t sweepStep = 0;
+        std::vector<double> sweepResults;   // sweepThreadCounts に対応する平均(ミリ秒).
+    } m_recordStats;
+
+    // 静的な BLAS のコンパクション結果.
+    std::vector<AccelerationStructureBuilder::CompactionResult> m_blasCompactionResults;
+
+    // BLAS のディスクキャッシュ.
+    AccelerationStructureCache m_asCache;
+
+    // CPU 区間計測 1 回あたりの負荷(ナノ秒).
+    double m_cpuScopeOverhead = 0.0;
+    // そのうち時刻の取得 1 回分の負荷(ナノ秒). 区間ごとに 2 回取得する.
+    double m_cpuTimestampCost = 0.0;
 
     struct GUIParams {
         float elbowL = 0.0f;
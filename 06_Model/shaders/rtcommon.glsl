@@ -12,7 +12,10 @@
 #define BIND_SCENEPARAM     (2)
 #define BIND_OBJECTLIST     (3)
 #define BIND_MATERIALLIST   (4)
-#define BIND_TEXTURELIST    (5)
+
+// eNX`z MaterialManager Ǘ set=1 ɒu.
+#define SET_TEXTURELIST     (1)
+#define BIND_TEXTURELIST    (0)
 
 
 //---------------------------
@@ -23,6 +26,8 @@ struct MyHitPayload {
   vec3 rayOrigin;
   vec3 rayDirection;
   vec3 specular;
+  float coneWidth;   // CR[̕(eNX` LOD ̌vZp).
+  float coneSpread;  // CR[̍Lp.
 };
 struct MyShadowPayload {
   bool isHit;
@@ -64,4 +69,4 @@ layout(binding = BIND_SCENEPARAM, set = 0) uniform SceneParameters {
 
 layout(binding = BIND_OBJECTLIST, set = 0) readonly buffer _ObjectBuffer { ObjectParameters objParams[]; };
 layout(binding = BIND_MATERIALLIST, set = 0) readonly buffer _MaterialBuffer { Material materials[]; };
-layout(binding = BIND_TEXTURELIST, set=0) uniform sampler2D textures[];
+layout(binding = BIND_TEXTURELIST, set = SET_TEXTURELIST) uniform sampler2D textures[];
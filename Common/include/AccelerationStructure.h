@@ -6,6 +6,9 @@
 
 #include "GraphicsDevice.h"
 
+class AccelerationStructureBuilder;
+class AccelerationStructureCache;
+
 class AccelerationStructure {
 public:
     using VkGraphicsDevice = std::unique_ptr<vk::GraphicsDevice>;
@@ -36,8 +39,22 @@ public:
 
     VkAccelerationStructureKHR GetHandle() const { return m_accelerationStructure.handle; }
     VkDeviceAddress GetDeviceAddress() const { return m_accelerationStructure.deviceAddress; }
+    VkDeviceSize GetSize() const { return m_accelerationStructure.size; }
 private:
-    
+    friend class AccelerationStructureBuilder;
+
+    // AccelerationStructure 本体とアップデートバッファを確保する.
+    //  構築に必要なサイズ情報を返す.
+    //  storageSize を指定した場合は, そのサイズで本体を確保する.
+    VkAccelerationStructureBuildSizesInfoKHR Allocate(
+        VkGraphicsDevice& device,
+        VkAccelerationStructureBuildGeometryInfoKHR& asBuildGeometryInfo,
+        const Input& input,
+        VkDeviceSize storageSize = 0);
+
+    // 指定サイズで AccelerationStructure 本体を作成する.
+    void CreateStorage(VkGraphicsDevice& device, VkAccelerationStructureTypeKHR type, VkDeviceSize size);
+
     void Build(VkGraphicsDevice& device,
         const VkAccelerationStructureBuildGeometryInfoKHR& asBuildGeometryInfo,
         const std::vector<VkAccelerationStructureBuildRangeInfoKHR>& asBuildRangeInfo);
@@ -53,4 +70,60 @@ private:
     // AccelerationStructure構築/更新のための作業バッファ.
     vk::BufferResource m_scratchBuffer;
     vk::BufferResource m_updateBuffer;
-};
\ No newline at end of file
+};
+
+// 複数の AccelerationStructure をまとめて構築するクラス.
+//  スクラッチバッファは1つを切り分けて共有し, 1回の送信で構築する.
+//  スクラッチの合計が上限を超える場合は, バリアを挟んで領域を使い回す.
+//  VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR 付きの要求は,
+//  構築後にコンパクションを行い, 必要なサイズのバッファへ置き換える.
+//  キャッシュを設定した場合, キー付きの要求はキャッシュからの復元を試みて,
+//  無ければ構築後にシリアライズしてキャッシュへ書き出す.
+class AccelerationStructureBuilder {
+public:
+    using VkGraphicsDevice = std::unique_ptr<vk::GraphicsDevice>;
+
+    // キャッシュを設定する. nullptr ならキャッシュを使用しない.
+    void SetCache(AccelerationStructureCache* cache) { m_cache = cache; }
+
+    // 構築要求を積む. AccelerationStructure 本体はこの時点で確保されるため,
+    //  デバイスアドレスはすぐに取得できる.
+    //  cacheKey はジオメトリ内容から求めたハッシュ値. 0 ならキャッシュを使用しない.
+    void Add(
+        VkGraphicsDevice& device,
+        AccelerationStructure& as,
+        VkAccelerationStructureTypeKHR type,
+        const AccelerationStructure::Input& input,
+        VkBuildAccelerationStructureFlagsKHR buildFlags,
+        uint64_t cacheKey = 0);
+
+    // 積まれた要求をまとめて構築し, 完了を待つ.
+    void Build(VkGraphicsDevice& device, VkDeviceSize scratchBudget = DefaultScratchBudget);
+
+    size_t GetCount() const { return m_requests.size(); }
+
+    // 直前の Build でコンパクションした結果.
+    struct CompactionResult {
+        const AccelerationStructure* target = nullptr;
+        VkDeviceSize originalSize = 0;
+        VkDeviceSize compactedSize = 0;
+    };
+    const std::vector<CompactionResult>& GetCompactionResults() const { return m_compactionResults; }
+
+    static const VkDeviceSize DefaultScratchBudget = 64ull * 1024 * 1024;
+private:
+    struct Request {
+        AccelerationStructure* target = nullptr;
+        AccelerationStructure::Input input;
+        VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo;
+        VkDeviceSize scratchSize = 0;
+        uint64_t cacheKey = 0;
+        std::vector<uint8_t> serializedData;    // キャッシュから読み込んだデータ.
+    };
+    void Compact(VkGraphicsDevice& device, VkQueryPool queryPool, const std::vector<size_t>& compactIndices);
+    void StoreToCache(VkGraphicsDevice& device, const std::vector<size_t>& storeIndices);
+
+    std::vector<Request> m_requests;
+    std::vector<CompactionResult> m_compactionResults;
+    AccelerationStructureCache* m_cache = nullptr;
+};
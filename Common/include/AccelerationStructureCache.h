@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GraphicsDevice.h"
+
+// シリアライズした AccelerationStructure をファイルに保存/読み込みするクラス.
+//  ファイルはジオメトリ内容のハッシュ値(キー)ごとに作成し,
+//  デバイス UUID やドライバのバージョンが一致しないものは無効として削除する.
+class AccelerationStructureCache {
+public:
+    using VkGraphicsDevice = std::unique_ptr<vk::GraphicsDevice>;
+
+    bool Initialize(VkGraphicsDevice& device, const std::wstring& directory);
+
+    // キャッシュからシリアライズ済みデータを読み込む.
+    //  deserializedSize には復元に必要な AccelerationStructure のサイズが入る.
+    bool Load(VkGraphicsDevice& device, uint64_t key, std::vector<uint8_t>& data, VkDeviceSize& deserializedSize);
+
+    // シリアライズ済みデータをキャッシュに書き込む.
+    bool Store(uint64_t key, const void* data, size_t size);
+
+    bool IsEnabled() const { return !m_directory.empty(); }
+    uint32_t GetHitCount() const { return m_hitCount; }
+    uint32_t GetMissCount() const { return m_missCount; }
+private:
+    std::filesystem::path GetFilePath(uint64_t key) const;
+
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint8_t  deviceUUID[VK_UUID_SIZE];
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint32_t reserved;
+        uint64_t dataSize;
+    };
+    static const uint32_t FileMagic = 0x53414B56; // "VKAS"
+    static const uint32_t FileVersion = 1;
+
+    std::filesystem::path m_directory;
+    uint8_t  m_deviceUUID[VK_UUID_SIZE] = { 0 };
+    uint32_t m_vendorID = 0;
+    uint32_t m_deviceID = 0;
+    uint32_t m_driverVersion = 0;
+
+    uint32_t m_hitCount = 0;
+    uint32_t m_missCount = 0;
+};
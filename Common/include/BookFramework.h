@@ -1,4 +1,4 @@
-#pragma once
+﻿#pragma once
 
 #include <string>
 #include <memory>
@@ -13,6 +13,21 @@ public:
 
     int Run();
 
+    // ヘッドレス(ウィンドウなし)実行の設定.
+    struct HeadlessOptions {
+        uint32_t frameCount = 1;    // 描画するフレーム数.
+        std::wstring outputPath;    // PNG の出力先. %d (%04d などの幅指定も可) でフレーム番号を埋め込める (例: out/frame%04d.png). % 自体は %% と書く. 空なら出力しない.
+        vk::GraphicsDevice::FrameSink sink; // 読み戻した画像を受け取る関数 (メモリへの出力用).
+    };
+    // ヘッドレスで実行する. Run より前に設定する.
+    //  スワップチェインの代わりにオフスクリーンのバックバッファへ描画し, 指定フレーム数で終了する.
+    void SetHeadless(const HeadlessOptions& options);
+    bool IsHeadless() const { return m_headless; }
+
+    // コマンドライン引数からヘッドレスの設定を読み取る. --headless が無ければ false.
+    //  --headless [--frames N] [--output path]
+    static bool ParseHeadlessOptions(const std::wstring& commandLine, HeadlessOptions& options);
+
     enum MouseButton {
         LBUTTON = 0,
         RBUTTON,
@@ -40,10 +55,33 @@ protected:
     std::unique_ptr<vk::GraphicsDevice> m_device;
     GLFWwindow* m_window = nullptr;
 
+    // CPU が先行して記録できるフレームの数 (コンストラクタで変更可能).
+    uint32_t m_framesInFlight = vk::GraphicsDevice::DefaultFramesInFlight;
+
+    // 専用のコンピュート・転送キューがあれば使用する (コンストラクタで変更可能).
+    bool m_useAsyncCompute = true;
+    bool m_useTransferQueue = true;
+
+    // VK_EXT_descriptor_buffer が使えれば使用する (コンストラクタ等で Run より前に変更可能).
+    bool m_useDescriptorBuffer = true;
+
+    // フレームのコマンドを並列に記録するスレッドの数 (コンストラクタで変更可能).
+    uint32_t m_commandRecordingThreads = 1;
+
 private:
     void Initialize();
     void Destroy();
 
+    // 1 フレーム分の更新と描画. 各処理の CPU 時間を計測する.
+    void RunFrame();
+
+    void WriteFrameImage(const vk::GraphicsDevice::FrameImage& image);
+
     std::string m_title;
+    int m_width = 0;
+    int m_height = 0;
+
+    bool m_headless = false;
+    HeadlessOptions m_headlessOptions;
 };
 
@@ -0,0 +1,191 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 時刻の取得にはタイムスタンプカウンタを使用する(OS の時刻取得よりも軽いため).
+#if defined(_M_X64)
+# include <intrin.h>
+# define CPU_PROFILER_USE_RDTSC
+#elif defined(__x86_64__)
+# include <x86intrin.h>
+# define CPU_PROFILER_USE_RDTSC
+#endif
+
+// CPU 側の区間計測を有効にするか. 0 を定義すると計測用のマクロは何も生成しない.
+#ifndef VKRAY_CPU_PROFILER
+# define VKRAY_CPU_PROFILER 1
+#endif
+
+// CPU の処理時間を区間ごとに計測するクラス.
+//  各スレッドは自分専用のリングバッファへロック無しで区間を書き込み,
+//  メインスレッドがフレームの区切り(BeginFrame)でまとめて回収して集計する.
+class CpuProfiler {
+public:
+    static CpuProfiler& Get();
+
+    // 計測に使う時刻. 単位はタイムスタンプカウンタのカウント(使えない環境ではナノ秒).
+    static int64_t Now()
+    {
+#if defined(CPU_PROFILER_USE_RDTSC)
+        return int64_t(__rdtsc());
+#else
+        return ClockNow();
+#endif
+    }
+
+    // フレームの区切り. 前のフレームで記録された区間を回収して集計する. メインスレッドから呼ぶ.
+    void BeginFrame();
+
+    // 名前ごとに集計した直前のフレームの結果(ミリ秒).
+    struct ScopeSummary {
+        const char* name;
+        uint32_t count;
+        double totalTime;
+        double averageTime;   // 直近 AverageFrameCount フレームでの平均.
+    };
+    static const uint32_t AverageFrameCount = 60;
+    const std::vector<ScopeSummary>& GetFrameSummary() const { return m_summary; }
+    double GetFrameTime() const { return m_frameTime; }
+
+    // Chrome トレース形式(chrome://tracing, Perfetto で表示可能)での書き出し.
+    //  以降 frameCount フレーム分の区間を集め, 揃った時点で fileName に書き出す.
+    void CaptureTrace(uint32_t frameCount, const std::wstring& fileName);
+    bool IsCapturingTrace() const { return m_traceFramesLeft > 0; }
+
+    // 1 区間あたりの計測の負荷(ナノ秒)を測る.
+    //  専用のスレッドで空の区間を繰り返し記録し, その結果は集計に含めない.
+    //  区間ごとに時刻を 2 回取得するので, MeasureTimestampCost の 2 倍が下限になる.
+    static double MeasureScopeOverhead(uint32_t iterations = 10000);
+    // 時刻の取得(Now)1 回あたりの負荷(ナノ秒)を測る.
+    static double MeasureTimestampCost(uint32_t iterations = 10000);
+
+private:
+    friend class CpuProfileScope;
+
+    struct Event {
+        const char* name;
+        int64_t begin;
+        int64_t end;
+        uint32_t depth;
+    };
+
+    // スレッドごとの区間のバッファ. 書き込みは所有スレッドのみ, 回収はメインスレッドのみが行う.
+    static const uint32_t BufferCapacity = 16384;
+    struct ThreadBuffer {
+        // 所有スレッドのみが書き込む値.
+        std::atomic<uint32_t> writeIndex{ 0 };
+        uint32_t writeLimit = 0;    // 回収位置を読み直さずに書き込める上限.
+        uint32_t depth = 0;
+        Event events[BufferCapacity];
+        // 回収側が書き込む値. 記録のたびに触る値と同じキャッシュラインに載らないよう, バッファの後ろに置く.
+        std::atomic<uint32_t> readIndex{ 0 };
+        uint32_t threadId = 0;
+        bool discard = false;
+    };
+    static ThreadBuffer* GetThreadBuffer()
+    {
+        return t_buffer ? t_buffer : Get().RegisterThread();
+    }
+    static void Record(ThreadBuffer* buffer, const char* name, int64_t begin, int64_t end, uint32_t depth)
+    {
+        auto writeIndex = buffer->writeIndex.load(std::memory_order_relaxed);
+        if (writeIndex == buffer->writeLimit) {
+            // 上限に達したときだけ回収位置を読み直す.
+            buffer->writeLimit = buffer->readIndex.load(std::memory_order_acquire) + BufferCapacity;
+            if (writeIndex == buffer->writeLimit) {
+                // 回収が追いつかない場合は捨てる.
+                return;
+            }
+        }
+        buffer->events[writeIndex % BufferCapacity] = Event{ name, begin, end, depth };
+        buffer->writeIndex.store(writeIndex + 1, std::memory_order_release);
+    }
+    ThreadBuffer* RegisterThread();
+    static const uint32_t MeasureRoundCount = 5;
+    bool WriteTrace() const;
+
+    static int64_t ClockNow()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Now() の値をミリ秒へ変換する係数を, 起動からの経過時間で求め直す.
+    void Calibrate();
+    CpuProfiler();
+
+    static thread_local ThreadBuffer* t_buffer;
+
+    // スレッドの登録と回収の間のみ使用する(記録時には使わない).
+    std::mutex m_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+
+    int64_t m_calibrationTicks = 0;
+    int64_t m_calibrationClock = 0;
+    double m_ticksToMilliseconds = 1e-6;
+
+    int64_t m_frameBegin = 0;
+    double m_frameTime = 0.0;
+    std::vector<Event> m_events;
+    std::vector<ScopeSummary> m_summary;
+
+    // 名前ごとの直近の計測値.
+    struct History {
+        double samples[AverageFrameCount] = {};
+        uint32_t count = 0;
+        uint32_t next = 0;
+        double sum = 0.0;
+    };
+    std::unordered_map<std::string, History> m_histories;
+
+    // トレース出力用.
+    struct TraceEvent {
+        Event event;
+        uint32_t threadId;
+    };
+    std::vector<TraceEvent> m_traceEvents;
+    std::wstring m_traceFileName;
+    uint32_t m_traceFramesLeft = 0;
+};
+
+// スコープを抜けるまでを計測する.
+class CpuProfileScope {
+public:
+    explicit CpuProfileScope(const char* name)
+        : m_buffer(CpuProfiler::GetThreadBuffer()), m_name(name)
+    {
+        m_depth = m_buffer->depth++;
+        m_begin = CpuProfiler::Now();
+    }
+    ~CpuProfileScope()
+    {
+        auto end = CpuProfiler::Now();
+        m_buffer->depth--;
+        CpuProfiler::Record(m_buffer, m_name, m_begin, end, m_depth);
+    }
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+private:
+    CpuProfiler::ThreadBuffer* m_buffer;
+    const char* m_name;
+    int64_t m_begin;
+    uint32_t m_depth;
+};
+
+#if VKRAY_CPU_PROFILER
+# define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+# define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+// 区間の計測. name は文字列リテラルなど寿命の長いものを渡す.
+# define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
+# define CPU_PROFILE_FRAME() CpuProfiler::Get().BeginFrame()
+#else
+# define CPU_PROFILE_SCOPE(name) ((void)0)
+# define CPU_PROFILE_FRAME() ((void)0)
+#endif
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vk {
+
+    // ディスクリプタプールを必要に応じて追加しながらディスクリプタセットを割り当てるクラス.
+    //  プールが一杯(VK_ERROR_OUT_OF_POOL_MEMORY)になると, 前回の倍のセット数で次のプールを作成する.
+    //  スレッドセーフではない.
+    class DescriptorAllocator {
+    public:
+        // セット 1 つあたりに見込むディスクリプタの数. プールの大きさはこれとセット数の積になる.
+        struct PoolSizeRatio {
+            VkDescriptorType type;
+            float countPerSet;
+        };
+
+        // flags に VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT を指定すると Free で個別に解放できる.
+        //  指定しない場合は Reset でまとめて解放する(フレームごとの一時的なセット用).
+        bool Initialize(VkDevice device, const std::vector<PoolSizeRatio>& ratios, uint32_t initialSetCount, VkDescriptorPoolCreateFlags flags = 0);
+        void Destroy();
+
+        // 割り当てに失敗した場合は VK_NULL_HANDLE.
+        VkDescriptorSet Allocate(VkDescriptorSetLayout layout, const void* pNext = nullptr);
+
+        // 個別に解放する. FREE_DESCRIPTOR_SET_BIT を指定して初期化した場合のみ使用できる.
+        void Free(VkDescriptorSet descriptorSet);
+
+        // すべてのセットを解放する. プールは破棄せずに次の割り当てで再利用する.
+        void Reset();
+
+        uint32_t GetPoolCount() const { return uint32_t(m_pools.size()); }
+        uint32_t GetAllocatedSetCount() const { return m_allocatedSetCount; }
+
+        // 1 つのプールに用意するセット数の上限.
+        static const uint32_t MaxSetsPerPool = 4096;
+    private:
+        bool CreatePool();
+
+        struct Pool {
+            VkDescriptorPool pool = VK_NULL_HANDLE;
+            uint32_t setCount = 0;      // このプールから割り当て中のセットの数.
+        };
+        VkDevice m_device = VK_NULL_HANDLE;
+        std::vector<PoolSizeRatio> m_ratios;
+        VkDescriptorPoolCreateFlags m_flags = 0;
+        uint32_t m_nextSetCount = 0;    // 次に作成するプールのセット数.
+
+        std::vector<Pool> m_pools;
+        size_t m_currentPool = 0;       // 割り当てを試みるプール. これより前のプールは一杯.
+        uint32_t m_allocatedSetCount = 0;
+
+        // 個別に解放するときに割り当て元のプールを求めるため.
+        std::unordered_map<VkDescriptorSet, size_t> m_setOwners;
+    };
+}
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "GraphicsDevice.h"
+
+namespace vk {
+
+    // VK_EXT_descriptor_buffer でディスクリプタを GPU から参照するバッファへ直接書き込むクラス.
+    //  ディスクリプタセットの代わりにレイアウト 1 セット分の領域を確保し, バッファ内のオフセットでバインドする.
+    //  書き込みは即座に GPU から見えるため, 実行中のコマンドが参照している要素は書き換えないこと.
+    //  確保した領域は Reset までまとめて保持する. スレッドセーフではない.
+    class DescriptorBuffer {
+    public:
+        // ディスクリプタバッファで使うレイアウト・パイプラインに指定するフラグ.
+        static VkDescriptorSetLayoutCreateFlags GetSetLayoutCreateFlags();
+        static VkPipelineCreateFlags GetPipelineCreateFlags();
+
+        // 拡張機能が有効なデバイスでのみ成功する.
+        bool Initialize(GraphicsDevice& device, VkDeviceSize requestSize);
+        void Destroy(GraphicsDevice& device);
+
+        // レイアウト 1 セット分の領域を確保してバッファ先頭からのオフセットを返す.
+        //  容量が足りない場合は InvalidOffset.
+        static const VkDeviceSize InvalidOffset = ~VkDeviceSize(0);
+        VkDeviceSize AllocateSet(VkDescriptorSetLayout layout);
+
+        // 確保した全ての領域を解放する.
+        void Reset() { m_usedSize = 0; }
+
+        // setOffset のセットの binding(配列なら arrayElement 番目)へディスクリプタを書き込む.
+        void WriteImage(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding, uint32_t arrayElement,
+            VkDescriptorType type, const VkDescriptorImageInfo& imageInfo);
+        void WriteBuffer(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+            VkDescriptorType type, VkDeviceAddress address, VkDeviceSize range);
+        void WriteAccelerationStructure(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+            VkDeviceAddress address);
+
+        // バッファをバインドし, firstSet から順に各セットのオフセットを設定する.
+        void Bind(VkCommandBuffer command, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+            uint32_t firstSet, const std::vector<VkDeviceSize>& setOffsets) const;
+
+        VkDeviceSize GetSize() const { return m_size; }
+        VkDeviceSize GetUsedSize() const { return m_usedSize; }
+    private:
+        size_t GetDescriptorSize(VkDescriptorType type) const;
+        uint8_t* GetDescriptorPointer(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+            uint32_t arrayElement, VkDescriptorType type) const;
+
+        VkDevice m_device = VK_NULL_HANDLE;
+        BufferResource m_buffer;
+        VkBufferUsageFlags m_usage = 0;
+        uint8_t* m_mapped = nullptr;
+        VkDeviceSize m_size = 0;
+        VkDeviceSize m_usedSize = 0;
+        VkDeviceSize m_offsetAlignment = 1;
+
+        // ディスクリプタタイプごとの大きさ(デバイスにより異なる).
+        size_t m_combinedImageSamplerSize = 0;
+        size_t m_storageImageSize = 0;
+        size_t m_uniformBufferSize = 0;
+        size_t m_storageBufferSize = 0;
+        size_t m_accelerationStructureSize = 0;
+    };
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vk {
+
+    // タイムスタンプクエリで GPU の処理時間を区間ごとに計測するクラス.
+    //  フレームごとにクエリプールを持ち, 同じフレームインデックスを再び使うとき(前回分の完了後)に結果を回収する.
+    //  記録時はタイムスタンプの書き込みと名前の登録のみを行うため, 常に有効のままで使用できる.
+    class GpuProfiler {
+    public:
+        // timestampValidBits が 0 のときは計測を行わない(各関数は何もしない).
+        bool Initialize(VkDevice device, uint32_t framesInFlight, float timestampPeriod, uint32_t timestampValidBits);
+        void Destroy();
+
+        bool IsEnabled() const { return !m_frames.empty(); }
+
+        // フレームの開始. このフレームインデックスで前回計測した結果を回収し, クエリをリセットする.
+        //  そのフレームの GPU の処理が完了してから呼ぶこと.
+        void BeginFrame(uint32_t frameIndex);
+
+        // 区間の開始・終了. BeginScope/EndScope の入れ子で階層を表す.
+        //  name は文字列リテラルなど寿命の長いものを渡す(結果にはポインタのまま保持する). track はトレース出力での行(キューの種類など).
+        //  戻り値を EndScope に渡す.
+        uint32_t BeginScope(VkCommandBuffer command, const char* name, uint32_t track = 0);
+        void EndScope(VkCommandBuffer command, uint32_t scope);
+
+        // スコープを抜けるまでを計測する.
+        class Scope {
+        public:
+            Scope(GpuProfiler& profiler, VkCommandBuffer command, const char* name, uint32_t track = 0)
+                : m_profiler(profiler), m_command(command), m_scope(profiler.BeginScope(command, name, track)) { }
+            ~Scope() { m_profiler.EndScope(m_command, m_scope); }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        private:
+            GpuProfiler& m_profiler;
+            VkCommandBuffer m_command;
+            uint32_t m_scope;
+        };
+
+        // 区間の計測結果(ミリ秒). beginTime はそのフレームの最初の区間の開始からの時間.
+        struct ScopeResult {
+            const char* name;
+            uint32_t depth;
+            uint32_t track;
+            double beginTime;
+            double duration;
+            double averageDuration;   // 直近 AverageFrameCount フレームでの平均.
+        };
+        static const uint32_t AverageFrameCount = 60;
+
+        // 最後に回収したフレームの結果(記録順).
+        const std::vector<ScopeResult>& GetResults() const { return m_results; }
+
+        // Chrome トレース形式(chrome://tracing, Perfetto で表示可能)での書き出し.
+        //  以降 frameCount フレーム分の結果を集め, 揃った時点で fileName に書き出す.
+        void CaptureTrace(uint32_t frameCount, const std::wstring& fileName);
+        bool IsCapturingTrace() const { return m_traceFramesLeft > 0; }
+
+    private:
+        void ResolveFrame(uint32_t frameIndex);
+        bool WriteTrace() const;
+
+        static const uint32_t MaxQueriesPerFrame = 256;
+        static const uint32_t InvalidScope = ~0u;
+
+        struct ScopeRecord {
+            const char* name;
+            uint32_t depth;
+            uint32_t track;
+            uint32_t query;     // 開始のクエリ. 終了は query + 1.
+        };
+        struct FrameData {
+            VkQueryPool queryPool = VK_NULL_HANDLE;
+            std::vector<ScopeRecord> scopes;
+            uint32_t queryCount = 0;
+        };
+        VkDevice m_device = VK_NULL_HANDLE;
+        std::vector<FrameData> m_frames;
+        FrameData* m_current = nullptr;
+        uint32_t m_depth = 0;
+        double m_timestampPeriod = 1.0;  // 1 カウントあたりのナノ秒.
+        uint64_t m_timestampMask = ~0ull;
+        std::vector<uint64_t> m_timestamps;
+
+        std::vector<ScopeResult> m_results;
+
+        // 名前ごとの直近の計測値.
+        struct History {
+            double samples[AverageFrameCount] = {};
+            uint32_t count = 0;
+            uint32_t next = 0;
+            double sum = 0.0;
+        };
+        std::unordered_map<std::string, History> m_histories;
+
+        // トレース出力用.
+        struct TraceEvent {
+            const char* name;
+            uint32_t track;
+            uint64_t begin;   // タイムスタンプのカウント.
+            uint64_t end;
+        };
+        std::vector<TraceEvent> m_traceEvents;
+        std::wstring m_traceFileName;
+        uint32_t m_traceFramesLeft = 0;
+    };
+}
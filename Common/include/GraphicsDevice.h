@@ -4,28 +4,41 @@
 #include <cstdint>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 
 #include "extensions_vk.hpp"
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "TimelineSemaphore.h"
+#include "GpuProfiler.h"
+#include "DescriptorAllocator.h"
 
 // forward declaration.
 struct GLFWwindow;
 
 namespace vk {
     class GraphicsDevice;
+    class DescriptorBuffer;
 
     class BufferResource {
     public:
         VkBuffer GetBuffer() const { return m_buffer; }
-        VkDeviceMemory GetMemory()const { return m_memory; }
+        VkDeviceMemory GetMemory()const { return m_allocation.memory; }
+        VkDeviceSize GetMemoryOffset() const { return m_allocation.offset; }
         VkDeviceAddress GetDeviceAddress()const { return m_deviceAddress; }
+        VkDeviceSize GetSize() const { return m_size; }
 
         VkDescriptorBufferInfo GetDescriptor() const { return VkDescriptorBufferInfo{ m_buffer, 0, VK_WHOLE_SIZE }; }
     private:
         VkBuffer m_buffer = VK_NULL_HANDLE;
-        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        MemoryAllocation m_allocation;
         VkBufferUsageFlags  m_usage = 0;
         VkMemoryPropertyFlags m_memProps = 0;
         VkDeviceAddress m_deviceAddress = 0;
+        VkDeviceSize m_size = 0;
 
         friend class GraphicsDevice;
     };
@@ -39,12 +52,17 @@ namespace vk {
         void BarrierToDst(VkCommandBuffer command);
         void BarrierToShaderReadOnly(VkCommandBuffer command);
         void BarrierToPresentSrc(VkCommandBuffer command);
+        void BarrierToLayout(VkCommandBuffer command, VkImageLayout newLayout);
 
         VkImage GetImage() const { return m_image; }
         VkImageView GetImageView()const { return m_view; }
-        VkDeviceMemory GetMemory()const { return m_memory; }
+        VkDeviceMemory GetMemory()const { return m_allocation.memory; }
+        VkDeviceSize GetMemoryOffset() const { return m_allocation.offset; }
 
         VkImageLayout GetImageLayout() const { return m_layout; }
+        uint32_t GetMipLevels() const { return m_subresourceRange.levelCount; }
+        VkFormat GetFormat() const { return m_format; }
+        VkExtent2D GetExtent() const { return m_extent; }
 
         const VkDescriptorImageInfo* GetDescriptor(VkSampler sampler = VK_NULL_HANDLE);
     private:
@@ -52,9 +70,11 @@ namespace vk {
 
         VkImage m_image = VK_NULL_HANDLE;
         VkImageView m_view = VK_NULL_HANDLE;
-        VkDeviceMemory m_memory = VK_NULL_HANDLE;
+        MemoryAllocation m_allocation;
 
         VkImageLayout m_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+        VkExtent2D m_extent = { 0, 0 };
         VkImageSubresourceRange m_subresourceRange = { 
             VK_IMAGE_ASPECT_COLOR_BIT, 
             0, /*baseMipLevel*/
@@ -73,16 +93,98 @@ namespace vk {
 
         ~GraphicsDevice();
 
+        // L[̎.
+        //  p̃L[(܂͎gpȂ)ꍇ Graphics L[őp.
+        enum QueueType {
+            QueueGraphics = 0,
+            QueueCompute,
+            QueueTransfer,
+            QueueTypeCount,
+        };
+
+        // p Compute(񓯊Rs[g)/Transfer L[gp邩. OnInit Oɐݒ肷.
+        void SetDedicatedQueueUsage(bool useAsyncCompute, bool useTransferQueue);
+
+        // VK_EXT_descriptor_buffer gΗLɂ邩. OnInit Oɐݒ肷.
+        void SetDescriptorBufferUsage(bool useDescriptorBuffer);
+
+        // EBhEg킸ɃItXN[֕`悷邩. OnInit Oɐݒ肷.
+        //  wbhXł̓T[tFXXbv`FC炸, CreateOffscreenTargets ŃobNobt@pӂ.
+        void SetHeadless(bool headless);
+        bool IsHeadless() const { return m_headless; }
+
+        // pCvCLbVۑt@C. OnInit Oɐݒ肷.
+        //  OnInit œǂݍ(foCXvȂΔj), OnDestroy ŏ߂. ȂۑȂ.
+        void SetPipelineCacheFileName(const std::wstring& fileName) { m_pipelineCacheFileName = fileName; }
+
         bool OnInit(const std::vector<const char*>& requiredExtensions, bool enableValidationLayer);
         void OnDestroy();
 
         bool CreateSwapchain(uint32_t width, uint32_t height, GLFWwindow* window);
 
+        // wbhXpɃXbv`FC̑ƂȂobNobt@쐬.
+        //  Present ł͕`挋ʂzXg֓ǂݖ߂, SetFrameSink Őݒ肵֐֓n.
+        bool CreateOffscreenTargets(uint32_t width, uint32_t height);
+
+        // ǂݖ߂t[̉摜.
+        //  pixels  width * height  BackBufferFormat ̉f, ֐߂ƖɂȂ.
+        struct FrameImage {
+            uint64_t frameNumber;
+            uint32_t width;
+            uint32_t height;
+            VkFormat format;
+            const void* pixels;
+        };
+        using FrameSink = std::function<void(const FrameImage&)>;
+        void SetFrameSink(FrameSink sink) { m_frameSink = sink; }
+
+        // ǂݖ߂̃t[̊҂, ׂ FrameSink ֓n.
+        void FlushFrameReadbacks();
+
+        // t[̍ŌɃobNobt@uCAEg.
+        //  ʏ PRESENT_SRC, wbhXł͓ǂݖ߂̂ TRANSFER_SRC ƂȂ.
+        VkImageLayout GetPresentLayout() const;
+
+        // ɏt[. Xbv`FC̃C[WƂ͓Ɨɐݒł,
+        //  CreateSwapchain Oɐݒ肷.
+        static const uint32_t DefaultFramesInFlight = 2;
+        void SetFramesInFlight(uint32_t count);
+        uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+
+        // t[Ƃ̃\[X(萔obt@Ȃ)IԂ߂̃CfbNX [0, GetFramesInFlight()).
         uint32_t GetCurrentFrameIndex() const { return m_frameIndex; }
 
+        // `ƂȂXbv`FCC[W̃CfbNX [0, GetBackBufferCount()).
+        uint32_t GetCurrentBackBufferIndex() const { return m_backBufferIndex; }
+
+        // GPU ̋Ԍv. t[Ƃ̃NG WaitAvailableFrame ŉEZbg.
+        GpuProfiler& GetGpuProfiler() { return m_gpuProfiler; }
+
+        // P̏p̃R}hobt@.
+        //  DestroyCommandBuffer ŕԋp͉̂,  CreateCommandBuffer ōėp.
+        //  ԋp GPU ł̎sĂs. CXbhgp.
         VkCommandBuffer CreateCommandBuffer(bool isBegin = true);
         void DestroyCommandBuffer(VkCommandBuffer command);
 
+        // w̃L[ŎgpR}hobt@.
+        VkCommandBuffer CreateCommandBuffer(QueueType type, bool isBegin = true);
+        void DestroyCommandBuffer(QueueType type, VkCommandBuffer command);
+
+        // t[̃R}hL^Xbh̐. CreateSwapchain Oɐݒ肷.
+        void SetCommandRecordingThreadCount(uint32_t count);
+        uint32_t GetCommandRecordingThreadCount() const { return m_recordingThreadCount; }
+
+        // ݂̃t[Ŏgp Graphics L[p̃R}hobt@蓖Ă.
+        //  t[EXbhƂ̃R}hv[犄蓖, t[CfbNX
+        //  ĂюgƂ(WaitAvailableFrame)Ƀv[ƃZbĝŕԋp͕sv.
+        //  threadIndex  [0, GetCommandRecordingThreadCount()) , l𕡐̃XbhœɎgȂ.
+        VkCommandBuffer AllocateFrameCommandBuffer(uint32_t threadIndex = 0, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+        // w̃L[ŎsR}hobt@݂̃t[pɊ蓖Ă.
+        //  ̃t[ Graphics L[̏̃L[̊҂ꍇɂ̂ݎgpł.
+        //  p̃L[ Graphics L[p̃v[L.
+        VkCommandBuffer AllocateFrameCommandBuffer(QueueType type, uint32_t threadIndex, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
         VkFence CreateFence();
         void DestroyFence(VkFence fence);
         void ResetFence(VkFence fence);
@@ -96,43 +198,124 @@ namespace vk {
 
         VkCommandBuffer GetCurrentFrameCommandBuffer();
 
+        // ̃L[̏҂߂̎w.
+        //  value  GPU őҋ@邻̃L[̃^CC̒l.
+        struct QueueWait {
+            QueueType queue;
+            uint64_t value;
+            VkPipelineStageFlags stageMask;
+        };
+
         // R}hobt@𑗐MĎs.
-        void SubmitCurrentFrameCommandBuffer();
+        //  waits Ɏw肵L[̏܂, YXe[W̎s҂.
+        void SubmitCurrentFrameCommandBuffer(const std::vector<QueueWait>& waits = {});
 
         // R}hobt@𑗐MĎs.
         //  t[Ɗ֘AtȂR}hobt@sp.
         void SubmitAndWait(VkCommandBuffer command);
 
+        // R}hobt@𑗐M(͑҂Ȃ).
+        //  ɓB^CC̒lԂ̂, WaitForTimelineValue őҋ@ł.
+        uint64_t Submit(VkCommandBuffer command);
+
+        // ^CC̒l Graphics L[̏mFEҋ@.
+        //  t[̑M, Submit, ](FlushUploads)ׂ̊͂ē^CCŕ\.
+        bool IsTimelineValueCompleted(uint64_t value) const { return m_timeline.IsCompleted(value); }
+        void WaitForTimelineValue(uint64_t value) { m_timeline.Wait(value); }
+        uint64_t GetLastSubmittedTimelineValue() const { return m_timeline.GetLastSignaledValue(); }
+
+        // w̃L[փR}hobt@𑗐M(͑҂Ȃ).
+        //  ߂l͂̃L[̃^CCŊɓBl.
+        //  ς܂Ă]͐ɑM, Graphics ȊÕL[ł͂̊҂.
+        uint64_t Submit(QueueType type, VkCommandBuffer command, const std::vector<QueueWait>& waits = {});
+        bool IsTimelineValueCompleted(QueueType type, uint64_t value) const { return m_queues[type].timeline->IsCompleted(value); }
+        void WaitForTimelineValue(QueueType type, uint64_t value) { m_queues[type].timeline->Wait(value); }
+
+        // p̃L[gpĂ邩. false ̂Ƃ Graphics L[őpĂ.
+        bool HasDedicatedQueue(QueueType type) const { return type != QueueGraphics && m_queues[type].familyIndex != m_gfxQueueIndex; }
+        VkQueue GetQueue(QueueType type) const { return m_queues[type].queue; }
+        uint32_t GetQueueFamily(QueueType type) const { return m_queues[type].familyIndex; }
+
         void Present();
         void WaitForIdleGpu();
+
+        // ̃t[̊Jn҂.
+        //  t[CfbNXg GetFramesInFlight() Õt[̊҂,
+        //  `̃Xbv`FCC[W擾.
         void WaitAvailableFrame();
 
         BufferResource CreateBuffer(size_t requestSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps);
         void DestroyBuffer(BufferResource& objBuffer);
 
-        ImageResource  CreateTexture2D(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps);
+        ImageResource  CreateTexture2D(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps, uint32_t mipLevels = 1);
+        // O .ktx2 t@C摜V, ǂݍ.
         ImageResource  CreateTexture2DFromFile(const wchar_t* fileName, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps);
+        // KTX2 ̃f[^ł CreateTexture2DFromKtx2 , ȊO stb_image ŃfR[hēǂݍ.
         ImageResource  CreateTexture2DFromMemory(const void* imageData, size_t size, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps);
+        // KTX2 Ɋi[ꂽtH[}bg(BCn Ȃ)ƃ~bv}bv̂܂ܓǂݍ.
+        ImageResource  CreateTexture2DFromKtx2(const void* data, size_t size, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps);
+
+        // RGBA8 ̃sNZf[^eNX`֏, VF[_[ǂ߂Ԃɂ.
+        //  ]̓Xe[WOOɐς܂, ̃R}hM̑Oɂ܂Ƃ߂ē].
+        //  eNX`~bv}bvꍇ, kRs[(blit)Ŏc̃x𐶐.
+        void WriteToTexture2D(ImageResource& image, uint32_t width, uint32_t height, const void* pixels);
+
+        // CPU Őς݂̃~bv}bv`FC(levels[0] ő̃x).
+        void WriteToTexture2D(ImageResource& image, uint32_t width, uint32_t height, const std::vector<const void*>& levels);
+
+        // wTCỶ摜 1x1 ܂ŏkƂ̃~bvx.
+        static uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+        // tH[}bg`tB^ł̏kRs[ɑΉĂ邩.
+        bool IsLinearBlitSupported(VkFormat format) const;
+
+        // tH[}bgeNX`ƂăTvO\(BCn Ȃǂ̑ΉmFp).
+        bool IsSampledFormatSupported(VkFormat format) const;
+
+        // foCXg@\ɑΉĂ邩.
+        bool IsDeviceExtensionSupported(const char* extensionName) const;
 
         ImageResource  CreateTextureCube(const wchar_t* faceFiles[6], VkImageUsageFlags usage, VkMemoryPropertyFlags memProps);
         void DestroyImage(ImageResource& objImage);
 
-        VkDeviceMemory AllocateMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps);
-        VkDeviceMemory AllocateMemory(VkImage image, VkMemoryPropertyFlags memProps);
+        // ̓AP[^؂oĊ蓖Ă. oChɂ offset gp邱.
+        MemoryAllocation AllocateMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps);
+        MemoryAllocation AllocateMemory(VkImage image, VkMemoryPropertyFlags memProps);
+
+        // AP[^̓v.
+        const DeviceMemoryAllocator& GetMemoryAllocator() const { return m_memoryAllocator; }
 
         // CPU̏ԂŎgp\ȃ}bv֐.
         void* Map(const BufferResource&);
         void  Unmap(const BufferResource&);
 
         // obt@ւ̏݊֐.
-        //  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ւ݂̏̓R}hsA҂ɂȂ̂Œ.
+        //  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT ւ݂̏̓Xe[WOOɐς܂,
+        //  ̃R}hM(SubmitAndWait, SubmitCurrentFrameCommandBuffer)̑Oɂ܂Ƃ߂ē].
         void WriteToBuffer(BufferResource&, const void* data, size_t size);
 
+        // ς܂Ă]𑗐M. waitForCompletion  true Ȃ犮܂ő҂.
+        void FlushUploads(bool waitForCompletion = false);
+
         VkDevice GetDevice() const { return m_device; }
         VkPhysicalDevice GetPhysicalDevice() const { return m_physicalDevice; }
         VkInstance GetVulkanInstance() const { return m_instance; }
         VkQueue GetDefaultQueue() const { return m_deviceQueue; }
+        // ImGui ȂǊÕCuɓn߂̌Œ̃v[.
+        //  AvP[ṼfBXNv^Zbg AllocateDescriptorSet Ŋ蓖Ă.
         VkDescriptorPool GetDescriptorPool() const { return m_descriptorPool; }
+        VkPipelineCache GetPipelineCache() const { return m_pipelineCache; }
+
+        // fBXNLȃpCvCLbVǂݍ߂.
+        bool IsPipelineCacheWarm() const { return m_pipelineCacheWarm; }
+
+        // pCvCLbVgpăpCvC𐶐.
+        //  ɂԂLbV̏(cold/warm)Ƌɏo͂. s VK_NULL_HANDLE.
+        VkPipeline CreateRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& createInfo, const char* name);
+        VkPipeline CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, const char* name);
+
+        // pCvCLbV̓et@C֏o.
+        bool SavePipelineCache();
         uint32_t GetGraphicsQueueFamily() const { return m_gfxQueueIndex; }
 
         VkSurfaceFormatKHR GetBackBufferFormat() const { return BackBufferFormat; }
@@ -141,9 +324,22 @@ namespace vk {
         const char* GetDeviceName() const { return m_physicalDeviceProperties.deviceName; }
         uint32_t GetMemoryTypeIndex(uint32_t requestBits, VkMemoryPropertyFlags requestProps) const;
 
+        // j܂ŎgfBXNv^Zbg. v[ȂȂΒǉ.
+        //  s VK_NULL_HANDLE.
         VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout dsLayout, const void* pNext = nullptr);
         void DeallocateDescriptorSet(VkDescriptorSet ds);
 
+        // ݂̃t[̊ԂgfBXNv^Zbg.
+        //  t[CfbNXĂюgƂ(WaitAvailableFrame)Ƀv[ƃZbĝŉ͕sv.
+        //  CXbhgp.
+        VkDescriptorSet AllocateFrameDescriptorSet(VkDescriptorSetLayout dsLayout, const void* pNext = nullptr);
+
+        // 蓖Ē̃fBXNv^Zbgƃv[̐.
+        const DescriptorAllocator& GetDescriptorAllocator() const { return m_descriptorAllocator; }
+
+        // fBXNv^𒼐ڏދL̃obt@. VK_EXT_descriptor_buffer gȂꍇ nullptr.
+        DescriptorBuffer* GetDescriptorBuffer() const { return m_descriptorBuffer.get(); }
+
 
         VkSampler CreateSampler(
             VkFilter minFilter = VK_FILTER_LINEAR,
@@ -155,11 +351,23 @@ namespace vk {
         // foCXAhX̎擾.
         uint64_t GetDeviceAddress(VkBuffer buffer);
         VkPhysicalDeviceRayTracingPipelinePropertiesKHR GetRayTracingPipelineProperties();
+        VkPhysicalDeviceAccelerationStructurePropertiesKHR GetAccelerationStructureProperties();
         VkDeviceSize GetUniformBufferAlignment() const { return m_physicalDeviceProperties.limits.minUniformBufferOffsetAlignment; }
         VkDeviceSize GetStorageBufferAlignment() const { return m_physicalDeviceProperties.limits.minStorageBufferOffsetAlignment; }
+        const VkPhysicalDeviceLimits& GetDeviceLimits() const { return m_physicalDeviceProperties.limits; }
 
     private:
         bool CreateDescriptorPool();
+        bool CreatePipelineCache();
+        void ReportPipelineCreation(const char* name, double milliseconds);
+
+        void CopyToImageLevel(ImageResource& image, uint32_t level, uint32_t width, uint32_t height, const void* data);
+        // Rq[głȂ, 蓖ė̈̐擪 size oCgtbV.
+        void FlushMappedMemory(const MemoryAllocation& allocation, VkDeviceSize size);
+        // ]̃\[XjO, ̃\[Xւ̓]̂҂.
+        void WaitBufferUploads(VkBuffer buffer);
+        void WaitImageUploads(VkImage image);
+        void GenerateMipmaps(ImageResource& image, uint32_t width, uint32_t height);
 
         VkInstance m_instance = VK_NULL_HANDLE;
         VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
@@ -167,8 +375,50 @@ namespace vk {
         VkQueue    m_deviceQueue = VK_NULL_HANDLE;
         uint32_t   m_gfxQueueIndex = 0;
 
+        // ނƂ̃L[. p̃L[̂ Graphics L[Ɠe.
+        struct QueueContext {
+            VkQueue queue = VK_NULL_HANDLE;
+            uint32_t familyIndex = 0;
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            TimelineSemaphore* timeline = nullptr;
+            std::vector<VkCommandBuffer> freeCommands;  // ԋpꂽP̃R}hobt@.
+        };
+        QueueContext m_queues[QueueTypeCount];
+        TimelineSemaphore m_computeTimeline;
+        TimelineSemaphore m_transferTimeline;
+        bool m_useAsyncCompute = true;
+        bool m_useTransferQueue = true;
+
+        // gpL[t@~[̈ꗗ. ΃obt@͂ŋL(CONCURRENT).
+        std::vector<uint32_t> m_queueFamilies;
+
+        DeviceMemoryAllocator m_memoryAllocator;
+        StagingRing m_stagingRing;
+        // ]̃\[X, Ōɂ̃\[Xւ̓]ς񂾃Xe[WOÕob`.
+        std::unordered_map<VkBuffer, uint64_t> m_bufferUploads;
+        std::unordered_map<VkImage, uint64_t> m_imageUploads;
+        GpuProfiler m_gpuProfiler;
+        uint32_t m_timestampValidBits = 0;
+
         VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+        DescriptorAllocator m_descriptorAllocator;
+        bool m_useDescriptorBuffer = true;
+        std::unique_ptr<DescriptorBuffer> m_descriptorBuffer;
         VkCommandPool m_commandPool = VK_NULL_HANDLE;
+
+        // pCvCLbV.
+        //  t@Cɂ͓Ǝ̃wb_(TCYƃnbV)t, ꂽf[^hCo֓nȂ悤ɂ.
+        struct PipelineCacheFileHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t dataSize;
+            uint64_t dataHash;
+        };
+        static const uint32_t PipelineCacheMagic = 0x43504B56; // "VKPC"
+        static const uint32_t PipelineCacheVersion = 1;
+        VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+        std::wstring m_pipelineCacheFileName = L"pipeline_cache.bin";
+        bool m_pipelineCacheWarm = false;
         std::vector<VkPhysicalDevice> m_physicalDevices;
         VkPhysicalDeviceMemoryProperties m_memProps;
         VkPhysicalDeviceProperties  m_physicalDeviceProperties;
@@ -178,18 +428,51 @@ namespace vk {
         VkSurfaceKHR    m_surface = VK_NULL_HANDLE;
         VkExtent2D      m_surfaceExtent;
         VkSwapchainKHR  m_swapchain = VK_NULL_HANDLE;
-
-        VkSemaphore m_renderCompleted;
-        VkSemaphore m_presentCompleted;
+        bool m_headless = false;
+        FrameSink m_frameSink;
+        uint64_t m_frameNumber = 0;
 
         std::vector<vk::ImageResource> m_renderTargets;
 
+        // Graphics L[ւ̑Mׂ͂Ẵ^CC̒li߂.
+        TimelineSemaphore m_timeline;
+
+        uint32_t m_framesInFlight = DefaultFramesInFlight;
         uint32_t m_frameIndex = 0;
-        struct FrameCommandBuffer {
-            VkCommandBuffer commandBuffer;
-            VkFence fence;
+        uint32_t m_backBufferIndex = 0;
+        uint32_t m_recordingThreadCount = 1;
+
+        // t[EXbhƂ̃R}hv[. t[̊Jnɂ܂Ƃ߂ăZbg.
+        struct FrameCommandPool {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> commands[2];   // PRIMARY, SECONDARY ̏.
+            uint32_t usedCount[2] = {};
+        };
+        struct FrameContext {
+            std::vector<FrameCommandPool> commandPools[QueueTypeCount];   // Graphics ƐpL[̕쐬.
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;   // commandPools[QueueGraphics][0] 犄蓖Ă.
+            VkSemaphore imageAcquired = VK_NULL_HANDLE; // Xbv`FCC[W̎擾.
+            uint64_t timelineValue = 0;                 // ̃t[̏Ƃ̃^CC̒l.
+            DescriptorAllocator descriptorAllocator;    // ̃t[̊ԂgfBXNv^Zbgp.
+
+            // wbhXł̓ǂݖ߂p.
+            VkCommandBuffer readbackCommand = VK_NULL_HANDLE;
+            BufferResource readbackBuffer;
+            uint64_t readbackFrameNumber = 0;
+            bool readbackPending = false;
         };
-        std::vector<FrameCommandBuffer> m_commandBuffers;
+        std::vector<FrameContext> m_frames;
+
+        // t[Ƃ̃ReLXgƕ\pZ}tH̏.
+        void CreateFrameContexts(uint32_t imageCount);
+
+        // ǂݖ߂t[̉摜 FrameSink ֓n.
+        void DeliverReadback(FrameContext& frame);
+
+        // `抮(\̑ҋ@p)̃Z}tH̓Xbv`FCC[WƂɎ.
+        //  \ҋ@I^C~O͕Ȃ, t[PʂŎg񂷂
+        //  \OɍĂ signal Ă܂\.
+        std::vector<VkSemaphore> m_renderCompleted;
 
         VkDebugReportCallbackEXT  m_debugReport = VK_NULL_HANDLE;
 
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace util {
+    // テクセルブロックの情報. 非圧縮フォーマットは 1x1 のブロックとして扱う.
+    struct FormatBlockInfo {
+        uint32_t blockBytes = 0;
+        uint32_t blockExtent = 1;
+        bool compressed = false;
+    };
+
+    // テクスチャとして扱えるフォーマットのブロック情報を取得する.
+    bool GetFormatBlockInfo(VkFormat format, FormatBlockInfo& info);
+
+    // ミップマップを含めたテクセルデータのバイト数.
+    VkDeviceSize CalcTextureDataSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount);
+
+    // KTX2 コンテナ(2D, 超圧縮なし)の読み書きを行うクラス.
+    //  BCn で圧縮済みのミップマップをそのままイメージへ転送するために使用する.
+    class Ktx2Texture {
+    public:
+        struct Level {
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            uint32_t width = 0;
+            uint32_t height = 0;
+        };
+
+        static bool IsKtx2(const void* data, size_t size);
+
+        // メモリ上の KTX2 を解析する. 各レベルは data を参照するので, 使い終わるまで保持すること.
+        bool Parse(const void* data, size_t size);
+
+        VkFormat GetFormat() const { return m_format; }
+        uint32_t GetWidth() const { return m_width; }
+        uint32_t GetHeight() const { return m_height; }
+        const std::vector<Level>& GetLevels() const { return m_levels; }
+
+        // ファイル側でミップマップを持たず, 読み込み時の生成を要求しているか(levelCount == 0).
+        bool IsMipGenerationRequested() const { return m_mipGenerationRequested; }
+
+        // levels[0] を最大のレベルとして KTX2 ファイルを書き出す.
+        static bool Write(
+            const std::wstring& fileName, VkFormat format, uint32_t width, uint32_t height,
+            const std::vector<std::vector<uint8_t>>& levels);
+    private:
+        VkFormat m_format = VK_FORMAT_UNDEFINED;
+        uint32_t m_width = 0;
+        uint32_t m_height = 0;
+        std::vector<Level> m_levels;
+        bool m_mipGenerationRequested = false;
+    };
+}
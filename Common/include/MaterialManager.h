@@ -8,9 +8,14 @@
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 
+#include "VkrayBookUtility.h"
+
+class MaterialManager;
+
 namespace vk {
     class GraphicsDevice;
     class ImageResource;
+    class DescriptorBuffer;
 }
 
 class Material {
@@ -31,14 +36,22 @@ public:
         return { glm::vec4(m_diffuse, 0.0f), glm::vec4(m_specular, m_specPower), m_type, m_textureIndex };
     }
 
-    void SetTexture(int textureIndex) { m_textureIndex = textureIndex; }
-    void SetType(int type) { m_type = type; }
-    void SetDiffuse(glm::vec3 diffuse) { m_diffuse = diffuse; }
-    void SetSpecular(glm::vec3 specular) { m_specular = specular; }
-    void SetSpecularPower(float specPower) { m_specPower = specPower; }
+    // ݒ肷 MaterialManager ɓo^ς݂ł GPU ̍XVΏۂɂȂ.
+    void SetTexture(int textureIndex) { m_textureIndex = textureIndex; MarkDirty(); }
+    void SetType(int type) { m_type = type; MarkDirty(); }
+    void SetDiffuse(glm::vec3 diffuse) { m_diffuse = diffuse; MarkDirty(); }
+    void SetSpecular(glm::vec3 specular) { m_specular = specular; MarkDirty(); }
+    void SetSpecularPower(float specPower) { m_specPower = specPower; MarkDirty(); }
 
     std::wstring GetName() const { return m_name; }
 private:
+    friend class MaterialManager;
+    void MarkDirty();
+
+    // o^̃}l[W[ƃobt@̈ʒu.
+    MaterialManager* m_owner = nullptr;
+    int m_materialIndex = -1;
+
     // QƂeNX`̃CfbNX.
     int m_textureIndex = -1;
     int m_type = 0;
@@ -61,10 +74,20 @@ public:
     // eNX`o^.
     int AddTexture(const std::wstring& name, vk::ImageResource texture);
 
+    // 摜̓eƋɃeNX`o^.
+    //  contentHash ̓fR[hÕf[^ util::ComputeContentHash ŋ߂l.
+    //  OdĂĂeƂɓo^, O͖o^̏ꍇ̂݌pɓo^.
+    int AddTexture(const std::wstring& name, vk::ImageResource texture, uint64_t contentHash, size_t encodedSize);
+
+    // ẽeNX`o^ς݂Ȃ炻L.
+    //  ꍇ̓fR[hȗ𓝌vɉ, CfbNXԂ.  -1.
+    int ShareTexture(const std::wstring& name, uint64_t contentHash, size_t encodedSize);
+
     // eNX`.
     int GetTexture(const std::wstring& name) const;
 
     // }eAo^.
+    //  }eAobt@̗eʂ𒴂ꍇ̓obt@g. głȂΓo^ -1 Ԃ.
     int AddMaterial(std::shared_ptr<Material> mate);
 
     // }eAŌ.
@@ -73,16 +96,87 @@ public:
     // o^ς݃eNX`̃fBXNv^zԂ.
     std::vector<VkDescriptorImageInfo> GetTextureDescriptors() const;
 
+    // SeNX` binding 0 ̔zƂĎQƂZbg.
+    //  VK_EXT_descriptor_buffer g΃fBXNv^obt@, gȂ΃fBXNv^Zbgɒu,
+    //  AddTexture ̂тɒǉvf.
+    //  fBXNv^Zbg̏ꍇ, ZbgQƂR}h̎s AddTexture Ȃ.
+    VkDescriptorSetLayout GetTextureSetLayout() const { return m_textureSetLayout; }
+    bool UsesDescriptorBuffer() const { return m_descriptorBuffer != nullptr; }
+    VkDescriptorSet GetTextureSet() const { return m_textureSet; }          // fBXNv^Zbg̏ꍇ.
+    VkDeviceSize GetTextureSetOffset() const { return m_textureSetOffset; } // fBXNv^obt@̏ꍇ.
+
     int GetMaxTextureCount() const { return static_cast<int>(m_textures.capacity()); }
     int GetTextureCount() const { return static_cast<int>(m_textures.size()); }
 
     // UBOɏ}eAz擾.
     std::vector<Material::DataBlock> GetMaterialData() const;
+
+    // }eAuXg[Wobt@.
+    //  st[̗̈, UpdateMaterialBuffer ŕύX̂vf
+    //  wt[̗̈֏. ύXꂽvf͑St[̗̈ɔf܂ōXVΏۂɎc.
+    //  eʂ𒴂ēo^ GPU ̏҂č蒼, obt@QƂfBXNv^
+    //  GetMaterialBufferVersion ς珑. 蒼̓R}h̋L^ɍsȂ.
+    bool CreateMaterialBuffer(VkGraphicsDevice& device, int maxMaterials = 0);
+    void UpdateMaterialBuffer(uint32_t frameIndex);
+    VkDescriptorBufferInfo GetMaterialBufferDescriptor() const { return m_materialBuffer.GetDescriptor(); }
+    VkDeviceSize GetMaterialBufferBlockSize() const { return m_materialBuffer.GetBlockSize(); }
+    VkDeviceAddress GetMaterialBufferAddress(uint32_t frameIndex) const { return m_materialBuffer.GetDeviceAddress(frameIndex); }
+    uint32_t GetMaterialBufferVersion() const { return m_materialBufferVersion; }
+
+    // ߂ UpdateMaterialBuffer ŏ񂾃}eA.
+    uint32_t GetMaterialUploadCount() const { return m_materialUploadCount; }
+    int GetMaterialCount() const { return static_cast<int>(m_materials.size()); }
+
+    // o^ς݃eNX`̃gp.
+    struct TextureStatistics {
+        int textureCount = 0;
+        int compressedCount = 0;            // ubNktH[}bg̃eNX`.
+        VkDeviceSize dataBytes = 0;         // eNZf[^̍v(~bv}bv܂).
+        VkDeviceSize uncompressedBytes = 0; // S RGBA8 ŕێꍇ̍v.
+        int sharedCount = 0;                // eߊ̃eNX`L摜.
+        VkDeviceSize sharedEncodedBytes = 0;// LɂfR[hȂ摜f[^̍v.
+        VkDeviceSize sharedDataBytes = 0;   // LɂmۂȂeNZf[^̍v.
+    };
+    TextureStatistics GetTextureStatistics() const { return m_textureStats; }
 private:
+    int RegisterTexture(vk::ImageResource texture);
+    void CreateTextureSet(VkGraphicsDevice& device, int maxTextures);
+    VkDescriptorSetLayout CreateTextureSetLayout(uint32_t textureCount, bool descriptorBuffer);
+    void WriteTextureDescriptor(int textureIndex);
+
+    friend class Material;
+    void MarkMaterialDirty(int materialIndex);
+    bool GrowMaterialBuffer(uint32_t requiredCapacity);
+
     std::vector<vk::ImageResource> m_textures;
     std::vector<std::shared_ptr<Material>> m_materials;
 
     std::unordered_map<std::wstring, int> m_textureMap;
+    // ẽnbVlo^ς݃eNX`. Փ˂ɔăf[^TCYׂ.
+    struct TextureContent {
+        size_t encodedSize;
+        int textureIndex;
+    };
+    std::unordered_multimap<uint64_t, TextureContent> m_textureContentMap;
     std::unordered_map<std::wstring, int> m_materialMap;
     VkSampler m_defaultSampler;
+    TextureStatistics m_textureStats;
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    vk::DescriptorBuffer* m_descriptorBuffer = nullptr;
+    VkDescriptorSetLayout m_textureSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet m_textureSet = VK_NULL_HANDLE;
+    VkDeviceSize m_textureSetOffset = 0;
+    uint32_t m_textureSetCapacity = 0;  // Zbgɏ߂eNX`̐.
+
+    util::DynamicBuffer m_materialBuffer;
+    bool m_hasMaterialBuffer = false;
+    uint32_t m_materialCapacity = 0;
+    uint32_t m_materialBufferVersion = 0;   // obt@蒼тɑ.
+    VkGraphicsDevice* m_materialDevice = nullptr;
+    uint32_t m_framesInFlight = 0;
+    // vfƂɖf̃t[̈搔, 0 łȂ m_dirtyMaterials ɓĂ.
+    std::vector<uint32_t> m_materialPendingFrames;
+    std::vector<int> m_dirtyMaterials;
+    uint32_t m_materialUploadCount = 0;
 };
@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vk {
+
+    // 1つのメモリブロック内の空き領域を管理するクラス.
+    //  Vulkan API は呼ばないので CPU 側だけで動作確認ができる.
+    class MemoryBlockRange {
+    public:
+        explicit MemoryBlockRange(VkDeviceSize size = 0);
+
+        // 空き領域から確保. 成功時には offset に先頭位置が入る.
+        bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+        // 確保した領域を返却. 隣接する空き領域とは結合される.
+        void Free(VkDeviceSize offset, VkDeviceSize size);
+
+        VkDeviceSize GetSize() const { return m_size; }
+        VkDeviceSize GetUsedSize() const { return m_used; }
+        VkDeviceSize GetLargestFreeRange() const;
+        uint32_t GetFreeRangeCount() const { return uint32_t(m_freeRanges.size()); }
+        bool IsEmpty() const { return m_used == 0; }
+    private:
+        // key: オフセット, value: サイズ.
+        std::map<VkDeviceSize, VkDeviceSize> m_freeRanges;
+        VkDeviceSize m_size = 0;
+        VkDeviceSize m_used = 0;
+    };
+
+    // 確保済みメモリの情報.
+    //  VkDeviceMemory を他のリソースと共有するため, オフセットとセットで扱う.
+    struct MemoryAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;         // HOST_VISIBLE なメモリの場合のみ有効.
+        uint32_t memoryTypeIndex = ~0u;
+        int32_t poolIndex = -1;         // -1 のときは専用確保(ラージブロック).
+        int32_t blockIndex = -1;
+    };
+
+    // メモリタイプごとにブロックを確保して, そこから切り出して割り当てるアロケータ.
+    //  - 要求サイズはサイズクラスに丸めて断片化を抑える.
+    //  - ブロックサイズの半分を超える要求は専用の VkDeviceMemory で確保する.
+    class DeviceMemoryAllocator {
+    public:
+        void Initialize(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize = DefaultBlockSize);
+        void Destroy();
+
+        MemoryAllocation Allocate(const VkMemoryRequirements& reqs, uint32_t memoryTypeIndex, bool isImage, bool useDeviceAddress);
+        void Free(const MemoryAllocation& allocation);
+
+        struct HeapStatistics {
+            uint32_t blockCount = 0;            // ブロック数(専用確保分を含む).
+            uint32_t dedicatedCount = 0;        // 専用確保の数.
+            uint32_t allocationCount = 0;       // 割り当て済みの数.
+            VkDeviceSize bytesReserved = 0;     // vkAllocateMemory で確保したバイト数.
+            VkDeviceSize bytesInUse = 0;        // 割り当て済みのバイト数.
+            VkDeviceSize bytesFree = 0;
+            VkDeviceSize largestFreeRange = 0;
+            float fragmentation = 0.0f;         // 1 - 最大空き領域/空き領域合計.
+        };
+        std::vector<HeapStatistics> GetStatistics() const;
+
+        // 統計情報を文字列にして返す.
+        std::string DumpStatistics() const;
+
+        // サイズクラスへの丸め.
+        static VkDeviceSize GetSizeClass(VkDeviceSize size);
+
+        static const VkDeviceSize DefaultBlockSize = 64ull * 1024 * 1024;
+        static const VkDeviceSize MinSizeClass = 256;
+        static const VkDeviceSize MaxSizeClass = 1024 * 1024;
+    private:
+        struct Block {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void* mapped = nullptr;
+            MemoryBlockRange range;
+            uint32_t allocationCount = 0;
+        };
+        // メモリタイプ & (バッファ/イメージ) ごとのブロック群.
+        //  bufferImageGranularity を気にしなくて済むようにバッファとイメージは別にしておく.
+        struct Pool {
+            uint32_t memoryTypeIndex = 0;
+            bool isImage = false;
+            std::vector<std::unique_ptr<Block>> blocks;
+        };
+        int32_t GetPoolIndex(uint32_t memoryTypeIndex, bool isImage) const;
+        VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, bool useDeviceAddress, void** mapped);
+        VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const;
+
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties m_memProps{};
+        VkDeviceSize m_preferredBlockSize = DefaultBlockSize;
+
+        std::vector<Pool> m_pools;
+
+        // 専用確保分の統計用.
+        struct DedicatedInfo {
+            uint32_t count = 0;
+            VkDeviceSize bytes = 0;
+        };
+        std::vector<DedicatedInfo> m_dedicated;
+
+        mutable std::mutex m_mutex;
+    };
+}
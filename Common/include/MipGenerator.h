@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace util {
+
+    // RGBA8 画像のミップマップを CPU で生成するクラス.
+    //  GPU の縮小コピーが使えないフォーマットや, オフラインでの変換処理で使用する.
+    class MipGenerator {
+    public:
+        enum class Filter {
+            Box,        // 2x2 の平均(高速).
+            Kaiser,     // Kaiser 窓付き sinc による 6 タップの分離フィルタ(高品質).
+        };
+
+        // 1 段縮小した画像を dst に書き込む.
+        //  出力サイズは (max(width / 2, 1), max(height / 2, 1)).
+        static void Downsample(
+            const uint8_t* src, uint32_t width, uint32_t height,
+            uint8_t* dst, Filter filter = Filter::Box);
+
+        // レベル 1 以降(1x1 まで)の画像を生成する. レベル 0 は src そのものとなる.
+        static std::vector<std::vector<uint8_t>> GenerateChain(
+            const uint8_t* src, uint32_t width, uint32_t height, Filter filter = Filter::Box);
+    };
+}
@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "GraphicsDevice.h"
+
+namespace vk {
+
+    // コマンドの記録をワーカースレッドに分け, セカンダリコマンドバッファを経由してプライマリへ積むクラス.
+    //  各スレッドは GraphicsDevice のフレーム・スレッドごとのプールから割り当てるので, 解放は不要.
+    class ParallelCommandRecorder {
+    public:
+        // 要素 [begin, end) のコマンドを command へ記録する関数.
+        //  ワーカースレッドから呼ばれる. パイプライン等の状態は引き継がれないので, 関数内で設定すること.
+        using RecordFunc = std::function<void(VkCommandBuffer command, size_t begin, size_t end)>;
+
+        // 記録に使うスレッド数の上限. 0 なら GraphicsDevice::GetCommandRecordingThreadCount まで使う.
+        //  1 の場合はセカンダリを使わずに, 呼び出し元のスレッドで primary へ直接記録する.
+        void SetMaxThreadCount(uint32_t count) { m_maxThreadCount = count; }
+        uint32_t GetMaxThreadCount() const { return m_maxThreadCount; }
+
+        // 実際に記録に使うスレッドの数.
+        uint32_t GetThreadCount(std::unique_ptr<GraphicsDevice>& device) const;
+
+        // count 個の要素を連続した範囲に分けて並列に記録し, 範囲の順に primary から実行する.
+        //  primary は記録中であること. 戻るときにはすべての記録が完了している.
+        //  type には primary を実行するキューを指定する.
+        void Record(
+            std::unique_ptr<GraphicsDevice>& device,
+            GraphicsDevice::QueueType type,
+            VkCommandBuffer primary,
+            size_t count,
+            const RecordFunc& func) const;
+
+    private:
+        uint32_t m_maxThreadCount = 0;
+    };
+}
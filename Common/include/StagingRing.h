@@ -0,0 +1,116 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+#include "TimelineSemaphore.h"
+
+namespace vk {
+
+    // DEVICE_LOCAL なリソースへの転送に使う, マップしたままのステージング用リングバッファ.
+    //  書き込みは 1 つのコマンドバッファにまとめて記録し, Flush で送信する.
+    //  送信済みの領域はタイムラインセマフォで完了を確認してから再利用する.
+    //
+    //  SetOwnerQueue で転送先のリソースを使うキュー(所有キュー)を指定すると, 専用の転送キューで
+    //  コピーを行い, 所有キューでは転送の完了を待ってから所有権の取得(acquire)を行う.
+    //  バッファは複数のキューで共有(CONCURRENT)されている前提で, 所有権の移動はイメージのみ行う.
+    class StagingRing {
+    public:
+        bool Initialize(
+            VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, TimelineSemaphore& timeline,
+            DeviceMemoryAllocator& allocator, const VkPhysicalDeviceMemoryProperties& memProps,
+            VkDeviceSize size = DefaultSize);
+        void Destroy();
+
+        // 転送したリソースを使うキューが転送用のキューと異なるファミリーの場合に設定する.
+        //  完了の判定(Flush の戻り値, Retire)は所有キューのタイムラインで行う.
+        bool SetOwnerQueue(VkQueue ownerQueue, uint32_t ownerQueueFamilyIndex, TimelineSemaphore& ownerTimeline);
+        bool HasOwnerQueue() const { return m_ownerQueue != VK_NULL_HANDLE; }
+
+        // バッファへの書き込みを積む. リングより大きいデータは分割して転送する.
+        void WriteBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+        // リングから領域を確保してデータを書き込む.
+        //  イメージへの転送など, 呼び出し側でコピー命令を記録するときに使用する.
+        bool Write(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+        // 積まれている転送コマンドを記録中のコマンドバッファ.
+        VkCommandBuffer GetCommandBuffer();
+
+        // 転送後に所有キューで実行するコマンド(ミップマップ生成やレイアウト変更など)を記録するコマンドバッファ.
+        //  所有キューが無ければ GetCommandBuffer と同じもの.
+        VkCommandBuffer GetOwnerCommandBuffer();
+
+        // 転送を終えたイメージの所有権を所有キューへ移す. 所有キューが無ければ何もしない.
+        //  レイアウトは変更しないため, 以降の状態遷移は GetOwnerCommandBuffer へ記録する.
+        void TransferOwnership(VkImage image, VkImageLayout layout, const VkImageSubresourceRange& range);
+        VkBuffer GetBuffer() const { return m_buffer; }
+        VkDeviceSize GetSize() const { return m_size; }
+
+        // 積まれている転送を送信する(完了は待たない).
+        //  完了時に到達するタイムラインの値(所有キューがあればそのタイムライン)を返す. 積まれていなければ 0.
+        uint64_t Flush();
+
+        // 送信済みの転送の完了を確認して領域を回収する.
+        void Retire(bool waitAll = false);
+
+        // 記録中の転送をまとめた単位(バッチ)の番号. 送信ごとに増えていく. 記録中でなければ 0.
+        //  リソースを破棄する前に, そのリソースへの転送を積んだバッチを WaitBatch で待つのに使う.
+        uint64_t GetPendingBatch() const { return m_hasPending ? m_pending.id : 0; }
+
+        // 指定したバッチまでの転送を送信して完了を待つ. 完了済みなら何もしない.
+        void WaitBatch(uint64_t batch);
+
+        static const VkDeviceSize DefaultSize = 32ull * 1024 * 1024;
+    private:
+        bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+        void RetireOldest();
+        // 確保済みの領域が無ければ, 記録中や送信済みのバッチがあっても先頭から使い直せる.
+        bool IsEmpty() const { return m_usedSize == 0; }
+        TimelineSemaphore* GetCompletionTimeline() const { return HasOwnerQueue() ? m_ownerTimeline : m_timeline; }
+
+        struct Batch {
+            VkCommandBuffer command = VK_NULL_HANDLE;
+            VkCommandBuffer ownerCommand = VK_NULL_HANDLE;  // 所有キューで実行する分.
+            uint64_t timelineValue = 0;                     // 完了の判定に使うタイムラインの値.
+            VkDeviceSize endOffset = 0;
+            VkDeviceSize size = 0;                          // このバッチで確保した領域のバイト数.
+            uint64_t id = 0;
+        };
+
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkQueue m_queue = VK_NULL_HANDLE;
+        VkCommandPool m_commandPool = VK_NULL_HANDLE;
+        TimelineSemaphore* m_timeline = nullptr;
+        DeviceMemoryAllocator* m_allocator = nullptr;
+        uint32_t m_queueFamilyIndex = 0;
+
+        VkQueue m_ownerQueue = VK_NULL_HANDLE;
+        uint32_t m_ownerQueueFamilyIndex = 0;
+        VkCommandPool m_ownerCommandPool = VK_NULL_HANDLE;
+        TimelineSemaphore* m_ownerTimeline = nullptr;
+
+        VkBuffer m_buffer = VK_NULL_HANDLE;
+        MemoryAllocation m_allocation;
+        uint8_t* m_mapped = nullptr;
+        VkDeviceSize m_size = 0;
+
+        // [m_tail, m_head) が使用中の領域.
+        VkDeviceSize m_head = 0;
+        VkDeviceSize m_tail = 0;
+
+        // m_head == m_tail が空か満杯かを区別するため, 確保したバイト数を数えておく.
+        //  (バリアのみのバッチは領域を使わないので満杯とは扱わない)
+        VkDeviceSize m_usedSize = 0;
+        VkDeviceSize m_pendingSize = 0;
+
+        Batch m_pending;
+        bool m_hasPending = false;
+        std::deque<Batch> m_inFlight;
+        std::vector<Batch> m_freeBatches;
+        uint64_t m_lastBatchId = 0;
+    };
+}
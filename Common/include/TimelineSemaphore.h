@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+namespace vk {
+
+    // タイムラインセマフォで GPU の進み具合を管理するクラス.
+    //  キューへの送信ごとに値を 1 つ進めて signal し, 任意の値の完了を確認・待機できる.
+    //  同じキューへの送信は順に完了するため, ある値の完了はそれ以前の送信の完了も意味する.
+    class TimelineSemaphore {
+    public:
+        bool Initialize(VkDevice device);
+        void Destroy();
+
+        VkSemaphore GetSemaphore() const { return m_semaphore; }
+
+        // 次の送信で signal する値を払い出す.
+        uint64_t Advance() { return ++m_lastSignaledValue; }
+
+        // 最後に払い出した値.
+        uint64_t GetLastSignaledValue() const { return m_lastSignaledValue; }
+
+        // GPU 側で完了済みの値.
+        uint64_t GetCompletedValue() const;
+
+        bool IsCompleted(uint64_t value) const;
+
+        // 指定した値に到達するまで待機する.
+        void Wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+    private:
+        VkDevice m_device = VK_NULL_HANDLE;
+        VkSemaphore m_semaphore = VK_NULL_HANDLE;
+        uint64_t m_lastSignaledValue = 0;
+
+        // 完了を確認済みの値(問い合わせを減らすためのキャッシュ).
+        mutable uint64_t m_completedValue = 0;
+    };
+}
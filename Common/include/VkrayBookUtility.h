@@ -27,6 +27,15 @@ namespace util {
     VkTransformMatrixKHR ConvertTransform(const glm::mat4x3& m);
     std::wstring ConvertFromUTF8(const std::string& s);
 
+    // ------------------------------------------
+    // Hash
+    // ------------------------------------------
+    // oCg 64bit nbVl߂. seed ɑO̒lnƑČvZł.
+    uint64_t ComputeHash(const void* data, size_t size, uint64_t seed = 0);
+
+    // 傫ȃf[^(摜t@C)̓erp. 8 byte Pʂŏ xxHash64.
+    uint64_t ComputeContentHash(const void* data, size_t size, uint64_t seed = 0);
+
     // ------------------------------------------
     // Helper Function
     // ------------------------------------------
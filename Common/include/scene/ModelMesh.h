@@ -19,10 +19,17 @@ public:
     virtual void Destroy(std::unique_ptr<vk::GraphicsDevice>& device) override;
 
     void BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
+    // \z builder ɐς. \z builder.Build ł܂Ƃ߂čs.
+    void BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
 
     virtual std::vector<VkAccelerationStructureGeometryKHR> GetAccelerationStructureGeometry(int frameIndex = 0) override;
     virtual std::vector<VkAccelerationStructureBuildRangeInfoKHR> GetAccelerationStructureBuildRangeInfo() override;
-    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters() override;
+    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters(int frameIndex = 0) override;
+
+    // XLjOf͕ό`̒_ BLAS t[ƂɎ.
+    //  Rs[gL[Ŏ̃t[̕ό`sĂԂ, Õt[̌ʂŃCg[Xł.
+    virtual int GetBlasFrameCount() const override { return m_frameCount; }
+    virtual VkAccelerationStructureInstanceKHR GetAccelerationStructureInstance(int frameIndex = 0) const override;
 
     class ModelNode {
     public:
@@ -120,7 +127,8 @@ public:
     void ApplyTransform(VkGraphicsDevice& device);
 
     // ApplyTransform ̓e BLAS XV.
-    void UpdateBlas(VkCommandBuffer command);
+    //  frameIndex ɂ ApplyTransform Ă񂾂Ƃ̃t[CfbNXw肷.
+    void UpdateBlas(VkCommandBuffer command, int frameIndex = 0);
 
     // w肳ꂽm[h.
     std::shared_ptr<ModelNode> SearchNode(const std::wstring& name) const;
@@ -143,6 +151,8 @@ public:
     const util::DynamicBuffer& GetJointMatricesBuffer() const;  // WCg̍s(XLjOs)obt@.
     vk::BufferResource GetPositionTransformedBuffer() const;    // ό`̒_ʒuobt@.
     vk::BufferResource GetNormalTransformedBuffer() const;      // ό`̒_@obt@.
+    VkDeviceSize GetTransformedFrameOffset(int frameIndex) const { return m_transformedStride * frameIndex; } // ό`obt@̃t[Ƃ̈ʒu.
+    VkDeviceSize GetTransformedFrameSize() const { return m_transformedSize; }    // ό`obt@ 1 t[̃TCY.
 private:
     void CreateNodes(const util::VkrModel* model);
     void CreateTextures(VkGraphicsDevice& device, const std::vector<util::VkrModel::ImageInfo>& images, MaterialManager& materialManager);
@@ -151,9 +161,13 @@ private:
     void AllocateBlasTransformMatrices(VkGraphicsDevice& device, const util::VkrModel* model);
     void AllocateTransformedBuffer(VkGraphicsDevice& device, uint64_t size);
 
+    AccelerationStructure& GetFrameBlas(int frameIndex);
+    const AccelerationStructure& GetFrameBlas(int frameIndex) const;
+
     std::vector<std::shared_ptr<ModelNode>> m_nodes;
     std::vector<std::shared_ptr<ModelNode>> m_blasNodes;    // BLAS\zɎQƂm[h.
     std::vector<std::shared_ptr<Material>> m_materials;
+    std::vector<int> m_imageTextures;   // f̉摜Ƃ MaterialManager ̃eNX`ԍ.
     std::vector<std::shared_ptr<ModelNode>> m_skinJoints;   // XLjOɊ֘AWCg(m[h) ̎Q.
     std::vector<glm::mat4> m_invBindMatrices;               // XLjOoChts.
 
@@ -173,8 +187,13 @@ private:
     vk::BufferResource m_positionTransformed;   // ό`㒸_ʒuobt@.
     vk::BufferResource m_normalTransformed;     // ό`@obt@.
     util::DynamicBuffer m_jointMatricesBuffer;   // XLjOvZ̍si[obt@.
+    VkDeviceSize m_transformedSize = 0;         // ό`obt@ 1 t[̃TCY.
+    VkDeviceSize m_transformedStride = 0;       // ό`obt@̃t[Ԃ̊Ԋu (ACgς).
+    std::vector<AccelerationStructure> m_frameBlas; // 2 t[ڈȍ~ BLAS (1 t[ڂ m_blas).
+    int m_frameCount = 1;
 
     bool m_isSkinned = false;
     int m_skinVertexCount = 0;
     VkBuildAccelerationStructureFlagsKHR m_blasBuildFlags = 0;
+    uint64_t m_contentHash = 0;     // BLAS LbṼL[vZp.
 };
\ No newline at end of file
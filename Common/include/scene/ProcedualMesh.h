@@ -21,13 +21,15 @@ public:
     }
 
     void BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
+    // \z builder ɐς. \z builder.Build ł܂Ƃ߂čs.
+    void BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
 
     virtual std::vector<VkAccelerationStructureGeometryKHR> GetAccelerationStructureGeometry(int frameIndex=0) override;
     virtual std::vector<VkAccelerationStructureBuildRangeInfoKHR> GetAccelerationStructureBuildRangeInfo() override;
 
     virtual uint64_t GetDeviceAddressVB() const { return aabbBuffer.GetDeviceAddress(); }
 
-    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters();
+    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters(int frameIndex = 0);
 
     std::shared_ptr<Material> GetMaterial() const { return m_material; }
 
@@ -38,7 +38,12 @@ public:
 
         int materialIndex;
     };
-    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters() = 0;
+    // frameIndex  GetBlasFrameCount()  2 ȏ̂ƂɃt[Ƃ̒lIԂ߂Ɏg.
+    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters(int frameIndex = 0) = 0;
+
+    // t[ƂɌʂ BLAS  (ʏ 1).
+    //  qbgVF[_[̃R[hׂ͂̐ēo^.
+    virtual int GetBlasFrameCount() const { return 1; }
 
     virtual void SetWorldMatrix(glm::mat4 m);
     void SetHitShaderOffset(uint32_t offset);
@@ -46,7 +51,7 @@ public:
     void SetCustomIndex(uint32_t customIndex);
     void SetGeometryInstanceFlags(VkGeometryInstanceFlagsKHR flags);
 
-    VkAccelerationStructureInstanceKHR GetAccelerationStructureInstance() const;
+    virtual VkAccelerationStructureInstanceKHR GetAccelerationStructureInstance(int frameIndex = 0) const;
 
     void SetHitShader(const std::string& name) { m_hitShaderName = name; }
     std::string GetHitShader()const { return m_hitShaderName; }
@@ -27,6 +27,8 @@ public:
     }
 
     void BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
+    // \z builder ɐς. \z builder.Build ł܂Ƃ߂čs.
+    void BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags = 0);
 
     virtual std::vector<VkAccelerationStructureGeometryKHR> GetAccelerationStructureGeometry(int frameIndex=0) override;
     virtual std::vector<VkAccelerationStructureBuildRangeInfoKHR> GetAccelerationStructureBuildRangeInfo() override;
@@ -34,7 +36,7 @@ public:
     virtual uint64_t GetDeviceAddressVB() const { return vertexBuffer.GetDeviceAddress(); }
     virtual uint64_t GetDeviceAddressIB() const { return indexBuffer.GetDeviceAddress(); }
 
-    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters();
+    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters(int frameIndex = 0);
     virtual int GetSubMeshCount() const { return 1; }
 
     uint32_t GetVertexCount() const { return vertexCount; }
@@ -76,7 +78,7 @@ public:
 
     virtual uint64_t GetDeviceAddressVB() const { return aabbBuffer.GetDeviceAddress(); }
 
-    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters();
+    virtual std::vector<SceneObjectParameter> GetSceneObjectParameters(int frameIndex = 0);
 
     void SetMaterial(std::shared_ptr<Material> material) { m_material = material; }
     std::shared_ptr<Material> GetMaterial() const { return m_material; }
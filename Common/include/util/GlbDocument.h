@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/MappedFile.h"
+
+namespace util {
+
+    // glTF バイナリ(.glb)ファイルを参照するクラス.
+    //  ファイルはメモリマップし, 解析するのは JSON チャンクのみとする.
+    //  アクセサや画像のデータは BIN チャンク内を直接指すスパンとして取得する.
+    class GlbDocument {
+    public:
+        struct Accessor {
+            int bufferView = -1;
+            uint64_t byteOffset = 0;
+            int componentType = 0;
+            bool normalized = false;
+            uint64_t count = 0;
+            uint32_t componentCount = 0;    // SCALAR=1, VEC2=2, ..., MAT4=16
+        };
+        struct BufferView {
+            int buffer = 0;
+            uint64_t byteOffset = 0;
+            uint64_t byteLength = 0;
+            uint32_t byteStride = 0;
+        };
+        struct Primitive {
+            std::unordered_map<std::string, int> attributes;
+            int indices = -1;
+            int material = -1;
+        };
+        struct Mesh {
+            std::string name;
+            std::vector<Primitive> primitives;
+        };
+        struct Node {
+            std::string name;
+            std::vector<double> translation;
+            std::vector<double> rotation;
+            std::vector<double> scale;
+            std::vector<int> children;
+            int mesh = -1;
+            int skin = -1;
+        };
+        struct Skin {
+            std::string name;
+            std::vector<int> joints;
+            int inverseBindMatrices = -1;
+        };
+        struct Material {
+            std::string name;
+            int baseColorTexture = -1;
+            int normalTexture = -1;
+            double baseColorFactor[4] = { 1.0, 1.0, 1.0, 1.0 };
+        };
+        struct Texture {
+            int source = -1;
+            int sampler = -1;
+        };
+        struct Image {
+            std::string name;
+            std::string mimeType;
+            int bufferView = -1;
+        };
+        struct Scene {
+            std::vector<int> nodes;
+        };
+
+        // マップした領域への参照.
+        struct Span {
+            const uint8_t* data = nullptr;
+            uint64_t size = 0;
+        };
+
+        bool Open(const std::wstring& fileName);
+
+        // メモリ上の glb を参照する. data は Close するまで呼び出し側で保持しておくこと.
+        bool OpenFromMemory(const uint8_t* data, uint64_t size);
+        void Close();
+
+        // バッファビューの範囲. BIN チャンク外を指すものは空となる.
+        Span GetBufferView(int index) const;
+
+        // アクセサの先頭要素へのポインタ. stride には要素間のバイト数が入る.
+        //  範囲外を指す場合は nullptr を返す.
+        const uint8_t* GetAccessorData(const Accessor& accessor, uint32_t& stride) const;
+
+        // アクセサの [first, first + count) の要素を float に変換して読み取る.
+        //  整数型は normalized の指定があれば [0,1] または [-1,1] に正規化し, 無ければ値をそのまま変換する.
+        //  dst には 1 要素につき accessor.componentCount 個の値を詰めて書き込む.
+        bool ReadFloat(const Accessor& accessor, size_t first, size_t count, float* dst) const;
+
+        // アクセサの要素を uint32_t に変換して読み取る. 符号なし整数型のみ対応する.
+        bool ReadUInt(const Accessor& accessor, size_t first, size_t count, uint32_t* dst) const;
+
+        // マップしているファイル. 取得したスパンを保持する場合に参照を残しておく.
+        std::shared_ptr<MappedFile> GetFile() const { return m_file; }
+
+        static uint32_t GetComponentSize(int componentType);
+
+        std::vector<Accessor> accessors;
+        std::vector<BufferView> bufferViews;
+        std::vector<Mesh> meshes;
+        std::vector<Node> nodes;
+        std::vector<Skin> skins;
+        std::vector<Material> materials;
+        std::vector<Texture> textures;
+        std::vector<Image> images;
+        std::vector<Scene> scenes;
+        int defaultScene = 0;
+
+        // 読み込みに必須とされている拡張機能.
+        std::vector<std::string> extensionsRequired;
+
+        static const int ComponentTypeByte = 5120;
+        static const int ComponentTypeUnsignedByte = 5121;
+        static const int ComponentTypeShort = 5122;
+        static const int ComponentTypeUnsignedShort = 5123;
+        static const int ComponentTypeUnsignedInt = 5125;
+        static const int ComponentTypeFloat = 5126;
+    private:
+        bool Parse(const char* json, size_t length);
+
+        std::shared_ptr<MappedFile> m_file;
+        Span m_binChunk;
+
+        // uri を持つ(外部ファイルの)バッファは参照できないので区別しておく.
+        std::vector<bool> m_bufferIsEmbedded;
+    };
+}
@@ -0,0 +1,29 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+    // ファイルを読み取り専用でメモリマップするクラス.
+    //  ヒープへコピーせずにファイル内容を直接参照する.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile() { Close(); }
+
+        bool Open(const std::wstring& fileName);
+        void Close();
+
+        bool IsOpen() const { return m_data != nullptr; }
+        const uint8_t* GetData() const { return m_data; }
+        uint64_t GetSize() const { return m_size; }
+    private:
+        void* m_file = nullptr;
+        void* m_mapping = nullptr;
+        const uint8_t* m_data = nullptr;
+        uint64_t m_size = 0;
+    };
+}
@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "GraphicsDevice.h"
+
+namespace util {
+
+    // 圧縮された画像データ(png, jpg, KTX2 など)からまとめてテクスチャを生成するクラス.
+    //  デコードはワーカースレッドで並列に行い, 終わったものから順次ステージングリングへ書き込む.
+    //  転送コマンドはリングのコマンドバッファにまとめて記録され, テクスチャごとの完了待ちは行わない.
+    class TextureLoader {
+    public:
+        using VkGraphicsDevice = std::unique_ptr<vk::GraphicsDevice>;
+
+        struct Source {
+            const void* data = nullptr;
+            size_t size = 0;
+        };
+
+        // sources と同じ順序でテクスチャを返す. デコードに失敗したものは空のリソースとなる.
+        //  転送は次のコマンド送信(または FlushUploads)の前に送信される.
+        //  generateMipmaps が true なら 1x1 までのミップマップを持つテクスチャを作成する.
+        static std::vector<vk::ImageResource> CreateTextures(
+            VkGraphicsDevice& device,
+            const std::vector<Source>& sources,
+            VkImageUsageFlags usage,
+            VkMemoryPropertyFlags memProps,
+            bool generateMipmaps = true);
+    };
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace util {
+
+    // 固定数のワーカースレッドでタスクを処理するクラス.
+    class ThreadPool {
+    public:
+        // threadCount が 0 の場合は (論理コア数 - 1) 個のスレッドを作成する.
+        explicit ThreadPool(uint32_t threadCount = 0);
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        // タスクを積む. 完了は待たない.
+        void Enqueue(std::function<void()> task);
+
+        // [0, count) の各インデックスについて func を並列に実行し, 全ての完了を待つ.
+        //  呼び出し元のスレッドも処理に参加する.
+        void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+        uint32_t GetThreadCount() const { return uint32_t(m_threads.size()); }
+
+        // アプリケーション全体で共有するインスタンス.
+        static ThreadPool& GetShared();
+    private:
+        void WorkerMain();
+        bool RunPendingTask();
+
+        std::vector<std::thread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_taskAdded;
+        bool m_exit = false;
+    };
+}
@@ -11,13 +11,9 @@
 #include "VkrayBookUtility.h"
 #include "AccelerationStructure.h"
 
-namespace tinygltf {
-    class Node;
-    class Model;
-    struct Mesh;
-}
-
 namespace util {
+    class GlbDocument;
+    class MappedFile;
 
     // ff[^\NX.
     class VkrModel {
@@ -38,10 +34,28 @@ namespace util {
         void Destroy(VkGraphicsDevice& device);
 
         // f[h.
+        //  ϊς݂̃LbVt@CLł΂炩ǂݍ,
+        //   glTF ͂ăLbVt@C쐬.
         bool LoadFromGltf(
             const std::wstring& fileName,
             VkGraphicsDevice& device);
 
+        // glTF Oς݂̃oCi(LbVt@C)ɕϊ.
+        //  foCXKvƂȂ, ÖꊇϊɎgpł.
+        static bool ConvertToCache(const std::wstring& fileName, const std::wstring& cacheFileName);
+
+        // glTF t@CɑΉLbVt@C̃pX.
+        static std::wstring GetCacheFileName(const std::wstring& fileName);
+
+        // ǂݍ݌oHƂ CPU ̏(͂Ɠ]f[^̕܂)s. GPU ւ̓]͊܂܂Ȃ.
+        //  foCXKvƂȂ, c[ł̓ǂݍݎԂ̌vɎgp.
+        static bool ParseGltfOnly(const std::wstring& fileName);
+        static bool ReadCacheOnly(const std::wstring& cacheFileName, const std::wstring& fileName);
+
+        // _̓WJ(LoadMesh)݂̂w肵Xbh(Ăяo܂)Ŏs, ̎Ԃ~bŕԂ.
+        //  threadCount  1 ȂĂяô݂ŏ. ǂݍ߂ȂΕ̒lԂ.
+        static double MeasureLoadMesh(const std::wstring& fileName, uint32_t threadCount);
+
         // eKw֐߂\m[hNX.
         class Node {
         public:
@@ -85,7 +99,7 @@ namespace util {
             std::vector<Mesh> GetMeshes() const { return m_meshes; }
         private:
             std::vector<Mesh> m_meshes;
-            int m_nodeIndex;
+            int m_nodeIndex = -1;
             friend class VkrModel;
         };
 
@@ -113,8 +127,11 @@ namespace util {
             friend class VkrModel;
         };
 
+        // 摜f[^(kꂽ܂܂̃t@CC[W).
+        //  imageData ͓ǂݍ񂾃t@C}bv̈w, fj܂ŗL.
         struct ImageInfo {
-            std::vector<uint8_t> imageBuffer;
+            const uint8_t* imageData = nullptr;
+            size_t imageSize = 0;
             std::wstring fileName;
         };
         struct TextureInfo {
@@ -172,6 +189,10 @@ namespace util {
 
         // XLjO_̌.
         int GetSkinnedVertexCount() const { return m_skinInfo.skinVertexCount; }
+
+        // _ECfbNXf[^狁߂nbVl.
+        //  LbṼL[ƂĎgp.
+        uint64_t GetContentHash() const { return m_contentHash; }
     private:
         struct VertexAttributeVisitor {
             std::vector<uint32_t> indexBuffer;
@@ -182,10 +203,31 @@ namespace util {
             std::vector<uvec4> jointBuffer;
             std::vector<vec4>  weightBuffer;
         };
-        void LoadNode(const tinygltf::Model& inModel);
-        void LoadMesh(const tinygltf::Model& inModel, VertexAttributeVisitor& visitor);
-        void LoadSkin(const tinygltf::Model& inModel);
-        void LoadMaterial(const tinygltf::Model& inModel);
+        void LoadNode(const GlbDocument& inModel);
+        void LoadMesh(const GlbDocument& inModel, VertexAttributeVisitor& visitor);
+        void LoadSkin(const GlbDocument& inModel);
+        void LoadMaterial(const GlbDocument& inModel);
+
+        // glTF ͂ CPU ̃f[^\z.
+        bool ParseGltf(const std::wstring& fileName, VertexAttributeVisitor& visitor);
+
+        // _ECfbNXf[^̎Q(TCY̓oCgP).
+        struct VertexStreams {
+            const void* index = nullptr;    size_t indexSize = 0;
+            const void* position = nullptr; size_t positionSize = 0;
+            const void* normal = nullptr;   size_t normalSize = 0;
+            const void* texcoord = nullptr; size_t texcoordSize = 0;
+            const void* joint = nullptr;    size_t jointSize = 0;
+            const void* weight = nullptr;   size_t weightSize = 0;
+        };
+        void CreateBuffers(VkGraphicsDevice& device, const VertexStreams& streams);
+        static VertexStreams GetStreams(const VertexAttributeVisitor& visitor);
+        static size_t CopyStreams(const VertexStreams& streams);
+
+        // LbVt@C̓ǂݏ(VkrModelCache.cpp).
+        bool LoadFromCache(const std::wstring& cacheFileName, const std::wstring& fileName, VkGraphicsDevice& device);
+        bool ReadCache(const std::wstring& cacheFileName, const std::wstring& fileName, VertexStreams& streams);
+        bool WriteCache(const std::wstring& cacheFileName, const std::wstring& fileName, const VertexAttributeVisitor& visitor) const;
 
         // e_Ƃ̃obt@(Xg[)
         struct VertexAttribute {
@@ -212,6 +254,14 @@ namespace util {
 
         std::vector<ImageInfo> m_images;
         std::vector<TextureInfo> m_textures;
+
+        // m_images QƂĂ}bvς݂̃t@C.
+        std::shared_ptr<MappedFile> m_sourceFile;
+
+        uint64_t m_contentHash = 0;
+
+        // LoadMesh ŎgpXbh. 0 Ȃ狤L̃Xbhv[gp.
+        uint32_t m_decodeThreadCount = 0;
         
         friend class VkrModelActor;
     };
@@ -1,7 +1,13 @@
 ﻿#include "AccelerationStructure.h"
+#include "AccelerationStructureCache.h"
 #include "VkrayBookUtility.h"
 #include "GraphicsDevice.h"
 
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
 void AccelerationStructure::Destroy(VkGraphicsDevice& device)
 {
     DestroyScratchBuffer(device);
@@ -18,16 +24,43 @@ void AccelerationStructure::BuildAS(
     const Input& input,
     VkBuildAccelerationStructureFlagsKHR buildFlags)
 {
-    auto deviceVk = device->GetDevice();
+    if (buildFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) {
+        // コンパクションは構築後にサイズを読み戻す必要があるので builder に任せる.
+        AccelerationStructureBuilder builder;
+        builder.Add(device, *this, type, input, buildFlags);
+        builder.Build(device);
+        return;
+    }
 
-    // サイズを求める.
     VkAccelerationStructureBuildGeometryInfoKHR asBuildGeometryInfo{
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR
     };
     asBuildGeometryInfo.type = type;
     asBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
     asBuildGeometryInfo.flags = buildFlags;
+    auto asBuildSizesInfo = Allocate(device, asBuildGeometryInfo, input);
+
+    // スクラッチバッファを準備する.
+    if (asBuildSizesInfo.buildScratchSize > 0) {
+        VkBufferUsageFlags asUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+        m_scratchBuffer = device->CreateBuffer(
+            asBuildSizesInfo.buildScratchSize, asUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    // Acceleration Structure を構築する.
+    asBuildGeometryInfo.scratchData.deviceAddress = m_scratchBuffer.GetDeviceAddress();
+    Build(device, asBuildGeometryInfo, input.asBuildRangeInfo);
+}
+
+VkAccelerationStructureBuildSizesInfoKHR AccelerationStructure::Allocate(
+    VkGraphicsDevice& device,
+    VkAccelerationStructureBuildGeometryInfoKHR& asBuildGeometryInfo,
+    const Input& input,
+    VkDeviceSize storageSize)
+{
+    auto deviceVk = device->GetDevice();
 
+    // サイズを求める.
     asBuildGeometryInfo.geometryCount = uint32_t(input.asGeometry.size());
     asBuildGeometryInfo.pGeometries = input.asGeometry.data();
 
@@ -49,19 +82,39 @@ void AccelerationStructure::BuildAS(
     );
 
     // Accleration Structure を確保する.
+    //  キャッシュから復元する場合は, 復元に必要なサイズで確保する.
+    CreateStorage(device, asBuildGeometryInfo.type,
+        storageSize > 0 ? storageSize : asBuildSizesInfo.accelerationStructureSize);
+
     VkBufferUsageFlags asUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
     VkMemoryPropertyFlags memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    m_accelerationStructure.bufferResource = device->CreateBuffer(
-        asBuildSizesInfo.accelerationStructureSize, asUsage, memProps);
-    m_accelerationStructure.size = asBuildSizesInfo.accelerationStructureSize;
+    // アップデートバッファを準備する.
+    if (asBuildSizesInfo.updateScratchSize > 0) {
+        m_updateBuffer = device->CreateBuffer(
+            asBuildSizesInfo.updateScratchSize, asUsage, memProps);
+    }
+
+    asBuildGeometryInfo.dstAccelerationStructure = m_accelerationStructure.handle;
+    return asBuildSizesInfo;
+}
+
+void AccelerationStructure::CreateStorage(
+    VkGraphicsDevice& device, VkAccelerationStructureTypeKHR type, VkDeviceSize size)
+{
+    auto deviceVk = device->GetDevice();
+    VkBufferUsageFlags asUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    VkMemoryPropertyFlags memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    m_accelerationStructure.bufferResource = device->CreateBuffer(size, asUsage, memProps);
+    m_accelerationStructure.size = size;
 
     VkAccelerationStructureCreateInfoKHR asCreateInfo{
         VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR
     };
     asCreateInfo.buffer = m_accelerationStructure.bufferResource.GetBuffer();
     asCreateInfo.size = m_accelerationStructure.size;
-    asCreateInfo.type = asBuildGeometryInfo.type;
+    asCreateInfo.type = type;
     vkCreateAccelerationStructureKHR(
         deviceVk, &asCreateInfo, nullptr, &m_accelerationStructure.handle);
 
@@ -71,23 +124,6 @@ void AccelerationStructure::BuildAS(
     asDeviceAddressInfo.accelerationStructure = m_accelerationStructure.handle;
     m_accelerationStructure.deviceAddress = vkGetAccelerationStructureDeviceAddressKHR(
         deviceVk, &asDeviceAddressInfo);
-
-    // スクラッチバッファを準備する.
-    if (asBuildSizesInfo.buildScratchSize > 0) {
-        m_scratchBuffer = device->CreateBuffer(
-            asBuildSizesInfo.buildScratchSize, asUsage, memProps);
-    }
-
-    // アップデートバッファを準備する.
-    if (asBuildSizesInfo.updateScratchSize > 0) {
-        m_updateBuffer = device->CreateBuffer(
-            asBuildSizesInfo.updateScratchSize, asUsage, memProps);
-    }
-
-    // Acceleration Structure を構築する.
-    asBuildGeometryInfo.dstAccelerationStructure = m_accelerationStructure.handle;
-    asBuildGeometryInfo.scratchData.deviceAddress = m_scratchBuffer.GetDeviceAddress();
-    Build(device, asBuildGeometryInfo, input.asBuildRangeInfo);
 }
 
 void AccelerationStructure::Update(VkCommandBuffer command, 
@@ -176,3 +212,363 @@ void AccelerationStructure::Build(
     device->DestroyCommandBuffer(command);
 }
 
+void AccelerationStructureBuilder::Add(
+    VkGraphicsDevice& device,
+    AccelerationStructure& as,
+    VkAccelerationStructureTypeKHR type,
+    const AccelerationStructure::Input& input,
+    VkBuildAccelerationStructureFlagsKHR buildFlags,
+    uint64_t cacheKey)
+{
+    // pGeometries が入力の配列を指すので, 入力はコピーして保持しておく.
+    m_requests.emplace_back();
+    auto& request = m_requests.back();
+    request.target = &as;
+    request.input = input;
+    request.buildGeometryInfo = VkAccelerationStructureBuildGeometryInfoKHR{
+        VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR
+    };
+    request.buildGeometryInfo.type = type;
+    request.buildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    request.buildGeometryInfo.flags = buildFlags;
+
+    // キーにはビルドフラグも含める.
+    if (m_cache && cacheKey != 0) {
+        request.cacheKey = util::ComputeHash(&buildFlags, sizeof(buildFlags), cacheKey);
+    }
+
+    // キャッシュにあれば構築せずに復元する.
+    VkDeviceSize deserializedSize = 0;
+    if (request.cacheKey != 0 && m_cache->Load(device, request.cacheKey, request.serializedData, deserializedSize)) {
+        as.Allocate(device, request.buildGeometryInfo, request.input, deserializedSize);
+        return;
+    }
+    auto asBuildSizesInfo = as.Allocate(device, request.buildGeometryInfo, request.input);
+    request.scratchSize = asBuildSizesInfo.buildScratchSize;
+}
+
+void AccelerationStructureBuilder::Build(VkGraphicsDevice& device, VkDeviceSize scratchBudget)
+{
+    if (m_requests.empty()) {
+        return;
+    }
+    auto alignment = VkDeviceSize(device->GetAccelerationStructureProperties().minAccelerationStructureScratchOffsetAlignment);
+    auto alignUp = [](VkDeviceSize v, VkDeviceSize a) {
+        return a > 1 ? (v + a - 1) / a * a : v;
+    };
+
+    // キャッシュから復元するものと, 構築するものに分ける.
+    std::vector<size_t> buildIndices, restoreIndices;
+    for (size_t i = 0; i < m_requests.size(); ++i) {
+        if (m_requests[i].serializedData.empty()) {
+            buildIndices.push_back(i);
+        } else {
+            restoreIndices.push_back(i);
+        }
+    }
+
+    // スクラッチの合計が上限に収まるようにグループ分けする.
+    //  上限を超える単体の要求は, それだけで1グループとする.
+    std::vector<size_t> groupStarts = { 0 };
+    std::vector<VkDeviceSize> scratchOffsets(m_requests.size());
+    VkDeviceSize groupSize = 0, scratchSize = 0;
+    for (size_t n = 0; n < buildIndices.size(); ++n) {
+        auto i = buildIndices[n];
+        auto size = alignUp(m_requests[i].scratchSize, alignment);
+        if (groupSize > 0 && groupSize + size > scratchBudget) {
+            groupStarts.push_back(n);
+            groupSize = 0;
+        }
+        scratchOffsets[i] = groupSize;
+        groupSize += size;
+        scratchSize = (std::max)(scratchSize, groupSize);
+    }
+    groupStarts.push_back(buildIndices.size());
+
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    vk::BufferResource scratchBuffer;
+    VkDeviceAddress scratchAddress = 0;
+    if (!buildIndices.empty()) {
+        // アライメント調整のための余白を含めて確保する.
+        scratchBuffer = device->CreateBuffer(scratchSize + alignment, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        scratchAddress = alignUp(scratchBuffer.GetDeviceAddress(), alignment);
+    }
+
+    // コンパクション対象は構築後のサイズをクエリで取得する.
+    std::vector<size_t> compactIndices;
+    std::vector<uint32_t> queryIndices(m_requests.size(), ~0u);
+    for (auto i : buildIndices) {
+        if (m_requests[i].buildGeometryInfo.flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR) {
+            queryIndices[i] = uint32_t(compactIndices.size());
+            compactIndices.push_back(i);
+        }
+    }
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (!compactIndices.empty()) {
+        VkQueryPoolCreateInfo queryPoolCI{
+            VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO
+        };
+        queryPoolCI.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+        queryPoolCI.queryCount = uint32_t(compactIndices.size());
+        vkCreateQueryPool(device->GetDevice(), &queryPoolCI, nullptr, &queryPool);
+    }
+
+    auto command = device->CreateCommandBuffer();
+    if (queryPool) {
+        vkCmdResetQueryPool(command, queryPool, 0, uint32_t(compactIndices.size()));
+    }
+
+    // キャッシュから読み込んだデータを転送して復元する.
+    //  復元元のアドレスは 256 バイト境界である必要がある.
+    vk::BufferResource restoreBuffer;
+    if (!restoreIndices.empty()) {
+        const VkDeviceSize restoreAlignment = 256;
+        std::vector<VkDeviceSize> offsets;
+        VkDeviceSize restoreSize = 0;
+        for (auto i : restoreIndices) {
+            offsets.push_back(restoreSize);
+            restoreSize = alignUp(restoreSize + m_requests[i].serializedData.size(), restoreAlignment);
+        }
+        auto restoreUsage = usage | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+        restoreBuffer = device->CreateBuffer(restoreSize + restoreAlignment, restoreUsage,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        auto restoreAddress = alignUp(restoreBuffer.GetDeviceAddress(), restoreAlignment);
+        auto mapped = static_cast<uint8_t*>(device->Map(restoreBuffer)) + (restoreAddress - restoreBuffer.GetDeviceAddress());
+
+        for (size_t n = 0; n < restoreIndices.size(); ++n) {
+            auto& request = m_requests[restoreIndices[n]];
+            memcpy(mapped + offsets[n], request.serializedData.data(), request.serializedData.size());
+
+            VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{
+                VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR
+            };
+            copyInfo.src.deviceAddress = restoreAddress + offsets[n];
+            copyInfo.dst = request.target->GetHandle();
+            copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+            vkCmdCopyMemoryToAccelerationStructureKHR(command, &copyInfo);
+        }
+        device->Unmap(restoreBuffer);
+    }
+
+    for (size_t group = 0; group + 1 < groupStarts.size(); ++group) {
+        auto first = groupStarts[group];
+        auto last = groupStarts[group + 1];
+
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> buildRangeInfoPtrs;
+        for (size_t n = first; n < last; ++n) {
+            auto i = buildIndices[n];
+            auto& request = m_requests[i];
+            request.buildGeometryInfo.pGeometries = request.input.asGeometry.data();
+            request.buildGeometryInfo.scratchData.deviceAddress = scratchAddress + scratchOffsets[i];
+            buildInfos.push_back(request.buildGeometryInfo);
+            buildRangeInfoPtrs.push_back(request.input.asBuildRangeInfo.data());
+        }
+        if (!buildInfos.empty()) {
+            vkCmdBuildAccelerationStructuresKHR(
+                command, uint32_t(buildInfos.size()), buildInfos.data(), buildRangeInfoPtrs.data()
+            );
+        }
+
+        // スクラッチの再利用と, 構築結果の参照のためにバリアが必要.
+        VkMemoryBarrier barrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        };
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        vkCmdPipelineBarrier(
+            command,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+            0, 1, &barrier,
+            0, nullptr,
+            0, nullptr
+        );
+
+        // このグループのコンパクション後のサイズを書き込む.
+        for (size_t n = first; n < last; ++n) {
+            auto i = buildIndices[n];
+            if (queryIndices[i] == ~0u) {
+                continue;
+            }
+            auto handle = m_requests[i].target->GetHandle();
+            vkCmdWriteAccelerationStructuresPropertiesKHR(
+                command, 1, &handle,
+                VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR,
+                queryPool, queryIndices[i]);
+        }
+    }
+    vkEndCommandBuffer(command);
+
+    // 全ての構築が完了するまでを待機.
+    device->SubmitAndWait(command);
+    device->DestroyCommandBuffer(command);
+    if (scratchBuffer.GetBuffer()) {
+        device->DestroyBuffer(scratchBuffer);
+    }
+    if (restoreBuffer.GetBuffer()) {
+        device->DestroyBuffer(restoreBuffer);
+    }
+
+    m_compactionResults.clear();
+    if (queryPool) {
+        Compact(device, queryPool, compactIndices);
+        vkDestroyQueryPool(device->GetDevice(), queryPool, nullptr);
+    }
+
+    // 新しく構築したものはキャッシュに書き出しておく.
+    std::vector<size_t> storeIndices;
+    for (auto i : buildIndices) {
+        if (m_requests[i].cacheKey != 0) {
+            storeIndices.push_back(i);
+        }
+    }
+    if (!storeIndices.empty()) {
+        StoreToCache(device, storeIndices);
+    }
+    if (m_cache) {
+        std::stringstream ss;
+        ss << "AS cache: restored " << restoreIndices.size() << ", built " << buildIndices.size() << std::endl;
+        OutputDebugStringA(ss.str().c_str());
+    }
+    m_requests.clear();
+}
+
+void AccelerationStructureBuilder::StoreToCache(VkGraphicsDevice& device, const std::vector<size_t>& storeIndices)
+{
+    auto deviceVk = device->GetDevice();
+    auto count = uint32_t(storeIndices.size());
+
+    // シリアライズに必要なサイズを取得する.
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VkQueryPoolCreateInfo queryPoolCI{
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO
+    };
+    queryPoolCI.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+    queryPoolCI.queryCount = count;
+    vkCreateQueryPool(deviceVk, &queryPoolCI, nullptr, &queryPool);
+
+    std::vector<VkAccelerationStructureKHR> handles;
+    for (auto i : storeIndices) {
+        handles.push_back(m_requests[i].target->GetHandle());
+    }
+    auto command = device->CreateCommandBuffer();
+    vkCmdResetQueryPool(command, queryPool, 0, count);
+    vkCmdWriteAccelerationStructuresPropertiesKHR(
+        command, count, handles.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR,
+        queryPool, 0);
+    vkEndCommandBuffer(command);
+    device->SubmitAndWait(command);
+    device->DestroyCommandBuffer(command);
+
+    std::vector<VkDeviceSize> serializedSizes(count);
+    vkGetQueryPoolResults(
+        deviceVk, queryPool, 0, count,
+        sizeof(VkDeviceSize) * serializedSizes.size(), serializedSizes.data(), sizeof(VkDeviceSize),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    vkDestroyQueryPool(deviceVk, queryPool, nullptr);
+
+    // CPU から読める領域へシリアライズする.
+    const VkDeviceSize serializeAlignment = 256;
+    auto alignUp = [=](VkDeviceSize v) { return (v + serializeAlignment - 1) / serializeAlignment * serializeAlignment; };
+    std::vector<VkDeviceSize> offsets;
+    VkDeviceSize totalSize = 0;
+    for (auto size : serializedSizes) {
+        offsets.push_back(totalSize);
+        totalSize = alignUp(totalSize + size);
+    }
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    auto serializeBuffer = device->CreateBuffer(totalSize + serializeAlignment, usage,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    auto serializeAddress = alignUp(serializeBuffer.GetDeviceAddress());
+
+    command = device->CreateCommandBuffer();
+    for (uint32_t n = 0; n < count; ++n) {
+        VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{
+            VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR
+        };
+        copyInfo.src = handles[n];
+        copyInfo.dst.deviceAddress = serializeAddress + offsets[n];
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+        vkCmdCopyAccelerationStructureToMemoryKHR(command, &copyInfo);
+    }
+    vkEndCommandBuffer(command);
+    device->SubmitAndWait(command);
+    device->DestroyCommandBuffer(command);
+
+    auto mapped = static_cast<const uint8_t*>(device->Map(serializeBuffer)) + (serializeAddress - serializeBuffer.GetDeviceAddress());
+    for (uint32_t n = 0; n < count; ++n) {
+        m_cache->Store(m_requests[storeIndices[n]].cacheKey, mapped + offsets[n], size_t(serializedSizes[n]));
+    }
+    device->Unmap(serializeBuffer);
+    device->DestroyBuffer(serializeBuffer);
+}
+
+void AccelerationStructureBuilder::Compact(VkGraphicsDevice& device, VkQueryPool queryPool, const std::vector<size_t>& compactIndices)
+{
+    auto deviceVk = device->GetDevice();
+    std::vector<VkDeviceSize> compactedSizes(compactIndices.size());
+    vkGetQueryPoolResults(
+        deviceVk, queryPool, 0, uint32_t(compactIndices.size()),
+        sizeof(VkDeviceSize) * compactedSizes.size(), compactedSizes.data(), sizeof(VkDeviceSize),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    // 必要なサイズで作り直して, コンパクトモードでコピーする.
+    std::vector<decltype(AccelerationStructure::m_accelerationStructure)> oldStructures;
+    auto command = device->CreateCommandBuffer();
+    for (size_t i = 0; i < compactIndices.size(); ++i) {
+        auto& request = m_requests[compactIndices[i]];
+        auto& as = request.target->m_accelerationStructure;
+        oldStructures.push_back(as);
+
+        request.target->CreateStorage(device, request.buildGeometryInfo.type, compactedSizes[i]);
+
+        VkCopyAccelerationStructureInfoKHR copyInfo{
+            VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR
+        };
+        copyInfo.src = oldStructures.back().handle;
+        copyInfo.dst = as.handle;
+        copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+        vkCmdCopyAccelerationStructureKHR(command, &copyInfo);
+
+        CompactionResult result;
+        result.target = request.target;
+        result.originalSize = oldStructures.back().size;
+        result.compactedSize = as.size;
+        m_compactionResults.push_back(result);
+    }
+    VkMemoryBarrier barrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+    };
+    barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+    vkCmdPipelineBarrier(
+        command,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &barrier,
+        0, nullptr,
+        0, nullptr
+    );
+    vkEndCommandBuffer(command);
+    device->SubmitAndWait(command);
+    device->DestroyCommandBuffer(command);
+
+    // 元の AccelerationStructure は不要になったので破棄.
+    for (auto& old : oldStructures) {
+        vkDestroyAccelerationStructureKHR(deviceVk, old.handle, nullptr);
+        device->DestroyBuffer(old.bufferResource);
+    }
+
+    // コンパクションの結果を出力.
+    std::stringstream ss;
+    VkDeviceSize totalBefore = 0, totalAfter = 0;
+    for (const auto& result : m_compactionResults) {
+        ss << "BLAS compaction: " << result.originalSize << " -> " << result.compactedSize << " bytes" << std::endl;
+        totalBefore += result.originalSize;
+        totalAfter += result.compactedSize;
+    }
+    ss << "BLAS compaction total: " << totalBefore << " -> " << totalAfter << " bytes" << std::endl;
+    OutputDebugStringA(ss.str().c_str());
+}
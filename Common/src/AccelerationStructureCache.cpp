@@ -0,0 +1,129 @@
+﻿#include "AccelerationStructureCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+bool AccelerationStructureCache::Initialize(VkGraphicsDevice& device, const std::wstring& directory)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec) {
+        return false;
+    }
+    m_directory = directory;
+
+    // キャッシュの有効性の判定に使うデバイス情報.
+    VkPhysicalDeviceIDProperties idProps{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+    };
+    VkPhysicalDeviceProperties2 physDevProps2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2
+    };
+    physDevProps2.pNext = &idProps;
+    vkGetPhysicalDeviceProperties2(device->GetPhysicalDevice(), &physDevProps2);
+
+    memcpy(m_deviceUUID, idProps.deviceUUID, VK_UUID_SIZE);
+    m_vendorID = physDevProps2.properties.vendorID;
+    m_deviceID = physDevProps2.properties.deviceID;
+    m_driverVersion = physDevProps2.properties.driverVersion;
+    return true;
+}
+
+bool AccelerationStructureCache::Load(VkGraphicsDevice& device, uint64_t key, std::vector<uint8_t>& data, VkDeviceSize& deserializedSize)
+{
+    if (!IsEnabled()) {
+        return false;
+    }
+    auto filePath = GetFilePath(key);
+    std::ifstream infile(filePath, std::ifstream::binary);
+    if (!infile) {
+        m_missCount++;
+        return false;
+    }
+
+    FileHeader header{};
+    infile.read(reinterpret_cast<char*>(&header), sizeof(header));
+    bool isValid = infile.good();
+    isValid = isValid && header.magic == FileMagic && header.version == FileVersion;
+    isValid = isValid && header.key == key;
+    isValid = isValid && memcmp(header.deviceUUID, m_deviceUUID, VK_UUID_SIZE) == 0;
+    isValid = isValid && header.vendorID == m_vendorID && header.deviceID == m_deviceID;
+    isValid = isValid && header.driverVersion == m_driverVersion;
+
+    // シリアライズデータ先頭のヘッダ: driverUUID, compatibilityUUID, serializedSize, deserializedSize.
+    const size_t blobHeaderSize = VK_UUID_SIZE * 2 + sizeof(uint64_t) * 2;
+    isValid = isValid && header.dataSize >= blobHeaderSize;
+    if (isValid) {
+        data.resize(size_t(header.dataSize));
+        infile.read(reinterpret_cast<char*>(data.data()), data.size());
+        isValid = infile.good();
+    }
+    infile.close();
+
+    if (isValid) {
+        // ドライバ側でも互換性を確認する.
+        VkAccelerationStructureVersionInfoKHR versionInfo{
+            VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR
+        };
+        versionInfo.pVersionData = data.data();
+        VkAccelerationStructureCompatibilityKHR compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+        vkGetDeviceAccelerationStructureCompatibilityKHR(device->GetDevice(), &versionInfo, &compatibility);
+        isValid = compatibility == VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR;
+    }
+    if (!isValid) {
+        // 古いキャッシュは削除して作り直す.
+        std::error_code ec;
+        std::filesystem::remove(filePath, ec);
+        data.clear();
+        m_missCount++;
+        return false;
+    }
+
+    memcpy(&deserializedSize, data.data() + VK_UUID_SIZE * 2 + sizeof(uint64_t), sizeof(uint64_t));
+    m_hitCount++;
+    return true;
+}
+
+bool AccelerationStructureCache::Store(uint64_t key, const void* data, size_t size)
+{
+    if (!IsEnabled()) {
+        return false;
+    }
+    FileHeader header{};
+    header.magic = FileMagic;
+    header.version = FileVersion;
+    header.key = key;
+    memcpy(header.deviceUUID, m_deviceUUID, VK_UUID_SIZE);
+    header.vendorID = m_vendorID;
+    header.deviceID = m_deviceID;
+    header.driverVersion = m_driverVersion;
+    header.dataSize = size;
+
+    // 書き込み途中のファイルが読まれないよう, 一時ファイルに書いてから置き換える.
+    auto filePath = GetFilePath(key);
+    auto tempPath = filePath;
+    tempPath += L".tmp";
+    {
+        std::ofstream outfile(tempPath, std::ofstream::binary);
+        if (!outfile) {
+            return false;
+        }
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outfile.write(static_cast<const char*>(data), size);
+        if (!outfile.good()) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, filePath, ec);
+    return !ec;
+}
+
+std::filesystem::path AccelerationStructureCache::GetFilePath(uint64_t key) const
+{
+    std::wstringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill(L'0') << key << L".bin";
+    return m_directory / ss.str();
+}
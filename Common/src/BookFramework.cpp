@@ -1,13 +1,60 @@
 #include "BookFramework.h"
+#include "CpuProfiler.h"
 #include "extensions_vk.hpp"
 
 #include <GLFW/glfw3.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <cwctype>
+
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 720
 
+namespace {
+    // o͐̃p^[Ƀt[ԍ𖄂ߍ.
+    //  ƂĂ͓n, %d, %Nd, %0Nd (1 ܂)  %% u. ȊO܂ޏꍇ false.
+    bool FormatFrameFileName(const std::wstring& pattern, uint64_t frameNumber, std::wstring& fileName)
+    {
+        fileName.clear();
+        bool numbered = false;
+        for (size_t i = 0; i < pattern.size(); ++i) {
+            if (pattern[i] != L'%') {
+                fileName += pattern[i];
+                continue;
+            }
+            if (++i < pattern.size() && pattern[i] == L'%') {
+                fileName += L'%';
+                continue;
+            }
+            const bool zeroPad = i < pattern.size() && pattern[i] == L'0';
+            size_t width = 0;
+            for (; i < pattern.size() && iswdigit(pattern[i]); ++i) {
+                width = width * 10 + (pattern[i] - L'0');
+                if (width > 32) {
+                    return false;
+                }
+            }
+            if (i >= pattern.size() || pattern[i] != L'd' || numbered) {
+                return false;
+            }
+            auto number = std::to_wstring(frameNumber);
+            if (number.size() < width) {
+                number.insert(0, width - number.size(), zeroPad ? L'0' : L' ');
+            }
+            fileName += number;
+            numbered = true;
+        }
+        return true;
+    }
+}
+
 BookFramework::BookFramework(const char* title) : m_title(title)
 {
 
@@ -15,8 +62,10 @@ BookFramework::BookFramework(const char* title) : m_title(title)
 
 float BookFramework::GetAspect() const
 {
-    int width = 0, height = 0;
-    glfwGetWindowSize(m_window, &width, &height);
+    int width = m_width, height = m_height;
+    if (m_window) {
+        glfwGetWindowSize(m_window, &width, &height);
+    }
     width = (std::max)(1, width);
     height = (std::max)(1, height);
 
@@ -25,8 +74,10 @@ float BookFramework::GetAspect() const
 
 int BookFramework::GetWidth() const
 {
-    int width = 0, height = 0;
-    glfwGetWindowSize(m_window, &width, &height);
+    int width = m_width, height = m_height;
+    if (m_window) {
+        glfwGetWindowSize(m_window, &width, &height);
+    }
     width = (std::max)(1, width);
     height = (std::max)(1, height);
     return width;
@@ -34,22 +85,99 @@ int BookFramework::GetWidth() const
 
 int BookFramework::GetHeight() const
 {
-    int width = 0, height = 0;
-    glfwGetWindowSize(m_window, &width, &height);
+    int width = m_width, height = m_height;
+    if (m_window) {
+        glfwGetWindowSize(m_window, &width, &height);
+    }
     return height;
 }
 
-void BookFramework::Initialize()
+void BookFramework::SetHeadless(const HeadlessOptions& options)
+{
+    m_headless = true;
+    m_headlessOptions = options;
+}
+
+bool BookFramework::ParseHeadlessOptions(const std::wstring& commandLine, HeadlessOptions& options)
 {
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    std::wistringstream ss(commandLine);
+    std::wstring arg;
+    bool headless = false;
+    while (ss >> arg) {
+        if (arg == L"--headless") {
+            headless = true;
+        } else if (arg == L"--frames") {
+            ss >> options.frameCount;
+        } else if (arg == L"--output") {
+            ss >> options.outputPath;
+            std::wstring fileName;
+            if (!FormatFrameFileName(options.outputPath, 0, fileName)) {
+                OutputDebugStringW((L"Invalid output path: " + options.outputPath + L"\n").c_str());
+                options.outputPath.clear();
+            }
+        }
+    }
+    return headless;
+}
+
+void BookFramework::WriteFrameImage(const vk::GraphicsDevice::FrameImage& image)
+{
+    if (m_headlessOptions.sink) {
+        m_headlessOptions.sink(image);
+    }
+    if (m_headlessOptions.outputPath.empty()) {
+        return;
+    }
 
+    // PNG  RGBA ̏ŏô, BGRA ̃obNobt@͓ւ.
+    const auto pixelCount = size_t(image.width) * image.height;
+    std::vector<uint8_t> rgba(pixelCount * 4);
+    memcpy(rgba.data(), image.pixels, rgba.size());
+    if (image.format == VK_FORMAT_B8G8R8A8_UNORM || image.format == VK_FORMAT_B8G8R8A8_SRGB) {
+        for (size_t i = 0; i < pixelCount; ++i) {
+            std::swap(rgba[i * 4 + 0], rgba[i * 4 + 2]);
+        }
+    }
+
+    std::wstring fileName;
+    if (!FormatFrameFileName(m_headlessOptions.outputPath, image.frameNumber, fileName)) {
+        OutputDebugStringW((L"Invalid output path: " + m_headlessOptions.outputPath + L"\n").c_str());
+        return;
+    }
+    std::filesystem::path path(fileName);
+    if (path.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (ec) {
+            OutputDebugStringW((L"Failed to create " + path.parent_path().wstring() + L"\n").c_str());
+            return;
+        }
+    }
+    std::ofstream outfile(path, std::ios::binary);
+    if (!outfile) {
+        OutputDebugStringW((L"Failed to write " + path.wstring() + L"\n").c_str());
+        return;
+    }
+    auto writeFunc = [](void* context, void* data, int size) {
+        static_cast<std::ofstream*>(context)->write(static_cast<const char*>(data), size);
+    };
+    stbi_write_png_to_func(writeFunc, &outfile, int(image.width), int(image.height), 4, rgba.data(), int(image.width * 4));
+}
+
+void BookFramework::Initialize()
+{
     int width = WINDOW_WIDTH, height = WINDOW_HEIGHT;
+    m_width = width;
+    m_height = height;
+
+    if (!m_headless) {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    }
 
     m_device = std::make_unique<vk::GraphicsDevice>();
     std::vector<const char*> requiredExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_MAINTENANCE3_EXTENSION_NAME,
         VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
         //VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,    // Vulkan1.2 g킸 vkGetBufferDeviceAddressKHR gꍇɂ͕Kv.
@@ -62,13 +190,34 @@ void BookFramework::Initialize()
         // descriptor indexing ɕKv.
         VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
     };
+    if (!m_headless) {
+        // \sƂ̂ݕKv.
+        requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
     bool useValidationLayer = false;
 #if _DEBUG
     useValidationLayer = true;
 #endif
+    m_device->SetHeadless(m_headless);
+    m_device->SetDedicatedQueueUsage(m_useAsyncCompute, m_useTransferQueue);
+    m_device->SetDescriptorBufferUsage(m_useDescriptorBuffer);
     if (!m_device->OnInit(requiredExtensions, useValidationLayer)) {
         throw std::runtime_error("GraphicsDevice OnInit() failed.");
     }
+    m_device->SetFramesInFlight(m_framesInFlight);
+    m_device->SetCommandRecordingThreadCount(m_commandRecordingThreads);
+
+    if (m_headless) {
+        // EBhȆɃItXN[̃obNobt@.
+        if (!m_device->CreateOffscreenTargets(width, height)) {
+            throw std::runtime_error("CreateOffscreenTargets failed.");
+        }
+        m_device->SetFrameSink([this](const vk::GraphicsDevice::FrameImage& image) { WriteFrameImage(image); });
+
+        // eAvP[VŗL̏.
+        OnInit();
+        return;
+    }
 
     // EBhE̐ƃXbv`FC̏.
     m_window = glfwCreateWindow(width, height, m_title.c_str(), nullptr, nullptr);
@@ -115,14 +264,38 @@ void BookFramework::Destroy()
     m_device.reset();
 }
 
-int BookFramework::Run()
+void BookFramework::RunFrame()
 {
-    Initialize();
-    while (glfwWindowShouldClose(m_window) == GLFW_FALSE) {
-        glfwPollEvents();
+    {
+        CPU_PROFILE_SCOPE("OnUpdate");
         OnUpdate();
+    }
+    {
+        CPU_PROFILE_SCOPE("OnRender");
         OnRender();
     }
+}
+
+int BookFramework::Run()
+{
+    Initialize();
+    if (m_headless) {
+        // wt[`悵, ǂݖ߂̉摜ׂĎ󂯎ĂI.
+        for (uint32_t i = 0; i < m_headlessOptions.frameCount; ++i) {
+            CPU_PROFILE_FRAME();
+            RunFrame();
+        }
+        m_device->FlushFrameReadbacks();
+    } else {
+        while (glfwWindowShouldClose(m_window) == GLFW_FALSE) {
+            CPU_PROFILE_FRAME();
+            {
+                CPU_PROFILE_SCOPE("PollEvents");
+                glfwPollEvents();
+            }
+            RunFrame();
+        }
+    }
     Destroy();
     return 0;
 }
@@ -0,0 +1,184 @@
+﻿#include "CpuProfiler.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+thread_local CpuProfiler::ThreadBuffer* CpuProfiler::t_buffer = nullptr;
+
+CpuProfiler& CpuProfiler::Get()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+CpuProfiler::CpuProfiler()
+{
+    m_calibrationTicks = Now();
+    m_calibrationClock = ClockNow();
+}
+
+void CpuProfiler::Calibrate()
+{
+#if defined(CPU_PROFILER_USE_RDTSC)
+    // 経過時間が長いほど誤差が小さくなるので, フレームごとに求め直す.
+    auto elapsedClock = ClockNow() - m_calibrationClock;
+    auto elapsedTicks = Now() - m_calibrationTicks;
+    if (elapsedClock > 1000000 && elapsedTicks > 0) {
+        m_ticksToMilliseconds = double(elapsedClock) / double(elapsedTicks) * 1e-6;
+    }
+#endif
+}
+
+CpuProfiler::ThreadBuffer* CpuProfiler::RegisterThread()
+{
+    // スレッドが終了してもバッファは残す(回収中に解放されないように).
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->threadId = uint32_t(m_buffers.size());
+    t_buffer = buffer.get();
+    m_buffers.push_back(std::move(buffer));
+    return t_buffer;
+}
+
+void CpuProfiler::BeginFrame()
+{
+    Calibrate();
+    auto now = Now();
+    if (m_frameBegin != 0) {
+        m_frameTime = double(now - m_frameBegin) * m_ticksToMilliseconds;
+    }
+    m_frameBegin = now;
+
+    // 各スレッドのバッファから記録済みの区間を回収する.
+    m_events.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& buffer : m_buffers) {
+            auto readIndex = buffer->readIndex.load(std::memory_order_relaxed);
+            auto writeIndex = buffer->writeIndex.load(std::memory_order_acquire);
+            for (auto i = readIndex; i != writeIndex && !buffer->discard; ++i) {
+                const auto& e = buffer->events[i % BufferCapacity];
+                m_events.push_back(e);
+                if (m_traceFramesLeft > 0) {
+                    m_traceEvents.push_back(TraceEvent{ e, buffer->threadId });
+                }
+            }
+            buffer->readIndex.store(writeIndex, std::memory_order_release);
+        }
+    }
+
+    // 名前ごとに集計する.
+    m_summary.clear();
+    for (const auto& e : m_events) {
+        auto itr = std::find_if(m_summary.begin(), m_summary.end(),
+            [&](const ScopeSummary& s) { return strcmp(s.name, e.name) == 0; });
+        if (itr == m_summary.end()) {
+            m_summary.push_back(ScopeSummary{ e.name, 0, 0.0, 0.0 });
+            itr = m_summary.end() - 1;
+        }
+        itr->count++;
+        itr->totalTime += double(e.end - e.begin) * m_ticksToMilliseconds;
+    }
+    for (auto& summary : m_summary) {
+        auto& history = m_histories[summary.name];
+        history.sum += summary.totalTime - history.samples[history.next];
+        history.samples[history.next] = summary.totalTime;
+        history.next = (history.next + 1) % AverageFrameCount;
+        history.count = (std::min)(history.count + 1, AverageFrameCount);
+        summary.averageTime = history.sum / history.count;
+    }
+
+    if (m_traceFramesLeft > 0 && --m_traceFramesLeft == 0) {
+        if (!WriteTrace()) {
+            OutputDebugStringA("CpuProfiler: failed to write the trace file.\n");
+        }
+        m_traceEvents.clear();
+    }
+}
+
+void CpuProfiler::CaptureTrace(uint32_t frameCount, const std::wstring& fileName)
+{
+    m_traceEvents.clear();
+    m_traceFileName = fileName;
+    m_traceFramesLeft = frameCount;
+}
+
+double CpuProfiler::MeasureScopeOverhead(uint32_t iterations)
+{
+    // バッファに収まる回数に制限し, 書き込みが捨てられない状態で測る.
+    iterations = (std::max)(1u, (std::min)(iterations, BufferCapacity));
+    double overhead = 0.0;
+    std::thread worker([&]() {
+        auto buffer = GetThreadBuffer();
+        auto& profiler = Get();
+        {
+            std::lock_guard<std::mutex> lock(profiler.m_mutex);
+            buffer->discard = true;
+        }
+        // 初回はバッファのページを確保する分が乗るので, 何度か測って最小値を採る.
+        for (uint32_t round = 0; round < MeasureRoundCount; ++round) {
+            {
+                std::lock_guard<std::mutex> lock(profiler.m_mutex);
+                buffer->readIndex.store(buffer->writeIndex.load(std::memory_order_relaxed), std::memory_order_release);
+            }
+            auto begin = ClockNow();
+            for (uint32_t i = 0; i < iterations; ++i) {
+                CpuProfileScope scope("MeasureScopeOverhead");
+            }
+            auto time = double(ClockNow() - begin) / iterations;
+            overhead = round == 0 ? time : (std::min)(overhead, time);
+        }
+    });
+    worker.join();
+    return overhead;
+}
+
+double CpuProfiler::MeasureTimestampCost(uint32_t iterations)
+{
+    iterations = (std::max)(1u, iterations);
+    double cost = 0.0;
+    for (uint32_t round = 0; round < MeasureRoundCount; ++round) {
+        volatile int64_t sink = 0;
+        auto begin = ClockNow();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            sink = Now();
+        }
+        auto time = double(ClockNow() - begin) / iterations;
+        cost = round == 0 ? time : (std::min)(cost, time);
+    }
+    return cost;
+}
+
+bool CpuProfiler::WriteTrace() const
+{
+    std::filesystem::path path(m_traceFileName);
+    if (path.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    std::ofstream outfile(path);
+    if (!outfile) {
+        return false;
+    }
+    int64_t traceBegin = INT64_MAX;
+    for (const auto& e : m_traceEvents) {
+        traceBegin = (std::min)(traceBegin, e.event.begin);
+    }
+
+    // 時間の単位はマイクロ秒. 区間は完了イベント("X")として出力する.
+    const double toMicroseconds = m_ticksToMilliseconds * 1e3;
+    outfile << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < m_traceEvents.size(); ++i) {
+        const auto& e = m_traceEvents[i];
+        outfile << "{\"name\":\"" << e.event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.threadId
+            << ",\"ts\":" << double(e.event.begin - traceBegin) * toMicroseconds
+            << ",\"dur\":" << double(e.event.end - e.event.begin) * toMicroseconds << "}"
+            << (i + 1 < m_traceEvents.size() ? ",\n" : "\n");
+    }
+    outfile << "],\"displayTimeUnit\":\"ms\"}\n";
+    return outfile.good();
+}
@@ -0,0 +1,120 @@
+﻿#include "DescriptorAllocator.h"
+
+#include <Windows.h>
+#include <algorithm>
+
+bool vk::DescriptorAllocator::Initialize(VkDevice device, const std::vector<PoolSizeRatio>& ratios, uint32_t initialSetCount, VkDescriptorPoolCreateFlags flags)
+{
+    m_device = device;
+    m_ratios = ratios;
+    m_flags = flags;
+    m_nextSetCount = (std::max)(initialSetCount, 1u);
+    return CreatePool();
+}
+
+void vk::DescriptorAllocator::Destroy()
+{
+    for (auto& pool : m_pools) {
+        vkDestroyDescriptorPool(m_device, pool.pool, nullptr);
+    }
+    m_pools.clear();
+    m_setOwners.clear();
+    m_currentPool = 0;
+    m_allocatedSetCount = 0;
+}
+
+VkDescriptorSet vk::DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, const void* pNext)
+{
+    VkDescriptorSetAllocateInfo dsAI{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, pNext
+    };
+    dsAI.pSetLayouts = &layout;
+    dsAI.descriptorSetCount = 1;
+
+    // 現在のプールから順に試し, 足りなければ次のプールへ進む(無ければ作成する).
+    for (;;) {
+        if (m_currentPool == m_pools.size() && !CreatePool()) {
+            return VK_NULL_HANDLE;
+        }
+        auto& pool = m_pools[m_currentPool];
+        dsAI.descriptorPool = pool.pool;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        auto result = vkAllocateDescriptorSets(m_device, &dsAI, &descriptorSet);
+        if (result == VK_SUCCESS) {
+            pool.setCount++;
+            m_allocatedSetCount++;
+            if (m_flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) {
+                m_setOwners[descriptorSet] = m_currentPool;
+            }
+            return descriptorSet;
+        }
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+            OutputDebugStringA("DescriptorAllocator: vkAllocateDescriptorSets failed.\n");
+            return VK_NULL_HANDLE;
+        }
+        if (pool.setCount == 0) {
+            // 空のプールにも収まらない(1 セットのディスクリプタ数が見込みを超えている).
+            OutputDebugStringA("DescriptorAllocator: the descriptor set does not fit in an empty pool.\n");
+            return VK_NULL_HANDLE;
+        }
+        m_currentPool++;
+    }
+}
+
+void vk::DescriptorAllocator::Free(VkDescriptorSet descriptorSet)
+{
+    auto itr = m_setOwners.find(descriptorSet);
+    if (itr == m_setOwners.end()) {
+        OutputDebugStringA("DescriptorAllocator: Free called for an unknown descriptor set.\n");
+        return;
+    }
+    auto poolIndex = itr->second;
+    m_setOwners.erase(itr);
+
+    auto& pool = m_pools[poolIndex];
+    vkFreeDescriptorSets(m_device, pool.pool, 1, &descriptorSet);
+    pool.setCount--;
+    m_allocatedSetCount--;
+
+    // 空きができたプールから再び試す.
+    m_currentPool = (std::min)(m_currentPool, poolIndex);
+}
+
+void vk::DescriptorAllocator::Reset()
+{
+    for (auto& pool : m_pools) {
+        if (pool.setCount > 0) {
+            vkResetDescriptorPool(m_device, pool.pool, 0);
+            pool.setCount = 0;
+        }
+    }
+    m_setOwners.clear();
+    m_currentPool = 0;
+    m_allocatedSetCount = 0;
+}
+
+bool vk::DescriptorAllocator::CreatePool()
+{
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& ratio : m_ratios) {
+        auto count = uint32_t(ratio.countPerSet * m_nextSetCount);
+        poolSizes.push_back({ ratio.type, (std::max)(count, 1u) });
+    }
+    VkDescriptorPoolCreateInfo descPoolCI{
+      VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      nullptr, m_flags,
+      m_nextSetCount,
+      uint32_t(poolSizes.size()), poolSizes.data(),
+    };
+    Pool pool;
+    if (vkCreateDescriptorPool(m_device, &descPoolCI, nullptr, &pool.pool) != VK_SUCCESS) {
+        OutputDebugStringA("DescriptorAllocator: failed to create a descriptor pool.\n");
+        return false;
+    }
+    m_pools.push_back(pool);
+    m_currentPool = m_pools.size() - 1;
+
+    // 次に作るプールは倍の大きさにする.
+    m_nextSetCount = (std::min)(m_nextSetCount * 2, MaxSetsPerPool);
+    return true;
+}
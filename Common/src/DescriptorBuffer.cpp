@@ -0,0 +1,202 @@
+﻿#include "DescriptorBuffer.h"
+
+#include <Windows.h>
+#include <algorithm>
+
+// VK_EXT_descriptor_buffer に対応していない Vulkan ヘッダでは常に初期化に失敗し, 呼び出し側はディスクリプタセットを使う.
+#ifdef VK_EXT_descriptor_buffer
+
+VkDescriptorSetLayoutCreateFlags vk::DescriptorBuffer::GetSetLayoutCreateFlags()
+{
+    return VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+}
+
+VkPipelineCreateFlags vk::DescriptorBuffer::GetPipelineCreateFlags()
+{
+    return VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+}
+
+bool vk::DescriptorBuffer::Initialize(GraphicsDevice& device, VkDeviceSize requestSize)
+{
+    VkPhysicalDeviceDescriptorBufferPropertiesEXT descriptorBufferProps{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT
+    };
+    VkPhysicalDeviceProperties2 physDevProps2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2
+    };
+    physDevProps2.pNext = &descriptorBufferProps;
+    vkGetPhysicalDeviceProperties2(device.GetPhysicalDevice(), &physDevProps2);
+
+    // 結合イメージサンプラーの配列をイメージとサンプラーに分けて並べる必要がある実装には対応しない.
+    if (!descriptorBufferProps.combinedImageSamplerDescriptorSingleArray) {
+        OutputDebugStringA("DescriptorBuffer: combinedImageSamplerDescriptorSingleArray is not supported.\n");
+        return false;
+    }
+
+    m_device = device.GetDevice();
+    m_offsetAlignment = descriptorBufferProps.descriptorBufferOffsetAlignment;
+    m_combinedImageSamplerSize = descriptorBufferProps.combinedImageSamplerDescriptorSize;
+    m_storageImageSize = descriptorBufferProps.storageImageDescriptorSize;
+    m_uniformBufferSize = descriptorBufferProps.uniformBufferDescriptorSize;
+    m_storageBufferSize = descriptorBufferProps.storageBufferDescriptorSize;
+    m_accelerationStructureSize = descriptorBufferProps.accelerationStructureDescriptorSize;
+
+    // サンプラーとリソースのディスクリプタを 1 つのバッファに置くため, 両方の上限に収める.
+    //  (同時にバインドできるバッファの数は最小 1 のため, バッファは 1 つで済ませる.)
+    m_size = (std::min)({ requestSize,
+        descriptorBufferProps.maxSamplerDescriptorBufferRange,
+        descriptorBufferProps.maxResourceDescriptorBufferRange });
+    m_usedSize = 0;
+
+    m_usage = VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT | VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT;
+    m_buffer = device.CreateBuffer(size_t(m_size),
+        m_usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_mapped = static_cast<uint8_t*>(device.Map(m_buffer));
+    if (m_mapped == nullptr) {
+        OutputDebugStringA("DescriptorBuffer: failed to map the descriptor buffer.\n");
+        device.DestroyBuffer(m_buffer);
+        return false;
+    }
+    return true;
+}
+
+void vk::DescriptorBuffer::Destroy(GraphicsDevice& device)
+{
+    if (m_buffer.GetBuffer() != VK_NULL_HANDLE) {
+        device.DestroyBuffer(m_buffer);
+    }
+    m_mapped = nullptr;
+    m_size = 0;
+    m_usedSize = 0;
+}
+
+VkDeviceSize vk::DescriptorBuffer::AllocateSet(VkDescriptorSetLayout layout)
+{
+    VkDeviceSize layoutSize = 0;
+    vkGetDescriptorSetLayoutSizeEXT(m_device, layout, &layoutSize);
+
+    auto offset = (m_usedSize + m_offsetAlignment - 1) / m_offsetAlignment * m_offsetAlignment;
+    if (offset + layoutSize > m_size) {
+        OutputDebugStringA("DescriptorBuffer: out of descriptor buffer memory.\n");
+        return InvalidOffset;
+    }
+    m_usedSize = offset + layoutSize;
+    return offset;
+}
+
+void vk::DescriptorBuffer::WriteImage(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding, uint32_t arrayElement,
+    VkDescriptorType type, const VkDescriptorImageInfo& imageInfo)
+{
+    VkDescriptorGetInfoEXT getInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT
+    };
+    getInfo.type = type;
+    if (type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) {
+        getInfo.data.pStorageImage = &imageInfo;
+    } else {
+        getInfo.data.pCombinedImageSampler = &imageInfo;
+    }
+    auto dst = GetDescriptorPointer(layout, setOffset, binding, arrayElement, type);
+    vkGetDescriptorEXT(m_device, &getInfo, GetDescriptorSize(type), dst);
+}
+
+void vk::DescriptorBuffer::WriteBuffer(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+    VkDescriptorType type, VkDeviceAddress address, VkDeviceSize range)
+{
+    VkDescriptorAddressInfoEXT addressInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT
+    };
+    addressInfo.address = address;
+    addressInfo.range = range;
+
+    VkDescriptorGetInfoEXT getInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT
+    };
+    getInfo.type = type;
+    if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+        getInfo.data.pUniformBuffer = &addressInfo;
+    } else {
+        getInfo.data.pStorageBuffer = &addressInfo;
+    }
+    auto dst = GetDescriptorPointer(layout, setOffset, binding, 0, type);
+    vkGetDescriptorEXT(m_device, &getInfo, GetDescriptorSize(type), dst);
+}
+
+void vk::DescriptorBuffer::WriteAccelerationStructure(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+    VkDeviceAddress address)
+{
+    const auto type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+    VkDescriptorGetInfoEXT getInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT
+    };
+    getInfo.type = type;
+    getInfo.data.accelerationStructure = address;
+    auto dst = GetDescriptorPointer(layout, setOffset, binding, 0, type);
+    vkGetDescriptorEXT(m_device, &getInfo, GetDescriptorSize(type), dst);
+}
+
+void vk::DescriptorBuffer::Bind(VkCommandBuffer command, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout,
+    uint32_t firstSet, const std::vector<VkDeviceSize>& setOffsets) const
+{
+    VkDescriptorBufferBindingInfoEXT bindingInfo{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT
+    };
+    bindingInfo.address = m_buffer.GetDeviceAddress();
+    bindingInfo.usage = m_usage;
+    vkCmdBindDescriptorBuffersEXT(command, 1, &bindingInfo);
+
+    // 全てのセットが同じ(0 番の)バッファを参照する.
+    std::vector<uint32_t> bufferIndices(setOffsets.size(), 0);
+    vkCmdSetDescriptorBufferOffsetsEXT(command, bindPoint, pipelineLayout,
+        firstSet, uint32_t(setOffsets.size()), bufferIndices.data(), setOffsets.data());
+}
+
+size_t vk::DescriptorBuffer::GetDescriptorSize(VkDescriptorType type) const
+{
+    switch (type) {
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        return m_combinedImageSamplerSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        return m_storageImageSize;
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        return m_uniformBufferSize;
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        return m_storageBufferSize;
+    case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+        return m_accelerationStructureSize;
+    default:
+        // 動的なバッファなどはディスクリプタバッファでは使えない.
+        OutputDebugStringA("DescriptorBuffer: unsupported descriptor type.\n");
+        return 0;
+    }
+}
+
+uint8_t* vk::DescriptorBuffer::GetDescriptorPointer(VkDescriptorSetLayout layout, VkDeviceSize setOffset, uint32_t binding,
+    uint32_t arrayElement, VkDescriptorType type) const
+{
+    VkDeviceSize bindingOffset = 0;
+    vkGetDescriptorSetLayoutBindingOffsetEXT(m_device, layout, binding, &bindingOffset);
+    return m_mapped + setOffset + bindingOffset + arrayElement * GetDescriptorSize(type);
+}
+
+#else
+
+VkDescriptorSetLayoutCreateFlags vk::DescriptorBuffer::GetSetLayoutCreateFlags() { return 0; }
+VkPipelineCreateFlags vk::DescriptorBuffer::GetPipelineCreateFlags() { return 0; }
+
+bool vk::DescriptorBuffer::Initialize(GraphicsDevice&, VkDeviceSize)
+{
+    OutputDebugStringA("DescriptorBuffer: VK_EXT_descriptor_buffer is not available in this Vulkan SDK.\n");
+    return false;
+}
+void vk::DescriptorBuffer::Destroy(GraphicsDevice&) {}
+VkDeviceSize vk::DescriptorBuffer::AllocateSet(VkDescriptorSetLayout) { return InvalidOffset; }
+void vk::DescriptorBuffer::WriteImage(VkDescriptorSetLayout, VkDeviceSize, uint32_t, uint32_t, VkDescriptorType, const VkDescriptorImageInfo&) {}
+void vk::DescriptorBuffer::WriteBuffer(VkDescriptorSetLayout, VkDeviceSize, uint32_t, VkDescriptorType, VkDeviceAddress, VkDeviceSize) {}
+void vk::DescriptorBuffer::WriteAccelerationStructure(VkDescriptorSetLayout, VkDeviceSize, uint32_t, VkDeviceAddress) {}
+void vk::DescriptorBuffer::Bind(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, const std::vector<VkDeviceSize>&) const {}
+size_t vk::DescriptorBuffer::GetDescriptorSize(VkDescriptorType) const { return 0; }
+uint8_t* vk::DescriptorBuffer::GetDescriptorPointer(VkDescriptorSetLayout, VkDeviceSize, uint32_t, uint32_t, VkDescriptorType) const { return nullptr; }
+
+#endif
@@ -0,0 +1,188 @@
+﻿#include "GpuProfiler.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+bool vk::GpuProfiler::Initialize(VkDevice device, uint32_t framesInFlight, float timestampPeriod, uint32_t timestampValidBits)
+{
+    m_device = device;
+    m_timestampPeriod = timestampPeriod;
+    m_timestampMask = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+    if (timestampValidBits == 0) {
+        // タイムスタンプに対応していないキューがあるので計測しない.
+        return true;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCI{
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO
+    };
+    queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCI.queryCount = MaxQueriesPerFrame;
+
+    m_frames.resize(framesInFlight);
+    for (auto& frame : m_frames) {
+        if (vkCreateQueryPool(m_device, &queryPoolCI, nullptr, &frame.queryPool) != VK_SUCCESS) {
+            Destroy();
+            return false;
+        }
+        // 作成直後のクエリは未定義の状態なのでリセットしておく.
+        vkResetQueryPool(m_device, frame.queryPool, 0, MaxQueriesPerFrame);
+        frame.scopes.reserve(MaxQueriesPerFrame / 2);
+    }
+    m_timestamps.resize(MaxQueriesPerFrame);
+    m_current = &m_frames[0];
+    return true;
+}
+
+void vk::GpuProfiler::Destroy()
+{
+    for (auto& frame : m_frames) {
+        if (frame.queryPool) {
+            vkDestroyQueryPool(m_device, frame.queryPool, nullptr);
+        }
+    }
+    m_frames.clear();
+    m_current = nullptr;
+    m_results.clear();
+    m_histories.clear();
+    m_traceEvents.clear();
+    m_traceFramesLeft = 0;
+}
+
+void vk::GpuProfiler::BeginFrame(uint32_t frameIndex)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    ResolveFrame(frameIndex);
+
+    auto& frame = m_frames[frameIndex];
+    if (frame.queryCount > 0) {
+        vkResetQueryPool(m_device, frame.queryPool, 0, frame.queryCount);
+    }
+    frame.scopes.clear();
+    frame.queryCount = 0;
+    m_current = &frame;
+    m_depth = 0;
+}
+
+uint32_t vk::GpuProfiler::BeginScope(VkCommandBuffer command, const char* name, uint32_t track)
+{
+    if (m_current == nullptr || m_current->queryCount + 2 > MaxQueriesPerFrame) {
+        return InvalidScope;
+    }
+    auto& frame = *m_current;
+    uint32_t scope = uint32_t(frame.scopes.size());
+    frame.scopes.push_back(ScopeRecord{ name, m_depth, track, frame.queryCount });
+    frame.queryCount += 2;
+    m_depth++;
+
+    vkCmdWriteTimestamp(command, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, frame.scopes[scope].query);
+    return scope;
+}
+
+void vk::GpuProfiler::EndScope(VkCommandBuffer command, uint32_t scope)
+{
+    if (scope == InvalidScope) {
+        return;
+    }
+    auto& frame = *m_current;
+    m_depth--;
+    vkCmdWriteTimestamp(command, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, frame.scopes[scope].query + 1);
+}
+
+void vk::GpuProfiler::CaptureTrace(uint32_t frameCount, const std::wstring& fileName)
+{
+    m_traceEvents.clear();
+    m_traceFileName = fileName;
+    m_traceFramesLeft = frameCount;
+}
+
+void vk::GpuProfiler::ResolveFrame(uint32_t frameIndex)
+{
+    auto& frame = m_frames[frameIndex];
+    if (frame.queryCount == 0) {
+        return;
+    }
+    // GPU の処理は完了しているので待機はしない.
+    //  終了していない区間があるなど, 取得できなかったフレームは捨てる.
+    auto result = vkGetQueryPoolResults(
+        m_device, frame.queryPool, 0, frame.queryCount,
+        sizeof(uint64_t) * frame.queryCount, m_timestamps.data(), sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    uint64_t frameBegin = ~0ull;
+    for (const auto& scope : frame.scopes) {
+        frameBegin = (std::min)(frameBegin, m_timestamps[scope.query] & m_timestampMask);
+    }
+    const double toMilliseconds = m_timestampPeriod * 1e-6;
+
+    m_results.clear();
+    for (const auto& scope : frame.scopes) {
+        auto begin = m_timestamps[scope.query] & m_timestampMask;
+        auto end = m_timestamps[scope.query + 1] & m_timestampMask;
+        end = (std::max)(begin, end);
+
+        ScopeResult scopeResult{};
+        scopeResult.name = scope.name;
+        scopeResult.depth = scope.depth;
+        scopeResult.track = scope.track;
+        scopeResult.beginTime = double(begin - frameBegin) * toMilliseconds;
+        scopeResult.duration = double(end - begin) * toMilliseconds;
+
+        // 直近の値で平均を求める.
+        auto& history = m_histories[scope.name];
+        history.sum += scopeResult.duration - history.samples[history.next];
+        history.samples[history.next] = scopeResult.duration;
+        history.next = (history.next + 1) % AverageFrameCount;
+        history.count = (std::min)(history.count + 1, AverageFrameCount);
+        scopeResult.averageDuration = history.sum / history.count;
+        m_results.push_back(scopeResult);
+
+        if (m_traceFramesLeft > 0) {
+            m_traceEvents.push_back(TraceEvent{ scope.name, scope.track, begin, end });
+        }
+    }
+
+    if (m_traceFramesLeft > 0 && --m_traceFramesLeft == 0) {
+        if (!WriteTrace()) {
+            OutputDebugStringA("GpuProfiler: failed to write the trace file.\n");
+        }
+        m_traceEvents.clear();
+    }
+}
+
+bool vk::GpuProfiler::WriteTrace() const
+{
+    std::filesystem::path path(m_traceFileName);
+    if (path.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    std::ofstream outfile(path);
+    if (!outfile) {
+        return false;
+    }
+    uint64_t traceBegin = ~0ull;
+    for (const auto& e : m_traceEvents) {
+        traceBegin = (std::min)(traceBegin, e.begin);
+    }
+
+    // 時間の単位はマイクロ秒. 区間は完了イベント("X")として出力する.
+    const double toMicroseconds = m_timestampPeriod * 1e-3;
+    outfile << "{\"traceEvents\":[\n";
+    for (size_t i = 0; i < m_traceEvents.size(); ++i) {
+        const auto& e = m_traceEvents[i];
+        outfile << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.track
+            << ",\"ts\":" << double(e.begin - traceBegin) * toMicroseconds
+            << ",\"dur\":" << double(e.end - e.begin) * toMicroseconds << "}"
+            << (i + 1 < m_traceEvents.size() ? ",\n" : "\n");
+    }
+    outfile << "],\"displayTimeUnit\":\"ms\"}\n";
+    return outfile.good();
+}
@@ -7,12 +7,20 @@
 #endif
 
 #include "GraphicsDevice.h"
+#include "MipGenerator.h"
+#include "Ktx2Texture.h"
+#include "VkrayBookUtility.h"
+#include "CpuProfiler.h"
+#include "DescriptorBuffer.h"
 #include <vulkan/vulkan_win32.h>
 
 #include <vector>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
 
 #include <GLFW/glfw3.h>
 
@@ -26,6 +34,26 @@
   g_pfn##FuncName = reinterpret_cast<PFN_##FuncName>(vkGetInstanceProcAddr(instance, #FuncName))
 
 namespace {
+    // fBXNv^Zbg 1 Ɍފe^Cv̐.
+    const std::vector<vk::DescriptorAllocator::PoolSizeRatio>& GetDescriptorPoolRatios()
+    {
+        static const std::vector<vk::DescriptorAllocator::PoolSizeRatio> ratios = {
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10.0f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8.0f },
+            { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1.0f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2.0f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2.0f },
+        };
+        return ratios;
+    }
+    // ŏɗpӂv[̃Zbg(풓p/t[Ƃ̈ꎞp).
+    const uint32_t PersistentDescriptorSetCount = 128;
+    const uint32_t FrameDescriptorSetCount = 32;
+    // fBXNv^obt@̑傫(foCX̏𒴂ꍇ͏܂).
+    const VkDeviceSize DescriptorBufferSize = 1024 * 1024;
+
     PFN_vkCreateDebugReportCallbackEXT	g_pfnvkCreateDebugReportCallbackEXT;
     PFN_vkDebugReportMessageEXT	        g_pfnvkDebugReportMessageEXT;
     PFN_vkDestroyDebugReportCallbackEXT g_pfnvkDestroyDebugReportCallbackEXT;
@@ -62,6 +90,37 @@ namespace {
           VK_COMPONENT_SWIZZLE_R,VK_COMPONENT_SWIZZLE_G,VK_COMPONENT_SWIZZLE_B,VK_COMPONENT_SWIZZLE_A
         };
     }
+
+    // ~bvxPʂł̃CAEgJ(~bv}bvp).
+    void SetMipLevelBarrier(VkCommandBuffer command, VkImage image, uint32_t level, VkImageLayout oldLayout, VkImageLayout newLayout)
+    {
+        VkImageMemoryBarrier imb{
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        };
+        imb.oldLayout = oldLayout;
+        imb.newLayout = newLayout;
+        imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imb.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        imb.image = image;
+
+        imb.srcAccessMask = (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_TRANSFER_WRITE_BIT;
+        VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        if (newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            imb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            dstStage = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        } else {
+            imb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(
+            command,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            dstStage,
+            0,
+            0, nullptr,
+            0, nullptr,
+            1, &imb);
+    }
 }
 
 VkDebugReportCallbackEXT EnableDebugReport(VkInstance instance)
@@ -117,11 +176,15 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
     appinfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 
 
+    // T[tFXɕKvȊg̓EBhEgƂ̂ݗLɂ.
     uint32_t count = 0;
-    auto surfaceExtensions = glfwGetRequiredInstanceExtensions(&count);
-    if (!surfaceExtensions) {
+    std::vector<const char*> extensions;
+    if (!m_headless) {
+        auto surfaceExtensions = glfwGetRequiredInstanceExtensions(&count);
+        if (surfaceExtensions) {
+            extensions.assign(surfaceExtensions, surfaceExtensions + count);
+        }
     }
-    std::vector<const char*> extensions(surfaceExtensions, surfaceExtensions + count);
 
     VkInstanceCreateInfo instanceCI{};
     instanceCI.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -168,28 +231,92 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
     }
     m_gfxQueueIndex = graphicsQueue;
 
+    // p̃L[t@~[T. Ȃ Graphics L[őp.
+    auto findDedicatedFamily = [&](VkQueueFlags required, VkQueueFlags excluded) {
+        for (uint32_t i = 0; i < queuePropCount; ++i) {
+            const auto& props = queueFamilyProps[i];
+            if ((props.queueFlags & required) == required && (props.queueFlags & excluded) == 0 && props.queueCount > 0) {
+                return i;
+            }
+        }
+        return m_gfxQueueIndex;
+    };
+    uint32_t computeQueue = m_gfxQueueIndex;
+    if (m_useAsyncCompute) {
+        computeQueue = findDedicatedFamily(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+    }
+    uint32_t transferQueue = m_gfxQueueIndex;
+    if (m_useTransferQueue) {
+        transferQueue = findDedicatedFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+
+        // ~bv̖[ȂǔCӂ̃TCYRs[邽, ]̗x 1 eNZPʂ̂̂Ɍ.
+        const auto& granularity = queueFamilyProps[transferQueue].minImageTransferGranularity;
+        if (granularity.width != 1 || granularity.height != 1 || granularity.depth != 1) {
+            transferQueue = m_gfxQueueIndex;
+        }
+    }
+    m_queueFamilies.clear();
+    for (auto family : { m_gfxQueueIndex, computeQueue, transferQueue }) {
+        if (std::find(m_queueFamilies.begin(), m_queueFamilies.end(), family) == m_queueFamilies.end()) {
+            m_queueFamilies.push_back(family);
+        }
+    }
+
+    // ^CX^v̗Lrbg. gpL[̂ꂩΉ(0)Ȃ GPU ̌v͍sȂ.
+    m_timestampValidBits = 64;
+    for (auto family : m_queueFamilies) {
+        m_timestampValidBits = (std::min)(m_timestampValidBits, queueFamilyProps[family].timestampValidBits);
+    }
+
 
     if (enableValidationLayer) {
         m_debugReport = EnableDebugReport(m_instance);
     }
 
     const float defaultQueuePriority(1.0f);
-    VkDeviceQueueCreateInfo devQueueCI{
-      VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      nullptr, 0,
-      m_gfxQueueIndex,
-      1, &defaultQueuePriority
-    };
+    std::vector<VkDeviceQueueCreateInfo> devQueueCIs;
+    for (auto family : m_queueFamilies) {
+        VkDeviceQueueCreateInfo devQueueCI{
+          VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+          nullptr, 0,
+          family,
+          1, &defaultQueuePriority
+        };
+        devQueueCIs.push_back(devQueueCI);
+    }
 
     extensions.clear();
     for (auto& e : requiredExtensions) {
         extensions.push_back(e);
     }
 
+    // fBXNv^obt@͑ΉĂΎg(C).
+    bool enableDescriptorBuffer = false;
+#ifdef VK_EXT_descriptor_buffer
+    VkPhysicalDeviceDescriptorBufferFeaturesEXT enabledDescriptorBufferFeatures{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT, nullptr,
+    };
+    if (m_useDescriptorBuffer && IsDeviceExtensionSupported(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 supportedFeatures2{
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &enabledDescriptorBufferFeatures,
+        };
+        vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures2);
+        enableDescriptorBuffer = enabledDescriptorBufferFeatures.descriptorBuffer == VK_TRUE;
+
+        // gpȂ@\͖̂܂܂ɂ.
+        enabledDescriptorBufferFeatures.descriptorBufferCaptureReplay = VK_FALSE;
+        enabledDescriptorBufferFeatures.descriptorBufferImageLayoutIgnored = VK_FALSE;
+        enabledDescriptorBufferFeatures.descriptorBufferPushDescriptors = VK_FALSE;
+    }
+    if (enableDescriptorBuffer) {
+        extensions.push_back(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+    }
+#endif
+
     VkDeviceCreateInfo deviceCI{
       VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       nullptr, 0,
-      1, &devQueueCI,
+      uint32_t(devQueueCIs.size()), devQueueCIs.data(),
       0, nullptr,
       uint32_t(extensions.size()), extensions.data(),
     };
@@ -213,10 +340,24 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
     enabledAccelerataionStuctureFeatures.accelerationStructure = VK_TRUE;
     enabledAccelerataionStuctureFeatures.pNext = &enabledRayTracingPipelineFeatures;
 
+    // t[]̊ǗɃ^CCZ}tHgp.
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineSemaphoreFeatures{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, nullptr,
+    };
+    enabledTimelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+    enabledTimelineSemaphoreFeatures.pNext = &enabledAccelerataionStuctureFeatures;
+
+    // GPU ṽNGzXgŃZbg.
+    VkPhysicalDeviceHostQueryResetFeatures enabledHostQueryResetFeatures{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_QUERY_RESET_FEATURES, nullptr,
+    };
+    enabledHostQueryResetFeatures.hostQueryReset = VK_TRUE;
+    enabledHostQueryResetFeatures.pNext = &enabledTimelineSemaphoreFeatures;
+
     VkPhysicalDeviceDescriptorIndexingFeatures enabledDescriptorIndexingFeatures{
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES
     };
-    enabledDescriptorIndexingFeatures.pNext = &enabledAccelerataionStuctureFeatures;
+    enabledDescriptorIndexingFeatures.pNext = &enabledHostQueryResetFeatures;
     enabledDescriptorIndexingFeatures.shaderUniformBufferArrayNonUniformIndexing = VK_TRUE;
     enabledDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
     enabledDescriptorIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
@@ -230,6 +371,12 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
     };
     physicalDeviceFeatures2.pNext = &enabledDescriptorIndexingFeatures;
     physicalDeviceFeatures2.features = features;
+#ifdef VK_EXT_descriptor_buffer
+    if (enableDescriptorBuffer) {
+        enabledDescriptorBufferFeatures.pNext = physicalDeviceFeatures2.pNext;
+        physicalDeviceFeatures2.pNext = &enabledDescriptorBufferFeatures;
+    }
+#endif
 
     // VkPhysicalDeviceFeatures2  pNextŎw肵Ă邽,
     // pEnabledFeatures = nullptr ł邱ƂKv.
@@ -242,11 +389,12 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
         return false;
     }
 
-    // R}hv[̍쐬.
+    // P̏p̃R}hv[̍쐬.
+    //  R}hobt@͕ԋpɌʂɃZbgčėp.
     VkCommandPoolCreateInfo cmdPoolCI{
       VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
       nullptr,
-      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
       m_gfxQueueIndex
     };
     result = vkCreateCommandPool(m_device, &cmdPoolCI, nullptr, &m_commandPool);
@@ -254,11 +402,57 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
     vkGetDeviceQueue(m_device, m_gfxQueueIndex, 0, &m_deviceQueue);
 
     // fBXNv^v[̏.
-    CreateDescriptorPool();
+    if (!CreateDescriptorPool()) {
+        OutputDebugStringA("Failed to create the descriptor pools.\n");
+        return false;
+    }
 
     // 擾Ă.
     vkGetPhysicalDeviceProperties(m_physicalDevice, &m_physicalDeviceProperties);
 
+    // pCvCLbV̏.
+    if (!CreatePipelineCache()) {
+        return false;
+    }
+
+    // AP[^̏.
+    m_memoryAllocator.Initialize(m_device, m_physicalDevice);
+
+    // L[ւ̑M̊Ǘ^CC̏.
+    if (!m_timeline.Initialize(m_device)) {
+        return false;
+    }
+
+    // ނƂ̃L[̏. p̃L[͂ꂼR}hv[ƃ^CC.
+    m_queues[QueueGraphics] = QueueContext{ m_deviceQueue, m_gfxQueueIndex, m_commandPool, &m_timeline };
+    const uint32_t dedicatedFamilies[] = { computeQueue, transferQueue };
+    TimelineSemaphore* dedicatedTimelines[] = { &m_computeTimeline, &m_transferTimeline };
+    for (uint32_t i = 0; i < _countof(dedicatedFamilies); ++i) {
+        auto& queue = m_queues[QueueCompute + i];
+        queue = m_queues[QueueGraphics];
+        if (dedicatedFamilies[i] == m_gfxQueueIndex) {
+            continue;
+        }
+        queue.familyIndex = dedicatedFamilies[i];
+        vkGetDeviceQueue(m_device, queue.familyIndex, 0, &queue.queue);
+        cmdPoolCI.queueFamilyIndex = queue.familyIndex;
+        vkCreateCommandPool(m_device, &cmdPoolCI, nullptr, &queue.commandPool);
+        queue.timeline = dedicatedTimelines[i];
+        if (!queue.timeline->Initialize(m_device)) {
+            return false;
+        }
+    }
+
+    // DEVICE_LOCAL ւ̓]p̃Xe[WOȌ.
+    //  p̓]L[΂ŃRs[s, Graphics L[֏Lڂ.
+    const auto& transfer = m_queues[QueueTransfer];
+    if (!m_stagingRing.Initialize(m_device, transfer.queue, transfer.familyIndex, *transfer.timeline, m_memoryAllocator, m_memProps)) {
+        return false;
+    }
+    if (!m_stagingRing.SetOwnerQueue(m_deviceQueue, m_gfxQueueIndex, m_timeline)) {
+        return false;
+    }
+
     // Vulkan Raytracing p̗lXȊg֐g悤ɃZbgAbv.
     load_VK_EXTENSIONS(
         m_instance,
@@ -266,6 +460,14 @@ bool vk::GraphicsDevice::OnInit(const std::vector<const char*>& requiredExtensio
         m_device,
         vkGetDeviceProcAddr
     );
+
+    // g֐̏łĂfBXNv^obt@. s΃fBXNv^Zbgg.
+    if (enableDescriptorBuffer) {
+        m_descriptorBuffer = std::make_unique<DescriptorBuffer>();
+        if (!m_descriptorBuffer->Initialize(*this, DescriptorBufferSize)) {
+            m_descriptorBuffer.reset();
+        }
+    }
     return true;
 }
 
@@ -278,22 +480,35 @@ void vk::GraphicsDevice::OnDestroy()
         vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
     }
     for (auto& rt : m_renderTargets) {
-        vkDestroyImageView(m_device, rt.GetImageView(), nullptr);
+        if (m_headless) {
+            // ItXN[̃obNobt@͎OŊmۂ.
+            DestroyImage(rt);
+        } else {
+            vkDestroyImageView(m_device, rt.GetImageView(), nullptr);
+        }
     }
     m_renderTargets.clear();
 
-    for (auto& cb : m_commandBuffers) {
-        vkDestroyFence(m_device, cb.fence, nullptr);
-        vkFreeCommandBuffers(m_device, m_commandPool, 1, &cb.commandBuffer);
+    for (auto& frame : m_frames) {
+        vkDestroySemaphore(m_device, frame.imageAcquired, nullptr);
+        for (auto& commandPools : frame.commandPools) {
+            for (auto& commandPool : commandPools) {
+                // v[犄蓖ĂR}hobt@܂Ƃ߂ĉ.
+                vkDestroyCommandPool(m_device, commandPool.pool, nullptr);
+            }
+        }
+        frame.descriptorAllocator.Destroy();
+        if (frame.readbackCommand) {
+            DestroyBuffer(frame.readbackBuffer);
+        }
     }
-    m_commandBuffers.clear();
+    m_frames.clear();
+    m_gpuProfiler.Destroy();
 
-    if (m_renderCompleted) {
-        vkDestroySemaphore(m_device, m_renderCompleted, nullptr);
-    }
-    if (m_presentCompleted) {
-        vkDestroySemaphore(m_device, m_presentCompleted, nullptr);
+    for (auto& semaphore : m_renderCompleted) {
+        vkDestroySemaphore(m_device, semaphore, nullptr);
     }
+    m_renderCompleted.clear();
     if (m_surface) {
         vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     }
@@ -303,6 +518,34 @@ void vk::GraphicsDevice::OnDestroy()
     if (m_descriptorPool) {
         vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
     }
+    m_descriptorAllocator.Destroy();
+    if (m_descriptorBuffer) {
+        m_descriptorBuffer->Destroy(*this);
+        m_descriptorBuffer.reset();
+    }
+    if (m_pipelineCache) {
+        // ̋NŎg悤ۑĂ.
+        if (!SavePipelineCache()) {
+            OutputDebugStringA("Failed to save the pipeline cache.\n");
+        }
+        vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+    }
+    m_stagingRing.Destroy();
+    for (int i = QueueCompute; i < QueueTypeCount; ++i) {
+        if (HasDedicatedQueue(QueueType(i))) {
+            vkDestroyCommandPool(m_device, m_queues[i].commandPool, nullptr);
+        }
+        m_queues[i].freeCommands.clear();
+    }
+    m_queues[QueueGraphics].freeCommands.clear();
+    m_computeTimeline.Destroy();
+    m_transferTimeline.Destroy();
+    m_timeline.Destroy();
+#if _DEBUG
+    // R̊mFp.
+    OutputDebugStringA(m_memoryAllocator.DumpStatistics().c_str());
+#endif
+    m_memoryAllocator.Destroy();
     if (m_device) {
         vkDestroyDevice(m_device, nullptr);
     }
@@ -434,47 +677,182 @@ bool vk::GraphicsDevice::CreateSwapchain(uint32_t width, uint32_t height, GLFWwi
         DestroyCommandBuffer(command);
     }
 
-    if (m_commandBuffers.empty()) {
-        // 쐬.
-        VkSemaphoreCreateInfo semCI{
-          VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-          nullptr, 0,
-        };
-        vkCreateSemaphore(m_device, &semCI, nullptr, &m_renderCompleted);
-        vkCreateSemaphore(m_device, &semCI, nullptr, &m_presentCompleted);
+    CreateFrameContexts(imageCount);
+    return true;
+}
+
+bool vk::GraphicsDevice::CreateOffscreenTargets(uint32_t width, uint32_t height)
+{
+    if (!m_headless) {
+        OutputDebugStringA("CreateOffscreenTargets requires SetHeadless(true).\n");
+        return false;
+    }
+    m_width = width;
+    m_height = height;
+    m_surfaceExtent = { width, height };
 
-        m_commandBuffers.resize(imageCount);
-        for (auto& cb : m_commandBuffers) {
-            cb.fence = CreateFence();
-            cb.commandBuffer = CreateCommandBuffer(false);
+    // Xbv`FC̃C[WƓ悤ɎgobNobt@pӂ.
+    //  GPU ŏ̃t[ƏdȂȂ悤, ̓t[ȏɂ.
+    auto imageCount = (std::max)(DesiredBackBufferCount, m_framesInFlight);
+    auto usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    auto command = CreateCommandBuffer();
+    for (uint32_t i = 0; i < imageCount; ++i) {
+        auto image = CreateTexture2D(width, height, BackBufferFormat.format, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (image.GetImage() == VK_NULL_HANDLE) {
+            return false;
         }
+        image.BarrierToLayout(command, GetPresentLayout());
+        m_renderTargets.push_back(image);
     }
+    vkEndCommandBuffer(command);
+    SubmitAndWait(command);
+    DestroyCommandBuffer(command);
 
+    CreateFrameContexts(imageCount);
+
+    // ǂݖ߂̓t[ƂɎ, t[CfbNXĂюgƂɌʂo.
+    auto readbackSize = VkDeviceSize(width) * height * 4;
+    auto memProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (auto& frame : m_frames) {
+        if (frame.readbackCommand == VK_NULL_HANDLE) {
+            VkCommandBufferAllocateInfo commandAI{
+              VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+              nullptr, frame.commandPools[QueueGraphics][0].pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+              1
+            };
+            vkAllocateCommandBuffers(m_device, &commandAI, &frame.readbackCommand);
+            frame.readbackBuffer = CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memProps);
+        }
+    }
     return true;
 }
 
-VkCommandBuffer vk::GraphicsDevice::CreateCommandBuffer(bool isBegin)
+void vk::GraphicsDevice::CreateFrameContexts(uint32_t imageCount)
 {
-    VkCommandBufferAllocateInfo commandAI{
-       VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      nullptr, m_commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      1
+    VkSemaphoreCreateInfo semCI{
+      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      nullptr, 0,
     };
+    if (m_frames.empty()) {
+        // 쐬. t[̐̓Xbv`FC̃C[WƂ͓Ɨ.
+        //  R}hobt@͌ʂɃZbg, v[ƃZbg.
+        VkCommandPoolCreateInfo cmdPoolCI{
+          VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+          nullptr,
+          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+          m_gfxQueueIndex
+        };
+        m_frames.resize(m_framesInFlight);
+        for (auto& frame : m_frames) {
+            if (!m_headless) {
+                vkCreateSemaphore(m_device, &semCI, nullptr, &frame.imageAcquired);
+            }
+            for (int i = 0; i < QueueTypeCount; ++i) {
+                if (i != QueueGraphics && !HasDedicatedQueue(QueueType(i))) {
+                    continue;
+                }
+                cmdPoolCI.queueFamilyIndex = m_queues[i].familyIndex;
+                frame.commandPools[i].resize(m_recordingThreadCount);
+                for (auto& commandPool : frame.commandPools[i]) {
+                    vkCreateCommandPool(m_device, &cmdPoolCI, nullptr, &commandPool.pool);
+                }
+            }
+            VkCommandBufferAllocateInfo commandAI{
+              VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+              nullptr, frame.commandPools[QueueGraphics][0].pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+              1
+            };
+            vkAllocateCommandBuffers(m_device, &commandAI, &frame.commandBuffer);
+            frame.descriptorAllocator.Initialize(m_device, GetDescriptorPoolRatios(), FrameDescriptorSetCount);
+        }
+        m_gpuProfiler.Initialize(m_device, m_framesInFlight,
+            m_physicalDeviceProperties.limits.timestampPeriod, m_timestampValidBits);
+    }
+    if (m_headless) {
+        // \sȂ̂ŕ\p̃Z}tH͕sv.
+        return;
+    }
+    while (m_renderCompleted.size() < imageCount) {
+        VkSemaphore semaphore;
+        vkCreateSemaphore(m_device, &semCI, nullptr, &semaphore);
+        m_renderCompleted.push_back(semaphore);
+    }
+}
+
+VkCommandBuffer vk::GraphicsDevice::CreateCommandBuffer(bool isBegin)
+{
+    return CreateCommandBuffer(QueueGraphics, isBegin);
+}
+
+void vk::GraphicsDevice::DestroyCommandBuffer(VkCommandBuffer command)
+{
+    DestroyCommandBuffer(QueueGraphics, command);
+}
+
+VkCommandBuffer vk::GraphicsDevice::CreateCommandBuffer(QueueType type, bool isBegin)
+{
+    // ԋpς݂̂̂΍ėp.
+    //  v[ RESET_COMMAND_BUFFER w肵Ă̂, L^̊JnɈÖٓIɃZbg.
+    auto& queue = m_queues[type];
+    VkCommandBuffer command = VK_NULL_HANDLE;
+    if (!queue.freeCommands.empty()) {
+        command = queue.freeCommands.back();
+        queue.freeCommands.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo commandAI{
+           VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+          nullptr, queue.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+          1
+        };
+        vkAllocateCommandBuffers(m_device, &commandAI, &command);
+    }
     VkCommandBufferBeginInfo beginInfo{
       VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
     };
-
-    VkCommandBuffer command;
-    vkAllocateCommandBuffers(m_device, &commandAI, &command);
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     if (isBegin) {
         vkBeginCommandBuffer(command, &beginInfo);
     }
     return command;
 }
 
-void vk::GraphicsDevice::DestroyCommandBuffer(VkCommandBuffer command)
+void vk::GraphicsDevice::DestroyCommandBuffer(QueueType type, VkCommandBuffer command)
+{
+    m_queues[type].freeCommands.push_back(command);
+}
+
+void vk::GraphicsDevice::SetCommandRecordingThreadCount(uint32_t count)
+{
+    // t[Ƃ̃R}hv[쐬ł͕ύXłȂ.
+    if (!m_frames.empty()) {
+        OutputDebugStringA("SetCommandRecordingThreadCount must be called before CreateSwapchain.\n");
+        return;
+    }
+    m_recordingThreadCount = (std::max)(count, 1u);
+}
+
+VkCommandBuffer vk::GraphicsDevice::AllocateFrameCommandBuffer(uint32_t threadIndex, VkCommandBufferLevel level)
+{
+    return AllocateFrameCommandBuffer(QueueGraphics, threadIndex, level);
+}
+
+VkCommandBuffer vk::GraphicsDevice::AllocateFrameCommandBuffer(QueueType type, uint32_t threadIndex, VkCommandBufferLevel level)
 {
-    vkFreeCommandBuffers(m_device, m_commandPool, 1, &command);
+    auto& frame = m_frames[m_frameIndex];
+    auto& commandPool = frame.commandPools[HasDedicatedQueue(type) ? type : QueueGraphics][threadIndex];
+    auto& commands = commandPool.commands[level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1];
+    auto& usedCount = commandPool.usedCount[level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1];
+    if (usedCount == commands.size()) {
+        VkCommandBufferAllocateInfo commandAI{
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+          nullptr, commandPool.pool, level,
+          1
+        };
+        VkCommandBuffer command = VK_NULL_HANDLE;
+        vkAllocateCommandBuffers(m_device, &commandAI, &command);
+        commands.push_back(command);
+    }
+    return commands[usedCount++];
 }
 
 VkFence vk::GraphicsDevice::CreateFence()
@@ -508,57 +886,167 @@ void vk::GraphicsDevice::WaitFence(VkFence fence)
 //  t[Ɗ֘AtȂR}hobt@sp.
 void vk::GraphicsDevice::SubmitAndWait(VkCommandBuffer command)
 {
-    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    auto value = Submit(command);
+    m_timeline.Wait(value);
+    m_stagingRing.Retire();
+}
+
+uint64_t vk::GraphicsDevice::Submit(VkCommandBuffer command)
+{
+    return Submit(QueueGraphics, command);
+}
+
+uint64_t vk::GraphicsDevice::Submit(QueueType type, VkCommandBuffer command, const std::vector<QueueWait>& waits)
+{
+    CPU_PROFILE_SCOPE("GraphicsDevice::Submit");
+    // ς܂Ă]ɑMĂ.
+    //  ]̊ Graphics L[̃^CCŕ\̂, ̃L[ł͂҂.
+    auto waitList = waits;
+    auto uploadValue = m_stagingRing.Flush();
+    if (uploadValue != 0 && type != QueueGraphics) {
+        waitList.push_back(QueueWait{ QueueGraphics, uploadValue, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT });
+    }
+
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+    for (const auto& wait : waitList) {
+        waitSemaphores.push_back(m_queues[wait.queue].timeline->GetSemaphore());
+        waitValues.push_back(wait.value);
+        waitStageMasks.push_back(wait.stageMask);
+    }
+
+    auto& queue = m_queues[type];
+    uint64_t signalValue = queue.timeline->Advance();
+    auto timelineSemaphore = queue.timeline->GetSemaphore();
+    VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      nullptr,
+      uint32_t(waitValues.size()), waitValues.data(),   // WaitSemaphoreValues
+      1, &signalValue, // SignalSemaphoreValues
+    };
     VkSubmitInfo submitInfo{
       VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      nullptr,
-      0, nullptr, // WaitSemaphore
-      &waitStageMask, // DstStageMask
+      &timelineInfo,
+      uint32_t(waitSemaphores.size()), waitSemaphores.data(), // WaitSemaphore
+      waitStageMasks.data(), // DstStageMask
       1, &command, // CommandBuffer
-      0, nullptr, // SignalSemaphore
+      1, &timelineSemaphore, // SignalSemaphore
     };
-
-    auto fence = CreateFence();
-    ResetFence(fence);
-    vkQueueSubmit(m_deviceQueue, 1, &submitInfo, fence);
-    WaitFence(fence);
-    DestroyFence(fence);
-    vkQueueWaitIdle(m_deviceQueue);
+    vkQueueSubmit(queue.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    return signalValue;
 }
 
 void vk::GraphicsDevice::Present()
 {
+    CPU_PROFILE_SCOPE("GraphicsDevice::Present");
+    if (m_headless) {
+        // \̑ɃobNobt@̓ezXg֓ǂݖ߂.
+        //  ʂ͓t[CfbNXĂюgƂ(܂ FlushFrameReadbacks)Ɏ󂯎.
+        auto& frame = m_frames[m_frameIndex];
+        auto& backbuffer = m_renderTargets[m_backBufferIndex];
+        auto command = frame.readbackCommand;
+        VkCommandBufferBeginInfo beginInfo{
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        };
+        vkBeginCommandBuffer(command, &beginInfo);
+
+        VkMemoryBarrier barrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        };
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(command,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { m_surfaceExtent.width, m_surfaceExtent.height, 1 };
+        vkCmdCopyImageToBuffer(command,
+            backbuffer.GetImage(), backbuffer.GetImageLayout(),
+            frame.readbackBuffer.GetBuffer(), 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(command,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(command);
+
+        frame.timelineValue = Submit(command);
+        frame.readbackFrameNumber = m_frameNumber++;
+        frame.readbackPending = true;
+
+        m_backBufferIndex = (m_backBufferIndex + 1) % uint32_t(m_renderTargets.size());
+        m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+        return;
+    }
+
     VkPresentInfoKHR presentInfo{
         VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         nullptr,
-        1,&m_renderCompleted,
+        1,&m_renderCompleted[m_backBufferIndex],
         1,&m_swapchain,
-        &m_frameIndex
+        &m_backBufferIndex
     };
     vkQueuePresentKHR(m_deviceQueue, &presentInfo);
+
+    // ̃t[. Õt[ GPU ҂ɋL^n߂.
+    m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
 }
 
 VkCommandBuffer vk::GraphicsDevice::GetCurrentFrameCommandBuffer()
 {
-    return m_commandBuffers[m_frameIndex].commandBuffer;
+    return m_frames[m_frameIndex].commandBuffer;
 }
 
 // R}hobt@𑗐MĎs.
-void vk::GraphicsDevice::SubmitCurrentFrameCommandBuffer()
+void vk::GraphicsDevice::SubmitCurrentFrameCommandBuffer(const std::vector<QueueWait>& waits)
 {
-    auto command = GetCurrentFrameCommandBuffer();
-    VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    CPU_PROFILE_SCOPE("GraphicsDevice::SubmitCurrentFrameCommandBuffer");
+    m_stagingRing.Flush();
+
+    auto& frame = m_frames[m_frameIndex];
+    frame.timelineValue = m_timeline.Advance();
+
+    // C[W擾Ƒ̃L[̏҂Ăs,
+    //  ɕ\p̃Z}tHƃ^CC signal .
+    //  wbhXł̓C[W̎擾ƕ\̂, ^CĈ݂.
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStageMasks;
+    std::vector<VkSemaphore> signalSemaphores = { m_timeline.GetSemaphore() };
+    std::vector<uint64_t> signalValues = { frame.timelineValue };
+    if (!m_headless) {
+        waitSemaphores.push_back(frame.imageAcquired);
+        waitValues.push_back(0); // oCiZ}tHł͖.
+        waitStageMasks.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        signalSemaphores.push_back(m_renderCompleted[m_backBufferIndex]);
+        signalValues.push_back(0);
+    }
+    for (const auto& wait : waits) {
+        waitSemaphores.push_back(m_queues[wait.queue].timeline->GetSemaphore());
+        waitValues.push_back(wait.value);
+        waitStageMasks.push_back(wait.stageMask);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+      nullptr,
+      uint32_t(waitValues.size()), waitValues.data(), // WaitSemaphoreValues
+      uint32_t(signalValues.size()), signalValues.data(), // SignalSemaphoreValues
+    };
+
     VkSubmitInfo submitInfo{
       VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      nullptr,
-      1, &m_presentCompleted, // WaitSemaphore
-      &waitStageMask, // DstStageMask
-      1, &command, // CommandBuffer
-      1, &m_renderCompleted, // SignalSemaphore
+      &timelineInfo,
+      uint32_t(waitSemaphores.size()), waitSemaphores.data(), // WaitSemaphore
+      waitStageMasks.data(), // DstStageMask
+      1, &frame.commandBuffer, // CommandBuffer
+      uint32_t(signalSemaphores.size()), signalSemaphores.data(), // SignalSemaphore
     };
-    auto fence = m_commandBuffers[m_frameIndex].fence;
-    vkResetFences(m_device, 1, &fence);
-    vkQueueSubmit(m_deviceQueue, 1, &submitInfo, fence);
+    vkQueueSubmit(m_deviceQueue, 1, &submitInfo, VK_NULL_HANDLE);
 }
 
 
@@ -571,10 +1059,107 @@ void vk::GraphicsDevice::WaitForIdleGpu()
 
 void vk::GraphicsDevice::WaitAvailableFrame()
 {
+    CPU_PROFILE_SCOPE("GraphicsDevice::WaitAvailableFrame");
+    // ̃t[̃\[XOgt[̊҂.
+    //  Vt[ GPU Ŏŝ܂܂ł悢.
+    auto& frame = m_frames[m_frameIndex];
+    m_timeline.Wait(frame.timelineValue);
+    m_gpuProfiler.BeginFrame(m_frameIndex);
+
+    // ̃t[ŋL^R}hobt@ׂ͂Ďsς݂Ȃ̂, v[ƃZbg.
+    //  ̃L[Ŏŝ, ̃t[ Graphics L[̏̊҂Ă.
+    for (auto& commandPools : frame.commandPools) {
+        for (auto& commandPool : commandPools) {
+            vkResetCommandPool(m_device, commandPool.pool, 0);
+            commandPool.usedCount[0] = 0;
+            commandPool.usedCount[1] = 0;
+        }
+    }
+    // ̃t[ŎgꎞIȃfBXNv^Zbg܂Ƃ߂ĉ.
+    frame.descriptorAllocator.Reset();
+
+    if (m_headless) {
+        // O񂱂̃t[œǂݖ߂摜n. obNobt@ Present ŏɐ؂ւ.
+        DeliverReadback(frame);
+        return;
+    }
+
     auto timeout = UINT64_MAX;
-    auto result = vkAcquireNextImageKHR(m_device, m_swapchain, timeout, m_presentCompleted, VK_NULL_HANDLE, &m_frameIndex);
-    auto fence = m_commandBuffers[m_frameIndex].fence;
-    vkWaitForFences(m_device, 1, &fence, VK_TRUE, timeout);
+    vkAcquireNextImageKHR(m_device, m_swapchain, timeout, frame.imageAcquired, VK_NULL_HANDLE, &m_backBufferIndex);
+}
+
+void vk::GraphicsDevice::SetHeadless(bool headless)
+{
+    // CX^X̊g@\ɉê, foCX̍쐬ɂ͕ύXłȂ.
+    if (m_device != VK_NULL_HANDLE) {
+        OutputDebugStringA("SetHeadless must be called before OnInit.\n");
+        return;
+    }
+    m_headless = headless;
+}
+
+VkImageLayout vk::GraphicsDevice::GetPresentLayout() const
+{
+    return m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+void vk::GraphicsDevice::FlushFrameReadbacks()
+{
+    // Ât[珇ɓn. m_frameIndex ͎Ɏg(łÂ)t[wĂ.
+    for (uint32_t i = 0; i < m_framesInFlight && i < m_frames.size(); ++i) {
+        auto& frame = m_frames[(m_frameIndex + i) % m_framesInFlight];
+        m_timeline.Wait(frame.timelineValue);
+        DeliverReadback(frame);
+    }
+}
+
+void vk::GraphicsDevice::DeliverReadback(FrameContext& frame)
+{
+    if (!frame.readbackPending) {
+        return;
+    }
+    frame.readbackPending = false;
+    if (!m_frameSink) {
+        return;
+    }
+    FrameImage image{
+        frame.readbackFrameNumber,
+        m_surfaceExtent.width, m_surfaceExtent.height,
+        BackBufferFormat.format,
+        Map(frame.readbackBuffer),
+    };
+    m_frameSink(image);
+}
+
+void vk::GraphicsDevice::SetDedicatedQueueUsage(bool useAsyncCompute, bool useTransferQueue)
+{
+    // L[̓foCX̍쐬Ɍ܂.
+    if (m_device != VK_NULL_HANDLE) {
+        OutputDebugStringA("SetDedicatedQueueUsage must be called before OnInit.\n");
+        return;
+    }
+    m_useAsyncCompute = useAsyncCompute;
+    m_useTransferQueue = useTransferQueue;
+}
+
+void vk::GraphicsDevice::SetDescriptorBufferUsage(bool useDescriptorBuffer)
+{
+    // g@\̓foCX̍쐬ɗLɂ.
+    if (m_device != VK_NULL_HANDLE) {
+        OutputDebugStringA("SetDescriptorBufferUsage must be called before OnInit.\n");
+        return;
+    }
+    m_useDescriptorBuffer = useDescriptorBuffer;
+}
+
+void vk::GraphicsDevice::SetFramesInFlight(uint32_t count)
+{
+    // t[Ƃ̃\[X쐬ł͕ύXłȂ.
+    if (!m_frames.empty()) {
+        OutputDebugStringA("SetFramesInFlight must be called before CreateSwapchain.\n");
+        return;
+    }
+    m_framesInFlight = (std::max)(count, 1u);
 }
 
 vk::BufferResource vk::GraphicsDevice::CreateBuffer(size_t requestSize, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps)
@@ -587,17 +1172,25 @@ vk::BufferResource vk::GraphicsDevice::CreateBuffer(size_t requestSize, VkBuffer
     };
     bufferCI.size = requestSize;
     bufferCI.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    if (m_queueFamilies.size() > 1) {
+        // p̃L[gꍇ, obt@͏L̈ړȂɂǂ̃L[g悤ɂ.
+        //  (L̈ړKvȂ̂̓C[Ŵ݂ƂȂ.)
+        bufferCI.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferCI.queueFamilyIndexCount = uint32_t(m_queueFamilies.size());
+        bufferCI.pQueueFamilyIndices = m_queueFamilies.data();
+    }
     VkBuffer buffer;
     vkCreateBuffer(m_device, &bufferCI, nullptr, &buffer);
 
     // ̊m.
-    auto memory = AllocateMemory(buffer, bufferCI.usage, memProps);
-    vkBindBufferMemory(m_device, buffer, memory, 0);
+    auto allocation = AllocateMemory(buffer, bufferCI.usage, memProps);
+    vkBindBufferMemory(m_device, buffer, allocation.memory, allocation.offset);
 
     ret.m_buffer = buffer;
-    ret.m_memory = memory;
+    ret.m_allocation = allocation;
     ret.m_memProps = memProps;
     ret.m_usage = usage;
+    ret.m_size = requestSize;
 
     if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
         ret.m_deviceAddress = GetDeviceAddress(ret.m_buffer);
@@ -608,22 +1201,28 @@ vk::BufferResource vk::GraphicsDevice::CreateBuffer(size_t requestSize, VkBuffer
 
 void vk::GraphicsDevice::DestroyBuffer(BufferResource& objBuffer)
 {
+    // ]ƂĎgĂ, ̓]܂ő҂.
+    WaitBufferUploads(objBuffer.GetBuffer());
     vkDestroyBuffer(m_device, objBuffer.GetBuffer(), nullptr);
-    vkFreeMemory(m_device, objBuffer.GetMemory(), nullptr);
+    m_memoryAllocator.Free(objBuffer.m_allocation);
     objBuffer.m_buffer = VK_NULL_HANDLE;
-    objBuffer.m_memory = VK_NULL_HANDLE;
+    objBuffer.m_allocation = MemoryAllocation();
 }
 
-vk::ImageResource vk::GraphicsDevice::CreateTexture2D(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps)
+vk::ImageResource vk::GraphicsDevice::CreateTexture2D(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps, uint32_t mipLevels)
 {
     ImageResource ret{};
+    if (mipLevels > 1) {
+        // ~bv}bvɏkƂĎgp.
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     VkImageCreateInfo imageCI{
         VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO, nullptr
     };
     imageCI.imageType = VK_IMAGE_TYPE_2D;
     imageCI.format = format;
     imageCI.extent = { width, height, 1 };
-    imageCI.mipLevels = 1;
+    imageCI.mipLevels = mipLevels;
     imageCI.arrayLayers = 1;
     imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
     imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -636,8 +1235,8 @@ vk::ImageResource vk::GraphicsDevice::CreateTexture2D(uint32_t width, uint32_t h
     vkCreateImage(m_device, &imageCI, nullptr, &image);
 
     // ̊m.
-    auto memory = AllocateMemory(image, memProps);
-    vkBindImageMemory(m_device, image, memory, 0);
+    auto allocation = AllocateMemory(image, memProps);
+    vkBindImageMemory(m_device, image, allocation.memory, allocation.offset);
 
     // r[̐.
     VkImageViewCreateInfo viewCI{
@@ -647,22 +1246,33 @@ vk::ImageResource vk::GraphicsDevice::CreateTexture2D(uint32_t width, uint32_t h
     viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
     viewCI.format = format;
     viewCI.components = DefaultComponentMapping();
-    viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
 
     VkImageView view;
     vkCreateImageView(m_device, &viewCI, nullptr, &view);
 
     ret.m_image = image;
     ret.m_view = view;
-    ret.m_memory = memory;
+    ret.m_allocation = allocation;
+    ret.m_subresourceRange = viewCI.subresourceRange;
+    ret.m_format = format;
+    ret.m_extent = { width, height };
     return ret;
 }
 
 vk::ImageResource vk::GraphicsDevice::CreateTexture2DFromFile(const wchar_t* fileName, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps)
 {
-    stbi_uc* image = nullptr;
+    // ϊc[ō쐬kς݂̃t@CΗD悷.
+    std::filesystem::path filePath(fileName);
+    auto ktx2Path = std::filesystem::path(filePath).replace_extension(L".ktx2");
+    std::error_code ec;
+    if (std::filesystem::exists(ktx2Path, ec) &&
+        std::filesystem::last_write_time(ktx2Path, ec) >= std::filesystem::last_write_time(filePath, ec)) {
+        filePath = ktx2Path;
+    }
+
     std::vector<char> binImage;
-    std::ifstream infile(fileName, std::ios::binary);
+    std::ifstream infile(filePath, std::ios::binary);
     if (!infile) {
         return vk::ImageResource();
     }
@@ -675,54 +1285,209 @@ vk::ImageResource vk::GraphicsDevice::CreateTexture2DFromFile(const wchar_t* fil
 
 vk::ImageResource vk::GraphicsDevice::CreateTexture2DFromMemory(const void* imageData, size_t size, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps)
 {
+    if (util::Ktx2Texture::IsKtx2(imageData, size)) {
+        return CreateTexture2DFromKtx2(imageData, size, usage, memProps);
+    }
+
     int width, height;
     auto image = stbi_load_from_memory(static_cast<const stbi_uc*>(imageData), int(size), &width, &height, nullptr, 4);
-    usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if (image == nullptr) {
+        OutputDebugStringA("Failed to decode image.\n");
+        return vk::ImageResource();
+    }
 
-    // ݐ̃eNX`𐶐.
+    // ݐ̃eNX`, ~bv}bv܂߂Đ.
     VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
-    vk::ImageResource tex = CreateTexture2D(width, height, format, usage, memProps);
+    const auto mipLevels = GetMipLevelCount(uint32_t(width), uint32_t(height));
+    vk::ImageResource tex = CreateTexture2D(width, height, format, usage, memProps, mipLevels);
+    WriteToTexture2D(tex, uint32_t(width), uint32_t(height), image);
 
-    // Xe[WOp.
-    auto imageSize = width * height * sizeof(uint32_t);
-    auto buffersSrc = CreateBuffer(
-        imageSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    WriteToBuffer(buffersSrc, image, imageSize);
+    stbi_image_free(image);
+    return tex;
+}
 
-    auto command = CreateCommandBuffer();
-    VkImageSubresourceRange subresource{};
-    subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    subresource.baseMipLevel = 0;
-    subresource.levelCount = 1;
-    subresource.baseArrayLayer = 0;
-    subresource.layerCount = 1;
+vk::ImageResource vk::GraphicsDevice::CreateTexture2DFromKtx2(const void* data, size_t size, VkImageUsageFlags usage, VkMemoryPropertyFlags memProps)
+{
+    util::Ktx2Texture ktx2;
+    if (!ktx2.Parse(data, size)) {
+        OutputDebugStringA("Unsupported KTX2 texture.\n");
+        return vk::ImageResource();
+    }
+    const auto format = ktx2.GetFormat();
+    if (!IsSampledFormatSupported(format)) {
+        OutputDebugStringA("KTX2 texture format is not supported on this device.\n");
+        return vk::ImageResource();
+    }
+    const auto width = ktx2.GetWidth(), height = ktx2.GetHeight();
+    const auto& levels = ktx2.GetLevels();
 
-    // ]ɐݒ肷.
-    tex.BarrierToDst(command);
+    // ~bv}bvȂt@C, \ȂǂݍݎɏkRs[Ő.
+    const bool generateMipmaps = ktx2.IsMipGenerationRequested() && IsLinearBlitSupported(format);
+    const auto levelCount = generateMipmaps ? GetMipLevelCount(width, height) : uint32_t(levels.size());
+    auto tex = CreateTexture2D(width, height, format, usage, memProps, levelCount);
 
-    // ].
-    VkBufferImageCopy region{};
-    region.imageExtent = { uint32_t(width), uint32_t(height), 1 };
-    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    // ]惌CAEgւ̃oA CopyToImageLevel ŏ݂̏̌ɋL^.
+    for (uint32_t level = 0; level < uint32_t(levels.size()); ++level) {
+        CopyToImageLevel(tex, level, levels[level].width, levels[level].height, levels[level].data);
+    }
+    m_stagingRing.TransferOwnership(tex.m_image, tex.m_layout, tex.m_subresourceRange);
+    if (generateMipmaps) {
+        GenerateMipmaps(tex, width, height);
+    } else {
+        tex.BarrierToShaderReadOnly(m_stagingRing.GetOwnerCommandBuffer());
+    }
+    m_imageUploads[tex.m_image] = m_stagingRing.GetPendingBatch();
+    return tex;
+}
 
-    vkCmdCopyBufferToImage(
-        command,
-        buffersSrc.GetBuffer(),
-        tex.m_image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1, &region
-    );
-    // eNX`Ƃēǂݎ\Ԃ֐ݒ.
-    tex.BarrierToShaderReadOnly(command);
+void vk::GraphicsDevice::WriteToTexture2D(ImageResource& image, uint32_t width, uint32_t height, const void* pixels)
+{
+    const auto levelCount = image.GetMipLevels();
+    if (levelCount > 1 && !IsLinearBlitSupported(VK_FORMAT_R8G8B8A8_UNORM)) {
+        // kRs[gȂ̂ CPU Ő̂.
+        auto chain = util::MipGenerator::GenerateChain(static_cast<const uint8_t*>(pixels), width, height);
+        std::vector<const void*> levels = { pixels };
+        for (const auto& level : chain) {
+            levels.push_back(level.data());
+        }
+        WriteToTexture2D(image, width, height, levels);
+        return;
+    }
 
-    vkEndCommandBuffer(command);
-    SubmitAndWait(command);
-    DestroyCommandBuffer(command);
-    
-    DestroyBuffer(buffersSrc);
-    return tex;
+    CopyToImageLevel(image, 0, width, height, pixels);
+
+    // p̓]L[gꍇ, ȍ~̏(kRs[⃌CAEgύX) Graphics L[ōs.
+    m_stagingRing.TransferOwnership(image.m_image, image.m_layout, image.m_subresourceRange);
+    if (levelCount > 1) {
+        GenerateMipmaps(image, width, height);
+    } else {
+        // eNX`Ƃēǂݎ\Ԃ֐ݒ.
+        image.BarrierToShaderReadOnly(m_stagingRing.GetOwnerCommandBuffer());
+    }
+    m_imageUploads[image.m_image] = m_stagingRing.GetPendingBatch();
+}
+
+void vk::GraphicsDevice::WriteToTexture2D(ImageResource& image, uint32_t width, uint32_t height, const std::vector<const void*>& levels)
+{
+    const auto levelCount = (std::min)(image.GetMipLevels(), uint32_t(levels.size()));
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        auto levelWidth = (std::max)(width >> level, 1u);
+        auto levelHeight = (std::max)(height >> level, 1u);
+        CopyToImageLevel(image, level, levelWidth, levelHeight, levels[level]);
+    }
+    m_stagingRing.TransferOwnership(image.m_image, image.m_layout, image.m_subresourceRange);
+    image.BarrierToShaderReadOnly(m_stagingRing.GetOwnerCommandBuffer());
+    m_imageUploads[image.m_image] = m_stagingRing.GetPendingBatch();
+}
+
+uint32_t vk::GraphicsDevice::GetMipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levelCount = 1;
+    for (auto size = (std::max)(width, height); size > 1; size >>= 1) {
+        ++levelCount;
+    }
+    return levelCount;
+}
+
+bool vk::GraphicsDevice::IsLinearBlitSupported(VkFormat format) const
+{
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &props);
+    const VkFormatFeatureFlags required =
+        VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (props.optimalTilingFeatures & required) == required;
+}
+
+bool vk::GraphicsDevice::IsSampledFormatSupported(VkFormat format) const
+{
+    VkFormatProperties props{};
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool vk::GraphicsDevice::IsDeviceExtensionSupported(const char* extensionName) const
+{
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> properties(count);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &count, properties.data());
+    for (const auto& props : properties) {
+        if (strcmp(props.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void vk::GraphicsDevice::CopyToImageLevel(ImageResource& image, uint32_t level, uint32_t width, uint32_t height, const void* data)
+{
+    util::FormatBlockInfo block;
+    if (!util::GetFormatBlockInfo(image.m_format, block)) {
+        return;
+    }
+
+    // Og؂Ȃ悤, 傫ȉ摜̓ubNsPʂŕē].
+    const uint32_t blockRows = (height + block.blockExtent - 1) / block.blockExtent;
+    const VkDeviceSize rowPitch = VkDeviceSize((width + block.blockExtent - 1) / block.blockExtent) * block.blockBytes;
+    const uint32_t rowsPerChunk = uint32_t((std::max)(m_stagingRing.GetSize() / 4 / rowPitch, VkDeviceSize(1)));
+    const VkDeviceSize alignment = (block.blockBytes % 4 == 0) ? block.blockBytes : block.blockBytes * 4;
+
+    auto src = static_cast<const uint8_t*>(data);
+    for (uint32_t row = 0; row < blockRows; row += rowsPerChunk) {
+        const auto rows = (std::min)(rowsPerChunk, blockRows - row);
+        VkDeviceSize srcOffset = 0;
+        m_stagingRing.Write(src + rowPitch * row, rowPitch * rows, alignment, srcOffset);
+
+        // Write ̒őMs邱Ƃ̂, R}hobt@͏݌Ɏ擾.
+        //  ]惌CAEgւ̃oA, ̃ob`Ȃ悤ŏ݂̏̌ɋL^.
+        if (image.m_layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+            image.BarrierToDst(m_stagingRing.GetCommandBuffer());
+        }
+        const auto y = row * block.blockExtent;
+        VkBufferImageCopy region{};
+        region.bufferOffset = srcOffset;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        region.imageOffset = { 0, int32_t(y), 0 };
+        region.imageExtent = { width, (std::min)(rows * block.blockExtent, height - y), 1 };
+        vkCmdCopyBufferToImage(
+            m_stagingRing.GetCommandBuffer(),
+            m_stagingRing.GetBuffer(),
+            image.m_image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &region
+        );
+    }
+}
+
+void vk::GraphicsDevice::GenerateMipmaps(ImageResource& image, uint32_t width, uint32_t height)
+{
+    // 1 ̃x]ɂ, `tB^Ŕ̃TCY֏kRs[Ă.
+    //  kƂĎgIx珇ɃVF[_[ǂݎԂɂ.
+    auto command = m_stagingRing.GetOwnerCommandBuffer();
+    const auto levelCount = image.GetMipLevels();
+    auto srcWidth = int32_t(width), srcHeight = int32_t(height);
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        auto dstWidth = (std::max)(srcWidth / 2, 1);
+        auto dstHeight = (std::max)(srcHeight / 2, 1);
+        SetMipLevelBarrier(command, image.m_image, level - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+        VkImageBlit blit{};
+        blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+        blit.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+        blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        blit.dstOffsets[1] = { dstWidth, dstHeight, 1 };
+        vkCmdBlitImage(
+            command,
+            image.m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+
+        SetMipLevelBarrier(command, image.m_image, level - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        srcWidth = dstWidth;
+        srcHeight = dstHeight;
+    }
+    SetMipLevelBarrier(command, image.m_image, levelCount - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    image.m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 }
 
 vk::ImageResource vk::GraphicsDevice::CreateTextureCube(const wchar_t* faceFiles[6], VkImageUsageFlags usage, VkMemoryPropertyFlags memProps)
@@ -766,8 +1531,8 @@ vk::ImageResource vk::GraphicsDevice::CreateTextureCube(const wchar_t* faceFiles
 
     vk::ImageResource cubemap;
     vkCreateImage(m_device, &imageCI, nullptr, &cubemap.m_image);
-    cubemap.m_memory = AllocateMemory(cubemap.m_image, memProps);
-    vkBindImageMemory(m_device, cubemap.m_image, cubemap.m_memory, 0);
+    cubemap.m_allocation = AllocateMemory(cubemap.m_image, memProps);
+    vkBindImageMemory(m_device, cubemap.m_image, cubemap.GetMemory(), cubemap.GetMemoryOffset());
 
     // r[̐.
     VkImageViewCreateInfo viewCI{
@@ -780,6 +1545,8 @@ vk::ImageResource vk::GraphicsDevice::CreateTextureCube(const wchar_t* faceFiles
     viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
     vkCreateImageView(m_device, &viewCI, nullptr, &cubemap.m_view);
     cubemap.m_subresourceRange = viewCI.subresourceRange;
+    cubemap.m_format = imageCI.format;
+    cubemap.m_extent = { uint32_t(width), uint32_t(height) };
 
     // Xe[WOp.
     BufferResource buffersSrc[6];
@@ -825,69 +1592,74 @@ vk::ImageResource vk::GraphicsDevice::CreateTextureCube(const wchar_t* faceFiles
 
 void vk::GraphicsDevice::DestroyImage(ImageResource& objImage)
 {
+    // ]ƂĎgĂ, ̓]܂ő҂.
+    WaitImageUploads(objImage.GetImage());
     vkDestroyImage(m_device, objImage.GetImage(), nullptr);
     vkDestroyImageView(m_device, objImage.GetImageView(), nullptr);
-    vkFreeMemory(m_device, objImage.GetMemory(), nullptr);
+    m_memoryAllocator.Free(objImage.m_allocation);
     objImage.m_image = VK_NULL_HANDLE;
-    objImage.m_memory = VK_NULL_HANDLE;
+    objImage.m_allocation = MemoryAllocation();
     objImage.m_view = VK_NULL_HANDLE;
 }
 
-VkDeviceMemory vk::GraphicsDevice::AllocateMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps)
+vk::MemoryAllocation vk::GraphicsDevice::AllocateMemory(VkBuffer buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags memProps)
 {
-    VkDeviceMemory memory;
     VkMemoryRequirements reqs;
     vkGetBufferMemoryRequirements(m_device, buffer, &reqs);
-    VkMemoryAllocateInfo info{
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      nullptr,
-      reqs.size,
-      GetMemoryTypeIndex(reqs.memoryTypeBits, memProps)
-    };
-
-    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{
-    VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr,
-    };
-    memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-    if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-        info.pNext = &memoryAllocateFlagsInfo;
-    }
-
-    vkAllocateMemory(m_device, &info, nullptr, &memory);
-    return memory;
+    auto memoryTypeIndex = GetMemoryTypeIndex(reqs.memoryTypeBits, memProps);
+    bool useDeviceAddress = (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0;
+    return m_memoryAllocator.Allocate(reqs, memoryTypeIndex, false, useDeviceAddress);
 }
 
-VkDeviceMemory vk::GraphicsDevice::AllocateMemory(VkImage image, VkMemoryPropertyFlags memProps)
+vk::MemoryAllocation vk::GraphicsDevice::AllocateMemory(VkImage image, VkMemoryPropertyFlags memProps)
 {
-    VkDeviceMemory memory;
     VkMemoryRequirements reqs;
     vkGetImageMemoryRequirements(m_device, image, &reqs);
-    VkMemoryAllocateInfo info{
-      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-      nullptr,
-      reqs.size,
-      GetMemoryTypeIndex(reqs.memoryTypeBits, memProps)
-    };
-
-    vkAllocateMemory(m_device, &info, nullptr, &memory);
-    return memory;
+    auto memoryTypeIndex = GetMemoryTypeIndex(reqs.memoryTypeBits, memProps);
+    return m_memoryAllocator.Allocate(reqs, memoryTypeIndex, true, false);
 }
 
 
 void* vk::GraphicsDevice::Map(const BufferResource& bufferRes)
 {
+    // HOST_VISIBLE ȃ̓AP[^}bv܂܂ɂĂ.
     void* p = nullptr;
     if (bufferRes.m_memProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-        vkMapMemory(m_device, bufferRes.GetMemory(), 0, VK_WHOLE_SIZE, 0, &p);
+        p = bufferRes.m_allocation.mapped;
     }
     return p;
 }
 
 void vk::GraphicsDevice::Unmap(const BufferResource& bufferRes)
 {
-    if (bufferRes.m_memProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-        vkUnmapMemory(m_device, bufferRes.GetMemory());
+    // ubNPʂŃ}bvĂ邽, ł̓A}bvȂ.
+    //  Rq[głȂ̂݃tbVĂ.
+    auto memProps = bufferRes.m_memProps;
+    if ((memProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (memProps & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+        FlushMappedMemory(bufferRes.m_allocation, bufferRes.m_size);
+    }
+}
+
+void vk::GraphicsDevice::FlushMappedMemory(const MemoryAllocation& allocation, VkDeviceSize size)
+{
+    VkMappedMemoryRange range{
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE
+    };
+    range.memory = allocation.memory;
+    if (allocation.poolIndex < 0) {
+        // pmۂ̓Ŝ̊蓖ĂȂ̂, ̊ۂ߂CɂŜw肷.
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+    } else {
+        // ubN͑̊蓖ĂƋLĂ邽, ̊蓖Ă͈̔͂ nonCoherentAtomSize ɍLĎw肷.
+        //  (ubNTCY atom ̔{Ȃ̂Ŗ؂グĂubNɎ܂.)
+        const auto atom = m_physicalDeviceProperties.limits.nonCoherentAtomSize;
+        const auto begin = allocation.offset / atom * atom;
+        const auto end = (allocation.offset + size + atom - 1) / atom * atom;
+        range.offset = begin;
+        range.size = end - begin;
     }
+    vkFlushMappedMemoryRanges(m_device, 1, &range);
 }
 
 
@@ -895,44 +1667,45 @@ void vk::GraphicsDevice::WriteToBuffer(BufferResource& bufferRes, const void* da
 {
     auto memProps = bufferRes.m_memProps;
     if (memProps & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-        void* p;
-        vkMapMemory(m_device, bufferRes.GetMemory(), 0, VK_WHOLE_SIZE, 0, &p);
+        void* p = bufferRes.m_allocation.mapped;
         memcpy(p, data, size);
-        vkUnmapMemory(m_device, bufferRes.GetMemory());
         if ((memProps & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
-            VkMappedMemoryRange range{
-                VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE
-            };
-            range.memory = bufferRes.GetMemory();
-            range.offset = 0;
-            range.size = VK_WHOLE_SIZE;
-            vkFlushMappedMemoryRanges(m_device, 1, &range);
+            FlushMappedMemory(bufferRes.m_allocation, size);
         }
         return;
     }
     if (memProps & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
-        // Xe[WOobt@pӂ.
-        VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        VkMemoryPropertyFlags memProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        auto stagingBuffer = CreateBuffer(size, usage, memProps);
-        WriteToBuffer(stagingBuffer, data, size);
+        // Xe[WOOɐςł, ̑Mɂ܂Ƃ߂ē].
+        m_stagingRing.WriteBuffer(bufferRes.GetBuffer(), 0, data, size);
+        m_bufferUploads[bufferRes.GetBuffer()] = m_stagingRing.GetPendingBatch();
+        return;
+    }
+}
 
-        // ].
-        auto command = CreateCommandBuffer();
-        VkBufferCopy region{};
-        region.size = size;
-        vkCmdCopyBuffer(command, stagingBuffer.GetBuffer(), bufferRes.GetBuffer(), 1, &region);
-        vkEndCommandBuffer(command);
-        
-        // ]̊҂Ĕ.
-        SubmitAndWait(command);
-        DestroyCommandBuffer(command);
+void vk::GraphicsDevice::WaitBufferUploads(VkBuffer buffer)
+{
+    auto itr = m_bufferUploads.find(buffer);
+    if (itr != m_bufferUploads.end()) {
+        m_stagingRing.WaitBatch(itr->second);
+        m_bufferUploads.erase(itr);
+    }
+}
 
-        DestroyBuffer(stagingBuffer);
-        return;
+void vk::GraphicsDevice::WaitImageUploads(VkImage image)
+{
+    auto itr = m_imageUploads.find(image);
+    if (itr != m_imageUploads.end()) {
+        m_stagingRing.WaitBatch(itr->second);
+        m_imageUploads.erase(itr);
     }
 }
 
+void vk::GraphicsDevice::FlushUploads(bool waitForCompletion)
+{
+    m_stagingRing.Flush();
+    m_stagingRing.Retire(waitForCompletion);
+}
+
 uint64_t vk::GraphicsDevice::GetDeviceAddress(VkBuffer buffer)
 {
     // Vulkan1.2gȂꍇɂ́A KHR t̂̂g.
@@ -945,14 +1718,10 @@ uint64_t vk::GraphicsDevice::GetDeviceAddress(VkBuffer buffer)
 
 bool vk::GraphicsDevice::CreateDescriptorPool()
 {
+    // ÕCu(ImGui)p. tHg̃eNX`ɂ̂ݎg.
     VkResult result;
     VkDescriptorPoolSize poolSize[] = {
-      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-      { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-      { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-      { VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 100 },
-      { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-      { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
+      { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100 },
     };
     VkDescriptorPoolCreateInfo descPoolCI{
       VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -961,7 +1730,13 @@ bool vk::GraphicsDevice::CreateDescriptorPool()
       _countof(poolSize), poolSize,
     };
     result = vkCreateDescriptorPool(m_device, &descPoolCI, nullptr, &m_descriptorPool);
-    return result == VK_SUCCESS;
+    if (result != VK_SUCCESS) {
+        return false;
+    }
+
+    // AvP[Vp. ʂɉł悤ɂ.
+    return m_descriptorAllocator.Initialize(m_device, GetDescriptorPoolRatios(), PersistentDescriptorSetCount,
+        VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 }
 
 uint32_t vk::GraphicsDevice::GetMemoryTypeIndex(uint32_t requestBits, VkMemoryPropertyFlags requestProps) const
@@ -983,24 +1758,146 @@ uint32_t vk::GraphicsDevice::GetMemoryTypeIndex(uint32_t requestBits, VkMemoryPr
     return result;
 }
 
-VkDescriptorSet vk::GraphicsDevice::AllocateDescriptorSet(VkDescriptorSetLayout dsLayout, const void* pNext)
+bool vk::GraphicsDevice::CreatePipelineCache()
 {
-    VkDescriptorSetAllocateInfo dsAI{
-        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr
+    // ȑOɕۑLbVǂݍ.
+    //  ̃foCXhCoōꂽf[^͎gȂ, wb_mFĂn.
+    std::vector<char> initialData;
+    std::ifstream infile;
+    if (!m_pipelineCacheFileName.empty()) {
+        infile.open(std::filesystem::path(m_pipelineCacheFileName), std::ifstream::binary);
+    }
+    PipelineCacheFileHeader fileHeader{};
+    if (infile && infile.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader))) {
+        bool isValid = fileHeader.magic == PipelineCacheMagic && fileHeader.version == PipelineCacheVersion;
+        isValid = isValid && fileHeader.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne);
+        if (isValid) {
+            initialData.resize(size_t(fileHeader.dataSize));
+            isValid = bool(infile.read(initialData.data(), initialData.size()));
+            isValid = isValid && util::ComputeHash(initialData.data(), initialData.size()) == fileHeader.dataHash;
+        }
+        if (isValid) {
+            VkPipelineCacheHeaderVersionOne header{};
+            memcpy(&header, initialData.data(), sizeof(header));
+            isValid = header.headerSize >= sizeof(header);
+            isValid = isValid && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+            isValid = isValid && header.vendorID == m_physicalDeviceProperties.vendorID;
+            isValid = isValid && header.deviceID == m_physicalDeviceProperties.deviceID;
+            isValid = isValid && memcmp(header.pipelineCacheUUID, m_physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!isValid) {
+            OutputDebugStringA("Pipeline cache: discarded an incompatible or corrupted file.\n");
+            initialData.clear();
+        }
+    }
+    infile.close();
+
+    VkPipelineCacheCreateInfo pipelineCacheCI{
+        VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO
     };
-    dsAI.descriptorPool = m_descriptorPool;
-    dsAI.pSetLayouts = &dsLayout;
-    dsAI.descriptorSetCount = 1;
-    dsAI.pNext = pNext;
-    VkDescriptorSet ds{};
-    auto r = vkAllocateDescriptorSets(m_device, &dsAI, &ds);
-    assert(r == VK_SUCCESS);
-    return ds;
+    pipelineCacheCI.initialDataSize = initialData.size();
+    pipelineCacheCI.pInitialData = initialData.empty() ? nullptr : initialData.data();
+    auto result = vkCreatePipelineCache(m_device, &pipelineCacheCI, nullptr, &m_pipelineCache);
+    if (result != VK_SUCCESS && !initialData.empty()) {
+        // 󂯕tȂꍇ͋̃LbVō蒼.
+        initialData.clear();
+        pipelineCacheCI.initialDataSize = 0;
+        pipelineCacheCI.pInitialData = nullptr;
+        result = vkCreatePipelineCache(m_device, &pipelineCacheCI, nullptr, &m_pipelineCache);
+    }
+    m_pipelineCacheWarm = result == VK_SUCCESS && !initialData.empty();
+    return result == VK_SUCCESS;
+}
+
+bool vk::GraphicsDevice::SavePipelineCache()
+{
+    if (m_pipelineCache == VK_NULL_HANDLE || m_pipelineCacheFileName.empty()) {
+        return false;
+    }
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return false;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+        return false;
+    }
+    data.resize(dataSize);
+
+    PipelineCacheFileHeader fileHeader{};
+    fileHeader.magic = PipelineCacheMagic;
+    fileHeader.version = PipelineCacheVersion;
+    fileHeader.dataSize = dataSize;
+    fileHeader.dataHash = util::ComputeHash(data.data(), data.size());
+
+    // ݓr̃t@Cǂ܂Ȃ悤, ꎞt@CɏĂu.
+    std::filesystem::path filePath(m_pipelineCacheFileName);
+    auto tempPath = filePath;
+    tempPath += L".tmp";
+    {
+        std::ofstream outfile(tempPath, std::ofstream::binary);
+        if (!outfile) {
+            return false;
+        }
+        outfile.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+        outfile.write(data.data(), data.size());
+        if (!outfile.good()) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, filePath, ec);
+    return !ec;
+}
+
+VkPipeline vk::GraphicsDevice::CreateRayTracingPipeline(const VkRayTracingPipelineCreateInfoKHR& createInfo, const char* name)
+{
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto result = vkCreateRayTracingPipelinesKHR(
+        m_device, VK_NULL_HANDLE, m_pipelineCache, 1, &createInfo, nullptr, &pipeline);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    if (result != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    ReportPipelineCreation(name, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+    return pipeline;
+}
+
+VkPipeline vk::GraphicsDevice::CreateComputePipeline(const VkComputePipelineCreateInfo& createInfo, const char* name)
+{
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto result = vkCreateComputePipelines(m_device, m_pipelineCache, 1, &createInfo, nullptr, &pipeline);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    if (result != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    ReportPipelineCreation(name, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+    return pipeline;
+}
+
+void vk::GraphicsDevice::ReportPipelineCreation(const char* name, double milliseconds)
+{
+    std::stringstream ss;
+    ss << "Pipeline " << name << (m_pipelineCacheWarm ? " (warm cache) " : " (cold cache) ")
+        << milliseconds << " ms" << std::endl;
+    OutputDebugStringA(ss.str().c_str());
+}
+
+VkDescriptorSet vk::GraphicsDevice::AllocateDescriptorSet(VkDescriptorSetLayout dsLayout, const void* pNext)
+{
+    return m_descriptorAllocator.Allocate(dsLayout, pNext);
 }
 
 void vk::GraphicsDevice::DeallocateDescriptorSet(VkDescriptorSet ds)
 {
-    vkFreeDescriptorSets(m_device, m_descriptorPool, 1, &ds);
+    m_descriptorAllocator.Free(ds);
+}
+
+VkDescriptorSet vk::GraphicsDevice::AllocateFrameDescriptorSet(VkDescriptorSetLayout dsLayout, const void* pNext)
+{
+    return m_frames[m_frameIndex].descriptorAllocator.Allocate(dsLayout, pNext);
 }
 
 VkSampler vk::GraphicsDevice::CreateSampler(VkFilter minFilter, VkFilter magFilter, VkSamplerMipmapMode mipmapMode, VkSamplerAddressMode addressU, VkSamplerAddressMode addressV)
@@ -1020,7 +1917,7 @@ VkSampler vk::GraphicsDevice::CreateSampler(VkFilter minFilter, VkFilter magFilt
       VK_FALSE,
       VK_COMPARE_OP_NEVER,
       0.0f,
-      1.0f,
+      VK_LOD_CLAMP_NONE,    // gp郌x̓C[Wr[͈̔͂Ő.
       VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
       VK_FALSE
     };
@@ -1047,6 +1944,19 @@ VkPhysicalDeviceRayTracingPipelinePropertiesKHR vk::GraphicsDevice::GetRayTracin
     return physDevRtPipelineProps;
 }
 
+VkPhysicalDeviceAccelerationStructurePropertiesKHR vk::GraphicsDevice::GetAccelerationStructureProperties()
+{
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR physDevAsProps{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR
+    };
+    VkPhysicalDeviceProperties2 physDevProps2{
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2
+    };
+    physDevProps2.pNext = &physDevAsProps;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &physDevProps2);
+    return physDevAsProps;
+}
+
 
 
 void vk::ImageResource::BarrierToGeneral(VkCommandBuffer command)
@@ -1074,6 +1984,11 @@ void vk::ImageResource::BarrierToPresentSrc(VkCommandBuffer command)
     SetImageLayoutBarrier(command, m_image, m_layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 }
 
+void vk::ImageResource::BarrierToLayout(VkCommandBuffer command, VkImageLayout newLayout)
+{
+    SetImageLayoutBarrier(command, m_image, m_layout, newLayout);
+}
+
 const VkDescriptorImageInfo* vk::ImageResource::GetDescriptor(VkSampler sampler)
 {
     m_descriptor.imageView = m_view;
@@ -0,0 +1,296 @@
+﻿#include "Ktx2Texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    const uint8_t Ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct Ktx2Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Ktx2Header) == 80, "KTX2 header size mismatch.");
+
+    struct Ktx2LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    // Khronos Data Format の値(Basic Data Format Descriptor 用).
+    enum : uint8_t {
+        DF_MODEL_RGBSDA = 1,
+        DF_MODEL_BC1A = 128,
+        DF_MODEL_BC3 = 130,
+        DF_MODEL_BC5 = 132,
+        DF_MODEL_BC7 = 134,
+        DF_PRIMARIES_BT709 = 1,
+        DF_TRANSFER_LINEAR = 1,
+        DF_TRANSFER_SRGB = 2,
+        DF_CHANNEL_RED = 0,
+        DF_CHANNEL_GREEN = 1,
+        DF_CHANNEL_BLUE = 2,
+        DF_CHANNEL_ALPHA = 15,
+        DF_SAMPLE_LINEAR = 0x10,
+    };
+
+    bool IsSrgbFormat(VkFormat format)
+    {
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // フォーマットに対応する Data Format Descriptor を作成する.
+    //  サンプル情報は (チャンネル, ビット位置, ビット長, 上限値) の組.
+    bool BuildDataFormatDescriptor(VkFormat format, std::vector<uint32_t>& dfd)
+    {
+        struct Sample { uint8_t channel; uint16_t bitOffset; uint8_t bitLength; uint32_t upper; };
+        std::vector<Sample> samples;
+        uint8_t colorModel = 0;
+        uint8_t blockDim = 0;
+        uint8_t bytesPlane0 = 0;
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            colorModel = DF_MODEL_RGBSDA; bytesPlane0 = 4;
+            samples = { { DF_CHANNEL_RED, 0, 7, 255 }, { DF_CHANNEL_GREEN, 8, 7, 255 },
+                { DF_CHANNEL_BLUE, 16, 7, 255 }, { DF_CHANNEL_ALPHA, 24, 7, 255 } };
+            break;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            colorModel = DF_MODEL_BC1A; blockDim = 3; bytesPlane0 = 8;
+            samples = { { 0, 0, 63, ~0u } };
+            break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            colorModel = DF_MODEL_BC3; blockDim = 3; bytesPlane0 = 16;
+            samples = { { DF_CHANNEL_ALPHA, 0, 63, ~0u }, { 0, 64, 63, ~0u } };
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            colorModel = DF_MODEL_BC5; blockDim = 3; bytesPlane0 = 16;
+            samples = { { DF_CHANNEL_RED, 0, 63, ~0u }, { DF_CHANNEL_GREEN, 64, 63, ~0u } };
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            colorModel = DF_MODEL_BC7; blockDim = 3; bytesPlane0 = 16;
+            samples = { { 0, 0, 127, ~0u } };
+            break;
+        default:
+            return false;
+        }
+
+        const bool srgb = IsSrgbFormat(format);
+        const uint32_t blockSize = 24 + 16 * uint32_t(samples.size());
+        dfd.clear();
+        dfd.push_back(4 + blockSize);       // dfdTotalSize
+        dfd.push_back(0);                   // vendorId = KHRONOS, descriptorType = BASICFORMAT
+        dfd.push_back(2 | (blockSize << 16));   // versionNumber, descriptorBlockSize
+        dfd.push_back(colorModel | (DF_PRIMARIES_BT709 << 8) | ((srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16));
+        dfd.push_back(blockDim | (blockDim << 8));
+        dfd.push_back(bytesPlane0);
+        dfd.push_back(0);
+        for (const auto& s : samples) {
+            uint8_t channelType = s.channel;
+            if (srgb && s.channel == DF_CHANNEL_ALPHA) {
+                channelType |= DF_SAMPLE_LINEAR;
+            }
+            dfd.push_back(s.bitOffset | (uint32_t(s.bitLength) << 16) | (uint32_t(channelType) << 24));
+            dfd.push_back(0);               // samplePosition
+            dfd.push_back(0);               // sampleLower
+            dfd.push_back(s.upper);         // sampleUpper
+        }
+        return true;
+    }
+
+    VkDeviceSize CalcLevelSize(const util::FormatBlockInfo& block, uint32_t width, uint32_t height)
+    {
+        VkDeviceSize blocksX = (width + block.blockExtent - 1) / block.blockExtent;
+        VkDeviceSize blocksY = (height + block.blockExtent - 1) / block.blockExtent;
+        return blocksX * blocksY * block.blockBytes;
+    }
+}
+
+namespace util {
+
+    bool GetFormatBlockInfo(VkFormat format, FormatBlockInfo& info)
+    {
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            info = { 4, 1, false };
+            return true;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            info = { 8, 4, true };
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            info = { 16, 4, true };
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    VkDeviceSize CalcTextureDataSize(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount)
+    {
+        FormatBlockInfo block;
+        if (!GetFormatBlockInfo(format, block)) {
+            return 0;
+        }
+        VkDeviceSize total = 0;
+        for (uint32_t level = 0; level < levelCount; ++level) {
+            total += CalcLevelSize(block, (std::max)(width >> level, 1u), (std::max)(height >> level, 1u));
+        }
+        return total;
+    }
+
+    bool Ktx2Texture::IsKtx2(const void* data, size_t size)
+    {
+        return data != nullptr && size >= sizeof(Ktx2Header) && memcmp(data, Ktx2Identifier, sizeof(Ktx2Identifier)) == 0;
+    }
+
+    bool Ktx2Texture::Parse(const void* data, size_t size)
+    {
+        m_levels.clear();
+        if (!IsKtx2(data, size)) {
+            return false;
+        }
+        const auto bytes = static_cast<const uint8_t*>(data);
+        Ktx2Header header;
+        memcpy(&header, bytes, sizeof(header));
+
+        // 2D テクスチャ(配列・キューブ・3D 以外)で, 超圧縮されていないものだけを扱う.
+        if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+            header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0) {
+            return false;
+        }
+        const auto format = VkFormat(header.vkFormat);
+        FormatBlockInfo block;
+        if (!GetFormatBlockInfo(format, block)) {
+            return false;
+        }
+
+        const uint32_t levelCount = (std::max)(header.levelCount, 1u);
+        if (levelCount > 32) {
+            return false;
+        }
+        const size_t indexEnd = sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * levelCount;
+        if (indexEnd > size) {
+            return false;
+        }
+
+        std::vector<Level> levels(levelCount);
+        for (uint32_t i = 0; i < levelCount; ++i) {
+            Ktx2LevelIndex index;
+            memcpy(&index, bytes + sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * i, sizeof(index));
+
+            auto& level = levels[i];
+            level.width = (std::max)(header.pixelWidth >> i, 1u);
+            level.height = (std::max)(header.pixelHeight >> i, 1u);
+            const auto expected = CalcLevelSize(block, level.width, level.height);
+            if (index.byteOffset > size || index.byteLength > size - index.byteOffset || index.byteLength < expected) {
+                return false;
+            }
+            level.data = bytes + index.byteOffset;
+            level.size = size_t(expected);
+        }
+
+        m_format = format;
+        m_width = header.pixelWidth;
+        m_height = header.pixelHeight;
+        m_levels = std::move(levels);
+        m_mipGenerationRequested = header.levelCount == 0;
+        return true;
+    }
+
+    bool Ktx2Texture::Write(
+        const std::wstring& fileName, VkFormat format, uint32_t width, uint32_t height,
+        const std::vector<std::vector<uint8_t>>& levels)
+    {
+        FormatBlockInfo block;
+        std::vector<uint32_t> dfd;
+        if (levels.empty() || !GetFormatBlockInfo(format, block) || !BuildDataFormatDescriptor(format, dfd)) {
+            return false;
+        }
+        const uint32_t levelCount = uint32_t(levels.size());
+
+        Ktx2Header header{};
+        memcpy(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier));
+        header.vkFormat = uint32_t(format);
+        header.typeSize = 1;
+        header.pixelWidth = width;
+        header.pixelHeight = height;
+        header.faceCount = 1;
+        header.levelCount = levelCount;
+        header.dfdByteOffset = uint32_t(sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * levelCount);
+        header.dfdByteLength = uint32_t(dfd.size() * sizeof(uint32_t));
+
+        // ミップマップは小さいレベルから順に, ブロックサイズと 4 の公倍数に揃えて配置する.
+        const uint64_t alignment = (block.blockBytes % 4 == 0) ? block.blockBytes : block.blockBytes * 4;
+        std::vector<Ktx2LevelIndex> indices(levelCount);
+        uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+        for (uint32_t i = levelCount; i-- > 0;) {
+            offset = (offset + alignment - 1) / alignment * alignment;
+            indices[i].byteOffset = offset;
+            indices[i].byteLength = levels[i].size();
+            indices[i].uncompressedByteLength = levels[i].size();
+            offset += levels[i].size();
+        }
+
+        std::ofstream outfile(std::filesystem::path(fileName), std::ios::binary);
+        if (!outfile) {
+            return false;
+        }
+        outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(indices.data()), sizeof(Ktx2LevelIndex) * indices.size());
+        outfile.write(reinterpret_cast<const char*>(dfd.data()), header.dfdByteLength);
+
+        uint64_t written = header.dfdByteOffset + header.dfdByteLength;
+        const char padding[16] = {};
+        for (uint32_t i = levelCount; i-- > 0;) {
+            outfile.write(padding, std::streamsize(indices[i].byteOffset - written));
+            outfile.write(reinterpret_cast<const char*>(levels[i].data()), levels[i].size());
+            written = indices[i].byteOffset + levels[i].size();
+        }
+        return bool(outfile);
+    }
+}
@@ -1,5 +1,18 @@
 #include "MaterialManager.h"
 #include "GraphicsDevice.h"
+#include "Ktx2Texture.h"
+#include "DescriptorBuffer.h"
+
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+
+void Material::MarkDirty()
+{
+    if (m_owner) {
+        m_owner->MarkMaterialDirty(m_materialIndex);
+    }
+}
 
 void MaterialManager::Create(VkGraphicsDevice& device, int maxTextures)
 {
@@ -8,6 +21,7 @@ void MaterialManager::Create(VkGraphicsDevice& device, int maxTextures)
         VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR,
         VK_SAMPLER_ADDRESS_MODE_REPEAT,
         VK_SAMPLER_ADDRESS_MODE_REPEAT);
+    CreateTextureSet(device, maxTextures);
 }
 
 void MaterialManager::Destroy(VkGraphicsDevice& device)
@@ -16,25 +30,75 @@ void MaterialManager::Destroy(VkGraphicsDevice& device)
         device->DestroyImage(t);
     }
     device->DestroySampler(m_defaultSampler);
+
+    // fBXNv^obt@̗̈̓foCX̔jɂ܂Ƃ߂ĉ.
+    if (m_textureSet != VK_NULL_HANDLE) {
+        device->DeallocateDescriptorSet(m_textureSet);
+        m_textureSet = VK_NULL_HANDLE;
+    }
+    vkDestroyDescriptorSetLayout(m_device, m_textureSetLayout, nullptr);
+    m_textureSetLayout = VK_NULL_HANDLE;
+
+    if (m_hasMaterialBuffer) {
+        m_materialBuffer.Destroy(device);
+        m_hasMaterialBuffer = false;
+    }
+    for (auto& m : m_materials) {
+        m->m_owner = nullptr;
+    }
 }
 
 void MaterialManager::Reset()
 {
     m_textureMap.clear();
+    m_textureContentMap.clear();
     m_textures.clear();
+    m_textureStats = TextureStatistics();
 }
 
 int MaterialManager::AddTexture(const std::wstring& name, vk::ImageResource texture)
 {
     auto textureIndex = GetTexture(name);
     if (textureIndex < 0) {
-        textureIndex = int(m_textures.size());
+        textureIndex = RegisterTexture(texture);
+        m_textureMap.insert(std::make_pair(name, textureIndex));
+    }
+    return textureIndex;
+}
+
+int MaterialManager::AddTexture(const std::wstring& name, vk::ImageResource texture, uint64_t contentHash, size_t encodedSize)
+{
+    // Ȍd͋Cɂ, VvfƂēo^.
+    auto textureIndex = RegisterTexture(texture);
+    if (!name.empty()) {
         m_textureMap.insert(std::make_pair(name, textureIndex));
-        m_textures.push_back(texture);
     }
+    m_textureContentMap.insert(std::make_pair(contentHash, TextureContent{ encodedSize, textureIndex }));
     return textureIndex;
 }
 
+int MaterialManager::ShareTexture(const std::wstring& name, uint64_t contentHash, size_t encodedSize)
+{
+    auto range = m_textureContentMap.equal_range(contentHash);
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (itr->second.encodedSize != encodedSize) {
+            continue;
+        }
+        auto textureIndex = itr->second.textureIndex;
+        if (!name.empty()) {
+            m_textureMap.insert(std::make_pair(name, textureIndex));
+        }
+        const auto& texture = m_textures[textureIndex];
+        const auto extent = texture.GetExtent();
+        m_textureStats.sharedCount++;
+        m_textureStats.sharedEncodedBytes += encodedSize;
+        m_textureStats.sharedDataBytes += util::CalcTextureDataSize(
+            texture.GetFormat(), extent.width, extent.height, texture.GetMipLevels());
+        return textureIndex;
+    }
+    return -1;
+}
+
 int MaterialManager::GetTexture(const std::wstring& name) const
 {
     auto itr = m_textureMap.find(name);
@@ -49,8 +113,18 @@ int MaterialManager::AddMaterial(std::shared_ptr<Material> mate)
     auto materialIndex = GetMaterialIndex(mate->GetName());
     if (materialIndex < 0) {
         materialIndex = int(m_materials.size());
+        if (m_hasMaterialBuffer && uint32_t(materialIndex) >= m_materialCapacity) {
+            // ̖̈CfbNXԂȂ悤, głȂΓo^Ȃ.
+            if (!GrowMaterialBuffer(uint32_t(materialIndex) + 1)) {
+                OutputDebugStringA("MaterialManager: failed to grow the material buffer.\n");
+                return -1;
+            }
+        }
         m_materialMap.insert(std::make_pair(mate->GetName(), materialIndex));
         m_materials.push_back(mate);
+        mate->m_owner = this;
+        mate->m_materialIndex = materialIndex;
+        MarkMaterialDirty(materialIndex);
     }
     return materialIndex;
 }
@@ -78,6 +152,112 @@ std::vector<VkDescriptorImageInfo> MaterialManager::GetTextureDescriptors() cons
     return descriptors;
 }
 
+int MaterialManager::RegisterTexture(vk::ImageResource texture)
+{
+    auto textureIndex = int(m_textures.size());
+    m_textures.push_back(texture);
+    WriteTextureDescriptor(textureIndex);
+
+    const auto format = texture.GetFormat();
+    const auto extent = texture.GetExtent();
+    const auto levelCount = texture.GetMipLevels();
+    util::FormatBlockInfo block;
+    m_textureStats.textureCount++;
+    if (util::GetFormatBlockInfo(format, block) && block.compressed) {
+        m_textureStats.compressedCount++;
+    }
+    m_textureStats.dataBytes += util::CalcTextureDataSize(format, extent.width, extent.height, levelCount);
+    m_textureStats.uncompressedBytes += util::CalcTextureDataSize(VK_FORMAT_R8G8B8A8_UNORM, extent.width, extent.height, levelCount);
+    return textureIndex;
+}
+
+void MaterialManager::CreateTextureSet(VkGraphicsDevice& device, int maxTextures)
+{
+    m_device = device->GetDevice();
+    m_descriptorBuffer = device->GetDescriptorBuffer();
+    if (m_descriptorBuffer) {
+        m_textureSetCapacity = uint32_t(maxTextures);
+        m_textureSetLayout = CreateTextureSetLayout(m_textureSetCapacity, true);
+        m_textureSetOffset = m_descriptorBuffer->AllocateSet(m_textureSetLayout);
+        if (m_textureSetOffset != vk::DescriptorBuffer::InvalidOffset) {
+            return;
+        }
+        // ̈悪Ȃ΃fBXNv^Zbgg.
+        vkDestroyDescriptorSetLayout(m_device, m_textureSetLayout, nullptr);
+        m_descriptorBuffer = nullptr;
+        m_textureSetOffset = 0;
+    }
+
+    // fBXNv^Zbgł̓Xe[W̏Ɏ߂.
+    const auto& limits = device->GetDeviceLimits();
+    m_textureSetCapacity = (std::min)({ uint32_t(maxTextures),
+        limits.maxPerStageDescriptorSamplers, limits.maxPerStageDescriptorSampledImages });
+    m_textureSetLayout = CreateTextureSetLayout(m_textureSetCapacity, false);
+    m_textureSet = device->AllocateDescriptorSet(m_textureSetLayout);
+}
+
+VkDescriptorSetLayout MaterialManager::CreateTextureSetLayout(uint32_t textureCount, bool descriptorBuffer)
+{
+    VkDescriptorSetLayoutBinding layoutTextures{};
+    layoutTextures.binding = 0;
+    layoutTextures.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    layoutTextures.descriptorCount = textureCount;
+    layoutTextures.stageFlags = VK_SHADER_STAGE_ALL;
+
+    VkDescriptorSetLayoutCreateInfo dsLayoutCI{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO
+    };
+    dsLayoutCI.bindingCount = 1;
+    dsLayoutCI.pBindings = &layoutTextures;
+
+    // o^̗vf̓VF[_[QƂȂ, fBXNv^Zbgł͕IȃoCh.
+    //  (fBXNv^obt@ł͏łȂvfĂQƂȂΖȂ.)
+    VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{
+        VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO
+    };
+    bindingFlagsCI.bindingCount = 1;
+    bindingFlagsCI.pBindingFlags = &bindingFlags;
+    if (descriptorBuffer) {
+        dsLayoutCI.flags = vk::DescriptorBuffer::GetSetLayoutCreateFlags();
+    } else {
+        dsLayoutCI.pNext = &bindingFlagsCI;
+    }
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    vkCreateDescriptorSetLayout(m_device, &dsLayoutCI, nullptr, &layout);
+    return layout;
+}
+
+void MaterialManager::WriteTextureDescriptor(int textureIndex)
+{
+    if (uint32_t(textureIndex) >= m_textureSetCapacity) {
+        OutputDebugStringA("MaterialManager: the texture set is full.\n");
+        return;
+    }
+    const auto& texture = m_textures[textureIndex];
+    VkDescriptorImageInfo info{};
+    info.imageView = texture.GetImageView();
+    info.imageLayout = texture.GetImageLayout();
+    info.sampler = m_defaultSampler;
+
+    if (m_descriptorBuffer) {
+        m_descriptorBuffer->WriteImage(m_textureSetLayout, m_textureSetOffset, 0, uint32_t(textureIndex),
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, info);
+        return;
+    }
+    VkWriteDescriptorSet textureWrite{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET
+    };
+    textureWrite.dstSet = m_textureSet;
+    textureWrite.dstBinding = 0;
+    textureWrite.dstArrayElement = uint32_t(textureIndex);
+    textureWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    textureWrite.descriptorCount = 1;
+    textureWrite.pImageInfo = &info;
+    vkUpdateDescriptorSets(m_device, 1, &textureWrite, 0, nullptr);
+}
+
 std::vector<Material::DataBlock> MaterialManager::GetMaterialData() const
 {
     std::vector<Material::DataBlock> blocks;
@@ -87,3 +267,85 @@ std::vector<Material::DataBlock> MaterialManager::GetMaterialData() const
     return blocks;
 }
 
+
+bool MaterialManager::CreateMaterialBuffer(VkGraphicsDevice& device, int maxMaterials)
+{
+    m_materialCapacity = uint32_t((std::max)({ maxMaterials, int(m_materials.size()), 1 }));
+    m_framesInFlight = device->GetFramesInFlight();
+    m_materialDevice = &device;
+    auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (!m_materialBuffer.Initialize(device, m_materialCapacity * sizeof(Material::DataBlock), usage)) {
+        OutputDebugStringA("MaterialManager: failed to create the material buffer.\n");
+        return false;
+    }
+    m_hasMaterialBuffer = true;
+    m_materialBufferVersion++;
+
+    // ͑St[̗̈֏ł.
+    auto blocks = GetMaterialData();
+    for (uint32_t frame = 0; frame < m_framesInFlight; ++frame) {
+        memcpy(m_materialBuffer.Map(frame), blocks.data(), blocks.size() * sizeof(Material::DataBlock));
+    }
+    m_materialPendingFrames.assign(m_materialCapacity, 0);
+    m_dirtyMaterials.clear();
+    m_materialUploadCount = 0;
+    return true;
+}
+
+void MaterialManager::UpdateMaterialBuffer(uint32_t frameIndex)
+{
+    m_materialUploadCount = 0;
+    if (!m_hasMaterialBuffer || m_dirtyMaterials.empty()) {
+        return;
+    }
+    // t[̗̈͏ԂɎĝ, st[߂ΑS̈ɔf.
+    auto dst = static_cast<Material::DataBlock*>(m_materialBuffer.Map(frameIndex));
+    size_t i = 0;
+    while (i < m_dirtyMaterials.size()) {
+        auto materialIndex = m_dirtyMaterials[i];
+        dst[materialIndex] = m_materials[materialIndex]->Get();
+        m_materialUploadCount++;
+        if (--m_materialPendingFrames[materialIndex] == 0) {
+            m_dirtyMaterials[i] = m_dirtyMaterials.back();
+            m_dirtyMaterials.pop_back();
+        } else {
+            ++i;
+        }
+    }
+}
+
+bool MaterialManager::GrowMaterialBuffer(uint32_t requiredCapacity)
+{
+    auto& device = *m_materialDevice;
+    const auto capacity = (std::max)(requiredCapacity, m_materialCapacity * 2);
+    util::DynamicBuffer buffer;
+    auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    if (!buffer.Initialize(device, capacity * sizeof(Material::DataBlock), usage)) {
+        return false;
+    }
+
+    // Âobt@͎s̃t[QƂĂ̂, ҂Ăj.
+    //  et[̗̈͂̂܂܎ʂ̂, f̗vf UpdateMaterialBuffer ŏ܂.
+    device->WaitForIdleGpu();
+    for (uint32_t frame = 0; frame < m_framesInFlight; ++frame) {
+        memcpy(buffer.Map(frame), m_materialBuffer.Map(frame), m_materialCapacity * sizeof(Material::DataBlock));
+    }
+    m_materialBuffer.Destroy(device);
+    m_materialBuffer = buffer;
+    m_materialCapacity = capacity;
+    m_materialPendingFrames.resize(capacity, 0);
+    m_materialBufferVersion++;
+    return true;
+}
+
+void MaterialManager::MarkMaterialDirty(int materialIndex)
+{
+    if (!m_hasMaterialBuffer) {
+        return;
+    }
+    auto& pendingFrames = m_materialPendingFrames[materialIndex];
+    if (pendingFrames == 0) {
+        m_dirtyMaterials.push_back(materialIndex);
+    }
+    pendingFrames = m_framesInFlight;
+}
@@ -0,0 +1,357 @@
+﻿#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+    inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        if (alignment <= 1) {
+            return value;
+        }
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+// ------------------------------------------
+// MemoryBlockRange
+// ------------------------------------------
+vk::MemoryBlockRange::MemoryBlockRange(VkDeviceSize size) : m_size(size)
+{
+    if (size > 0) {
+        m_freeRanges.emplace(0, size);
+    }
+}
+
+bool vk::MemoryBlockRange::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    // First-fit で探す.
+    for (auto itr = m_freeRanges.begin(); itr != m_freeRanges.end(); ++itr) {
+        const auto rangeStart = itr->first;
+        const auto rangeEnd = itr->first + itr->second;
+        const auto alignedStart = AlignUp(rangeStart, alignment);
+        if (alignedStart + size > rangeEnd) {
+            continue;
+        }
+
+        // 空き領域を分割する.
+        m_freeRanges.erase(itr);
+        if (alignedStart > rangeStart) {
+            m_freeRanges.emplace(rangeStart, alignedStart - rangeStart);
+        }
+        if (alignedStart + size < rangeEnd) {
+            m_freeRanges.emplace(alignedStart + size, rangeEnd - (alignedStart + size));
+        }
+        offset = alignedStart;
+        m_used += size;
+        return true;
+    }
+    return false;
+}
+
+void vk::MemoryBlockRange::Free(VkDeviceSize offset, VkDeviceSize size)
+{
+    auto itr = m_freeRanges.emplace(offset, size).first;
+    m_used -= size;
+
+    // 後ろの空き領域と結合.
+    auto next = std::next(itr);
+    if (next != m_freeRanges.end() && itr->first + itr->second == next->first) {
+        itr->second += next->second;
+        m_freeRanges.erase(next);
+    }
+    // 前の空き領域と結合.
+    if (itr != m_freeRanges.begin()) {
+        auto prev = std::prev(itr);
+        if (prev->first + prev->second == itr->first) {
+            prev->second += itr->second;
+            m_freeRanges.erase(itr);
+        }
+    }
+}
+
+VkDeviceSize vk::MemoryBlockRange::GetLargestFreeRange() const
+{
+    VkDeviceSize largest = 0;
+    for (const auto& v : m_freeRanges) {
+        largest = (std::max)(largest, v.second);
+    }
+    return largest;
+}
+
+// ------------------------------------------
+// DeviceMemoryAllocator
+// ------------------------------------------
+void vk::DeviceMemoryAllocator::Initialize(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize)
+{
+    m_device = device;
+    m_preferredBlockSize = preferredBlockSize;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memProps);
+    m_dedicated.resize(m_memProps.memoryTypeCount);
+}
+
+void vk::DeviceMemoryAllocator::Destroy()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& pool : m_pools) {
+        for (auto& block : pool.blocks) {
+            if (block && block->memory) {
+                vkFreeMemory(m_device, block->memory, nullptr);
+            }
+        }
+    }
+    m_pools.clear();
+    m_dedicated.clear();
+}
+
+VkDeviceSize vk::DeviceMemoryAllocator::GetSizeClass(VkDeviceSize size)
+{
+    if (size <= MinSizeClass) {
+        return MinSizeClass;
+    }
+    if (size <= MaxSizeClass) {
+        // 2 のべき乗に切り上げ.
+        VkDeviceSize sizeClass = MinSizeClass;
+        while (sizeClass < size) {
+            sizeClass <<= 1;
+        }
+        return sizeClass;
+    }
+    // 大きいものは 64KB 単位に切り上げ.
+    return AlignUp(size, 64 * 1024);
+}
+
+VkDeviceSize vk::DeviceMemoryAllocator::GetBlockSize(uint32_t memoryTypeIndex) const
+{
+    const auto heapIndex = m_memProps.memoryTypes[memoryTypeIndex].heapIndex;
+    const auto heapSize = m_memProps.memoryHeaps[heapIndex].size;
+
+    // 小さいヒープではブロックを小さくしておく.
+    if (heapSize <= 1024ull * 1024 * 1024) {
+        return (std::min)(m_preferredBlockSize, AlignUp(heapSize / 8, 1024 * 1024));
+    }
+    return m_preferredBlockSize;
+}
+
+int32_t vk::DeviceMemoryAllocator::GetPoolIndex(uint32_t memoryTypeIndex, bool isImage) const
+{
+    for (int32_t i = 0; i < int32_t(m_pools.size()); ++i) {
+        if (m_pools[i].memoryTypeIndex == memoryTypeIndex && m_pools[i].isImage == isImage) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+VkDeviceMemory vk::DeviceMemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, bool useDeviceAddress, void** mapped)
+{
+    VkMemoryAllocateInfo info{
+      VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      nullptr,
+      size,
+      memoryTypeIndex
+    };
+    VkMemoryAllocateFlagsInfo memoryAllocateFlagsInfo{
+        VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO, nullptr,
+    };
+    memoryAllocateFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+    if (useDeviceAddress) {
+        info.pNext = &memoryAllocateFlagsInfo;
+    }
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(m_device, &info, nullptr, &memory) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+
+    // CPU から見えるメモリは確保時にマップしたままにしておく.
+    //  (同じ VkDeviceMemory を複数回マップすることはできないため)
+    *mapped = nullptr;
+    const auto flags = m_memProps.memoryTypes[memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+    }
+    return memory;
+}
+
+vk::MemoryAllocation vk::DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& reqs, uint32_t memoryTypeIndex, bool isImage, bool useDeviceAddress)
+{
+    MemoryAllocation allocation{};
+    if (memoryTypeIndex >= m_memProps.memoryTypeCount) {
+        return allocation;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto blockSize = GetBlockSize(memoryTypeIndex);
+    const auto requestSize = GetSizeClass(reqs.size);
+
+    // ラージブロック: 専用に確保する.
+    if (requestSize > blockSize / 2) {
+        allocation.memory = AllocateDeviceMemory(reqs.size, memoryTypeIndex, useDeviceAddress, &allocation.mapped);
+        allocation.offset = 0;
+        allocation.size = reqs.size;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        if (allocation.memory) {
+            m_dedicated[memoryTypeIndex].count++;
+            m_dedicated[memoryTypeIndex].bytes += reqs.size;
+        }
+        return allocation;
+    }
+
+    auto poolIndex = GetPoolIndex(memoryTypeIndex, isImage);
+    if (poolIndex < 0) {
+        poolIndex = int32_t(m_pools.size());
+        m_pools.emplace_back();
+        m_pools.back().memoryTypeIndex = memoryTypeIndex;
+        m_pools.back().isImage = isImage;
+    }
+    auto& pool = m_pools[poolIndex];
+
+    // 既存ブロックから探す.
+    for (int32_t i = 0; i < int32_t(pool.blocks.size()); ++i) {
+        auto& block = pool.blocks[i];
+        if (!block) {
+            continue;
+        }
+        VkDeviceSize offset = 0;
+        if (block->range.Allocate(requestSize, reqs.alignment, offset)) {
+            block->allocationCount++;
+            allocation.memory = block->memory;
+            allocation.offset = offset;
+            allocation.size = requestSize;
+            allocation.mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+            allocation.memoryTypeIndex = memoryTypeIndex;
+            allocation.poolIndex = poolIndex;
+            allocation.blockIndex = i;
+            return allocation;
+        }
+    }
+
+    // 新しいブロックを確保する.
+    //  デバイスアドレスを使うバッファがあるので, バッファ用のブロックは常にフラグ付きで確保.
+    auto block = std::make_unique<Block>();
+    block->memory = AllocateDeviceMemory(blockSize, memoryTypeIndex, !isImage, &block->mapped);
+    if (block->memory == VK_NULL_HANDLE) {
+        return allocation;
+    }
+    block->range = MemoryBlockRange(blockSize);
+
+    VkDeviceSize offset = 0;
+    block->range.Allocate(requestSize, reqs.alignment, offset);
+    block->allocationCount++;
+
+    // 空いているスロットがあれば再利用.
+    int32_t blockIndex = -1;
+    for (int32_t i = 0; i < int32_t(pool.blocks.size()); ++i) {
+        if (!pool.blocks[i]) {
+            blockIndex = i;
+            break;
+        }
+    }
+    if (blockIndex < 0) {
+        blockIndex = int32_t(pool.blocks.size());
+        pool.blocks.emplace_back();
+    }
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = requestSize;
+    allocation.mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.poolIndex = poolIndex;
+    allocation.blockIndex = blockIndex;
+    pool.blocks[blockIndex] = std::move(block);
+    return allocation;
+}
+
+void vk::DeviceMemoryAllocator::Free(const MemoryAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (allocation.poolIndex < 0) {
+        // 専用確保分.
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+        auto& info = m_dedicated[allocation.memoryTypeIndex];
+        info.count--;
+        info.bytes -= allocation.size;
+        return;
+    }
+
+    auto& pool = m_pools[allocation.poolIndex];
+    auto& block = pool.blocks[allocation.blockIndex];
+    block->range.Free(allocation.offset, allocation.size);
+    block->allocationCount--;
+
+    // 空になったブロックは 1 つだけ残して解放する.
+    if (block->allocationCount == 0) {
+        auto emptyCount = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+            [](const auto& b) { return b && b->allocationCount == 0; });
+        if (emptyCount > 1) {
+            vkFreeMemory(m_device, block->memory, nullptr);
+            block.reset();
+        }
+    }
+}
+
+std::vector<vk::DeviceMemoryAllocator::HeapStatistics> vk::DeviceMemoryAllocator::GetStatistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<HeapStatistics> stats(m_memProps.memoryHeapCount);
+
+    for (const auto& pool : m_pools) {
+        auto& heap = stats[m_memProps.memoryTypes[pool.memoryTypeIndex].heapIndex];
+        for (const auto& block : pool.blocks) {
+            if (!block) {
+                continue;
+            }
+            heap.blockCount++;
+            heap.allocationCount += block->allocationCount;
+            heap.bytesReserved += block->range.GetSize();
+            heap.bytesInUse += block->range.GetUsedSize();
+            heap.bytesFree += block->range.GetSize() - block->range.GetUsedSize();
+            heap.largestFreeRange = (std::max)(heap.largestFreeRange, block->range.GetLargestFreeRange());
+        }
+    }
+    for (uint32_t i = 0; i < uint32_t(m_dedicated.size()); ++i) {
+        auto& heap = stats[m_memProps.memoryTypes[i].heapIndex];
+        heap.blockCount += m_dedicated[i].count;
+        heap.dedicatedCount += m_dedicated[i].count;
+        heap.allocationCount += m_dedicated[i].count;
+        heap.bytesReserved += m_dedicated[i].bytes;
+        heap.bytesInUse += m_dedicated[i].bytes;
+    }
+    for (auto& heap : stats) {
+        if (heap.bytesFree > 0) {
+            heap.fragmentation = 1.0f - float(heap.largestFreeRange) / float(heap.bytesFree);
+        }
+    }
+    return stats;
+}
+
+std::string vk::DeviceMemoryAllocator::DumpStatistics() const
+{
+    const auto stats = GetStatistics();
+    const double MB = 1024.0 * 1024.0;
+
+    std::ostringstream ss;
+    ss << "[DeviceMemoryAllocator]" << std::endl;
+    for (uint32_t i = 0; i < uint32_t(stats.size()); ++i) {
+        const auto& heap = stats[i];
+        if (heap.blockCount == 0) {
+            continue;
+        }
+        const bool isDeviceLocal = (m_memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        ss << " Heap" << i << (isDeviceLocal ? " (DeviceLocal)" : " (Host)")
+            << std::fixed << std::setprecision(2)
+            << " blocks: " << heap.blockCount << " (dedicated: " << heap.dedicatedCount << ")"
+            << " allocations: " << heap.allocationCount
+            << " reserved: " << heap.bytesReserved / MB << " MB"
+            << " in use: " << heap.bytesInUse / MB << " MB"
+            << " fragmentation: " << heap.fragmentation * 100.0f << " %"
+            << std::endl;
+    }
+    return ss.str();
+}
@@ -0,0 +1,164 @@
+﻿#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+# include <emmintrin.h>
+# define MIPGENERATOR_USE_SSE2
+#endif
+
+namespace {
+    const int KaiserTapCount = 6;
+
+    // 第 1 種変形ベッセル関数 I0 (Kaiser 窓の計算用).
+    double BesselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // 1/2 に縮小するときのフィルタ係数.
+    //  出力ピクセル i は入力ピクセル 2i-2 ~ 2i+3 を参照し, 中心は 2i+1 (ピクセル境界上)となる.
+    const float* GetKaiserWeights()
+    {
+        static const auto weights = []() {
+            const double alpha = 4.0, radius = KaiserTapCount / 2.0;
+            std::vector<float> w(KaiserTapCount);
+            double total = 0.0;
+            for (int i = 0; i < KaiserTapCount; ++i) {
+                double d = (i - 2) + 0.5 - 1.0;     // 出力中心からの距離(入力ピクセル単位).
+                double x = 3.14159265358979 * d * 0.5;
+                double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+                double r = d / radius;
+                double window = BesselI0(alpha * std::sqrt((std::max)(0.0, 1.0 - r * r))) / BesselI0(alpha);
+                w[i] = float(sinc * window);
+                total += w[i];
+            }
+            for (auto& v : w) {
+                v = float(v / total);
+            }
+            return w;
+        }();
+        return weights.data();
+    }
+
+    void DownsampleBoxRow(const uint8_t* row0, const uint8_t* row1, uint32_t srcWidth, uint8_t* dst, uint32_t dstWidth)
+    {
+        uint32_t x = 0;
+#if defined(MIPGENERATOR_USE_SSE2)
+        // 入力 4 ピクセルずつ(出力 2 ピクセル)をまとめて処理する.
+        if (srcWidth >= 2) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(2);
+            for (; x + 2 <= dstWidth; x += 2) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+                // 縦方向の和 (p0 p1 | p2 p3).
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                // 横方向の和 (p0+p1 | p2+p3).
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, zero));
+            }
+        }
+#endif
+        for (; x < dstWidth; ++x) {
+            const uint32_t x0 = (std::min)(x * 2, srcWidth - 1);
+            const uint32_t x1 = (std::min)(x * 2 + 1, srcWidth - 1);
+            for (int c = 0; c < 4; ++c) {
+                uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+                dst[x * 4 + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+
+    void DownsampleBox(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+    {
+        const uint32_t dstWidth = (std::max)(width / 2, 1u);
+        const uint32_t dstHeight = (std::max)(height / 2, 1u);
+        const size_t srcPitch = size_t(width) * 4;
+        for (uint32_t y = 0; y < dstHeight; ++y) {
+            const uint32_t y0 = (std::min)(y * 2, height - 1);
+            const uint32_t y1 = (std::min)(y * 2 + 1, height - 1);
+            DownsampleBoxRow(src + srcPitch * y0, src + srcPitch * y1, width, dst + size_t(dstWidth) * 4 * y, dstWidth);
+        }
+    }
+
+    void DownsampleKaiser(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+    {
+        const float* weights = GetKaiserWeights();
+        const uint32_t dstWidth = (std::max)(width / 2, 1u);
+        const uint32_t dstHeight = (std::max)(height / 2, 1u);
+
+        // 横方向を縮小してから縦方向を縮小する.
+        //  1 ピクセル幅(高さ)の場合はその方向には縮小しない.
+        std::vector<float> temp(size_t(dstWidth) * height * 4);
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint8_t* row = src + size_t(width) * 4 * y;
+            float* out = temp.data() + size_t(dstWidth) * 4 * y;
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                float sum[4] = {};
+                if (width == 1) {
+                    for (int c = 0; c < 4; ++c) { sum[c] = row[c]; }
+                } else {
+                    for (int t = 0; t < KaiserTapCount; ++t) {
+                        int sx = (std::min)((std::max)(int(x * 2) - 2 + t, 0), int(width) - 1);
+                        for (int c = 0; c < 4; ++c) { sum[c] += row[sx * 4 + c] * weights[t]; }
+                    }
+                }
+                memcpy(out + x * 4, sum, sizeof(sum));
+            }
+        }
+        for (uint32_t y = 0; y < dstHeight; ++y) {
+            uint8_t* out = dst + size_t(dstWidth) * 4 * y;
+            for (uint32_t x = 0; x < dstWidth * 4; ++x) {
+                float sum = 0.0f;
+                if (height == 1) {
+                    sum = temp[x];
+                } else {
+                    for (int t = 0; t < KaiserTapCount; ++t) {
+                        int sy = (std::min)((std::max)(int(y * 2) - 2 + t, 0), int(height) - 1);
+                        sum += temp[size_t(dstWidth) * 4 * sy + x] * weights[t];
+                    }
+                }
+                out[x] = uint8_t((std::min)((std::max)(sum + 0.5f, 0.0f), 255.0f));
+            }
+        }
+    }
+}
+
+namespace util {
+
+    void MipGenerator::Downsample(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst, Filter filter)
+    {
+        if (filter == Filter::Kaiser) {
+            DownsampleKaiser(src, width, height, dst);
+        } else {
+            DownsampleBox(src, width, height, dst);
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> MipGenerator::GenerateChain(const uint8_t* src, uint32_t width, uint32_t height, Filter filter)
+    {
+        std::vector<std::vector<uint8_t>> levels;
+        while (width > 1 || height > 1) {
+            const uint32_t dstWidth = (std::max)(width / 2, 1u);
+            const uint32_t dstHeight = (std::max)(height / 2, 1u);
+            std::vector<uint8_t> level(size_t(dstWidth) * dstHeight * 4);
+            Downsample(src, width, height, level.data(), filter);
+            levels.push_back(std::move(level));
+
+            src = levels.back().data();
+            width = dstWidth;
+            height = dstHeight;
+        }
+        return levels;
+    }
+}
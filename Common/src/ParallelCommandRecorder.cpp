@@ -0,0 +1,58 @@
+﻿#include "ParallelCommandRecorder.h"
+#include "CpuProfiler.h"
+#include "util/ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+uint32_t vk::ParallelCommandRecorder::GetThreadCount(std::unique_ptr<GraphicsDevice>& device) const
+{
+    auto threadCount = device->GetCommandRecordingThreadCount();
+    if (m_maxThreadCount > 0) {
+        threadCount = (std::min)(threadCount, m_maxThreadCount);
+    }
+    return threadCount;
+}
+
+void vk::ParallelCommandRecorder::Record(
+    std::unique_ptr<GraphicsDevice>& device,
+    GraphicsDevice::QueueType type,
+    VkCommandBuffer primary,
+    size_t count,
+    const RecordFunc& func) const
+{
+    CPU_PROFILE_SCOPE("ParallelCommandRecorder::Record");
+    if (count == 0) {
+        return;
+    }
+    auto threadCount = GetThreadCount(device);
+    if (threadCount <= 1) {
+        // 並列化しないときはセカンダリを経由する必要がない.
+        func(primary, 0, count);
+        return;
+    }
+
+    // 範囲のインデックスをそのままスレッド(プール)のインデックスに使う.
+    //  各範囲は 1 つのスレッドでしか処理されないので, プールが同時に使われることはない.
+    auto chunkCount = (std::min)(size_t(threadCount), count);
+    std::vector<VkCommandBuffer> commands(chunkCount);
+    util::ThreadPool::GetShared().ParallelFor(chunkCount, [&](size_t chunk) {
+        CPU_PROFILE_SCOPE("ParallelCommandRecorder::RecordChunk");
+        auto command = device->AllocateFrameCommandBuffer(type, uint32_t(chunk), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+        // レンダーパスの外で実行するので継承する情報は無い.
+        VkCommandBufferInheritanceInfo inheritanceInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        };
+        VkCommandBufferBeginInfo beginInfo{
+            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        vkBeginCommandBuffer(command, &beginInfo);
+        func(command, count * chunk / chunkCount, count * (chunk + 1) / chunkCount);
+        vkEndCommandBuffer(command);
+        commands[chunk] = command;
+    });
+    vkCmdExecuteCommands(primary, uint32_t(commands.size()), commands.data());
+}
@@ -0,0 +1,411 @@
+﻿#include "StagingRing.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        if (alignment <= 1) {
+            return value;
+        }
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool vk::StagingRing::Initialize(
+    VkDevice device, VkQueue queue, uint32_t queueFamilyIndex, TimelineSemaphore& timeline,
+    DeviceMemoryAllocator& allocator, const VkPhysicalDeviceMemoryProperties& memProps, VkDeviceSize size)
+{
+    m_device = device;
+    m_queue = queue;
+    m_timeline = &timeline;
+    m_allocator = &allocator;
+    m_queueFamilyIndex = queueFamilyIndex;
+    m_size = size;
+
+    VkBufferCreateInfo bufferCI{
+      VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      nullptr
+    };
+    bufferCI.size = size;
+    bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    if (vkCreateBuffer(m_device, &bufferCI, nullptr, &m_buffer) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(m_device, m_buffer, &reqs);
+
+    // CPU から書き込むので HOST_VISIBLE | HOST_COHERENT なメモリを選ぶ.
+    const VkMemoryPropertyFlags requestProps = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memoryTypeIndex = ~0u;
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
+        if ((reqs.memoryTypeBits & (1u << i)) == 0) {
+            continue;
+        }
+        if ((memProps.memoryTypes[i].propertyFlags & requestProps) == requestProps) {
+            memoryTypeIndex = i;
+            break;
+        }
+    }
+    if (memoryTypeIndex == ~0u) {
+        return false;
+    }
+    m_allocation = m_allocator->Allocate(reqs, memoryTypeIndex, false, false);
+    if (m_allocation.memory == VK_NULL_HANDLE || m_allocation.mapped == nullptr) {
+        return false;
+    }
+    vkBindBufferMemory(m_device, m_buffer, m_allocation.memory, m_allocation.offset);
+    m_mapped = static_cast<uint8_t*>(m_allocation.mapped);
+
+    // 転送用のコマンドはこのクラス専用のプールから確保する.
+    VkCommandPoolCreateInfo cmdPoolCI{
+      VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      nullptr,
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      queueFamilyIndex
+    };
+    return vkCreateCommandPool(m_device, &cmdPoolCI, nullptr, &m_commandPool) == VK_SUCCESS;
+}
+
+bool vk::StagingRing::SetOwnerQueue(VkQueue ownerQueue, uint32_t ownerQueueFamilyIndex, TimelineSemaphore& ownerTimeline)
+{
+    if (ownerQueueFamilyIndex == m_queueFamilyIndex) {
+        return true;
+    }
+    // 所有権の取得とその後の処理は所有キュー側のプールから確保したコマンドで行う.
+    VkCommandPoolCreateInfo cmdPoolCI{
+      VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      nullptr,
+      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+      ownerQueueFamilyIndex
+    };
+    if (vkCreateCommandPool(m_device, &cmdPoolCI, nullptr, &m_ownerCommandPool) != VK_SUCCESS) {
+        return false;
+    }
+    m_ownerQueue = ownerQueue;
+    m_ownerQueueFamilyIndex = ownerQueueFamilyIndex;
+    m_ownerTimeline = &ownerTimeline;
+    return true;
+}
+
+void vk::StagingRing::Destroy()
+{
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+    Flush();
+    Retire(true);
+
+    for (auto& batch : m_freeBatches) {
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &batch.command);
+        if (batch.ownerCommand) {
+            vkFreeCommandBuffers(m_device, m_ownerCommandPool, 1, &batch.ownerCommand);
+        }
+    }
+    m_freeBatches.clear();
+    if (m_commandPool) {
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+    if (m_ownerCommandPool) {
+        vkDestroyCommandPool(m_device, m_ownerCommandPool, nullptr);
+        m_ownerCommandPool = VK_NULL_HANDLE;
+    }
+    m_ownerQueue = VK_NULL_HANDLE;
+    m_ownerTimeline = nullptr;
+    if (m_buffer) {
+        vkDestroyBuffer(m_device, m_buffer, nullptr);
+        m_buffer = VK_NULL_HANDLE;
+    }
+    m_allocator->Free(m_allocation);
+    m_allocation = MemoryAllocation();
+    m_mapped = nullptr;
+    m_device = VK_NULL_HANDLE;
+}
+
+void vk::StagingRing::WriteBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    // リングを使い切らないよう, 大きなデータは分割する.
+    const auto chunkMax = m_size / 4;
+    auto src = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        auto chunkSize = (std::min)(size, chunkMax);
+        VkDeviceSize srcOffset = 0;
+        Write(src, chunkSize, 4, srcOffset);
+
+        VkBufferCopy region{};
+        region.srcOffset = srcOffset;
+        region.dstOffset = dstOffset;
+        region.size = chunkSize;
+        vkCmdCopyBuffer(GetCommandBuffer(), m_buffer, dst, 1, &region);
+
+        src += chunkSize;
+        dstOffset += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+bool vk::StagingRing::Write(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (size > m_size) {
+        return false;
+    }
+    while (!Allocate(size, alignment, offset)) {
+        // 空きが無いので, 積んである分を送信して古いものから完了を待つ.
+        Flush();
+        RetireOldest();
+    }
+    memcpy(m_mapped + offset, data, size);
+
+    // コマンドの記録を開始しておく.
+    GetCommandBuffer();
+    return true;
+}
+
+VkCommandBuffer vk::StagingRing::GetCommandBuffer()
+{
+    if (m_hasPending) {
+        return m_pending.command;
+    }
+    if (m_freeBatches.empty()) {
+        VkCommandBufferAllocateInfo commandAI{
+          VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+          nullptr, m_commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+          1
+        };
+        vkAllocateCommandBuffers(m_device, &commandAI, &m_pending.command);
+        if (HasOwnerQueue()) {
+            commandAI.commandPool = m_ownerCommandPool;
+            vkAllocateCommandBuffers(m_device, &commandAI, &m_pending.ownerCommand);
+        }
+    } else {
+        m_pending = m_freeBatches.back();
+        m_freeBatches.pop_back();
+        vkResetCommandBuffer(m_pending.command, 0);
+        if (m_pending.ownerCommand) {
+            vkResetCommandBuffer(m_pending.ownerCommand, 0);
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(m_pending.command, &beginInfo);
+    if (m_pending.ownerCommand) {
+        vkBeginCommandBuffer(m_pending.ownerCommand, &beginInfo);
+    }
+    m_pending.id = ++m_lastBatchId;
+    m_hasPending = true;
+    return m_pending.command;
+}
+
+VkCommandBuffer vk::StagingRing::GetOwnerCommandBuffer()
+{
+    auto command = GetCommandBuffer();
+    return HasOwnerQueue() ? m_pending.ownerCommand : command;
+}
+
+void vk::StagingRing::TransferOwnership(VkImage image, VkImageLayout layout, const VkImageSubresourceRange& range)
+{
+    if (!HasOwnerQueue()) {
+        return;
+    }
+    // 転送キューで解放(release)し, 所有キューで取得(acquire)する.
+    //  同じ内容のバリアを両方のキューで記録する必要がある.
+    VkImageMemoryBarrier imb{
+        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    };
+    imb.oldLayout = layout;
+    imb.newLayout = layout;
+    imb.srcQueueFamilyIndex = m_queueFamilyIndex;
+    imb.dstQueueFamilyIndex = m_ownerQueueFamilyIndex;
+    imb.image = image;
+    imb.subresourceRange = range;
+
+    imb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imb.dstAccessMask = 0;
+    vkCmdPipelineBarrier(
+        GetCommandBuffer(),
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &imb
+    );
+
+    imb.srcAccessMask = 0;
+    imb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        m_pending.ownerCommand,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &imb
+    );
+}
+
+uint64_t vk::StagingRing::Flush()
+{
+    if (!m_hasPending) {
+        return 0;
+    }
+    // 後続の(同じキューへ送信される)コマンドから転送結果が見えるようにしておく.
+    //  所有キューがある場合は, 転送の完了を待った後に所有キュー側で同じことを行う.
+    VkMemoryBarrier barrier{
+        VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+    };
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    if (!HasOwnerQueue()) {
+        vkCmdPipelineBarrier(
+            m_pending.command,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 1, &barrier,
+            0, nullptr,
+            0, nullptr
+        );
+    }
+    vkEndCommandBuffer(m_pending.command);
+
+    m_pending.timelineValue = m_timeline->Advance();
+    auto timelineSemaphore = m_timeline->GetSemaphore();
+    VkTimelineSemaphoreSubmitInfo timelineInfo{
+      VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+    };
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &m_pending.timelineValue;
+
+    VkSubmitInfo submitInfo{
+      VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      &timelineInfo,
+    };
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_pending.command;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timelineSemaphore;
+    vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
+
+    if (HasOwnerQueue()) {
+        // 所有キューでは転送の完了を待ってから, 所有権の取得と後続の処理を行う.
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            m_pending.ownerCommand,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 1, &barrier,
+            0, nullptr,
+            0, nullptr
+        );
+        vkEndCommandBuffer(m_pending.ownerCommand);
+
+        const auto transferValue = m_pending.timelineValue;
+        m_pending.timelineValue = m_ownerTimeline->Advance();
+        auto ownerSemaphore = m_ownerTimeline->GetSemaphore();
+        VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &transferValue;
+        timelineInfo.pSignalSemaphoreValues = &m_pending.timelineValue;
+
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &timelineSemaphore;
+        submitInfo.pWaitDstStageMask = &waitStageMask;
+        submitInfo.pCommandBuffers = &m_pending.ownerCommand;
+        submitInfo.pSignalSemaphores = &ownerSemaphore;
+        vkQueueSubmit(m_ownerQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    }
+    const auto timelineValue = m_pending.timelineValue;
+
+    m_pending.endOffset = m_head;
+    m_pending.size = m_pendingSize;
+    m_pendingSize = 0;
+    m_inFlight.push_back(m_pending);
+    m_pending = Batch();
+    m_hasPending = false;
+
+    // 完了しているものは回収しておく.
+    Retire(false);
+    return timelineValue;
+}
+
+void vk::StagingRing::Retire(bool waitAll)
+{
+    while (!m_inFlight.empty()) {
+        if (!waitAll && !GetCompletionTimeline()->IsCompleted(m_inFlight.front().timelineValue)) {
+            break;
+        }
+        RetireOldest();
+    }
+}
+
+void vk::StagingRing::WaitBatch(uint64_t batch)
+{
+    if (batch == 0) {
+        return;
+    }
+    if (m_hasPending && m_pending.id <= batch) {
+        Flush();
+    }
+    // 古いものから順に完了するので, 指定より後のバッチは待たない.
+    while (!m_inFlight.empty() && m_inFlight.front().id <= batch) {
+        RetireOldest();
+    }
+}
+
+void vk::StagingRing::RetireOldest()
+{
+    if (m_inFlight.empty()) {
+        return;
+    }
+    auto batch = m_inFlight.front();
+    m_inFlight.pop_front();
+    GetCompletionTimeline()->Wait(batch.timelineValue);
+
+    // 領域を使っていないバッチは末尾を動かさない.
+    //  (先頭に戻した後に完了した場合, endOffset は古い位置を指しているため)
+    if (batch.size > 0) {
+        m_tail = batch.endOffset;
+        m_usedSize -= batch.size;
+    }
+    m_freeBatches.push_back(batch);
+    if (IsEmpty()) {
+        m_head = m_tail = 0;
+    }
+}
+
+bool vk::StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (IsEmpty()) {
+        m_head = m_tail = 0;
+    } else if (m_head == m_tail) {
+        // 全領域が使用中.
+        return false;
+    }
+
+    auto aligned = AlignUp(m_head, alignment);
+    if (m_head >= m_tail) {
+        // 空き領域は [m_head, m_size) と [0, m_tail).
+        if (aligned + size <= m_size) {
+            offset = aligned;
+        } else if (size <= m_tail || (IsEmpty() && size <= m_size)) {
+            offset = 0;
+        } else {
+            return false;
+        }
+    } else if (aligned + size <= m_tail) {
+        // 空き領域は [m_head, m_tail).
+        offset = aligned;
+    } else {
+        return false;
+    }
+    m_head = offset + size;
+    m_usedSize += size;
+    m_pendingSize += size;
+    return true;
+}
@@ -0,0 +1,65 @@
+﻿#include "TimelineSemaphore.h"
+
+#include <algorithm>
+
+bool vk::TimelineSemaphore::Initialize(VkDevice device)
+{
+    m_device = device;
+    m_lastSignaledValue = 0;
+    m_completedValue = 0;
+
+    VkSemaphoreTypeCreateInfo typeCI{
+      VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      nullptr,
+      VK_SEMAPHORE_TYPE_TIMELINE,
+      0, // initialValue
+    };
+    VkSemaphoreCreateInfo semCI{
+      VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+      &typeCI, 0,
+    };
+    return vkCreateSemaphore(m_device, &semCI, nullptr, &m_semaphore) == VK_SUCCESS;
+}
+
+void vk::TimelineSemaphore::Destroy()
+{
+    if (m_semaphore) {
+        vkDestroySemaphore(m_device, m_semaphore, nullptr);
+        m_semaphore = VK_NULL_HANDLE;
+    }
+    m_device = VK_NULL_HANDLE;
+}
+
+uint64_t vk::TimelineSemaphore::GetCompletedValue() const
+{
+    if (m_completedValue < m_lastSignaledValue) {
+        uint64_t value = 0;
+        if (vkGetSemaphoreCounterValue(m_device, m_semaphore, &value) == VK_SUCCESS) {
+            m_completedValue = value;
+        }
+    }
+    return m_completedValue;
+}
+
+bool vk::TimelineSemaphore::IsCompleted(uint64_t value) const
+{
+    if (value <= m_completedValue) {
+        return true;
+    }
+    return value <= GetCompletedValue();
+}
+
+void vk::TimelineSemaphore::Wait(uint64_t value, uint64_t timeout) const
+{
+    if (IsCompleted(value)) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo{
+      VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+      nullptr, 0,
+      1, &m_semaphore, &value
+    };
+    if (vkWaitSemaphores(m_device, &waitInfo, timeout) == VK_SUCCESS) {
+        m_completedValue = (std::max)(m_completedValue, value);
+    }
+}
@@ -3,6 +3,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <fstream>
+#include <cstring>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
@@ -64,6 +65,99 @@ std::wstring util::ConvertFromUTF8(const std::string& s)
     return std::wstring(buf.data());
 }
 
+// ------------------------------------------
+// Hash
+// ------------------------------------------
+
+uint64_t util::ComputeHash(const void* data, size_t size, uint64_t seed)
+{
+    // FNV-1a
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    auto p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= prime;
+    }
+    return hash;
+}
+
+namespace {
+    const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ull;
+    const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ull;
+    const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+    uint64_t RotateLeft(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+    uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+    uint64_t XxhRound(uint64_t acc, uint64_t input)
+    {
+        acc += input * XXH_PRIME64_2;
+        acc = RotateLeft(acc, 31);
+        return acc * XXH_PRIME64_1;
+    }
+    uint64_t XxhMergeRound(uint64_t acc, uint64_t val)
+    {
+        acc ^= XxhRound(0, val);
+        return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+}
+
+uint64_t util::ComputeContentHash(const void* data, size_t size, uint64_t seed)
+{
+    // xxHash64 (gGfBAO).
+    auto p = static_cast<const uint8_t*>(data);
+    const auto end = p + size;
+    uint64_t hash;
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        const auto limit = end - 32;
+        do {
+            v1 = XxhRound(v1, Read64(p));
+            v2 = XxhRound(v2, Read64(p + 8));
+            v3 = XxhRound(v3, Read64(p + 16));
+            v4 = XxhRound(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = XxhMergeRound(hash, v1);
+        hash = XxhMergeRound(hash, v2);
+        hash = XxhMergeRound(hash, v3);
+        hash = XxhMergeRound(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME64_5;
+    }
+    hash += uint64_t(size);
+
+    while (end - p >= 8) {
+        hash ^= XxhRound(0, Read64(p));
+        hash = RotateLeft(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        hash ^= uint64_t(Read32(p)) * XXH_PRIME64_1;
+        hash = RotateLeft(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (*p) * XXH_PRIME64_5;
+        hash = RotateLeft(hash, 11) * XXH_PRIME64_1;
+        ++p;
+    }
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
 // ------------------------------------------
 // Helper Function
 // ------------------------------------------
@@ -128,8 +222,9 @@ bool util::DynamicBuffer::Initialize(Device& device, size_t requestSize, VkBuffe
         bufferAlignment = device->GetStorageBufferAlignment();
     }
     m_blockSize = (requestSize + bufferAlignment - 1) & ~(bufferAlignment - 1);
-    const auto backBufferCount = device->GetBackBufferCount();
-    auto bufferSizeWhole = backBufferCount * m_blockSize;
+    // CPU ރt[ GPU ǂݍރt[dȂȂ悤, st[m.
+    const auto framesInFlight = device->GetFramesInFlight();
+    auto bufferSizeWhole = framesInFlight * m_blockSize;
 
     m_buffer = device->CreateBuffer(
         bufferSizeWhole, usage, memProps);
@@ -1,8 +1,11 @@
 #include "util/VkrModel.h"
 #include "scene/ModelMesh.h"
+#include "util/TextureLoader.h"
+#include "CpuProfiler.h"
 #include <glm/gtx/transform.hpp>
 
 #include <sstream>
+#include <unordered_set>
 
 #if _DEBUG
 #define WIN32_LEAN_AND_MEAN
@@ -86,6 +89,7 @@ void ModelMesh::Create(VkGraphicsDevice& device, const CreateInfo& createInfo, M
     }
 
     m_isSkinned = model->IsSkinned();
+    m_contentHash = model->GetContentHash();
 
     m_positionBuffer = model->GetPositionBuffer();
     m_normalBuffer = model->GetNormalBuffer();
@@ -102,6 +106,9 @@ void ModelMesh::Create(VkGraphicsDevice& device, const CreateInfo& createInfo, M
         m_jointIndicesBuffer = model->GetJointIndicesBuffer();
 
         // XLjOfł́Aό`̃obt@`Ŏg.
+        //  ό`̃obt@ BLAS ͏̃t[ƋȂ悤t[Ƃɗpӂ.
+        m_frameCount = int(device->GetFramesInFlight());
+        m_frameBlas.resize(m_frameCount - 1);
         m_skinVertexCount = model->GetSkinnedVertexCount();
         auto bufferSize = sizeof(glm::vec3) * m_skinVertexCount;
         AllocateTransformedBuffer(device, bufferSize);
@@ -179,6 +186,10 @@ void ModelMesh::Create(VkGraphicsDevice& device, const CreateInfo& createInfo, M
 void ModelMesh::Destroy(std::unique_ptr<vk::GraphicsDevice>& device)
 {
     m_blas.Destroy(device);
+    for (auto& blas : m_frameBlas) {
+        blas.Destroy(device);
+    }
+    m_frameBlas.clear();
     m_blasTransformMatrices.Destroy(device);
     m_jointMatricesBuffer.Destroy(device);
     
@@ -189,13 +200,48 @@ void ModelMesh::Destroy(std::unique_ptr<vk::GraphicsDevice>& device)
 }
 
 void ModelMesh::BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructureFlagsKHR buildFlags)
+{
+    for (int frame = 0; frame < m_frameCount; ++frame) {
+        AccelerationStructure::Input blasInput;
+        blasInput.asGeometry = GetAccelerationStructureGeometry(frame);
+        blasInput.asBuildRangeInfo = GetAccelerationStructureBuildRangeInfo();
+
+        auto& blas = GetFrameBlas(frame);
+        blas.BuildAS(device, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasInput, buildFlags);
+        blas.DestroyScratchBuffer(device);
+    }
+
+    m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
+    m_blasBuildFlags = buildFlags;
+}
+
+void ModelMesh::BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags)
 {
     AccelerationStructure::Input blasInput;
     blasInput.asGeometry = GetAccelerationStructureGeometry();
     blasInput.asBuildRangeInfo = GetAccelerationStructureBuildRangeInfo();
 
-    m_blas.BuildAS(device, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasInput, buildFlags);
-    m_blas.DestroyScratchBuffer(device);
+    // LbṼL[̓f̓eƍ\zɎgs񂩂狁߂.
+    //  XLjOf͕ό`̒_\ẑŃLbVȂ.
+    uint64_t cacheKey = 0;
+    if (!IsSkinned()) {
+        cacheKey = m_contentHash;
+        auto matrixSize = sizeof(glm::mat3x4) * m_blasNodes.size();
+        cacheKey = util::ComputeHash(m_blasTransformMatrices.Map(0), matrixSize, cacheKey);
+        for (const auto& range : blasInput.asBuildRangeInfo) {
+            cacheKey = util::ComputeHash(&range.primitiveCount, sizeof(range.primitiveCount), cacheKey);
+        }
+    }
+    builder.Add(device, m_blas, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasInput, buildFlags, cacheKey);
+
+    // t[Ƃ BLAS (XLjOf̂).
+    //  builder  BLAS QƂŕێ̂, m_frameBlas ͂ȍ~ōĊmۂȂ.
+    for (int frame = 1; frame < m_frameCount; ++frame) {
+        AccelerationStructure::Input frameInput;
+        frameInput.asGeometry = GetAccelerationStructureGeometry(frame);
+        frameInput.asBuildRangeInfo = blasInput.asBuildRangeInfo;
+        builder.Add(device, GetFrameBlas(frame), VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, frameInput, buildFlags, 0);
+    }
 
     m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
     m_blasBuildFlags = buildFlags;
@@ -204,6 +250,7 @@ void ModelMesh::BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructureFl
 std::vector<VkAccelerationStructureGeometryKHR> ModelMesh::GetAccelerationStructureGeometry(int frameIndex)
 {
     std::vector<VkAccelerationStructureGeometryKHR> asGeometries;
+    const auto frameOffset = IsSkinned() ? GetTransformedFrameOffset(frameIndex) : 0;
 
     for (const auto& mesh : m_meshes) {
         VkAccelerationStructureGeometryKHR asGeometry{
@@ -216,7 +263,7 @@ std::vector<VkAccelerationStructureGeometryKHR> ModelMesh::GetAccelerationStruct
         triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
         triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
         triangles.vertexStride = sizeof(glm::vec3);
-        triangles.vertexData.deviceAddress = mesh.GetPositionOffseted();
+        triangles.vertexData.deviceAddress = mesh.GetPositionOffseted() + frameOffset;
         triangles.maxVertex = mesh.GetVertexCount();
 
         triangles.indexType = VK_INDEX_TYPE_UINT32;
@@ -244,19 +291,20 @@ std::vector<VkAccelerationStructureBuildRangeInfoKHR> ModelMesh::GetAcceleration
     return asBuildRanges;
 }
 
-std::vector<SceneObject::SceneObjectParameter> ModelMesh::GetSceneObjectParameters()
+std::vector<SceneObject::SceneObjectParameter> ModelMesh::GetSceneObjectParameters(int frameIndex)
 {
     std::vector<SceneObjectParameter> params;
+    const auto frameOffset = IsSkinned() ? GetTransformedFrameOffset(frameIndex) : 0;
 
     for (const auto& m : m_meshes) {
         SceneObjectParameter objParam{};
         objParam.blasMatrixIndex = m.GetBlasMatrixIndex();
         objParam.materialIndex = m.GetMaterialIndex();
-        objParam.vertexPosition = m.GetPositionOffseted();
-        objParam.vertexNormal = m.GetNormalOffseted();
+        objParam.vertexPosition = m.GetPositionOffseted() + frameOffset;
+        objParam.vertexNormal = m.GetNormalOffseted() + frameOffset;
         objParam.vertexTexcoord = m.GetTexcoordOffseted();
         objParam.indexBuffer = m.GetIndexOffseted();
-        objParam.blasTransformMatrices = m_blasTransformMatrices.GetDeviceAddress(0);
+        objParam.blasTransformMatrices = m_blasTransformMatrices.GetDeviceAddress(frameIndex);
         objParam.blasMatrixStride = GetSubMeshCount() * sizeof(glm::mat3x4);
 
         params.emplace_back(objParam);
@@ -266,6 +314,7 @@ std::vector<SceneObject::SceneObjectParameter> ModelMesh::GetSceneObjectParamete
 
 void ModelMesh::UpdateMatrices()
 {
+    CPU_PROFILE_SCOPE("ModelMesh::UpdateMatrices");
     for (auto& node : m_nodes) {
         node->UpdateMatrices(m_transform);
     }
@@ -273,6 +322,7 @@ void ModelMesh::UpdateMatrices()
 
 void ModelMesh::ApplyTransform(VkGraphicsDevice& device)
 {
+    CPU_PROFILE_SCOPE("ModelMesh::ApplyTransform");
     auto frameIndex = device->GetCurrentFrameIndex();
     if (IsSkinned()) {
         const auto jointCount = m_skinJoints.size();
@@ -310,13 +360,35 @@ void ModelMesh::ApplyTransform(VkGraphicsDevice& device)
     memcpy(dst, blasMatices.data(), size);
 }
 
-void ModelMesh::UpdateBlas(VkCommandBuffer command)
+void ModelMesh::UpdateBlas(VkCommandBuffer command, int frameIndex)
 {
+    // s ApplyTransform ŏ񂾃t[̗̈QƂ.
     AccelerationStructure::Input blasInput;
-    blasInput.asGeometry = GetAccelerationStructureGeometry();
+    blasInput.asGeometry = GetAccelerationStructureGeometry(frameIndex);
     blasInput.asBuildRangeInfo = GetAccelerationStructureBuildRangeInfo();
 
-    m_blas.Update(command, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasInput, m_blasBuildFlags);
+    auto& blas = GetFrameBlas(frameIndex % m_frameCount);
+    blas.Update(command, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, blasInput, m_blasBuildFlags);
+}
+
+VkAccelerationStructureInstanceKHR ModelMesh::GetAccelerationStructureInstance(int frameIndex) const
+{
+    // t[Ƃ BLAS , ɑΉqbgVF[_[̃R[hQƂ.
+    auto instance = SceneObject::GetAccelerationStructureInstance(frameIndex);
+    auto frame = frameIndex % m_frameCount;
+    instance.accelerationStructureReference = GetFrameBlas(frame).GetDeviceAddress();
+    instance.instanceShaderBindingTableRecordOffset += uint32_t(frame * m_meshes.size());
+    return instance;
+}
+
+AccelerationStructure& ModelMesh::GetFrameBlas(int frameIndex)
+{
+    return frameIndex == 0 ? m_blas : m_frameBlas[frameIndex - 1];
+}
+
+const AccelerationStructure& ModelMesh::GetFrameBlas(int frameIndex) const
+{
+    return frameIndex == 0 ? m_blas : m_frameBlas[frameIndex - 1];
 }
 
 std::shared_ptr<ModelMesh::ModelNode> ModelMesh::SearchNode(const std::wstring& name) const
@@ -406,20 +478,47 @@ void ModelMesh::CreateTextures(VkGraphicsDevice& device, const std::vector<util:
     auto usage = VK_IMAGE_USAGE_SAMPLED_BIT;
     auto memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    for (auto img : images) {
-        auto id = materialManager.GetTexture(img.fileName);
-        if (id < 0) {
-            auto texture = device->CreateTexture2DFromMemory(
-                img.imageBuffer.data(), img.imageBuffer.size(), usage, memProps
-            );
-            // }l[W[ɓo^.
-            materialManager.AddTexture(img.fileName, texture);
+    // 摜̖O͋d邽, fR[hÕf[^̓eœo^ς݂𔻒肷.
+    //  o^̉摜W߂, ܂Ƃ߂ăfR[hE].
+    m_imageTextures.assign(images.size(), -1);
+    std::vector<uint64_t> contentHashes(images.size());
+    std::vector<size_t> targets;
+    std::vector<util::TextureLoader::Source> sources;
+    std::unordered_set<uint64_t> pendingHashes;
+    for (size_t i = 0; i < images.size(); ++i) {
+        const auto& img = images[i];
+        if (img.imageData == nullptr) {
+            continue;
+        }
+        contentHashes[i] = util::ComputeContentHash(img.imageData, img.imageSize);
+        m_imageTextures[i] = materialManager.ShareTexture(img.fileName, contentHashes[i], img.imageSize);
+        if (m_imageTextures[i] < 0 && pendingHashes.insert(contentHashes[i]).second) {
+            targets.push_back(i);
+            sources.push_back({ img.imageData, img.imageSize });
+        }
+    }
+    auto textures = util::TextureLoader::CreateTextures(device, sources, usage, memProps);
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (textures[i].GetImage() == VK_NULL_HANDLE) {
+            continue;
+        }
+        // }l[W[ɓo^.
+        const auto& img = images[targets[i]];
+        m_imageTextures[targets[i]] = materialManager.AddTexture(
+            img.fileName, textures[i], contentHashes[targets[i]], img.imageSize);
 
 #if _DEBUG
-            std::wostringstream ss;
-            ss << L"Load Texture file (in model): " << img.fileName << std::endl;
-            OutputDebugStringW(ss.str().c_str());
+        std::wostringstream ss;
+        ss << L"Load Texture file (in model): " << img.fileName << std::endl;
+        OutputDebugStringW(ss.str().c_str());
 #endif
+    }
+
+    // ̃fœedĂ摜, o^̂L.
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (m_imageTextures[i] < 0 && images[i].imageData != nullptr) {
+            m_imageTextures[i] = materialManager.ShareTexture(images[i].fileName, contentHashes[i], images[i].imageSize);
         }
     }
 }
@@ -427,7 +526,6 @@ void ModelMesh::CreateTextures(VkGraphicsDevice& device, const std::vector<util:
 void ModelMesh::CreateMaterials(const util::VkrModel* model, MaterialManager& materialManager)
 {
     const auto modelTextures = model->GetTextures();
-    const auto modelImages = model->GetImages();
     for (auto& m : model->GetMaterials()) {
         m_materials.emplace_back(std::make_shared<Material>(m.GetName().c_str()));
         auto& material = m_materials.back();
@@ -437,14 +535,11 @@ void ModelMesh::CreateMaterials(const util::VkrModel* model, MaterialManager& ma
         material->SetSpecularPower(50.0f);          // XyLp[͌Œ.
         material->SetType(1);   // Phong ẅӖ.
 
-        // eNX`̖O}l[W[ɓo^ς݂̃CfbNX擾.
+        // 摜ƂɃ}l[W[֓o^CfbNXg.
         auto textureIndex = m.GetTextureIndex();
         if (textureIndex >= 0) {
             auto ti = modelTextures[textureIndex];
-            auto imageInfo = modelImages[ti.imageIndex];
-
-            auto indexRegistered= materialManager.GetTexture(imageInfo.fileName);
-            material->SetTexture(indexRegistered);
+            material->SetTexture(m_imageTextures[ti.imageIndex]);
         }
     }
 }
@@ -461,11 +556,17 @@ void ModelMesh::AllocateBlasTransformMatrices(VkGraphicsDevice& device, const ut
 
 void ModelMesh::AllocateTransformedBuffer(VkGraphicsDevice& device, uint64_t size)
 {
+    // t[Ƃ̗̈̓fBXNv^̃ItZbgƂĎg悤ACg𑵂.
+    auto alignment = device->GetStorageBufferAlignment();
+    m_transformedSize = size;
+    m_transformedStride = (size + alignment - 1) / alignment * alignment;
+
     auto memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
         VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
         VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    m_positionTransformed = device->CreateBuffer(size, usage, memProps);
-    m_normalTransformed = device->CreateBuffer(size, usage, memProps);
+    auto bufferSize = m_transformedStride * m_frameCount;
+    m_positionTransformed = device->CreateBuffer(bufferSize, usage, memProps);
+    m_normalTransformed = device->CreateBuffer(bufferSize, usage, memProps);
 }
 
@@ -39,6 +39,23 @@ void ProcedualMesh::BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStructu
     m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
 }
 
+void ProcedualMesh::BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags)
+{
+    auto asGeometry = GetAccelerationStructureGeometry();
+    auto asBuildRangeInfo = GetAccelerationStructureBuildRangeInfo();
+
+    AccelerationStructure::Input blasInput;
+    blasInput.asGeometry = { asGeometry };
+    blasInput.asBuildRangeInfo = { asBuildRangeInfo };
+
+    builder.Add(device, m_blas,
+        VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+        blasInput,
+        buildFlags);
+
+    m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
+}
+
 std::vector<VkAccelerationStructureGeometryKHR> ProcedualMesh::GetAccelerationStructureGeometry(int frameIndex)
 {
     VkAccelerationStructureGeometryKHR asGeometry{
@@ -65,7 +82,7 @@ std::vector<VkAccelerationStructureBuildRangeInfoKHR> ProcedualMesh::GetAccelera
     return { asBuildRangeInfo };
 }
 
-std::vector<SceneObject::SceneObjectParameter> ProcedualMesh::GetSceneObjectParameters()
+std::vector<SceneObject::SceneObjectParameter> ProcedualMesh::GetSceneObjectParameters(int frameIndex)
 {
     SceneObjectParameter objParam{};
 
@@ -29,7 +29,10 @@ void SceneObject::SetGeometryInstanceFlags(VkGeometryInstanceFlagsKHR flags)
     m_asInstance.flags = flags;
 }
 
-VkAccelerationStructureInstanceKHR SceneObject::GetAccelerationStructureInstance() const
+VkAccelerationStructureInstanceKHR SceneObject::GetAccelerationStructureInstance(int frameIndex) const
 {
-    return m_asInstance;
+    // RpNV BLAS u邱Ƃ̂, QƂ͖擾.
+    auto instance = m_asInstance;
+    instance.accelerationStructureReference = m_blas.GetDeviceAddress();
+    return instance;
 }
@@ -44,6 +44,20 @@ void SimplePolygonMesh::BuildAS(VkGraphicsDevice& device, VkBuildAccelerationStr
     m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
 }
 
+void SimplePolygonMesh::BuildAS(VkGraphicsDevice& device, AccelerationStructureBuilder& builder, VkBuildAccelerationStructureFlagsKHR buildFlags)
+{
+    AccelerationStructure::Input blasInput;
+    blasInput.asGeometry = GetAccelerationStructureGeometry();
+    blasInput.asBuildRangeInfo = GetAccelerationStructureBuildRangeInfo();
+
+    builder.Add(device, m_blas,
+        VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+        blasInput,
+        buildFlags);
+
+    m_asInstance.accelerationStructureReference = m_blas.GetDeviceAddress();
+}
+
 std::vector<VkAccelerationStructureGeometryKHR> SimplePolygonMesh::GetAccelerationStructureGeometry(int frameIndex)
 {
     VkAccelerationStructureGeometryKHR asGeometry{
@@ -73,7 +87,7 @@ std::vector<VkAccelerationStructureBuildRangeInfoKHR> SimplePolygonMesh::GetAcce
     return { asBuildRangeInfo };
 }
 
-std::vector<SceneObject::SceneObjectParameter> SimplePolygonMesh::GetSceneObjectParameters()
+std::vector<SceneObject::SceneObjectParameter> SimplePolygonMesh::GetSceneObjectParameters(int frameIndex)
 {
     SceneObjectParameter objParam{};
 
@@ -0,0 +1,410 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "util/GlbDocument.h"
+
+#include <algorithm>
+#include <cstring>
+
+// tinygltf に同梱されている JSON パーサを使用する.
+#include "json.hpp"
+
+namespace util {
+    namespace {
+        using json = nlohmann::json;
+
+        const uint32_t GlbMagic = 0x46546C67;       // "glTF"
+        const uint32_t GlbVersion = 2;
+        const uint32_t ChunkTypeJson = 0x4E4F534A;  // "JSON"
+        const uint32_t ChunkTypeBin = 0x004E4942;   // "BIN\0"
+
+        template<class T>
+        T GetValue(const json& obj, const char* key, T defaultValue)
+        {
+            auto it = obj.find(key);
+            if (it == obj.end() || it->is_null()) {
+                return defaultValue;
+            }
+            return it->get<T>();
+        }
+
+        int GetTextureIndex(const json& obj, const char* key)
+        {
+            auto it = obj.find(key);
+            if (it == obj.end() || !it->is_object()) {
+                return -1;
+            }
+            return GetValue(*it, "index", -1);
+        }
+
+        // glTF の仕様に従った正規化整数から float への変換.
+        inline float Normalize(int8_t v) { return (std::max)(v / 127.0f, -1.0f); }
+        inline float Normalize(uint8_t v) { return v / 255.0f; }
+        inline float Normalize(int16_t v) { return (std::max)(v / 32767.0f, -1.0f); }
+        inline float Normalize(uint16_t v) { return v / 65535.0f; }
+
+        // 型ごとにループを分けておき, 要素単位の分岐を無くす.
+        template<class T, bool normalized>
+        void ConvertToFloat(const uint8_t* src, uint32_t stride, size_t count, uint32_t componentCount, float* dst)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                const auto* element = src + size_t(stride) * i;
+                for (uint32_t c = 0; c < componentCount; ++c) {
+                    T v;
+                    memcpy(&v, element + sizeof(T) * c, sizeof(T));
+                    if constexpr (normalized) {
+                        dst[c] = Normalize(v);
+                    } else {
+                        dst[c] = float(v);
+                    }
+                }
+                dst += componentCount;
+            }
+        }
+
+        template<class T>
+        void ConvertToUInt(const uint8_t* src, uint32_t stride, size_t count, uint32_t componentCount, uint32_t* dst)
+        {
+            for (size_t i = 0; i < count; ++i) {
+                const auto* element = src + size_t(stride) * i;
+                for (uint32_t c = 0; c < componentCount; ++c) {
+                    T v;
+                    memcpy(&v, element + sizeof(T) * c, sizeof(T));
+                    dst[c] = uint32_t(v);
+                }
+                dst += componentCount;
+            }
+        }
+
+        // 要素がビューの先頭から詰まっている場合はまとめてコピーする.
+        template<class T>
+        bool CopyPacked(const uint8_t* src, uint32_t stride, size_t count, uint32_t componentCount, T* dst)
+        {
+            if (stride != sizeof(T) * componentCount) {
+                return false;
+            }
+            memcpy(dst, src, sizeof(T) * componentCount * count);
+            return true;
+        }
+
+        uint32_t GetComponentCount(const std::string& type)
+        {
+            if (type == "SCALAR") { return 1; }
+            if (type == "VEC2") { return 2; }
+            if (type == "VEC3") { return 3; }
+            if (type == "VEC4") { return 4; }
+            if (type == "MAT2") { return 4; }
+            if (type == "MAT3") { return 9; }
+            if (type == "MAT4") { return 16; }
+            return 0;
+        }
+    }
+
+    bool GlbDocument::Open(const std::wstring& fileName)
+    {
+        Close();
+        auto file = std::make_shared<MappedFile>();
+        if (!file->Open(fileName) || !OpenFromMemory(file->GetData(), file->GetSize())) {
+            return false;
+        }
+        m_file = file;
+        return true;
+    }
+
+    bool GlbDocument::OpenFromMemory(const uint8_t* data, uint64_t fileSize)
+    {
+        Close();
+
+        // ヘッダ: magic, version, length.
+        uint32_t header[3] = { 0 };
+        if (fileSize < sizeof(header)) {
+            return false;
+        }
+        memcpy(header, data, sizeof(header));
+        if (header[0] != GlbMagic || header[1] != GlbVersion || header[2] > fileSize) {
+            OutputDebugStringA("GlbDocument: invalid glb header.\n");
+            return false;
+        }
+
+        // チャンク: length, type, data(4 バイト境界).
+        const char* jsonChunk = nullptr;
+        size_t jsonLength = 0;
+        uint64_t offset = sizeof(header);
+        const uint64_t totalLength = header[2];
+        while (offset + sizeof(uint32_t) * 2 <= totalLength) {
+            uint32_t chunk[2] = { 0 };
+            memcpy(chunk, data + offset, sizeof(chunk));
+            offset += sizeof(chunk);
+            if (chunk[0] > totalLength - offset) {
+                return false;
+            }
+            if (chunk[1] == ChunkTypeJson && jsonChunk == nullptr) {
+                jsonChunk = reinterpret_cast<const char*>(data + offset);
+                jsonLength = chunk[0];
+            } else if (chunk[1] == ChunkTypeBin && m_binChunk.data == nullptr) {
+                m_binChunk.data = data + offset;
+                m_binChunk.size = chunk[0];
+            }
+            offset += (uint64_t(chunk[0]) + 3) & ~3ull;
+        }
+        if (jsonChunk == nullptr || !Parse(jsonChunk, jsonLength)) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void GlbDocument::Close()
+    {
+        accessors.clear();
+        bufferViews.clear();
+        meshes.clear();
+        nodes.clear();
+        skins.clear();
+        materials.clear();
+        textures.clear();
+        images.clear();
+        scenes.clear();
+        defaultScene = 0;
+        extensionsRequired.clear();
+        m_bufferIsEmbedded.clear();
+        m_binChunk = Span();
+        m_file.reset();
+    }
+
+    bool GlbDocument::Parse(const char* jsonText, size_t length)
+    {
+        json root;
+        try {
+            root = json::parse(jsonText, jsonText + length);
+        } catch (const json::exception& e) {
+            OutputDebugStringA(e.what());
+            return false;
+        }
+
+        try {
+            for (const auto& item : root.value("buffers", json::array())) {
+                // GLB では uri を持たない先頭のバッファが BIN チャンクとなる.
+                m_bufferIsEmbedded.push_back(item.find("uri") == item.end());
+            }
+            for (const auto& item : root.value("bufferViews", json::array())) {
+                BufferView view;
+                view.buffer = GetValue(item, "buffer", 0);
+                view.byteOffset = GetValue<uint64_t>(item, "byteOffset", 0);
+                view.byteLength = GetValue<uint64_t>(item, "byteLength", 0);
+                view.byteStride = GetValue<uint32_t>(item, "byteStride", 0);
+                bufferViews.push_back(view);
+            }
+            for (const auto& item : root.value("accessors", json::array())) {
+                Accessor accessor;
+                accessor.bufferView = GetValue(item, "bufferView", -1);
+                accessor.byteOffset = GetValue<uint64_t>(item, "byteOffset", 0);
+                accessor.componentType = GetValue(item, "componentType", 0);
+                accessor.normalized = GetValue(item, "normalized", false);
+                accessor.count = GetValue<uint64_t>(item, "count", 0);
+                accessor.componentCount = GetComponentCount(GetValue<std::string>(item, "type", ""));
+                accessors.push_back(accessor);
+            }
+            for (const auto& item : root.value("meshes", json::array())) {
+                Mesh mesh;
+                mesh.name = GetValue<std::string>(item, "name", "");
+                for (const auto& inPrimitive : item.value("primitives", json::array())) {
+                    Primitive primitive;
+                    const auto attributes = inPrimitive.value("attributes", json::object());
+                    for (const auto& attr : attributes.items()) {
+                        primitive.attributes[attr.key()] = attr.value().get<int>();
+                    }
+                    primitive.indices = GetValue(inPrimitive, "indices", -1);
+                    primitive.material = GetValue(inPrimitive, "material", -1);
+                    mesh.primitives.push_back(primitive);
+                }
+                meshes.push_back(mesh);
+            }
+            for (const auto& item : root.value("nodes", json::array())) {
+                Node node;
+                node.name = GetValue<std::string>(item, "name", "");
+                node.translation = GetValue(item, "translation", std::vector<double>());
+                node.rotation = GetValue(item, "rotation", std::vector<double>());
+                node.scale = GetValue(item, "scale", std::vector<double>());
+                node.children = GetValue(item, "children", std::vector<int>());
+                node.mesh = GetValue(item, "mesh", -1);
+                node.skin = GetValue(item, "skin", -1);
+                nodes.push_back(node);
+            }
+            for (const auto& item : root.value("skins", json::array())) {
+                Skin skin;
+                skin.name = GetValue<std::string>(item, "name", "");
+                skin.joints = GetValue(item, "joints", std::vector<int>());
+                skin.inverseBindMatrices = GetValue(item, "inverseBindMatrices", -1);
+                skins.push_back(skin);
+            }
+            for (const auto& item : root.value("materials", json::array())) {
+                Material material;
+                material.name = GetValue<std::string>(item, "name", "");
+                material.normalTexture = GetTextureIndex(item, "normalTexture");
+                auto pbr = item.find("pbrMetallicRoughness");
+                if (pbr != item.end() && pbr->is_object()) {
+                    material.baseColorTexture = GetTextureIndex(*pbr, "baseColorTexture");
+                    auto factor = GetValue(*pbr, "baseColorFactor", std::vector<double>());
+                    for (size_t i = 0; i < factor.size() && i < 4; ++i) {
+                        material.baseColorFactor[i] = factor[i];
+                    }
+                }
+                materials.push_back(material);
+            }
+            for (const auto& item : root.value("textures", json::array())) {
+                Texture texture;
+                texture.source = GetValue(item, "source", -1);
+                texture.sampler = GetValue(item, "sampler", -1);
+                textures.push_back(texture);
+            }
+            for (const auto& item : root.value("images", json::array())) {
+                Image image;
+                image.name = GetValue<std::string>(item, "name", "");
+                image.mimeType = GetValue<std::string>(item, "mimeType", "");
+                image.bufferView = GetValue(item, "bufferView", -1);
+                images.push_back(image);
+            }
+            for (const auto& item : root.value("scenes", json::array())) {
+                Scene scene;
+                scene.nodes = GetValue(item, "nodes", std::vector<int>());
+                scenes.push_back(scene);
+            }
+            defaultScene = GetValue(root, "scene", 0);
+            extensionsRequired = GetValue(root, "extensionsRequired", std::vector<std::string>());
+        } catch (const json::exception& e) {
+            OutputDebugStringA(e.what());
+            return false;
+        }
+        if (scenes.empty() || defaultScene < 0 || defaultScene >= int(scenes.size())) {
+            OutputDebugStringA("GlbDocument: no scene.\n");
+            return false;
+        }
+        return true;
+    }
+
+    GlbDocument::Span GlbDocument::GetBufferView(int index) const
+    {
+        if (index < 0 || index >= int(bufferViews.size())) {
+            return Span();
+        }
+        const auto& view = bufferViews[index];
+        if (view.buffer != 0 || m_bufferIsEmbedded.empty() || !m_bufferIsEmbedded[0]) {
+            // 外部ファイルのバッファには対応しない.
+            return Span();
+        }
+        if (view.byteOffset > m_binChunk.size || view.byteLength > m_binChunk.size - view.byteOffset) {
+            return Span();
+        }
+        Span span;
+        span.data = m_binChunk.data + view.byteOffset;
+        span.size = view.byteLength;
+        return span;
+    }
+
+    const uint8_t* GlbDocument::GetAccessorData(const Accessor& accessor, uint32_t& stride) const
+    {
+        if (accessor.bufferView < 0) {
+            return nullptr;
+        }
+        auto span = GetBufferView(accessor.bufferView);
+        const uint64_t elementSize = uint64_t(GetComponentSize(accessor.componentType)) * accessor.componentCount;
+        if (span.data == nullptr || elementSize == 0) {
+            return nullptr;
+        }
+        stride = bufferViews[accessor.bufferView].byteStride;
+        if (stride == 0) {
+            stride = uint32_t(elementSize);
+        }
+        if (accessor.count > 0) {
+            // 最後の要素までがビューに収まっていること.
+            const uint64_t required = accessor.byteOffset + uint64_t(stride) * (accessor.count - 1) + elementSize;
+            if (required > span.size) {
+                return nullptr;
+            }
+        }
+        return span.data + accessor.byteOffset;
+    }
+
+    bool GlbDocument::ReadFloat(const Accessor& accessor, size_t first, size_t count, float* dst) const
+    {
+        uint32_t stride = 0;
+        auto src = GetAccessorData(accessor, stride);
+        if (src == nullptr || first + count > accessor.count) {
+            return false;
+        }
+        src += size_t(stride) * first;
+        const auto components = accessor.componentCount;
+        const bool normalized = accessor.normalized;
+        switch (accessor.componentType) {
+        case ComponentTypeFloat:
+            if (!CopyPacked(src, stride, count, components, dst)) {
+                ConvertToFloat<float, false>(src, stride, count, components, dst);
+            }
+            return true;
+        case ComponentTypeByte:
+            normalized ? ConvertToFloat<int8_t, true>(src, stride, count, components, dst)
+                : ConvertToFloat<int8_t, false>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeUnsignedByte:
+            normalized ? ConvertToFloat<uint8_t, true>(src, stride, count, components, dst)
+                : ConvertToFloat<uint8_t, false>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeShort:
+            normalized ? ConvertToFloat<int16_t, true>(src, stride, count, components, dst)
+                : ConvertToFloat<int16_t, false>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeUnsignedShort:
+            normalized ? ConvertToFloat<uint16_t, true>(src, stride, count, components, dst)
+                : ConvertToFloat<uint16_t, false>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeUnsignedInt:
+            ConvertToFloat<uint32_t, false>(src, stride, count, components, dst);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool GlbDocument::ReadUInt(const Accessor& accessor, size_t first, size_t count, uint32_t* dst) const
+    {
+        uint32_t stride = 0;
+        auto src = GetAccessorData(accessor, stride);
+        if (src == nullptr || first + count > accessor.count) {
+            return false;
+        }
+        src += size_t(stride) * first;
+        const auto components = accessor.componentCount;
+        switch (accessor.componentType) {
+        case ComponentTypeUnsignedByte:
+            ConvertToUInt<uint8_t>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeUnsignedShort:
+            ConvertToUInt<uint16_t>(src, stride, count, components, dst);
+            return true;
+        case ComponentTypeUnsignedInt:
+            if (!CopyPacked(src, stride, count, components, dst)) {
+                ConvertToUInt<uint32_t>(src, stride, count, components, dst);
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    uint32_t GlbDocument::GetComponentSize(int componentType)
+    {
+        switch (componentType) {
+        case ComponentTypeByte:
+        case ComponentTypeUnsignedByte:
+            return 1;
+        case ComponentTypeShort:
+        case ComponentTypeUnsignedShort:
+            return 2;
+        case ComponentTypeUnsignedInt:
+        case ComponentTypeFloat:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "util/MappedFile.h"
+
+namespace util {
+
+    bool MappedFile::Open(const std::wstring& fileName)
+    {
+        Close();
+        auto file = CreateFileW(
+            fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        m_file = file;
+
+        LARGE_INTEGER fileSize{};
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            // 空のファイルはマップできない.
+            Close();
+            return false;
+        }
+        m_size = uint64_t(fileSize.QuadPart);
+
+        m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping == nullptr) {
+            Close();
+            return false;
+        }
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == nullptr) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_data) {
+            UnmapViewOfFile(m_data);
+            m_data = nullptr;
+        }
+        if (m_mapping) {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        if (m_file) {
+            CloseHandle(m_file);
+            m_file = nullptr;
+        }
+        m_size = 0;
+    }
+}
@@ -0,0 +1,121 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "util/TextureLoader.h"
+#include "util/ThreadPool.h"
+#include "MipGenerator.h"
+#include "Ktx2Texture.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+
+#include "stb_image.h"
+
+namespace util {
+
+    std::vector<vk::ImageResource> TextureLoader::CreateTextures(
+        VkGraphicsDevice& device,
+        const std::vector<Source>& sources,
+        VkImageUsageFlags usage,
+        VkMemoryPropertyFlags memProps,
+        bool generateMipmaps)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+
+        struct Decoded {
+            size_t index = 0;
+            stbi_uc* pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            std::vector<std::vector<uint8_t>> mipLevels;
+            bool isKtx2 = false;
+        };
+        std::mutex mutex;
+        std::condition_variable decodedCondition;
+        std::deque<Decoded> decodedQueue;
+
+        // デコード済みで転送待ちの画像が溜まりすぎないよう, 同時に処理する数を制限する.
+        auto& pool = ThreadPool::GetShared();
+        const size_t maxInFlight = size_t(pool.GetThreadCount()) + 1;
+
+        // GPU で縮小コピーできない場合は, デコードと合わせてワーカースレッドでミップマップを作る.
+        const bool generateOnCpu = generateMipmaps && !device->IsLinearBlitSupported(VK_FORMAT_R8G8B8A8_UNORM);
+
+        std::vector<vk::ImageResource> textures(sources.size());
+        size_t submitted = 0;
+        uint64_t uploadedBytes = 0;
+        for (size_t consumed = 0; consumed < sources.size(); ++consumed) {
+            for (; submitted < sources.size() && submitted - consumed < maxInFlight; ++submitted) {
+                pool.Enqueue([&, index = submitted]() {
+                    Decoded result;
+                    result.index = index;
+                    const auto& src = sources[index];
+                    if (Ktx2Texture::IsKtx2(src.data, src.size)) {
+                        // 圧縮済みのデータはデコード不要なので, そのまま転送に回す.
+                        result.isKtx2 = true;
+                    } else if (src.data != nullptr) {
+                        result.pixels = stbi_load_from_memory(
+                            static_cast<const stbi_uc*>(src.data), int(src.size),
+                            &result.width, &result.height, nullptr, 4);
+                    }
+                    if (result.pixels != nullptr && generateOnCpu) {
+                        result.mipLevels = MipGenerator::GenerateChain(result.pixels, uint32_t(result.width), uint32_t(result.height));
+                    }
+                    // 呼び出し元が待機を終えて戻る前に通知を終えるよう, ロック中に通知する.
+                    std::lock_guard<std::mutex> lock(mutex);
+                    decodedQueue.push_back(std::move(result));
+                    decodedCondition.notify_one();
+                });
+            }
+
+            Decoded decoded;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                decodedCondition.wait(lock, [&]() { return !decodedQueue.empty(); });
+                decoded = std::move(decodedQueue.front());
+                decodedQueue.pop_front();
+            }
+            if (decoded.isKtx2) {
+                const auto& src = sources[decoded.index];
+                auto& texture = textures[decoded.index];
+                texture = device->CreateTexture2DFromKtx2(src.data, src.size, usage, memProps);
+                auto extent = texture.GetExtent();
+                uploadedBytes += CalcTextureDataSize(texture.GetFormat(), extent.width, extent.height, texture.GetMipLevels());
+                continue;
+            }
+            if (decoded.pixels == nullptr) {
+                OutputDebugStringA("Failed to decode image.\n");
+                continue;
+            }
+
+            // 以降のデコードと並行して, リングへの書き込みと転送コマンドの記録を行う.
+            auto width = uint32_t(decoded.width), height = uint32_t(decoded.height);
+            auto& texture = textures[decoded.index];
+            auto mipLevels = generateMipmaps ? vk::GraphicsDevice::GetMipLevelCount(width, height) : 1;
+            texture = device->CreateTexture2D(width, height, VK_FORMAT_R8G8B8A8_UNORM, usage, memProps, mipLevels);
+            if (decoded.mipLevels.empty()) {
+                device->WriteToTexture2D(texture, width, height, decoded.pixels);
+            } else {
+                std::vector<const void*> levels = { decoded.pixels };
+                for (const auto& level : decoded.mipLevels) {
+                    levels.push_back(level.data());
+                }
+                device->WriteToTexture2D(texture, width, height, levels);
+            }
+            stbi_image_free(decoded.pixels);
+            uploadedBytes += CalcTextureDataSize(VK_FORMAT_R8G8B8A8_UNORM, width, height, mipLevels);
+        }
+        device->FlushUploads();
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::ostringstream ss;
+        ss << "TextureLoader: " << sources.size() << " images, "
+            << (uploadedBytes / (1024 * 1024)) << " MB, "
+            << std::chrono::duration<double, std::milli>(endTime - startTime).count() << " ms\n";
+        OutputDebugStringA(ss.str().c_str());
+        return textures;
+    }
+}
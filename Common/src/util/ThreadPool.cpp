@@ -0,0 +1,125 @@
+﻿#include "util/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace util {
+
+    ThreadPool::ThreadPool(uint32_t threadCount)
+    {
+        if (threadCount == 0) {
+            auto coreCount = std::thread::hardware_concurrency();
+            threadCount = coreCount > 1 ? coreCount - 1 : 1;
+        }
+        for (uint32_t i = 0; i < threadCount; ++i) {
+            m_threads.emplace_back([this]() { WorkerMain(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_exit = true;
+        }
+        m_taskAdded.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::Enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_taskAdded.notify_one();
+    }
+
+    void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+    {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1 || m_threads.empty()) {
+            for (size_t i = 0; i < count; ++i) {
+                func(i);
+            }
+            return;
+        }
+
+        // 各スレッドは共有のカウンタからインデックスを取り出して処理する.
+        std::atomic<size_t> nextIndex = 0;
+        auto processIndices = [&]() {
+            size_t index;
+            while ((index = nextIndex.fetch_add(1)) < count) {
+                func(index);
+            }
+        };
+
+        std::mutex doneMutex;
+        std::condition_variable doneCondition;
+        size_t helperCount = (std::min)(count - 1, m_threads.size());
+        size_t runningHelpers = helperCount;
+        for (size_t i = 0; i < helperCount; ++i) {
+            Enqueue([&]() {
+                processIndices();
+                std::lock_guard<std::mutex> lock(doneMutex);
+                if (--runningHelpers == 0) {
+                    doneCondition.notify_one();
+                }
+            });
+        }
+        processIndices();
+
+        // 手伝いのタスクがまだ始まっていなければ自分で実行する.
+        //  (ワーカースレッドから呼ばれた場合でも止まらないように)
+        while (RunPendingTask()) {
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (runningHelpers == 0) {
+                break;
+            }
+        }
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCondition.wait(lock, [&]() { return runningHelpers == 0; });
+    }
+
+    ThreadPool& ThreadPool::GetShared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::WorkerMain()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_taskAdded.wait(lock, [this]() { return m_exit || !m_tasks.empty(); });
+                if (m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    bool ThreadPool::RunPendingTask()
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+}
@@ -1,24 +1,24 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include "util/VkrModel.h"
+#include "util/GlbDocument.h"
+#include "util/ThreadPool.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <queue>
 
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
-#define TINYGLTF_IMPLEMENTATION
-//#define STB_IMAGE_IMPLEMENTATION   // Device NXŎĂ邽.
-#define TINYGLTF_NO_STB_IMAGE_WRITE  // ogpȂ.
-#include "tiny_gltf.h"
-
 
 namespace util {
     using namespace glm;
-    using namespace tinygltf;
 
     static vec3 makeFloat3(const double* in)
     {
@@ -40,6 +40,7 @@ namespace util {
         };
         return q;
     }
+
     
     VkrModel::Node::Node()
     {
@@ -78,114 +79,224 @@ namespace util {
         device->DestroyBuffer(m_vertexAttrib.jointWeights);
         device->DestroyBuffer(m_indexBuffer);
 
+        m_sourceFile.reset();
     }
 
     bool VkrModel::LoadFromGltf(
         const std::wstring& fileName, VkGraphicsDevice& device)
     {
-        std::filesystem::path filePath(fileName);
-        std::vector<char> buffer;
-        util::LoadFile(buffer, fileName);
-
-        std::string baseDir;
-        if (filePath.is_relative()) {
-            auto current = std::filesystem::current_path();
-            current /= filePath;
-            current.swap(filePath);
-        }
-        baseDir = filePath.parent_path().string();
-
-        std::string err, warn;
-        TinyGLTF loader;
-        Model model;
-        bool result = false;
-        if (filePath.extension() == L".glb") {
-            result = loader.LoadBinaryFromMemory(&model, &err, &warn,
-                reinterpret_cast<const uint8_t*>(buffer.data()),
-                uint32_t(buffer.size()), baseDir);
+        auto startTime = std::chrono::high_resolution_clock::now();
+        auto cacheFileName = GetCacheFileName(fileName);
+        bool fromCache = LoadFromCache(cacheFileName, fileName, device);
+        if (!fromCache) {
+            VertexAttributeVisitor visitor;
+            if (!ParseGltf(fileName, visitor)) {
+                return false;
+            }
+            CreateBuffers(device, GetStreams(visitor));
+
+            // ȍ~̂߂ɃLbVt@C쐬Ă.
+            if (!WriteCache(cacheFileName, fileName, visitor)) {
+                OutputDebugStringA("VkrModel: failed to write the model cache.\n");
+            }
         }
-        if (!warn.empty()) {
-            OutputDebugStringA(warn.c_str());
+
+        auto endTime = std::chrono::high_resolution_clock::now();
+        std::wstringstream ss;
+        ss << L"VkrModel: " << fileName << (fromCache ? L" (cache) " : L" (glTF) ")
+            << std::chrono::duration<double, std::milli>(endTime - startTime).count() << L" ms" << std::endl;
+        OutputDebugStringW(ss.str().c_str());
+        return true;
+    }
+
+    bool VkrModel::ConvertToCache(const std::wstring& fileName, const std::wstring& cacheFileName)
+    {
+        VkrModel model;
+        VertexAttributeVisitor visitor;
+        if (!model.ParseGltf(fileName, visitor)) {
+            return false;
         }
-        if (!err.empty()) {
-            OutputDebugStringA(err.c_str());
+        return model.WriteCache(cacheFileName, fileName, visitor);
+    }
+
+    bool VkrModel::ParseGltfOnly(const std::wstring& fileName)
+    {
+        VkrModel model;
+        VertexAttributeVisitor visitor;
+        if (!model.ParseGltf(fileName, visitor)) {
+            return false;
         }
-        if (!result) {
+        CopyStreams(GetStreams(visitor));
+        return true;
+    }
+
+    bool VkrModel::ReadCacheOnly(const std::wstring& cacheFileName, const std::wstring& fileName)
+    {
+        VkrModel model;
+        VertexStreams streams;
+        if (!model.ReadCache(cacheFileName, fileName, streams)) {
             return false;
         }
+        CopyStreams(streams);
+        return true;
+    }
 
+    double VkrModel::MeasureLoadMesh(const std::wstring& fileName, uint32_t threadCount)
+    {
+        GlbDocument document;
+        if (!document.Open(fileName)) {
+            return -1.0;
+        }
+        VkrModel model;
+        model.m_decodeThreadCount = (std::max)(threadCount, 1u);
         VertexAttributeVisitor visitor;
-        const auto& scene = model.scenes[0];
+        auto startTime = std::chrono::high_resolution_clock::now();
+        model.LoadMesh(document, visitor);
+        auto endTime = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    }
+
+    VkrModel::VertexStreams VkrModel::GetStreams(const VertexAttributeVisitor& visitor)
+    {
+        VertexStreams streams;
+        streams.index = visitor.indexBuffer.data();
+        streams.indexSize = sizeof(uint32_t) * visitor.indexBuffer.size();
+        streams.position = visitor.positionBuffer.data();
+        streams.positionSize = sizeof(vec3) * visitor.positionBuffer.size();
+        streams.normal = visitor.normalBuffer.data();
+        streams.normalSize = sizeof(vec3) * visitor.normalBuffer.size();
+        streams.texcoord = visitor.texcoordBuffer.data();
+        streams.texcoordSize = sizeof(vec2) * visitor.texcoordBuffer.size();
+        streams.joint = visitor.jointBuffer.data();
+        streams.jointSize = sizeof(uvec4) * visitor.jointBuffer.size();
+        streams.weight = visitor.weightBuffer.data();
+        streams.weightSize = sizeof(vec4) * visitor.weightBuffer.size();
+        return streams;
+    }
+
+    size_t VkrModel::CopyStreams(const VertexStreams& streams)
+    {
+        // Xe[WOobt@ւ݂̏ɑ镡.
+        //  LbV̓}bvł͓ǂݍ܂Ȃ, rɂ͂̏܂Ŋ܂߂.
+        const std::pair<const void*, size_t> sources[] = {
+            { streams.index, streams.indexSize },
+            { streams.position, streams.positionSize },
+            { streams.normal, streams.normalSize },
+            { streams.texcoord, streams.texcoordSize },
+            { streams.joint, streams.jointSize },
+            { streams.weight, streams.weightSize },
+        };
+        size_t totalSize = 0;
+        for (const auto& source : sources) {
+            totalSize += source.second;
+        }
+        std::unique_ptr<uint8_t[]> dst(new uint8_t[totalSize]);
+        size_t offset = 0;
+        for (const auto& source : sources) {
+            if (source.second > 0) {
+                memcpy(dst.get() + offset, source.first, source.second);
+                offset += source.second;
+            }
+        }
+        return totalSize;
+    }
+
+    std::wstring VkrModel::GetCacheFileName(const std::wstring& fileName)
+    {
+        std::filesystem::path cachePath(L"cache/model");
+        cachePath /= std::filesystem::path(fileName).filename();
+        cachePath += L".vkrmodel";
+        return cachePath.wstring();
+    }
+
+    bool VkrModel::ParseGltf(const std::wstring& fileName, VertexAttributeVisitor& visitor)
+    {
+        // t@C̓}bv JSON `N݂̂͂.
+        //  _摜̃f[^̓}bv̈悩璼ړǂݎ.
+        GlbDocument model;
+        if (std::filesystem::path(fileName).extension() != L".glb" || !model.Open(fileName)) {
+            return false;
+        }
+
+        const auto& scene = model.scenes[model.defaultScene];
         for (const auto& nodeIndex : scene.nodes) {
             m_rootNodes.push_back(nodeIndex);
         }
 
+        for (const auto& extension : model.extensionsRequired) {
+            // ʎqꂽ_͓ǂݎ莞ɕϊ̂őΉς.
+            if (extension != "KHR_mesh_quantization") {
+                std::string message = "VkrModel: unsupported extension " + extension + "\n";
+                OutputDebugStringA(message.c_str());
+            }
+        }
+
         LoadNode(model);
         LoadMesh(model, visitor);
         LoadSkin(model);
         LoadMaterial(model);
 
-        auto memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
-            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
-            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        auto sizePos = sizeof(vec3) * visitor.positionBuffer.size();
-        auto sizeNrm = sizeof(vec3) * visitor.normalBuffer.size();
-        auto sizeTex = sizeof(vec2) * visitor.texcoordBuffer.size();
-
-        // _f[^̐.
-        m_vertexAttrib.position = device->CreateBuffer(sizePos, usage, memProps);
-        device->WriteToBuffer(m_vertexAttrib.position, visitor.positionBuffer.data(), sizePos);
-
-        m_vertexAttrib.normal = device->CreateBuffer(sizeNrm, usage, memProps);
-        device->WriteToBuffer(m_vertexAttrib.normal, visitor.normalBuffer.data(), sizeNrm);
-
-        m_vertexAttrib.texcoord = device->CreateBuffer(sizeTex, usage, memProps);
-        device->WriteToBuffer(m_vertexAttrib.texcoord, visitor.texcoordBuffer.data(), sizeTex);
-
-        // CfbNXobt@.
-        auto sizeIdx = sizeof(uint32_t) * visitor.indexBuffer.size();
-        m_indexBuffer = device->CreateBuffer(sizeIdx, usage, memProps);
-        device->WriteToBuffer(m_indexBuffer, visitor.indexBuffer.data(), sizeIdx);
-
-        // XLjOfp.
         if (m_hasSkin) {
-            auto sizeJoint = sizeof(uvec4) * visitor.jointBuffer.size();
-            auto sizeWeight = sizeof(vec4) * visitor.weightBuffer.size();
-            m_vertexAttrib.jointIndices = device->CreateBuffer(sizeJoint, usage, memProps);
-            device->WriteToBuffer(m_vertexAttrib.jointIndices, visitor.jointBuffer.data(), sizeJoint);
-
-            m_vertexAttrib.jointWeights = device->CreateBuffer(sizeWeight, usage, memProps);
-            device->WriteToBuffer(m_vertexAttrib.jointWeights, visitor.weightBuffer.data(), sizeWeight);
-
             // XLjOŎgp钸_Ƃ.
             //   (Position ƓƂȂĂ̂ΏۂƂĂ̂łł悢)
             m_skinInfo.skinVertexCount = UINT(visitor.jointBuffer.size());
         }
 
-
         for (auto& image : model.images) {
-            auto fileName = util::ConvertFromUTF8(image.name);
-            auto view = model.bufferViews[image.bufferView];
-            auto offsetBytes = view.byteOffset;
-            const void* src = &model.buffers[view.buffer].data[offsetBytes];
+            // 摜̓Rs[, }bv̈QƂ.
+            auto span = model.GetBufferView(image.bufferView);
 
             m_images.emplace_back();
             auto& info = m_images.back();
-            info.fileName = fileName;
-            info.imageBuffer.resize(view.byteLength);
-            memcpy(info.imageBuffer.data(), src, view.byteLength);
+            info.fileName = util::ConvertFromUTF8(image.name);
+            info.imageData = span.data;
+            info.imageSize = size_t(span.size);
         }
+        m_sourceFile = model.GetFile();
 
         for (auto& texture : model.textures) {
             m_textures.emplace_back();
             auto& info = m_textures.back();
             info.imageIndex = texture.source;   // QƂ摜f[^ւ̃CfbNX.
         }
-
         return true;
     }
 
+    void VkrModel::CreateBuffers(VkGraphicsDevice& device, const VertexStreams& streams)
+    {
+        auto memProps = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | 
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        // _f[^̐.
+        m_vertexAttrib.position = device->CreateBuffer(streams.positionSize, usage, memProps);
+        device->WriteToBuffer(m_vertexAttrib.position, streams.position, streams.positionSize);
+
+        m_vertexAttrib.normal = device->CreateBuffer(streams.normalSize, usage, memProps);
+        device->WriteToBuffer(m_vertexAttrib.normal, streams.normal, streams.normalSize);
+
+        m_vertexAttrib.texcoord = device->CreateBuffer(streams.texcoordSize, usage, memProps);
+        device->WriteToBuffer(m_vertexAttrib.texcoord, streams.texcoord, streams.texcoordSize);
+
+        // CfbNXobt@.
+        m_indexBuffer = device->CreateBuffer(streams.indexSize, usage, memProps);
+        device->WriteToBuffer(m_indexBuffer, streams.index, streams.indexSize);
+
+        // WIgẽnbVl߂Ă.
+        m_contentHash = util::ComputeHash(streams.position, streams.positionSize);
+        m_contentHash = util::ComputeHash(streams.index, streams.indexSize, m_contentHash);
+
+        // XLjOfp.
+        if (m_hasSkin) {
+            m_vertexAttrib.jointIndices = device->CreateBuffer(streams.jointSize, usage, memProps);
+            device->WriteToBuffer(m_vertexAttrib.jointIndices, streams.joint, streams.jointSize);
+
+            m_vertexAttrib.jointWeights = device->CreateBuffer(streams.weightSize, usage, memProps);
+            device->WriteToBuffer(m_vertexAttrib.jointWeights, streams.weight, streams.weightSize);
+        }
+    }
+
     std::vector<std::wstring> VkrModel::GetJointNodeNames() const
     {
         std::vector<std::wstring> nameList;
@@ -200,20 +311,20 @@ namespace util {
         return m_skinInfo.invBindMatrices;
     }
 
-    void VkrModel::LoadNode(const tinygltf::Model& inModel)
+    void VkrModel::LoadNode(const GlbDocument& inModel)
     {
         for (auto& inNode : inModel.nodes) {
             m_nodes.emplace_back(new Node());
             auto node = m_nodes.back();
 
             node->name = util::ConvertFromUTF8(inNode.name);
-            if (!inNode.translation.empty()) {
+            if (inNode.translation.size() == 3) {
                 node->translation = makeFloat3(inNode.translation.data());
             }
-            if (!inNode.scale.empty()) {
+            if (inNode.scale.size() == 3) {
                 node->scale = makeFloat3(inNode.scale.data());
             }
-            if (!inNode.rotation.empty()) {
+            if (inNode.rotation.size() == 4) {
                 node->rotation = makeQuat(inNode.rotation.data());
             }
             for (auto& c : inNode.children) {
@@ -223,108 +334,115 @@ namespace util {
         }
     }
 
-    void VkrModel::LoadMesh(const tinygltf::Model& inModel, VertexAttributeVisitor& visitor)
+    void VkrModel::LoadMesh(const GlbDocument& inModel, VertexAttributeVisitor& visitor)
     {
-        auto& indexBuffer = visitor.indexBuffer;
-        auto& positionBuffer = visitor.positionBuffer;
-        auto& normalBuffer = visitor.normalBuffer;
-        auto& texcoordBuffer = visitor.texcoordBuffer;
-        auto& jointBuffer = visitor.jointBuffer;
-        auto& weightBuffer = visitor.weightBuffer;
+        enum Stream {
+            StreamPosition, StreamNormal, StreamTexcoord, StreamJoint, StreamWeight, StreamIndex, StreamCount
+        };
+        // eXg[ 1 vf̐, (uint32_t)Ŋi[邩ǂ.
+        const uint32_t componentCounts[StreamCount] = { 3, 3, 2, 4, 4, 1 };
+        const bool isIntegerStream[StreamCount] = { false, false, false, true, false, true };
+
+        // ANZT 1 ̓WJ. accessor  nullptr Ȃ[Ŗ߂.
+        struct DecodeJob {
+            const GlbDocument::Accessor* accessor;
+            Stream stream;
+            size_t dstOffset;   // i[Xg[̗vfItZbg.
+            size_t count;
+        };
+        size_t streamSizes[StreamCount] = { 0 };
+        std::vector<DecodeJob> jobs;
+        auto addJob = [&](const GlbDocument::Accessor* accessor, Stream stream, size_t count) {
+            jobs.push_back(DecodeJob{ accessor, stream, streamSizes[stream], count });
+            streamSizes[stream] += count;
+        };
+
+        // Xg[֕ϊłANZT擾. ^Ȃꍇ, ͈͊Ȍꍇ nullptr.
+        //  ʎqꂽ^(KHR_mesh_quantization)܂, ^͓ǂݎ莞ɕϊ.
+        auto getAccessor = [&](int accessorIndex, Stream stream, UINT& count) -> const GlbDocument::Accessor* {
+            if (accessorIndex < 0 || accessorIndex >= int(inModel.accessors.size())) {
+                return nullptr;
+            }
+            const auto& acc = inModel.accessors[accessorIndex];
+            if (acc.componentCount != componentCounts[stream]) {
+                return nullptr;
+            }
+            switch (acc.componentType) {
+            case GlbDocument::ComponentTypeUnsignedByte:
+            case GlbDocument::ComponentTypeUnsignedShort:
+            case GlbDocument::ComponentTypeUnsignedInt:
+                break;
+            case GlbDocument::ComponentTypeByte:
+            case GlbDocument::ComponentTypeShort:
+            case GlbDocument::ComponentTypeFloat:
+                if (isIntegerStream[stream]) {
+                    return nullptr;
+                }
+                break;
+            default:
+                return nullptr;
+            }
+            uint32_t stride = 0;
+            if (inModel.GetAccessorData(acc, stride) == nullptr) {
+                return nullptr;
+            }
+            count = UINT(acc.count);
+            return &acc;
+        };
+
+        // 1 pX: ANZT̗vfev~eBůi[ʒu߂.
         for (auto& inMesh : inModel.meshes) {
             m_meshGroups.emplace_back(MeshGroup());
             auto& meshgrp = m_meshGroups.back();
 
             for (auto& primitive : inMesh.primitives) {
-                auto indexStart = static_cast<UINT>(indexBuffer.size());
-                auto vertexStart = static_cast<UINT>(positionBuffer.size());
+                auto indexStart = static_cast<UINT>(streamSizes[StreamIndex]);
+                auto vertexStart = static_cast<UINT>(streamSizes[StreamPosition]);
                 UINT indexCount = 0, vertexCount = 0;
-                bool hasSkin = false;
+                UINT count = 0;
 
                 const auto& notfound = primitive.attributes.end();
                 if (auto attr = primitive.attributes.find("POSITION"); attr != notfound) {
-                    auto& acc = inModel.accessors[attr->second];
-                    auto& view = inModel.bufferViews[acc.bufferView];
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    const auto* src = reinterpret_cast<const vec3*>(&(inModel.buffers[view.buffer].data[offsetBytes]));
-
-                    vertexCount = UINT(acc.count);
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        positionBuffer.push_back(src[i]);
+                    if (auto acc = getAccessor(attr->second, StreamPosition, count)) {
+                        vertexCount = count;
+                        addJob(acc, StreamPosition, vertexCount);
                     }
                 }
                 if (auto attr = primitive.attributes.find("NORMAL"); attr != notfound) {
-                    auto& acc = inModel.accessors[attr->second];
-                    auto& view = inModel.bufferViews[acc.bufferView];
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    const auto* src = reinterpret_cast<const vec3*>(&(inModel.buffers[view.buffer].data[offsetBytes]));
-
-                    vertexCount = UINT(acc.count);
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        normalBuffer.push_back(src[i]);
+                    if (auto acc = getAccessor(attr->second, StreamNormal, count)) {
+                        vertexCount = count;
+                        addJob(acc, StreamNormal, vertexCount);
                     }
                 }
+                const GlbDocument::Accessor* texcoord = nullptr;
                 if (auto attr = primitive.attributes.find("TEXCOORD_0"); attr != notfound) {
-                    auto& acc = inModel.accessors[attr->second];
-                    auto& view = inModel.bufferViews[acc.bufferView];
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    const auto* src = reinterpret_cast<const vec2*>(&(inModel.buffers[view.buffer].data[offsetBytes]));
-
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        texcoordBuffer.push_back(src[i]);
-                    }
+                    texcoord = getAccessor(attr->second, StreamTexcoord, count);
+                }
+                if (texcoord && count >= vertexCount) {
+                    addJob(texcoord, StreamTexcoord, vertexCount);
                 } else {
                     // UV f[^ꍇɂ́Â̂ƍ킹ׂ[Ŗ߂Ă.
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        texcoordBuffer.push_back(vec2(0.0f, 0.0f));
-                    }
+                    addJob(nullptr, StreamTexcoord, vertexCount);
                 }
 
                 // XLjOp̃WCg(CfbNX)ԍƃEFCglǂݎ.
                 if (auto attr = primitive.attributes.find("JOINTS_0"); attr != notfound) {
-                    auto& acc = inModel.accessors[attr->second];
-                    auto& view = inModel.bufferViews[acc.bufferView];
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    const auto* src = reinterpret_cast<const uint16_t*>(&(inModel.buffers[view.buffer].data[offsetBytes]));
-
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        auto idx = i * 4;
-                        auto v = uvec4(
-                            src[idx + 0], src[idx + 1], src[idx + 2], src[idx + 3]);
-                        jointBuffer.push_back(v);
+                    auto acc = getAccessor(attr->second, StreamJoint, count);
+                    if (acc && count >= vertexCount) {
+                        addJob(acc, StreamJoint, vertexCount);
                     }
                 }
                 if (auto attr = primitive.attributes.find("WEIGHTS_0"); attr != notfound) {
-                    auto& acc = inModel.accessors[attr->second];
-                    auto& view = inModel.bufferViews[acc.bufferView];
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    const auto* src = reinterpret_cast<const vec4*>(&(inModel.buffers[view.buffer].data[offsetBytes]));
-
-                    for (UINT i = 0; i < vertexCount; ++i) {
-                        weightBuffer.push_back(src[i]);
+                    auto acc = getAccessor(attr->second, StreamWeight, count);
+                    if (acc && count >= vertexCount) {
+                        addJob(acc, StreamWeight, vertexCount);
                     }
                 }
 
                 //@CfbNXobt@p.
-                {
-                    auto& acc = inModel.accessors[primitive.indices];
-                    const auto& view = inModel.bufferViews[acc.bufferView];
-                    const auto& buffer = inModel.buffers[view.buffer];
-                    indexCount = UINT(acc.count);
-                    auto offsetBytes = acc.byteOffset + view.byteOffset;
-                    if (acc.componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT) {
-                        auto src = reinterpret_cast<const uint32_t*>(&(buffer.data[offsetBytes]));
-
-                        for (size_t index = 0; index < acc.count; index++)                         {
-                            indexBuffer.push_back(src[index]);
-                        }
-                    }
-                    if (acc.componentType == TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT) {
-                        auto src = reinterpret_cast<const uint16_t*>(&(buffer.data[offsetBytes]));
-                        for (size_t index = 0; index < acc.count; index++)                         {
-                            indexBuffer.push_back(src[index]);
-                        }
-                    }
+                if (auto acc = getAccessor(primitive.indices, StreamIndex, count)) {
+                    indexCount = count;
+                    addJob(acc, StreamIndex, indexCount);
                 }
 
                 meshgrp.m_meshes.emplace_back(Mesh());
@@ -339,14 +457,74 @@ namespace util {
 
         for (UINT nodeIndex = 0; nodeIndex < UINT(inModel.nodes.size()); ++nodeIndex) {
             auto meshIndex = inModel.nodes[nodeIndex].mesh;
-            if (meshIndex < 0) {
+            if (meshIndex < 0 || meshIndex >= int(m_meshGroups.size())) {
                 continue;
             }
             m_meshGroups[meshIndex].m_nodeIndex = nodeIndex;
         }
+
+        // 2 pX: mۍς݂̗̈֊eANZTɓWJ.
+        visitor.positionBuffer.resize(streamSizes[StreamPosition]);
+        visitor.normalBuffer.resize(streamSizes[StreamNormal]);
+        visitor.texcoordBuffer.resize(streamSizes[StreamTexcoord]);
+        visitor.jointBuffer.resize(streamSizes[StreamJoint]);
+        visitor.weightBuffer.resize(streamSizes[StreamWeight]);
+        visitor.indexBuffer.resize(streamSizes[StreamIndex]);
+        void* streamData[StreamCount] = {
+            visitor.positionBuffer.data(),
+            visitor.normalBuffer.data(),
+            visitor.texcoordBuffer.data(),
+            visitor.jointBuffer.data(),
+            visitor.weightBuffer.data(),
+            visitor.indexBuffer.data(),
+        };
+
+        // 傫ȃANZT͈̗vfƂɕď𕪎U.
+        struct DecodeRange {
+            size_t job;
+            size_t begin;
+            size_t end;
+        };
+        const size_t elementsPerRange = 64 * 1024;
+        std::vector<DecodeRange> ranges;
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            for (size_t begin = 0; begin < jobs[i].count; begin += elementsPerRange) {
+                ranges.push_back(DecodeRange{ i, begin, (std::min)(begin + elementsPerRange, jobs[i].count) });
+            }
+        }
+
+        auto decodeRange = [&](size_t rangeIndex) {
+            const auto& range = ranges[rangeIndex];
+            const auto& job = jobs[range.job];
+            const auto components = componentCounts[job.stream];
+            const auto dstIndex = (job.dstOffset + range.begin) * components;
+            const auto count = range.end - range.begin;
+
+            if (isIntegerStream[job.stream]) {
+                auto dst = static_cast<uint32_t*>(streamData[job.stream]) + dstIndex;
+                if (job.accessor == nullptr || !inModel.ReadUInt(*job.accessor, range.begin, count, dst)) {
+                    std::fill(dst, dst + count * components, 0u);
+                }
+            } else {
+                auto dst = static_cast<float*>(streamData[job.stream]) + dstIndex;
+                if (job.accessor == nullptr || !inModel.ReadFloat(*job.accessor, range.begin, count, dst)) {
+                    std::fill(dst, dst + count * components, 0.0f);
+                }
+            }
+        };
+        if (m_decodeThreadCount == 0) {
+            ThreadPool::GetShared().ParallelFor(ranges.size(), decodeRange);
+        } else if (m_decodeThreadCount == 1) {
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                decodeRange(i);
+            }
+        } else {
+            ThreadPool threadPool(m_decodeThreadCount - 1);
+            threadPool.ParallelFor(ranges.size(), decodeRange);
+        }
     }
 
-    void VkrModel::LoadSkin(const tinygltf::Model& inModel)
+    void VkrModel::LoadSkin(const GlbDocument& inModel)
     {
         if (inModel.skins.empty()) {
             m_hasSkin = false;
@@ -359,43 +537,32 @@ namespace util {
         m_skinInfo.name = ConvertFromUTF8(inSkin.name);
         m_skinInfo.joints.assign(inSkin.joints.begin(), inSkin.joints.end());
 
-        if (inSkin.inverseBindMatrices > -1) {
+        if (inSkin.inverseBindMatrices > -1 && inSkin.inverseBindMatrices < int(inModel.accessors.size())) {
             const auto& acc = inModel.accessors[inSkin.inverseBindMatrices];
-            const auto& view = inModel.bufferViews[acc.bufferView];
-            const auto& buffer = inModel.buffers[view.buffer];
-            m_skinInfo.invBindMatrices.resize(acc.count);
-
-            auto offsetBytes = acc.byteOffset + view.byteOffset;
-            memcpy(
-                m_skinInfo.invBindMatrices.data(),
-                &buffer.data[offsetBytes],
-                acc.count * sizeof(mat4));
+            if (acc.componentCount == 16) {
+                m_skinInfo.invBindMatrices.resize(size_t(acc.count));
+                auto dst = reinterpret_cast<float*>(m_skinInfo.invBindMatrices.data());
+                if (!inModel.ReadFloat(acc, 0, size_t(acc.count), dst)) {
+                    m_skinInfo.invBindMatrices.clear();
+                }
+            }
         }
+        // ȗ͒PʍsƂĈ. WCgƓɑĂ.
+        m_skinInfo.invBindMatrices.resize(m_skinInfo.joints.size(), glm::mat4(1.0f));
     }
 
-    void VkrModel::LoadMaterial(const tinygltf::Model& inModel)
+    void VkrModel::LoadMaterial(const GlbDocument& inModel)
     {
         for (const auto& inMaterial : inModel.materials) {
             m_materials.emplace_back(Material());
             auto& material = m_materials.back();
             material.m_name = util::ConvertFromUTF8(inMaterial.name);
+            material.m_textureIndex = inMaterial.baseColorTexture;
 
-            for (auto& value : inMaterial.values) {
-                auto valueName = value.first;
-                if (valueName == "baseColorTexture") {
-                    auto textureIndex = value.second.TextureIndex();
-                    material.m_textureIndex = textureIndex;
-                }
-                if (valueName == "normalTexture") {
-                    auto textureIndex = value.second.TextureIndex();
-                }
-                if (valueName == "baseColorFactor") {
-                    auto color = value.second.ColorFactor();
-                    material.m_diffuseColor = vec3(
-                        float(color[0]), float(color[1]), float(color[2])
-                    );
-                }
-            }
+            const auto& color = inMaterial.baseColorFactor;
+            material.m_diffuseColor = vec3(
+                float(color[0]), float(color[1]), float(color[2])
+            );
         }
     }
 }
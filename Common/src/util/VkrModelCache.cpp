@@ -0,0 +1,509 @@
+﻿#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "util/VkrModel.h"
+#include "util/MappedFile.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// VkrModel の前処理済みバイナリ(キャッシュファイル)の読み書き.
+//  ファイルはヘッダ, セクション表, 16 バイト境界に揃えた各セクションで構成する.
+//  頂点属性は属性ごとのストリーム(SoA)としてそのまま GPU へ転送できる形で格納する.
+namespace util {
+    namespace {
+        enum CacheSection : uint32_t {
+            SectionIndex,
+            SectionPosition,
+            SectionNormal,
+            SectionTexcoord,
+            SectionJoint,
+            SectionWeight,
+            SectionNode,
+            SectionNodeChild,
+            SectionRootNode,
+            SectionMeshGroup,
+            SectionMesh,
+            SectionSkinJoint,
+            SectionInvBindMatrix,
+            SectionMaterial,
+            SectionTexture,
+            SectionImage,
+            SectionString,
+            SectionImageData,
+            SectionCount
+        };
+
+        struct SectionEntry {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct CacheHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t sourceSize;
+            int64_t  sourceWriteTime;
+            uint32_t flags;
+            uint32_t skinVertexCount;
+            uint32_t skinNameOffset;
+            uint32_t skinNameLength;
+            uint32_t sectionCount;
+            uint32_t reserved;
+            SectionEntry sections[SectionCount];
+        };
+        const uint32_t CacheMagic = 0x4D524B56; // "VKRM"
+        const uint32_t CacheVersion = 1;
+        const uint32_t CacheFlagSkinned = 1u << 0;
+        const uint64_t SectionAlignment = 16;
+
+        struct NodeRecord {
+            float translation[3];
+            float rotation[4];  // x, y, z, w
+            float scale[3];
+            int32_t meshIndex;
+            uint32_t childStart;
+            uint32_t childCount;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+        struct MeshGroupRecord {
+            int32_t nodeIndex;
+            uint32_t meshStart;
+            uint32_t meshCount;
+        };
+        struct MaterialRecord {
+            float diffuseColor[3];
+            int32_t textureIndex;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+        struct ImageRecord {
+            uint64_t dataOffset;
+            uint64_t dataSize;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+
+        // 各セクションの要素サイズ.
+        const size_t SectionElementSize[SectionCount] = {
+            sizeof(uint32_t),               // SectionIndex
+            sizeof(glm::vec3),              // SectionPosition
+            sizeof(glm::vec3),              // SectionNormal
+            sizeof(glm::vec2),              // SectionTexcoord
+            sizeof(glm::uvec4),             // SectionJoint
+            sizeof(glm::vec4),              // SectionWeight
+            sizeof(NodeRecord),             // SectionNode
+            sizeof(int32_t),                // SectionNodeChild
+            sizeof(int32_t),                // SectionRootNode
+            sizeof(MeshGroupRecord),        // SectionMeshGroup
+            sizeof(VkrModel::Mesh),         // SectionMesh
+            sizeof(int32_t),                // SectionSkinJoint
+            sizeof(glm::mat4),              // SectionInvBindMatrix
+            sizeof(MaterialRecord),         // SectionMaterial
+            sizeof(int32_t),                // SectionTexture
+            sizeof(ImageRecord),            // SectionImage
+            sizeof(wchar_t),                // SectionString
+            sizeof(uint8_t),                // SectionImageData
+        };
+        static_assert(sizeof(VkrModel::Mesh) == sizeof(uint32_t) * 5, "Mesh must be tightly packed.");
+
+        uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // 元ファイルのサイズと更新日時(キャッシュの有効性の判定に使用).
+        bool GetSourceStamp(const std::wstring& fileName, uint64_t& size, int64_t& writeTime)
+        {
+            std::error_code ec;
+            size = std::filesystem::file_size(fileName, ec);
+            if (ec) {
+                return false;
+            }
+            auto time = std::filesystem::last_write_time(fileName, ec);
+            if (ec) {
+                return false;
+            }
+            writeTime = int64_t(time.time_since_epoch().count());
+            return true;
+        }
+
+        void AddString(std::vector<wchar_t>& table, const std::wstring& s, uint32_t& offset, uint32_t& length)
+        {
+            offset = uint32_t(table.size());
+            length = uint32_t(s.size());
+            table.insert(table.end(), s.begin(), s.end());
+        }
+
+        // マップしたファイル内のセクションを参照する.
+        class CacheReader {
+        public:
+            CacheReader(const uint8_t* base, const CacheHeader& header) : m_base(base), m_header(header) {}
+
+            template<class T>
+            const T* Get(CacheSection id) const
+            {
+                return reinterpret_cast<const T*>(m_base + m_header.sections[id].offset);
+            }
+            size_t GetCount(CacheSection id) const
+            {
+                return size_t(m_header.sections[id].size / SectionElementSize[id]);
+            }
+            size_t GetSize(CacheSection id) const
+            {
+                return size_t(m_header.sections[id].size);
+            }
+            bool InRange(CacheSection id, uint64_t start, uint64_t count) const
+            {
+                return start + count <= GetCount(id);
+            }
+            // テーブルの要素を指すインデックスの検証. allowNone なら -1 (参照なし) も許可する.
+            bool IsValidIndex(CacheSection id, int64_t index, bool allowNone = false) const
+            {
+                if (index < 0) {
+                    return allowNone && index == -1;
+                }
+                return uint64_t(index) < GetCount(id);
+            }
+            bool GetString(uint32_t offset, uint32_t length, std::wstring& out) const
+            {
+                if (!InRange(SectionString, offset, length)) {
+                    return false;
+                }
+                out.assign(Get<wchar_t>(SectionString) + offset, length);
+                return true;
+            }
+        private:
+            const uint8_t* m_base;
+            const CacheHeader& m_header;
+        };
+    }
+
+    bool VkrModel::LoadFromCache(const std::wstring& cacheFileName, const std::wstring& fileName, VkGraphicsDevice& device)
+    {
+        VertexStreams streams;
+        if (!ReadCache(cacheFileName, fileName, streams)) {
+            return false;
+        }
+        CreateBuffers(device, streams);
+        return true;
+    }
+
+    bool VkrModel::ReadCache(const std::wstring& cacheFileName, const std::wstring& fileName, VertexStreams& streams)
+    {
+        // 画像データはマップした領域を参照するので, ファイルはモデル側で保持する.
+        auto mappedFile = std::make_shared<MappedFile>();
+        auto& file = *mappedFile;
+        if (!file.Open(cacheFileName) || file.GetSize() < sizeof(CacheHeader)) {
+            return false;
+        }
+        CacheHeader header;
+        memcpy(&header, file.GetData(), sizeof(header));
+        if (header.magic != CacheMagic || header.version != CacheVersion || header.sectionCount != SectionCount) {
+            return false;
+        }
+
+        // 元ファイルが更新されていれば作り直す.
+        //  (元ファイルが存在しない場合はキャッシュファイルのみで動作させる)
+        uint64_t sourceSize = 0;
+        int64_t sourceWriteTime = 0;
+        if (GetSourceStamp(fileName, sourceSize, sourceWriteTime)) {
+            if (sourceSize != header.sourceSize || sourceWriteTime != header.sourceWriteTime) {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < SectionCount; ++i) {
+            const auto& entry = header.sections[i];
+            if (entry.offset % SectionAlignment != 0 || entry.size % SectionElementSize[i] != 0) {
+                return false;
+            }
+            if (entry.offset > file.GetSize() || entry.size > file.GetSize() - entry.offset) {
+                return false;
+            }
+        }
+        CacheReader reader(file.GetData(), header);
+
+        // 各テーブルを検証しながら復元する. 全て成功した場合のみメンバへ反映する.
+        //  壊れたキャッシュで範囲外を参照しないよう, 他のテーブルを指すインデックスは全て確認し,
+        //  不正なものがあれば false を返して glTF から読み直させる.
+        std::vector<std::shared_ptr<Node>> nodes;
+        const auto* nodeRecords = reader.Get<NodeRecord>(SectionNode);
+        const auto* nodeChildren = reader.Get<int32_t>(SectionNodeChild);
+        for (size_t i = 0; i < reader.GetCount(SectionNode); ++i) {
+            const auto& record = nodeRecords[i];
+            auto node = std::make_shared<Node>();
+            if (!reader.GetString(record.nameOffset, record.nameLength, node->name) ||
+                !reader.InRange(SectionNodeChild, record.childStart, record.childCount) ||
+                !reader.IsValidIndex(SectionMeshGroup, record.meshIndex, true)) {
+                return false;
+            }
+            for (uint32_t c = 0; c < record.childCount; ++c) {
+                if (!reader.IsValidIndex(SectionNode, nodeChildren[record.childStart + c])) {
+                    return false;
+                }
+            }
+            node->translation = vec3(record.translation[0], record.translation[1], record.translation[2]);
+            node->rotation = quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+            node->scale = vec3(record.scale[0], record.scale[1], record.scale[2]);
+            node->meshIndex = record.meshIndex;
+            node->children.assign(nodeChildren + record.childStart, nodeChildren + record.childStart + record.childCount);
+            nodes.push_back(node);
+        }
+
+        std::vector<MeshGroup> meshGroups;
+        const auto* meshGroupRecords = reader.Get<MeshGroupRecord>(SectionMeshGroup);
+        const auto* meshes = reader.Get<Mesh>(SectionMesh);
+        for (size_t i = 0; i < reader.GetCount(SectionMeshGroup); ++i) {
+            const auto& record = meshGroupRecords[i];
+            if (!reader.InRange(SectionMesh, record.meshStart, record.meshCount) ||
+                !reader.IsValidIndex(SectionNode, record.nodeIndex, true)) {
+                return false;
+            }
+            for (uint32_t m = 0; m < record.meshCount; ++m) {
+                // materialIndex は参照なしの場合 -1 (~0u) が入っている.
+                const auto& mesh = meshes[record.meshStart + m];
+                if (!reader.InRange(SectionIndex, mesh.indexStart, mesh.indexCount) ||
+                    !reader.InRange(SectionPosition, mesh.vertexStart, mesh.vertexCount) ||
+                    !reader.InRange(SectionTexcoord, mesh.vertexStart, mesh.vertexCount) ||
+                    !reader.IsValidIndex(SectionMaterial, int32_t(mesh.materialIndex), true)) {
+                    return false;
+                }
+            }
+            MeshGroup meshGroup;
+            meshGroup.m_nodeIndex = record.nodeIndex;
+            meshGroup.m_meshes.assign(meshes + record.meshStart, meshes + record.meshStart + record.meshCount);
+            meshGroups.push_back(meshGroup);
+        }
+
+        std::vector<Material> materials;
+        const auto* materialRecords = reader.Get<MaterialRecord>(SectionMaterial);
+        for (size_t i = 0; i < reader.GetCount(SectionMaterial); ++i) {
+            const auto& record = materialRecords[i];
+            Material material;
+            if (!reader.GetString(record.nameOffset, record.nameLength, material.m_name) ||
+                !reader.IsValidIndex(SectionTexture, record.textureIndex, true)) {
+                return false;
+            }
+            material.m_textureIndex = record.textureIndex;
+            material.m_diffuseColor = vec3(record.diffuseColor[0], record.diffuseColor[1], record.diffuseColor[2]);
+            materials.push_back(material);
+        }
+
+        std::vector<ImageInfo> images;
+        const auto* imageRecords = reader.Get<ImageRecord>(SectionImage);
+        const auto* imageData = reader.Get<uint8_t>(SectionImageData);
+        for (size_t i = 0; i < reader.GetCount(SectionImage); ++i) {
+            const auto& record = imageRecords[i];
+            ImageInfo info;
+            if (!reader.GetString(record.nameOffset, record.nameLength, info.fileName) ||
+                !reader.InRange(SectionImageData, record.dataOffset, record.dataSize)) {
+                return false;
+            }
+            info.imageData = imageData + record.dataOffset;
+            info.imageSize = size_t(record.dataSize);
+            images.push_back(info);
+        }
+
+        SkinInfo skinInfo;
+        skinInfo.skinVertexCount = header.skinVertexCount;
+        if (!reader.GetString(header.skinNameOffset, header.skinNameLength, skinInfo.name)) {
+            return false;
+        }
+        // ジョイントごとにバインド逆行列が必要 (ModelMesh::ApplyTransform で同じ添え字で参照する).
+        const auto* skinJoints = reader.Get<int32_t>(SectionSkinJoint);
+        const auto jointCount = reader.GetCount(SectionSkinJoint);
+        if (reader.GetCount(SectionInvBindMatrix) != jointCount) {
+            return false;
+        }
+        for (size_t i = 0; i < jointCount; ++i) {
+            if (!reader.IsValidIndex(SectionNode, skinJoints[i])) {
+                return false;
+            }
+        }
+        skinInfo.joints.assign(skinJoints, skinJoints + jointCount);
+        const auto* invBindMatrices = reader.Get<mat4>(SectionInvBindMatrix);
+        skinInfo.invBindMatrices.assign(invBindMatrices, invBindMatrices + jointCount);
+
+        const auto* rootNodes = reader.Get<int32_t>(SectionRootNode);
+        std::vector<int> rootNodeList(rootNodes, rootNodes + reader.GetCount(SectionRootNode));
+        for (auto nodeIndex : rootNodeList) {
+            if (!reader.IsValidIndex(SectionNode, nodeIndex)) {
+                return false;
+            }
+        }
+        const auto* textures = reader.Get<int32_t>(SectionTexture);
+        std::vector<TextureInfo> textureList;
+        for (size_t i = 0; i < reader.GetCount(SectionTexture); ++i) {
+            if (!reader.IsValidIndex(SectionImage, textures[i], true)) {
+                return false;
+            }
+            textureList.push_back(TextureInfo{ textures[i] });
+        }
+
+        m_rootNodes = std::move(rootNodeList);
+        m_textures = std::move(textureList);
+        m_nodes = std::move(nodes);
+        m_meshGroups = std::move(meshGroups);
+        m_materials = std::move(materials);
+        m_images = std::move(images);
+        m_sourceFile = mappedFile;
+        m_skinInfo = std::move(skinInfo);
+        m_hasSkin = (header.flags & CacheFlagSkinned) != 0;
+
+        // 頂点・インデックスのストリームはマップした領域から直接転送する.
+        streams.index = reader.Get<uint8_t>(SectionIndex);
+        streams.indexSize = reader.GetSize(SectionIndex);
+        streams.position = reader.Get<uint8_t>(SectionPosition);
+        streams.positionSize = reader.GetSize(SectionPosition);
+        streams.normal = reader.Get<uint8_t>(SectionNormal);
+        streams.normalSize = reader.GetSize(SectionNormal);
+        streams.texcoord = reader.Get<uint8_t>(SectionTexcoord);
+        streams.texcoordSize = reader.GetSize(SectionTexcoord);
+        streams.joint = reader.Get<uint8_t>(SectionJoint);
+        streams.jointSize = reader.GetSize(SectionJoint);
+        streams.weight = reader.Get<uint8_t>(SectionWeight);
+        streams.weightSize = reader.GetSize(SectionWeight);
+        return true;
+    }
+
+    bool VkrModel::WriteCache(const std::wstring& cacheFileName, const std::wstring& fileName, const VertexAttributeVisitor& visitor) const
+    {
+        CacheHeader header{};
+        header.magic = CacheMagic;
+        header.version = CacheVersion;
+        header.sectionCount = SectionCount;
+        if (!GetSourceStamp(fileName, header.sourceSize, header.sourceWriteTime)) {
+            return false;
+        }
+
+        // テーブルを作成する.
+        std::vector<wchar_t> strings;
+        std::vector<NodeRecord> nodeRecords;
+        std::vector<int32_t> nodeChildren;
+        for (const auto& node : m_nodes) {
+            NodeRecord record{};
+            record.translation[0] = node->translation.x;
+            record.translation[1] = node->translation.y;
+            record.translation[2] = node->translation.z;
+            record.rotation[0] = node->rotation.x;
+            record.rotation[1] = node->rotation.y;
+            record.rotation[2] = node->rotation.z;
+            record.rotation[3] = node->rotation.w;
+            record.scale[0] = node->scale.x;
+            record.scale[1] = node->scale.y;
+            record.scale[2] = node->scale.z;
+            record.meshIndex = node->meshIndex;
+            record.childStart = uint32_t(nodeChildren.size());
+            record.childCount = uint32_t(node->children.size());
+            nodeChildren.insert(nodeChildren.end(), node->children.begin(), node->children.end());
+            AddString(strings, node->name, record.nameOffset, record.nameLength);
+            nodeRecords.push_back(record);
+        }
+
+        std::vector<MeshGroupRecord> meshGroupRecords;
+        std::vector<Mesh> meshes;
+        for (const auto& meshGroup : m_meshGroups) {
+            MeshGroupRecord record{};
+            record.nodeIndex = meshGroup.m_nodeIndex;
+            record.meshStart = uint32_t(meshes.size());
+            record.meshCount = uint32_t(meshGroup.m_meshes.size());
+            meshes.insert(meshes.end(), meshGroup.m_meshes.begin(), meshGroup.m_meshes.end());
+            meshGroupRecords.push_back(record);
+        }
+
+        std::vector<MaterialRecord> materialRecords;
+        for (const auto& material : m_materials) {
+            MaterialRecord record{};
+            record.diffuseColor[0] = material.m_diffuseColor.x;
+            record.diffuseColor[1] = material.m_diffuseColor.y;
+            record.diffuseColor[2] = material.m_diffuseColor.z;
+            record.textureIndex = material.m_textureIndex;
+            AddString(strings, material.m_name, record.nameOffset, record.nameLength);
+            materialRecords.push_back(record);
+        }
+
+        std::vector<ImageRecord> imageRecords;
+        uint64_t imageDataSize = 0;
+        for (const auto& image : m_images) {
+            ImageRecord record{};
+            record.dataOffset = imageDataSize;
+            record.dataSize = image.imageSize;
+            AddString(strings, image.fileName, record.nameOffset, record.nameLength);
+            imageRecords.push_back(record);
+            imageDataSize += record.dataSize;
+        }
+
+        std::vector<int32_t> textures;
+        for (const auto& texture : m_textures) {
+            textures.push_back(texture.imageIndex);
+        }
+
+        if (m_hasSkin) {
+            header.flags |= CacheFlagSkinned;
+            header.skinVertexCount = m_skinInfo.skinVertexCount;
+            AddString(strings, m_skinInfo.name, header.skinNameOffset, header.skinNameLength);
+        }
+
+        // 書き込み途中のファイルが読まれないよう, 一時ファイルに書いてから置き換える.
+        std::filesystem::path cachePath(cacheFileName);
+        std::error_code ec;
+        if (cachePath.has_parent_path()) {
+            std::filesystem::create_directories(cachePath.parent_path(), ec);
+        }
+        auto tempPath = cachePath;
+        tempPath += L".tmp";
+        {
+            std::ofstream outfile(tempPath, std::ofstream::binary);
+            if (!outfile) {
+                return false;
+            }
+            // ヘッダはセクション表を確定させた後で書き直す.
+            outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            uint64_t offset = sizeof(header);
+            auto writeSection = [&](CacheSection id, const void* data, size_t size) {
+                static const char padding[SectionAlignment] = {};
+                auto aligned = AlignUp(offset, SectionAlignment);
+                outfile.write(padding, std::streamsize(aligned - offset));
+                if (size > 0) {
+                    outfile.write(static_cast<const char*>(data), std::streamsize(size));
+                }
+                header.sections[id].offset = aligned;
+                header.sections[id].size = size;
+                offset = aligned + size;
+            };
+            writeSection(SectionIndex, visitor.indexBuffer.data(), sizeof(uint32_t) * visitor.indexBuffer.size());
+            writeSection(SectionPosition, visitor.positionBuffer.data(), sizeof(vec3) * visitor.positionBuffer.size());
+            writeSection(SectionNormal, visitor.normalBuffer.data(), sizeof(vec3) * visitor.normalBuffer.size());
+            writeSection(SectionTexcoord, visitor.texcoordBuffer.data(), sizeof(vec2) * visitor.texcoordBuffer.size());
+            writeSection(SectionJoint, visitor.jointBuffer.data(), sizeof(uvec4) * visitor.jointBuffer.size());
+            writeSection(SectionWeight, visitor.weightBuffer.data(), sizeof(vec4) * visitor.weightBuffer.size());
+            writeSection(SectionNode, nodeRecords.data(), sizeof(NodeRecord) * nodeRecords.size());
+            writeSection(SectionNodeChild, nodeChildren.data(), sizeof(int32_t) * nodeChildren.size());
+            writeSection(SectionRootNode, m_rootNodes.data(), sizeof(int32_t) * m_rootNodes.size());
+            writeSection(SectionMeshGroup, meshGroupRecords.data(), sizeof(MeshGroupRecord) * meshGroupRecords.size());
+            writeSection(SectionMesh, meshes.data(), sizeof(Mesh) * meshes.size());
+            writeSection(SectionSkinJoint, m_skinInfo.joints.data(), sizeof(int32_t) * m_skinInfo.joints.size());
+            writeSection(SectionInvBindMatrix, m_skinInfo.invBindMatrices.data(), sizeof(mat4) * m_skinInfo.invBindMatrices.size());
+            writeSection(SectionMaterial, materialRecords.data(), sizeof(MaterialRecord) * materialRecords.size());
+            writeSection(SectionTexture, textures.data(), sizeof(int32_t) * textures.size());
+            writeSection(SectionImage, imageRecords.data(), sizeof(ImageRecord) * imageRecords.size());
+            writeSection(SectionString, strings.data(), sizeof(wchar_t) * strings.size());
+
+            // 画像データは連結して 1 つのセクションとする.
+            writeSection(SectionImageData, nullptr, 0);
+            for (const auto& image : m_images) {
+                outfile.write(reinterpret_cast<const char*>(image.imageData), std::streamsize(image.imageSize));
+            }
+            header.sections[SectionImageData].size = imageDataSize;
+
+            outfile.seekp(0);
+            outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (!outfile.good()) {
+                return false;
+            }
+        }
+        std::filesystem::rename(tempPath, cachePath, ec);
+        return !ec;
+    }
+}
@@ -18,6 +18,7 @@
  */
 
 /* 変更点: nvprint.hpp は使用しないのでコメントアウト. */
+/* 変更点: 生成元より新しい VK_EXT_descriptor_buffer の関数を追加. (ヘッダが対応している場合のみ有効) */
 
 #include <assert.h>
 #include "extensions_vk.hpp"
@@ -94,6 +95,13 @@ static PFN_vkSetDebugUtilsObjectNameEXT pfn_vkSetDebugUtilsObjectNameEXT= 0;
 static PFN_vkSetDebugUtilsObjectTagEXT pfn_vkSetDebugUtilsObjectTagEXT= 0;
 static PFN_vkSubmitDebugUtilsMessageEXT pfn_vkSubmitDebugUtilsMessageEXT= 0;
 #endif /* VK_EXT_debug_utils */
+#ifdef VK_EXT_descriptor_buffer
+static PFN_vkCmdBindDescriptorBuffersEXT pfn_vkCmdBindDescriptorBuffersEXT= 0;
+static PFN_vkCmdSetDescriptorBufferOffsetsEXT pfn_vkCmdSetDescriptorBufferOffsetsEXT= 0;
+static PFN_vkGetDescriptorEXT pfn_vkGetDescriptorEXT= 0;
+static PFN_vkGetDescriptorSetLayoutBindingOffsetEXT pfn_vkGetDescriptorSetLayoutBindingOffsetEXT= 0;
+static PFN_vkGetDescriptorSetLayoutSizeEXT pfn_vkGetDescriptorSetLayoutSizeEXT= 0;
+#endif /* VK_EXT_descriptor_buffer */
 #ifdef VK_EXT_direct_mode_display
 static PFN_vkReleaseDisplayEXT pfn_vkReleaseDisplayEXT= 0;
 #endif /* VK_EXT_direct_mode_display */
@@ -791,6 +799,49 @@ VKAPI_ATTR void VKAPI_CALL vkSubmitDebugUtilsMessageEXT(
   pfn_vkSubmitDebugUtilsMessageEXT(instance, messageSeverity, messageTypes, pCallbackData); 
 }
 #endif /* VK_EXT_debug_utils */
+#ifdef VK_EXT_descriptor_buffer
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorBuffersEXT(
+	VkCommandBuffer commandBuffer, 
+	uint32_t bufferCount, 
+	const VkDescriptorBufferBindingInfoEXT* pBindingInfos) 
+{ 
+  pfn_vkCmdBindDescriptorBuffersEXT(commandBuffer, bufferCount, pBindingInfos); 
+}
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDescriptorBufferOffsetsEXT(
+	VkCommandBuffer commandBuffer, 
+	VkPipelineBindPoint pipelineBindPoint, 
+	VkPipelineLayout layout, 
+	uint32_t firstSet, 
+	uint32_t setCount, 
+	const uint32_t* pBufferIndices, 
+	const VkDeviceSize* pOffsets) 
+{ 
+  pfn_vkCmdSetDescriptorBufferOffsetsEXT(commandBuffer, pipelineBindPoint, layout, firstSet, setCount, pBufferIndices, pOffsets); 
+}
+VKAPI_ATTR void VKAPI_CALL vkGetDescriptorEXT(
+	VkDevice device, 
+	const VkDescriptorGetInfoEXT* pDescriptorInfo, 
+	size_t dataSize, 
+	void* pDescriptor) 
+{ 
+  pfn_vkGetDescriptorEXT(device, pDescriptorInfo, dataSize, pDescriptor); 
+}
+VKAPI_ATTR void VKAPI_CALL vkGetDescriptorSetLayoutBindingOffsetEXT(
+	VkDevice device, 
+	VkDescriptorSetLayout layout, 
+	uint32_t binding, 
+	VkDeviceSize* pOffset) 
+{ 
+  pfn_vkGetDescriptorSetLayoutBindingOffsetEXT(device, layout, binding, pOffset); 
+}
+VKAPI_ATTR void VKAPI_CALL vkGetDescriptorSetLayoutSizeEXT(
+	VkDevice device, 
+	VkDescriptorSetLayout layout, 
+	VkDeviceSize* pLayoutSizeInBytes) 
+{ 
+  pfn_vkGetDescriptorSetLayoutSizeEXT(device, layout, pLayoutSizeInBytes); 
+}
+#endif /* VK_EXT_descriptor_buffer */
 #ifdef VK_EXT_direct_mode_display
 VKAPI_ATTR VkResult VKAPI_CALL vkReleaseDisplayEXT(
 	VkPhysicalDevice physicalDevice, 
@@ -2822,6 +2873,13 @@ void load_VK_EXTENSIONS(VkInstance instance, PFN_vkGetInstanceProcAddr getInstan
   pfn_vkSetDebugUtilsObjectTagEXT = (PFN_vkSetDebugUtilsObjectTagEXT)getInstanceProcAddr(instance, "vkSetDebugUtilsObjectTagEXT");
   pfn_vkSubmitDebugUtilsMessageEXT = (PFN_vkSubmitDebugUtilsMessageEXT)getInstanceProcAddr(instance, "vkSubmitDebugUtilsMessageEXT");
 #endif /* VK_EXT_debug_utils */
+#ifdef VK_EXT_descriptor_buffer
+  pfn_vkCmdBindDescriptorBuffersEXT = (PFN_vkCmdBindDescriptorBuffersEXT)getDeviceProcAddr(device, "vkCmdBindDescriptorBuffersEXT");
+  pfn_vkCmdSetDescriptorBufferOffsetsEXT = (PFN_vkCmdSetDescriptorBufferOffsetsEXT)getDeviceProcAddr(device, "vkCmdSetDescriptorBufferOffsetsEXT");
+  pfn_vkGetDescriptorEXT = (PFN_vkGetDescriptorEXT)getDeviceProcAddr(device, "vkGetDescriptorEXT");
+  pfn_vkGetDescriptorSetLayoutBindingOffsetEXT = (PFN_vkGetDescriptorSetLayoutBindingOffsetEXT)getDeviceProcAddr(device, "vkGetDescriptorSetLayoutBindingOffsetEXT");
+  pfn_vkGetDescriptorSetLayoutSizeEXT = (PFN_vkGetDescriptorSetLayoutSizeEXT)getDeviceProcAddr(device, "vkGetDescriptorSetLayoutSizeEXT");
+#endif /* VK_EXT_descriptor_buffer */
 #ifdef VK_EXT_direct_mode_display
   pfn_vkReleaseDisplayEXT = (PFN_vkReleaseDisplayEXT)getInstanceProcAddr(instance, "vkReleaseDisplayEXT");
 #endif /* VK_EXT_direct_mode_display */
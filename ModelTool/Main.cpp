@@ -0,0 +1,319 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/VkrModel.h"
+
+// glTF モデルを VkrModel のキャッシュファイルへ変換するツール.
+//  convert : 指定したファイル/ディレクトリ以下の .glb を事前に変換しておく.
+//            出力先は util::VkrModel::GetCacheFileName と同じ (実行したディレクトリからの cache/model) で,
+//            サンプルのディレクトリで実行しておけば初回起動時から変換済みのデータを読み込める.
+//  bench   : glTF を解析する経路とキャッシュを読み込む経路の CPU 側の時間を比較する.
+//  scale   : 数百万頂点の glb を生成し, 頂点属性の展開(LoadMesh)がスレッド数に応じて速くなるかを計測する.
+
+namespace {
+    bool IsSourceModel(const std::filesystem::path& path)
+    {
+        auto ext = path.extension().wstring();
+        for (auto& c : ext) {
+            c = towlower(c);
+        }
+        return ext == L".glb";
+    }
+
+    std::filesystem::path GetOutputPath(const std::filesystem::path& path, const std::filesystem::path& outputDir)
+    {
+        if (outputDir.empty()) {
+            return util::VkrModel::GetCacheFileName(path.wstring());
+        }
+        auto outputPath = outputDir / path.filename();
+        outputPath += L".vkrmodel";
+        return outputPath;
+    }
+
+    bool Convert(const std::filesystem::path& path, const std::filesystem::path& outputDir)
+    {
+        auto outputPath = GetOutputPath(path, outputDir);
+        std::error_code ec;
+        std::filesystem::create_directories(outputPath.parent_path(), ec);
+
+        auto timeStart = std::chrono::high_resolution_clock::now();
+        if (!util::VkrModel::ConvertToCache(path.wstring(), outputPath.wstring())) {
+            printf("  failed to convert : %ls\n", path.c_str());
+            return false;
+        }
+        auto timeEnd = std::chrono::high_resolution_clock::now();
+        auto sourceSize = std::filesystem::file_size(path, ec);
+        auto outputSize = std::filesystem::file_size(outputPath, ec);
+        printf("  %ls : %.1f KB -> %.1f KB (%.1f ms)\n",
+            outputPath.filename().c_str(), sourceSize / 1024.0, outputSize / 1024.0,
+            std::chrono::duration<double, std::milli>(timeEnd - timeStart).count());
+        return true;
+    }
+
+    struct Timing {
+        double minMs = 0.0;
+        double averageMs = 0.0;
+    };
+
+    template<class Func>
+    bool Measure(int iterations, Timing& timing, Func func)
+    {
+        double totalMs = 0.0;
+        for (int i = 0; i < iterations; ++i) {
+            auto timeStart = std::chrono::high_resolution_clock::now();
+            if (!func()) {
+                return false;
+            }
+            auto timeEnd = std::chrono::high_resolution_clock::now();
+            auto ms = std::chrono::duration<double, std::milli>(timeEnd - timeStart).count();
+            timing.minMs = (i == 0) ? ms : (std::min)(timing.minMs, ms);
+            totalMs += ms;
+        }
+        timing.averageMs = totalMs / iterations;
+        return true;
+    }
+
+    bool Benchmark(const std::filesystem::path& path, const std::filesystem::path& outputDir, int iterations)
+    {
+        // キャッシュは毎回作り直して, 元ファイルと一致した状態で計測する.
+        auto cachePath = GetOutputPath(path, outputDir);
+        std::error_code ec;
+        std::filesystem::create_directories(cachePath.parent_path(), ec);
+        if (!util::VkrModel::ConvertToCache(path.wstring(), cachePath.wstring())) {
+            printf("  failed to convert : %ls\n", path.c_str());
+            return false;
+        }
+
+        // どちらも 1 回目はファイルがまだ OS のキャッシュに乗っていない可能性があるので, 計測から外す.
+        Timing gltf, cache;
+        util::VkrModel::ParseGltfOnly(path.wstring());
+        util::VkrModel::ReadCacheOnly(cachePath.wstring(), path.wstring());
+        if (!Measure(iterations, gltf, [&]() { return util::VkrModel::ParseGltfOnly(path.wstring()); })) {
+            printf("  failed to parse : %ls\n", path.c_str());
+            return false;
+        }
+        if (!Measure(iterations, cache, [&]() { return util::VkrModel::ReadCacheOnly(cachePath.wstring(), path.wstring()); })) {
+            printf("  failed to read the cache : %ls\n", cachePath.c_str());
+            return false;
+        }
+        printf("  %ls : glTF %.2f ms (avg %.2f), cache %.2f ms (avg %.2f), x%.1f\n",
+            path.filename().c_str(), gltf.minMs, gltf.averageMs, cache.minMs, cache.averageMs,
+            cache.minMs > 0.0 ? gltf.minMs / cache.minMs : 0.0);
+        return true;
+    }
+
+    // 一辺 gridSize 頂点の格子を 1 つのメッシュとして持つ glb を書き出す.
+    //  位置と法線はインターリーブ(stride 24), UV は正規化された unsigned short (KHR_mesh_quantization) とし,
+    //  アクセサの各変換経路を通るようにしておく.
+    bool WriteSyntheticModel(const std::filesystem::path& path, uint32_t gridSize)
+    {
+        const uint64_t vertexCount = uint64_t(gridSize) * gridSize;
+        const uint64_t indexCount = uint64_t(gridSize - 1) * (gridSize - 1) * 6;
+        const uint64_t vertexBytes = vertexCount * sizeof(float) * 6;
+        const uint64_t texcoordBytes = vertexCount * sizeof(uint16_t) * 2;
+        const uint64_t indexBytes = indexCount * sizeof(uint32_t);
+        const uint64_t binSize = vertexBytes + texcoordBytes + indexBytes;
+        if (binSize > 0xFFFFFFF0ull) {
+            return false;
+        }
+
+        std::vector<uint8_t> bin(static_cast<size_t>(binSize));
+        auto vertices = reinterpret_cast<float*>(bin.data());
+        auto texcoords = reinterpret_cast<uint16_t*>(bin.data() + vertexBytes);
+        auto indices = reinterpret_cast<uint32_t*>(bin.data() + vertexBytes + texcoordBytes);
+        for (uint32_t y = 0; y < gridSize; ++y) {
+            for (uint32_t x = 0; x < gridSize; ++x) {
+                auto u = float(x) / (gridSize - 1), v = float(y) / (gridSize - 1);
+                auto vertex = vertices + (size_t(y) * gridSize + x) * 6;
+                vertex[0] = u; vertex[1] = 0.0f; vertex[2] = v;
+                vertex[3] = 0.0f; vertex[4] = 1.0f; vertex[5] = 0.0f;
+                auto texcoord = texcoords + (size_t(y) * gridSize + x) * 2;
+                texcoord[0] = uint16_t(u * 65535.0f);
+                texcoord[1] = uint16_t(v * 65535.0f);
+            }
+        }
+        for (uint32_t y = 0; y + 1 < gridSize; ++y) {
+            for (uint32_t x = 0; x + 1 < gridSize; ++x) {
+                auto i0 = y * gridSize + x, i1 = i0 + 1, i2 = i0 + gridSize, i3 = i2 + 1;
+                uint32_t quad[] = { i0, i2, i1, i1, i2, i3 };
+                memcpy(indices, quad, sizeof(quad));
+                indices += 6;
+            }
+        }
+
+        auto count = [](uint64_t value) { return std::to_string(value); };
+        std::string json =
+            "{\"asset\":{\"version\":\"2.0\"},\"extensionsUsed\":[\"KHR_mesh_quantization\"],"
+            "\"extensionsRequired\":[\"KHR_mesh_quantization\"],\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+            "\"nodes\":[{\"name\":\"grid\",\"mesh\":0}],"
+            "\"meshes\":[{\"name\":\"grid\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+            "\"buffers\":[{\"byteLength\":" + count(binSize) + "}],"
+            "\"bufferViews\":["
+            "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + count(vertexBytes) + ",\"byteStride\":24},"
+            "{\"buffer\":0,\"byteOffset\":" + count(vertexBytes) + ",\"byteLength\":" + count(texcoordBytes) + "},"
+            "{\"buffer\":0,\"byteOffset\":" + count(vertexBytes + texcoordBytes) + ",\"byteLength\":" + count(indexBytes) + "}],"
+            "\"accessors\":["
+            "{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":" + count(vertexCount) + ",\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":" + count(vertexCount) + ",\"type\":\"VEC3\"},"
+            "{\"bufferView\":1,\"componentType\":5123,\"normalized\":true,\"count\":" + count(vertexCount) + ",\"type\":\"VEC2\"},"
+            "{\"bufferView\":2,\"componentType\":5125,\"count\":" + count(indexCount) + ",\"type\":\"SCALAR\"}]}";
+        // チャンクは 4 バイト境界にそろえる. JSON は空白で埋める.
+        while (json.size() % 4 != 0) {
+            json.push_back(' ');
+        }
+
+        std::ofstream outfile(path, std::ios::binary);
+        if (!outfile) {
+            return false;
+        }
+        const uint32_t header[] = { 0x46546C67, 2, uint32_t(12 + 8 + json.size() + 8 + binSize) };
+        const uint32_t jsonChunk[] = { uint32_t(json.size()), 0x4E4F534A };
+        const uint32_t binChunk[] = { uint32_t(binSize), 0x004E4942 };
+        outfile.write(reinterpret_cast<const char*>(header), sizeof(header));
+        outfile.write(reinterpret_cast<const char*>(jsonChunk), sizeof(jsonChunk));
+        outfile.write(json.data(), json.size());
+        outfile.write(reinterpret_cast<const char*>(binChunk), sizeof(binChunk));
+        outfile.write(reinterpret_cast<const char*>(bin.data()), bin.size());
+        return bool(outfile);
+    }
+
+    int MeasureScaling(uint32_t millionVertices, int iterations)
+    {
+        auto gridSize = uint32_t(std::ceil(std::sqrt(millionVertices * 1000000.0)));
+        auto path = std::filesystem::temp_directory_path() / L"ModelTool_scale.glb";
+        if (!WriteSyntheticModel(path, gridSize)) {
+            printf("failed to write : %ls\n", path.c_str());
+            return 1;
+        }
+        printf("%ls : %u x %u vertices, %llu indices\n", path.c_str(), gridSize, gridSize,
+            (unsigned long long)(gridSize - 1) * (gridSize - 1) * 6);
+
+        // 1 スレッドから倍々に, 最後は論理コア数で計測する.
+        std::vector<uint32_t> threadCounts;
+        auto coreCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+        for (uint32_t n = 1; n < coreCount; n *= 2) {
+            threadCounts.push_back(n);
+        }
+        threadCounts.push_back(coreCount);
+
+        // 1 回目はマップしたファイルの読み込みが含まれるので計測から外す.
+        util::VkrModel::MeasureLoadMesh(path.wstring(), coreCount);
+        double baseMs = 0.0;
+        int result = 0;
+        for (auto threadCount : threadCounts) {
+            double minMs = 0.0;
+            for (int i = 0; i < iterations; ++i) {
+                auto ms = util::VkrModel::MeasureLoadMesh(path.wstring(), threadCount);
+                if (ms < 0.0) {
+                    printf("failed to load : %ls\n", path.c_str());
+                    result = 1;
+                    break;
+                }
+                minMs = (i == 0) ? ms : (std::min)(minMs, ms);
+            }
+            if (result != 0) {
+                break;
+            }
+            if (threadCount == 1) {
+                baseMs = minMs;
+            }
+            printf("  %2u thread(s) : %8.2f ms, x%.2f\n", threadCount, minMs, minMs > 0.0 ? baseMs / minMs : 0.0);
+        }
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+        return result;
+    }
+
+    void PrintUsage()
+    {
+        printf("usage: ModelTool convert [-o <directory>] <file or directory>...\n");
+        printf("       ModelTool bench [-o <directory>] [-n <iterations>] <file or directory>...\n");
+        printf("       ModelTool scale [-v <million vertices>] [-n <iterations>]\n");
+        printf("  convert : convert .glb files into model cache files\n");
+        printf("  bench   : compare the CPU time of loading from glTF and from the cache\n");
+        printf("  scale   : measure how LoadMesh scales with the thread count on a generated model\n");
+        printf("  -o      : output directory of the cache files (default: cache/model)\n");
+        printf("  -n      : number of measurements per file (default: 10)\n");
+        printf("  -v      : vertex count of the generated model in millions (default: 4)\n");
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    if (argc < 2) {
+        PrintUsage();
+        return 1;
+    }
+    std::wstring command = argv[1];
+    if (command != L"convert" && command != L"bench" && command != L"scale") {
+        PrintUsage();
+        return 1;
+    }
+
+    std::filesystem::path outputDir;
+    int iterations = 10;
+    uint32_t millionVertices = 4;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 2; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (arg == L"-o" && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (arg == L"-n" && i + 1 < argc) {
+            iterations = (std::max)(_wtoi(argv[++i]), 1);
+        } else if (arg == L"-v" && i + 1 < argc) {
+            millionVertices = uint32_t((std::max)(_wtoi(argv[++i]), 1));
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    if (command == L"scale") {
+        return MeasureScaling(millionVertices, iterations);
+    }
+    if (inputs.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    // ディレクトリが指定された場合は, その下の .glb ファイルをすべて対象にする.
+    std::vector<std::filesystem::path> files;
+    for (const auto& input : inputs) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(input, ec)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+                if (entry.is_regular_file() && IsSourceModel(entry.path())) {
+                    files.push_back(entry.path());
+                }
+            }
+        } else {
+            files.push_back(input);
+        }
+    }
+
+    auto timeStart = std::chrono::high_resolution_clock::now();
+    int succeeded = 0, failed = 0;
+    for (const auto& file : files) {
+        bool result = (command == L"convert") ? Convert(file, outputDir) : Benchmark(file, outputDir, iterations);
+        if (result) {
+            succeeded++;
+        } else {
+            failed++;
+        }
+    }
+    auto timeEnd = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+
+    printf("%s %d file(s), %d failed (%lld ms)\n",
+        command == L"convert" ? "converted" : "measured", succeeded, failed, elapsed);
+    return failed == 0 ? 0 : 1;
+}
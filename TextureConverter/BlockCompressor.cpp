@@ -0,0 +1,312 @@
+﻿#include "BlockCompressor.h"
+#include "util/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // べき乗法で色の分布の主成分軸を求める.
+    template<int N>
+    void ComputePrincipalAxis(const float (&points)[16][N], float (&mean)[N], float (&axis)[N])
+    {
+        for (int c = 0; c < N; ++c) {
+            mean[c] = 0.0f;
+            for (int i = 0; i < 16; ++i) {
+                mean[c] += points[i][c];
+            }
+            mean[c] /= 16.0f;
+        }
+        float cov[N][N] = {};
+        for (int i = 0; i < 16; ++i) {
+            for (int a = 0; a < N; ++a) {
+                for (int b = 0; b < N; ++b) {
+                    cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+                }
+            }
+        }
+        for (int c = 0; c < N; ++c) {
+            axis[c] = 1.0f;
+        }
+        for (int iter = 0; iter < 8; ++iter) {
+            float next[N] = {};
+            float length = 0.0f;
+            for (int a = 0; a < N; ++a) {
+                for (int b = 0; b < N; ++b) {
+                    next[a] += cov[a][b] * axis[b];
+                }
+                length = (std::max)(length, std::fabs(next[a]));
+            }
+            if (length < 1e-6f) {
+                break;
+            }
+            for (int c = 0; c < N; ++c) {
+                axis[c] = next[c] / length;
+            }
+        }
+    }
+
+    // 主成分軸へ射影した範囲の両端を端点とする. 外れ値の影響を抑えるため少し内側へ寄せる.
+    template<int N>
+    void FitEndpoints(const float (&points)[16][N], float (&e0)[N], float (&e1)[N])
+    {
+        float mean[N], axis[N];
+        ComputePrincipalAxis(points, mean, axis);
+        float minT = 1e30f, maxT = -1e30f;
+        for (int i = 0; i < 16; ++i) {
+            float t = 0.0f;
+            for (int c = 0; c < N; ++c) {
+                t += (points[i][c] - mean[c]) * axis[c];
+            }
+            minT = (std::min)(minT, t);
+            maxT = (std::max)(maxT, t);
+        }
+        float lengthSq = 0.0f;
+        for (int c = 0; c < N; ++c) {
+            lengthSq += axis[c] * axis[c];
+        }
+        const float inset = (maxT - minT) / 32.0f;
+        minT = (minT + inset) / (std::max)(lengthSq, 1e-6f);
+        maxT = (maxT - inset) / (std::max)(lengthSq, 1e-6f);
+        for (int c = 0; c < N; ++c) {
+            e0[c] = (std::min)((std::max)(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+            e1[c] = (std::min)((std::max)(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+        }
+    }
+
+    uint16_t PackRgb565(const float (&c)[3])
+    {
+        auto r = uint16_t(std::lround(c[0] * 31.0f / 255.0f));
+        auto g = uint16_t(std::lround(c[1] * 63.0f / 255.0f));
+        auto b = uint16_t(std::lround(c[2] * 31.0f / 255.0f));
+        return uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    void UnpackRgb565(uint16_t v, int (&c)[3])
+    {
+        c[0] = ((v >> 11) & 31) * 255 / 31;
+        c[1] = ((v >> 5) & 63) * 255 / 63;
+        c[2] = (v & 31) * 255 / 31;
+    }
+
+    void CompressColorBlock(const uint8_t block[64], uint8_t* dst)
+    {
+        float points[16][3];
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                points[i][c] = block[i * 4 + c];
+            }
+        }
+        float e0[3], e1[3];
+        FitEndpoints(points, e0, e1);
+
+        // 4 色モード(color0 > color1)で使うよう端点の順序を揃える.
+        auto color0 = PackRgb565(e0);
+        auto color1 = PackRgb565(e1);
+        if (color0 < color1) {
+            std::swap(color0, color1);
+        }
+        int palette[4][3];
+        UnpackRgb565(color0, palette[0]);
+        UnpackRgb565(color1, palette[1]);
+        for (int c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        uint32_t indices = 0;
+        if (color0 != color1) {
+            for (int i = 0; i < 16; ++i) {
+                int best = 0, bestError = INT32_MAX;
+                for (int p = 0; p < 4; ++p) {
+                    int error = 0;
+                    for (int c = 0; c < 3; ++c) {
+                        int d = block[i * 4 + c] - palette[p][c];
+                        error += d * d;
+                    }
+                    if (error < bestError) {
+                        best = p;
+                        bestError = error;
+                    }
+                }
+                indices |= uint32_t(best) << (i * 2);
+            }
+        }
+        memcpy(dst + 0, &color0, 2);
+        memcpy(dst + 2, &color1, 2);
+        memcpy(dst + 4, &indices, 4);
+    }
+
+    // BC4 形式で 1 チャンネルを圧縮する(BC3 のアルファ, BC5 の各チャンネル).
+    void CompressChannelBlock(const uint8_t block[64], int channel, uint8_t* dst)
+    {
+        int minValue = 255, maxValue = 0;
+        for (int i = 0; i < 16; ++i) {
+            minValue = (std::min)(minValue, int(block[i * 4 + channel]));
+            maxValue = (std::max)(maxValue, int(block[i * 4 + channel]));
+        }
+        // 8 段階モード(alpha0 > alpha1)を使う.
+        int palette[8] = { maxValue, minValue };
+        for (int p = 1; p < 7; ++p) {
+            palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+        }
+
+        uint64_t bits = uint64_t(maxValue) | (uint64_t(minValue) << 8);
+        for (int i = 0; i < 16; ++i) {
+            int value = block[i * 4 + channel];
+            int best = 0, bestError = INT32_MAX;
+            for (int p = 0; p < 8; ++p) {
+                int error = std::abs(value - palette[p]);
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            bits |= uint64_t(best) << (16 + i * 3);
+        }
+        memcpy(dst, &bits, 8);
+    }
+
+    // BC7 のモード 6 (1 サブセット, RGBA 7bit + P ビット, 4bit インデックス)で圧縮する.
+    void CompressBC7Block(const uint8_t block[64], uint8_t* dst)
+    {
+        static const int Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        float points[16][4];
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                points[i][c] = block[i * 4 + c];
+            }
+        }
+        float e[2][4];
+        FitEndpoints(points, e[0], e[1]);
+
+        // 7bit の値と P ビットの組み合わせから, 端点に最も近いものを選ぶ.
+        int quantized[2][4], pbits[2];
+        int endpoints[2][4];
+        for (int k = 0; k < 2; ++k) {
+            float bestError = 1e30f;
+            for (int p = 0; p < 2; ++p) {
+                float error = 0.0f;
+                int q[4];
+                for (int c = 0; c < 4; ++c) {
+                    q[c] = (std::min)((std::max)(int(std::lround((e[k][c] - p) / 2.0f)), 0), 127);
+                    float d = float((q[c] << 1) | p) - e[k][c];
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    pbits[k] = p;
+                    for (int c = 0; c < 4; ++c) {
+                        quantized[k][c] = q[c];
+                        endpoints[k][c] = (q[c] << 1) | p;
+                    }
+                }
+            }
+        }
+
+        int indices[16];
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestError = INT32_MAX;
+            for (int w = 0; w < 16; ++w) {
+                int error = 0;
+                for (int c = 0; c < 4; ++c) {
+                    int v = ((64 - Weights[w]) * endpoints[0][c] + Weights[w] * endpoints[1][c] + 32) >> 6;
+                    int d = block[i * 4 + c] - v;
+                    error += d * d;
+                }
+                if (error < bestError) {
+                    best = w;
+                    bestError = error;
+                }
+            }
+            indices[i] = best;
+        }
+        // 先頭ピクセルのインデックスの最上位ビットは 0 と決められているので, 必要なら端点を入れ替える.
+        if (indices[0] & 8) {
+            for (int c = 0; c < 4; ++c) {
+                std::swap(quantized[0][c], quantized[1][c]);
+            }
+            std::swap(pbits[0], pbits[1]);
+            for (auto& index : indices) {
+                index = 15 - index;
+            }
+        }
+
+        uint64_t bits[2] = {};
+        int position = 0;
+        auto write = [&](uint32_t value, int count) {
+            for (int i = 0; i < count; ++i, ++position) {
+                if (value & (1u << i)) {
+                    bits[position / 64] |= uint64_t(1) << (position % 64);
+                }
+            }
+        };
+        write(1u << 6, 7);  // モード 6.
+        for (int c = 0; c < 4; ++c) {
+            write(quantized[0][c], 7);
+            write(quantized[1][c], 7);
+        }
+        write(pbits[0], 1);
+        write(pbits[1], 1);
+        for (int i = 0; i < 16; ++i) {
+            write(indices[i], i == 0 ? 3 : 4);
+        }
+        memcpy(dst, bits, 16);
+    }
+}
+
+VkFormat BlockCompressor::GetVkFormat(Format format)
+{
+    switch (format) {
+    case Format::BC1: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case Format::BC3: return VK_FORMAT_BC3_UNORM_BLOCK;
+    case Format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case Format::BC7: return VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+void BlockCompressor::CompressBlock(const uint8_t block[64], Format format, uint8_t* dst)
+{
+    switch (format) {
+    case Format::BC1:
+        CompressColorBlock(block, dst);
+        break;
+    case Format::BC3:
+        CompressChannelBlock(block, 3, dst);
+        CompressColorBlock(block, dst + 8);
+        break;
+    case Format::BC5:
+        CompressChannelBlock(block, 0, dst);
+        CompressChannelBlock(block, 1, dst + 8);
+        break;
+    case Format::BC7:
+        CompressBC7Block(block, dst);
+        break;
+    }
+}
+
+std::vector<uint8_t> BlockCompressor::Compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = GetBlockBytes(format);
+    std::vector<uint8_t> result(size_t(blocksX) * blocksY * blockBytes);
+
+    // ブロック行ごとに並列に処理する.
+    util::ThreadPool::GetShared().ParallelFor(blocksY, [&](size_t by) {
+        uint8_t block[64];
+        for (uint32_t bx = 0; bx < blocksX; ++bx) {
+            for (uint32_t y = 0; y < 4; ++y) {
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t sx = (std::min)(bx * 4 + x, width - 1);
+                    uint32_t sy = (std::min)(uint32_t(by) * 4 + y, height - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + (size_t(sy) * width + sx) * 4, 4);
+                }
+            }
+            CompressBlock(block, format, result.data() + (size_t(by) * blocksX + bx) * blockBytes);
+        }
+    });
+    return result;
+}
@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// RGBA8 画像を BCn 形式へ圧縮するクラス.
+//  オフライン変換用のため, 品質より単純さを優先した主成分軸上のレンジフィットで端点を決める.
+class BlockCompressor {
+public:
+    enum class Format {
+        BC1,    // RGB (アルファなし), 4bpp.
+        BC3,    // RGBA, 8bpp.
+        BC5,    // RG 2 チャンネル(法線マップ向け), 8bpp.
+        BC7,    // RGBA (モード 6), 8bpp.
+    };
+
+    static VkFormat GetVkFormat(Format format);
+
+    // 画像全体を圧縮する. 端数のブロックは端のピクセルを繰り返して埋める.
+    static std::vector<uint8_t> Compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format);
+
+    // 4x4 ピクセル(RGBA8, 64 バイト)を 1 ブロック分圧縮する.
+    static void CompressBlock(const uint8_t block[64], Format format, uint8_t* dst);
+
+    static uint32_t GetBlockBytes(Format format) { return format == Format::BC1 ? 8 : 16; }
+};
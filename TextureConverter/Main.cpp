@@ -0,0 +1,208 @@
+﻿#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "Ktx2Texture.h"
+
+// PNG/JPG 画像を BCn 圧縮・ミップマップ付きの KTX2 ファイルへ変換するツール.
+//  出力は元の画像と同じフォルダに <名前>.ktx2 として書き出され,
+//  GraphicsDevice::CreateTexture2DFromFile はこれがあれば優先して読み込む.
+
+namespace {
+    struct Options {
+        bool autoFormat = true;
+        BlockCompressor::Format format = BlockCompressor::Format::BC7;
+        bool generateMips = true;
+        util::MipGenerator::Filter filter = util::MipGenerator::Filter::Kaiser;
+    };
+
+    struct Statistics {
+        int converted = 0;
+        int failed = 0;
+        uint64_t sourceBytes = 0;   // RGBA8 換算のサイズ.
+        uint64_t outputBytes = 0;
+    };
+
+    bool IsSourceImage(const std::filesystem::path& path)
+    {
+        auto ext = path.extension().wstring();
+        for (auto& c : ext) {
+            c = towlower(c);
+        }
+        return ext == L".png" || ext == L".jpg" || ext == L".jpeg";
+    }
+
+    bool ReadFile(const std::filesystem::path& path, std::vector<uint8_t>& data)
+    {
+        std::ifstream infile(path, std::ios::binary);
+        if (!infile) {
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(infile), std::istreambuf_iterator<char>());
+        return !data.empty();
+    }
+
+    bool IsOpaque(const uint8_t* rgba, size_t pixelCount)
+    {
+        for (size_t i = 0; i < pixelCount; ++i) {
+            if (rgba[i * 4 + 3] != 255) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char* GetFormatName(BlockCompressor::Format format)
+    {
+        switch (format) {
+        case BlockCompressor::Format::BC1: return "BC1";
+        case BlockCompressor::Format::BC3: return "BC3";
+        case BlockCompressor::Format::BC5: return "BC5";
+        case BlockCompressor::Format::BC7: return "BC7";
+        }
+        return "?";
+    }
+
+    bool Convert(const std::filesystem::path& path, const Options& options, Statistics& stats)
+    {
+        std::vector<uint8_t> fileData;
+        if (!ReadFile(path, fileData)) {
+            printf("  failed to read : %ls\n", path.c_str());
+            return false;
+        }
+        int width = 0, height = 0, channels = 0;
+        auto* pixels = stbi_load_from_memory(fileData.data(), int(fileData.size()), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            printf("  failed to decode : %ls (%s)\n", path.c_str(), stbi_failure_reason());
+            return false;
+        }
+
+        auto format = options.format;
+        if (options.autoFormat) {
+            format = IsOpaque(pixels, size_t(width) * height) ? BlockCompressor::Format::BC1 : BlockCompressor::Format::BC3;
+        }
+
+        std::vector<std::vector<uint8_t>> mipChain;
+        if (options.generateMips) {
+            mipChain = util::MipGenerator::GenerateChain(pixels, uint32_t(width), uint32_t(height), options.filter);
+        }
+
+        std::vector<std::vector<uint8_t>> levels;
+        uint32_t w = uint32_t(width), h = uint32_t(height);
+        levels.push_back(BlockCompressor::Compress(pixels, w, h, format));
+        for (const auto& level : mipChain) {
+            w = (std::max)(w / 2, 1u);
+            h = (std::max)(h / 2, 1u);
+            levels.push_back(BlockCompressor::Compress(level.data(), w, h, format));
+        }
+        stbi_image_free(pixels);
+
+        auto outputPath = path;
+        outputPath.replace_extension(L".ktx2");
+        auto vkFormat = BlockCompressor::GetVkFormat(format);
+        if (!util::Ktx2Texture::Write(outputPath.wstring(), vkFormat, uint32_t(width), uint32_t(height), levels)) {
+            printf("  failed to write : %ls\n", outputPath.c_str());
+            return false;
+        }
+
+        auto levelCount = uint32_t(levels.size());
+        auto sourceBytes = util::CalcTextureDataSize(VK_FORMAT_R8G8B8A8_UNORM, uint32_t(width), uint32_t(height), levelCount);
+        auto outputBytes = util::CalcTextureDataSize(vkFormat, uint32_t(width), uint32_t(height), levelCount);
+        stats.sourceBytes += sourceBytes;
+        stats.outputBytes += outputBytes;
+        printf("  %ls : %dx%d %s, %u levels, %.1f KB -> %.1f KB\n",
+            outputPath.filename().c_str(), width, height, GetFormatName(format), levelCount,
+            sourceBytes / 1024.0, outputBytes / 1024.0);
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        printf("usage: TextureConverter [-f bc1|bc3|bc5|bc7|auto] [-nomips] [-box|-kaiser] <file or directory>...\n");
+        printf("  -f       : output format (default: auto = BC1 for opaque images, otherwise BC3)\n");
+        printf("  -nomips  : do not generate mipmaps\n");
+        printf("  -box     : use the box filter for mipmaps\n");
+        printf("  -kaiser  : use the Kaiser filter for mipmaps (default)\n");
+    }
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    Options options;
+    std::vector<std::filesystem::path> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::wstring arg = argv[i];
+        if (arg == L"-f" && i + 1 < argc) {
+            std::wstring value = argv[++i];
+            options.autoFormat = false;
+            if (value == L"bc1") {
+                options.format = BlockCompressor::Format::BC1;
+            } else if (value == L"bc3") {
+                options.format = BlockCompressor::Format::BC3;
+            } else if (value == L"bc5") {
+                options.format = BlockCompressor::Format::BC5;
+            } else if (value == L"bc7") {
+                options.format = BlockCompressor::Format::BC7;
+            } else if (value == L"auto") {
+                options.autoFormat = true;
+            } else {
+                PrintUsage();
+                return 1;
+            }
+        } else if (arg == L"-nomips") {
+            options.generateMips = false;
+        } else if (arg == L"-box") {
+            options.filter = util::MipGenerator::Filter::Box;
+        } else if (arg == L"-kaiser") {
+            options.filter = util::MipGenerator::Filter::Kaiser;
+        } else {
+            inputs.emplace_back(arg);
+        }
+    }
+    if (inputs.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    // ディレクトリが指定された場合は, その下の画像ファイルをすべて変換する.
+    std::vector<std::filesystem::path> files;
+    for (const auto& input : inputs) {
+        std::error_code ec;
+        if (std::filesystem::is_directory(input, ec)) {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(input, ec)) {
+                if (entry.is_regular_file() && IsSourceImage(entry.path())) {
+                    files.push_back(entry.path());
+                }
+            }
+        } else {
+            files.push_back(input);
+        }
+    }
+
+    auto timeStart = std::chrono::high_resolution_clock::now();
+    Statistics stats;
+    for (const auto& file : files) {
+        if (Convert(file, options, stats)) {
+            stats.converted++;
+        } else {
+            stats.failed++;
+        }
+    }
+    auto timeEnd = std::chrono::high_resolution_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+
+    printf("converted %d file(s), %d failed, %.2f MB -> %.2f MB (%lld ms)\n",
+        stats.converted, stats.failed,
+        stats.sourceBytes / (1024.0 * 1024.0), stats.outputBytes / (1024.0 * 1024.0), elapsed);
+    return stats.failed == 0 ? 0 : 1;
+}
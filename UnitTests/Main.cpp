@@ -0,0 +1,43 @@
+﻿#include "UnitTest.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Vulkan デバイスを使わずに CPU 側だけで確認できる処理のテスト.
+//  引数を指定すると, 名前にその文字列を含むテストだけを実行する.
+
+namespace {
+    int g_failureCount = 0;
+}
+
+std::vector<unittest::TestEntry>& unittest::GetTests()
+{
+    static std::vector<TestEntry> tests;
+    return tests;
+}
+
+void unittest::ReportFailure(const char* expr, const char* file, int line)
+{
+    printf("  FAILED: %s (%s:%d)\n", expr, file, line);
+    g_failureCount++;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+    int testCount = 0;
+    int failedTests = 0;
+    for (const auto& test : unittest::GetTests()) {
+        if (filter && strstr(test.name, filter) == nullptr) {
+            continue;
+        }
+        auto failuresBefore = g_failureCount;
+        test.func();
+        auto passed = g_failureCount == failuresBefore;
+        printf("[%s] %s\n", passed ? "  OK  " : "FAILED", test.name);
+        testCount++;
+        failedTests += passed ? 0 : 1;
+    }
+    printf("%d tests, %d failed.\n", testCount, failedTests);
+    return failedTests == 0 ? 0 : 1;
+}
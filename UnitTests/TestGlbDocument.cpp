@@ -0,0 +1,243 @@
+﻿#include "UnitTest.h"
+#include "util/GlbDocument.h"
+
+#include <cstring>
+#include <string>
+
+using util::GlbDocument;
+
+namespace {
+    // JSON と BIN チャンクから glb のイメージを組み立てる.
+    std::vector<uint8_t> MakeGlb(std::string json, std::vector<uint8_t> bin)
+    {
+        while (json.size() % 4 != 0) {
+            json.push_back(' ');
+        }
+        while (bin.size() % 4 != 0) {
+            bin.push_back(0);
+        }
+        const uint32_t header[] = { 0x46546C67, 2, uint32_t(12 + 8 + json.size() + 8 + bin.size()) };
+        const uint32_t jsonChunk[] = { uint32_t(json.size()), 0x4E4F534A };
+        const uint32_t binChunk[] = { uint32_t(bin.size()), 0x004E4942 };
+
+        std::vector<uint8_t> glb(header[2]);
+        auto dst = glb.data();
+        memcpy(dst, header, sizeof(header)); dst += sizeof(header);
+        memcpy(dst, jsonChunk, sizeof(jsonChunk)); dst += sizeof(jsonChunk);
+        memcpy(dst, json.data(), json.size()); dst += json.size();
+        memcpy(dst, binChunk, sizeof(binChunk)); dst += sizeof(binChunk);
+        memcpy(dst, bin.data(), bin.size());
+        return glb;
+    }
+
+    // bufferViews と accessors の定義だけを持つ glTF の JSON.
+    std::string MakeJson(const std::string& bufferViews, const std::string& accessors, size_t binSize)
+    {
+        return "{\"asset\":{\"version\":\"2.0\"},\"scenes\":[{\"nodes\":[]}],"
+            "\"buffers\":[{\"byteLength\":" + std::to_string(binSize) + "}],"
+            "\"bufferViews\":[" + bufferViews + "],\"accessors\":[" + accessors + "]}";
+    }
+
+    template<class T>
+    void Append(std::vector<uint8_t>& bin, T value)
+    {
+        auto offset = bin.size();
+        bin.resize(offset + sizeof(T));
+        memcpy(bin.data() + offset, &value, sizeof(T));
+    }
+}
+
+UNIT_TEST(GlbDocument_ReadFloatPacked)
+{
+    std::vector<uint8_t> bin;
+    for (int i = 0; i < 12; ++i) {
+        Append(bin, float(i));
+    }
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteLength\":48}",
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":4,\"type\":\"VEC3\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+    CHECK(doc.accessors.size() == 1);
+    CHECK(doc.accessors[0].componentCount == 3);
+
+    // first を指定した場合はその要素から読み取る.
+    float dst[6] = { 0 };
+    CHECK(doc.ReadFloat(doc.accessors[0], 2, 2, dst));
+    for (int i = 0; i < 6; ++i) {
+        CHECK(dst[i] == float(6 + i));
+    }
+    // 範囲外の指定は失敗する.
+    CHECK(!doc.ReadFloat(doc.accessors[0], 3, 2, dst));
+}
+
+UNIT_TEST(GlbDocument_ReadFloatStrided)
+{
+    // 位置と法線をインターリーブしたバッファ (stride 24).
+    std::vector<uint8_t> bin;
+    for (int v = 0; v < 3; ++v) {
+        Append(bin, float(v)); Append(bin, float(v * 10)); Append(bin, float(v * 100));
+        Append(bin, 0.0f); Append(bin, 1.0f); Append(bin, float(-v));
+    }
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteLength\":72,\"byteStride\":24}",
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+        "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    float position[9] = { 0 }, normal[9] = { 0 };
+    CHECK(doc.ReadFloat(doc.accessors[0], 0, 3, position));
+    CHECK(doc.ReadFloat(doc.accessors[1], 0, 3, normal));
+    for (int v = 0; v < 3; ++v) {
+        CHECK(position[v * 3 + 0] == float(v));
+        CHECK(position[v * 3 + 1] == float(v * 10));
+        CHECK(position[v * 3 + 2] == float(v * 100));
+        CHECK(normal[v * 3 + 0] == 0.0f);
+        CHECK(normal[v * 3 + 1] == 1.0f);
+        CHECK(normal[v * 3 + 2] == float(-v));
+    }
+}
+
+UNIT_TEST(GlbDocument_ReadFloatNormalized)
+{
+    std::vector<uint8_t> bin;
+    Append<uint8_t>(bin, 0); Append<uint8_t>(bin, 255); Append<uint8_t>(bin, 51); Append<uint8_t>(bin, 0);
+    Append<int8_t>(bin, 127); Append<int8_t>(bin, -127); Append<int8_t>(bin, -128); Append<int8_t>(bin, 0);
+    Append<uint16_t>(bin, 0); Append<uint16_t>(bin, 65535);
+    Append<int16_t>(bin, 32767); Append<int16_t>(bin, -32768);
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":4},"
+        "{\"buffer\":0,\"byteOffset\":4,\"byteLength\":4},"
+        "{\"buffer\":0,\"byteOffset\":8,\"byteLength\":4},"
+        "{\"buffer\":0,\"byteOffset\":12,\"byteLength\":4}",
+        "{\"bufferView\":0,\"componentType\":5121,\"normalized\":true,\"count\":3,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":1,\"componentType\":5120,\"normalized\":true,\"count\":3,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":2,\"componentType\":5123,\"normalized\":true,\"count\":1,\"type\":\"VEC2\"},"
+        "{\"bufferView\":3,\"componentType\":5122,\"normalized\":true,\"count\":1,\"type\":\"VEC2\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    float u8[3] = { 0 }, s8[3] = { 0 }, u16[2] = { 0 }, s16[2] = { 0 };
+    CHECK(doc.ReadFloat(doc.accessors[0], 0, 3, u8));
+    CHECK(doc.ReadFloat(doc.accessors[1], 0, 3, s8));
+    CHECK(doc.ReadFloat(doc.accessors[2], 0, 1, u16));
+    CHECK(doc.ReadFloat(doc.accessors[3], 0, 1, s16));
+    CHECK(u8[0] == 0.0f);
+    CHECK(u8[1] == 1.0f);
+    CHECK_NEAR(u8[2], 0.2, 1e-6);
+    CHECK(s8[0] == 1.0f);
+    CHECK(s8[1] == -1.0f);
+    // 符号付きの最小値は -1 に丸める.
+    CHECK(s8[2] == -1.0f);
+    CHECK(u16[0] == 0.0f);
+    CHECK(u16[1] == 1.0f);
+    CHECK(s16[0] == 1.0f);
+    CHECK(s16[1] == -1.0f);
+}
+
+UNIT_TEST(GlbDocument_ReadFloatQuantized)
+{
+    // KHR_mesh_quantization の位置データ: 正規化しない short の VEC3 を 4 バイト境界に合わせたもの.
+    std::vector<uint8_t> bin;
+    for (int v = 0; v < 2; ++v) {
+        Append<int16_t>(bin, int16_t(-100 * (v + 1))); Append<int16_t>(bin, 0); Append<int16_t>(bin, int16_t(300 + v)); Append<int16_t>(bin, 0x7FFF);
+    }
+    Append<uint8_t>(bin, 1); Append<uint8_t>(bin, 2); Append<uint8_t>(bin, 3); Append<uint8_t>(bin, 200);
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":16,\"byteStride\":8},"
+        "{\"buffer\":0,\"byteOffset\":16,\"byteLength\":4}",
+        "{\"bufferView\":0,\"componentType\":5122,\"count\":2,\"type\":\"VEC3\"},"
+        "{\"bufferView\":1,\"componentType\":5121,\"count\":2,\"type\":\"VEC2\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    float position[6] = { 0 }, texcoord[4] = { 0 };
+    CHECK(doc.ReadFloat(doc.accessors[0], 0, 2, position));
+    CHECK(doc.ReadFloat(doc.accessors[1], 0, 2, texcoord));
+    CHECK(position[0] == -100.0f);
+    CHECK(position[1] == 0.0f);
+    CHECK(position[2] == 300.0f);
+    CHECK(position[3] == -200.0f);
+    CHECK(position[5] == 301.0f);
+    CHECK(texcoord[0] == 1.0f);
+    CHECK(texcoord[3] == 200.0f);
+}
+
+UNIT_TEST(GlbDocument_ReadUInt)
+{
+    std::vector<uint8_t> bin;
+    Append<uint8_t>(bin, 1); Append<uint8_t>(bin, 2); Append<uint8_t>(bin, 3); Append<uint8_t>(bin, 250);
+    Append<uint16_t>(bin, 7); Append<uint16_t>(bin, 65535);
+    Append<uint32_t>(bin, 10); Append<uint32_t>(bin, 0xFFFFFFFFu); Append<uint32_t>(bin, 12);
+    // stride 8 のジョイント番号 (残りは別の属性とする).
+    Append<uint32_t>(bin, 100); Append<uint32_t>(bin, 0); Append<uint32_t>(bin, 101); Append<uint32_t>(bin, 0);
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":4},"
+        "{\"buffer\":0,\"byteOffset\":4,\"byteLength\":4},"
+        "{\"buffer\":0,\"byteOffset\":8,\"byteLength\":12},"
+        "{\"buffer\":0,\"byteOffset\":20,\"byteLength\":16,\"byteStride\":8}",
+        "{\"bufferView\":0,\"componentType\":5121,\"count\":1,\"type\":\"VEC4\"},"
+        "{\"bufferView\":1,\"componentType\":5123,\"count\":2,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":2,\"componentType\":5125,\"count\":3,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":3,\"componentType\":5125,\"count\":2,\"type\":\"SCALAR\"},"
+        "{\"bufferView\":1,\"componentType\":5122,\"count\":2,\"type\":\"SCALAR\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    uint32_t u8[4] = { 0 }, u16[2] = { 0 }, u32[3] = { 0 }, strided[2] = { 0 };
+    CHECK(doc.ReadUInt(doc.accessors[0], 0, 1, u8));
+    CHECK(doc.ReadUInt(doc.accessors[1], 0, 2, u16));
+    CHECK(doc.ReadUInt(doc.accessors[2], 0, 3, u32));
+    CHECK(doc.ReadUInt(doc.accessors[3], 0, 2, strided));
+    CHECK(u8[0] == 1 && u8[1] == 2 && u8[2] == 3 && u8[3] == 250);
+    CHECK(u16[0] == 7 && u16[1] == 65535);
+    CHECK(u32[0] == 10 && u32[1] == 0xFFFFFFFFu && u32[2] == 12);
+    CHECK(strided[0] == 100 && strided[1] == 101);
+
+    // 符号付き整数は対象外.
+    uint32_t s16[2] = { 0 };
+    CHECK(!doc.ReadUInt(doc.accessors[4], 0, 2, s16));
+}
+
+UNIT_TEST(GlbDocument_AccessorOutOfRange)
+{
+    std::vector<uint8_t> bin;
+    for (int i = 0; i < 4; ++i) {
+        Append(bin, float(i));
+    }
+    // 最後の要素がビューからはみ出すアクセサと, BIN チャンクからはみ出すビュー.
+    auto glb = MakeGlb(MakeJson(
+        "{\"buffer\":0,\"byteLength\":16,\"byteStride\":8},"
+        "{\"buffer\":0,\"byteOffset\":8,\"byteLength\":16}",
+        "{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"},"
+        "{\"bufferView\":0,\"byteOffset\":4,\"componentType\":5126,\"count\":2,\"type\":\"VEC2\"},"
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":1,\"type\":\"SCALAR\"},"
+        "{\"componentType\":5126,\"count\":1,\"type\":\"SCALAR\"}", bin.size()), bin);
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    float dst[6] = { 0 };
+    uint32_t stride = 0;
+    CHECK(doc.GetAccessorData(doc.accessors[0], stride) == nullptr);
+    CHECK(!doc.ReadFloat(doc.accessors[0], 0, 1, dst));
+    CHECK(!doc.ReadFloat(doc.accessors[1], 0, 1, dst));
+    CHECK(!doc.ReadFloat(doc.accessors[2], 0, 1, dst));
+    CHECK(!doc.ReadFloat(doc.accessors[3], 0, 1, dst));
+}
+
+UNIT_TEST(GlbDocument_InvalidHeader)
+{
+    auto glb = MakeGlb(MakeJson("", "", 0), {});
+    GlbDocument doc;
+    CHECK(doc.OpenFromMemory(glb.data(), glb.size()));
+
+    auto broken = glb;
+    broken[0] = 'x';
+    CHECK(!doc.OpenFromMemory(broken.data(), broken.size()));
+    // 長さがファイルより大きい.
+    CHECK(!doc.OpenFromMemory(glb.data(), glb.size() - 4));
+    // シーンの無いものは読み込まない.
+    auto noScene = MakeGlb("{\"asset\":{\"version\":\"2.0\"}}", {});
+    CHECK(!doc.OpenFromMemory(noScene.data(), noScene.size()));
+}
@@ -0,0 +1,117 @@
+﻿#include "UnitTest.h"
+#include "MemoryAllocator.h"
+
+using vk::MemoryBlockRange;
+using vk::DeviceMemoryAllocator;
+
+UNIT_TEST(MemoryBlockRange_Allocate)
+{
+    MemoryBlockRange range(1024);
+    VkDeviceSize a = ~0ull, b = ~0ull;
+    CHECK(range.Allocate(256, 1, a));
+    CHECK(range.Allocate(256, 1, b));
+    CHECK(a == 0);
+    CHECK(b == 256);
+    CHECK(range.GetUsedSize() == 512);
+    CHECK(range.GetLargestFreeRange() == 512);
+    CHECK(range.GetFreeRangeCount() == 1);
+
+    // 残りより大きい要求は失敗し, 状態は変わらない.
+    VkDeviceSize c = ~0ull;
+    CHECK(!range.Allocate(513, 1, c));
+    CHECK(range.GetUsedSize() == 512);
+    CHECK(range.Allocate(512, 1, c));
+    CHECK(c == 512);
+    CHECK(range.GetFreeRangeCount() == 0);
+    CHECK(!range.Allocate(1, 1, c));
+}
+
+UNIT_TEST(MemoryBlockRange_Alignment)
+{
+    MemoryBlockRange range(4096);
+    VkDeviceSize a = 0, b = 0;
+    CHECK(range.Allocate(100, 1, a));
+    CHECK(range.Allocate(100, 256, b));
+    CHECK(b == 256);
+    // アライメントで空いた隙間は空き領域として残る.
+    CHECK(range.GetFreeRangeCount() == 2);
+    CHECK(range.GetUsedSize() == 200);
+
+    VkDeviceSize c = 0;
+    CHECK(range.Allocate(156, 1, c));
+    CHECK(c == 100);
+    CHECK(range.GetFreeRangeCount() == 1);
+}
+
+UNIT_TEST(MemoryBlockRange_FreeCoalesce)
+{
+    MemoryBlockRange range(1024);
+    VkDeviceSize offsets[4];
+    for (auto& offset : offsets) {
+        CHECK(range.Allocate(256, 1, offset));
+    }
+
+    // 隣接しない領域を返すと空き領域は分かれたまま.
+    range.Free(offsets[0], 256);
+    range.Free(offsets[2], 256);
+    CHECK(range.GetFreeRangeCount() == 2);
+    CHECK(range.GetLargestFreeRange() == 256);
+
+    // 間を返すと前後と結合される.
+    range.Free(offsets[1], 256);
+    CHECK(range.GetFreeRangeCount() == 1);
+    CHECK(range.GetLargestFreeRange() == 768);
+
+    range.Free(offsets[3], 256);
+    CHECK(range.GetFreeRangeCount() == 1);
+    CHECK(range.GetLargestFreeRange() == 1024);
+    CHECK(range.IsEmpty());
+
+    // 全て返した後は先頭から確保し直せる.
+    VkDeviceSize offset = ~0ull;
+    CHECK(range.Allocate(1024, 1, offset));
+    CHECK(offset == 0);
+}
+
+UNIT_TEST(MemoryBlockRange_Fragmentation)
+{
+    // 交互に返却して断片化させる.
+    const int count = 16;
+    MemoryBlockRange range(count * 64);
+    VkDeviceSize offsets[count];
+    for (auto& offset : offsets) {
+        CHECK(range.Allocate(64, 1, offset));
+    }
+    for (int i = 0; i < count; i += 2) {
+        range.Free(offsets[i], 64);
+    }
+    CHECK(range.GetFreeRangeCount() == count / 2);
+    CHECK(range.GetLargestFreeRange() == 64);
+    CHECK(range.GetUsedSize() == count / 2 * 64);
+
+    // 空き容量は足りていても連続した領域が無ければ失敗する.
+    VkDeviceSize offset = 0;
+    CHECK(!range.Allocate(128, 1, offset));
+
+    // 統計と同じ定義の断片化率 (1 - 最大空き領域/空き領域合計).
+    auto freeBytes = range.GetSize() - range.GetUsedSize();
+    auto fragmentation = 1.0 - double(range.GetLargestFreeRange()) / double(freeBytes);
+    CHECK_NEAR(fragmentation, 1.0 - 1.0 / (count / 2), 1e-6);
+
+    // 間を埋め戻すと 1 つにまとまる.
+    for (int i = 1; i < count; i += 2) {
+        range.Free(offsets[i], 64);
+    }
+    CHECK(range.GetFreeRangeCount() == 1);
+    CHECK(range.GetLargestFreeRange() == range.GetSize());
+}
+
+UNIT_TEST(DeviceMemoryAllocator_SizeClass)
+{
+    CHECK(DeviceMemoryAllocator::GetSizeClass(1) == DeviceMemoryAllocator::MinSizeClass);
+    CHECK(DeviceMemoryAllocator::GetSizeClass(256) == 256);
+    CHECK(DeviceMemoryAllocator::GetSizeClass(257) == 512);
+    CHECK(DeviceMemoryAllocator::GetSizeClass(1000) == 1024);
+    CHECK(DeviceMemoryAllocator::GetSizeClass(DeviceMemoryAllocator::MaxSizeClass) == DeviceMemoryAllocator::MaxSizeClass);
+    CHECK(DeviceMemoryAllocator::GetSizeClass(DeviceMemoryAllocator::MaxSizeClass + 1) == DeviceMemoryAllocator::MaxSizeClass + 64 * 1024);
+}
@@ -0,0 +1,135 @@
+﻿#include "UnitTest.h"
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using util::MipGenerator;
+
+namespace {
+    std::vector<uint8_t> MakeImage(uint32_t width, uint32_t height, uint8_t(*func)(uint32_t x, uint32_t y, uint32_t c))
+    {
+        std::vector<uint8_t> image(size_t(width) * height * 4);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                for (uint32_t c = 0; c < 4; ++c) {
+                    image[(size_t(y) * width + x) * 4 + c] = func(x, y, c);
+                }
+            }
+        }
+        return image;
+    }
+
+    // 2x2 平均(端は複製)の素直な実装. SIMD 版の結果と比較する.
+    std::vector<uint8_t> ReferenceBox(const std::vector<uint8_t>& src, uint32_t width, uint32_t height)
+    {
+        const uint32_t dstWidth = (std::max)(width / 2, 1u);
+        const uint32_t dstHeight = (std::max)(height / 2, 1u);
+        std::vector<uint8_t> dst(size_t(dstWidth) * dstHeight * 4);
+        for (uint32_t y = 0; y < dstHeight; ++y) {
+            const uint32_t y0 = (std::min)(y * 2, height - 1), y1 = (std::min)(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < dstWidth; ++x) {
+                const uint32_t x0 = (std::min)(x * 2, width - 1), x1 = (std::min)(x * 2 + 1, width - 1);
+                for (uint32_t c = 0; c < 4; ++c) {
+                    uint32_t sum = src[(size_t(y0) * width + x0) * 4 + c] + src[(size_t(y0) * width + x1) * 4 + c]
+                        + src[(size_t(y1) * width + x0) * 4 + c] + src[(size_t(y1) * width + x1) * 4 + c];
+                    dst[(size_t(y) * dstWidth + x) * 4 + c] = uint8_t((sum + 2) / 4);
+                }
+            }
+        }
+        return dst;
+    }
+}
+
+UNIT_TEST(MipGenerator_BoxAverage)
+{
+    // 2x2 の各ブロックの平均 (四捨五入).
+    const uint8_t src[4 * 2 * 4] = {
+        0, 10, 255, 1,    4, 20, 255, 2,    100, 0, 0, 0,   101, 0, 0, 0,
+        8, 30, 255, 3,   12, 40, 254, 4,    102, 0, 0, 0,   102, 0, 0, 255,
+    };
+    uint8_t dst[2 * 4] = { 0 };
+    MipGenerator::Downsample(src, 4, 2, dst, MipGenerator::Filter::Box);
+    CHECK(dst[0] == 6);
+    CHECK(dst[1] == 25);
+    CHECK(dst[2] == 255);
+    CHECK(dst[3] == 3);
+    CHECK(dst[4] == 101);
+    CHECK(dst[7] == 64);
+}
+
+UNIT_TEST(MipGenerator_BoxMatchesReference)
+{
+    // 奇数サイズ(端の複製)と, 4 ピクセル単位の SIMD 処理の両方を通る大きさ.
+    const uint32_t sizes[][2] = { { 37, 23 }, { 64, 16 }, { 1, 9 }, { 9, 1 }, { 2, 2 } };
+    for (const auto& size : sizes) {
+        auto src = MakeImage(size[0], size[1], [](uint32_t x, uint32_t y, uint32_t c) {
+            return uint8_t((x * 37 + y * 101 + c * 59) * 2654435761u >> 24);
+        });
+        auto expected = ReferenceBox(src, size[0], size[1]);
+        std::vector<uint8_t> dst(expected.size());
+        MipGenerator::Downsample(src.data(), size[0], size[1], dst.data(), MipGenerator::Filter::Box);
+        CHECK(dst == expected);
+    }
+}
+
+UNIT_TEST(MipGenerator_KaiserConstant)
+{
+    // 係数の和は 1 なので, 一様な画像は(端も含めて)変化しない.
+    auto src = MakeImage(13, 7, [](uint32_t, uint32_t, uint32_t c) { return uint8_t(40 + c * 60); });
+    std::vector<uint8_t> dst(6 * 3 * 4);
+    MipGenerator::Downsample(src.data(), 13, 7, dst.data(), MipGenerator::Filter::Kaiser);
+    for (size_t i = 0; i < dst.size(); ++i) {
+        CHECK(dst[i] == 40 + (i % 4) * 60);
+    }
+}
+
+UNIT_TEST(MipGenerator_KaiserFilter)
+{
+    // 縦縞(0/255 の交互)は平均の灰色になり, 折り返しが残らない.
+    //  (左右の端は入力を複製して参照するので対象外)
+    auto stripes = MakeImage(32, 8, [](uint32_t x, uint32_t, uint32_t) { return uint8_t((x & 1) ? 255 : 0); });
+    std::vector<uint8_t> dst(16 * 4 * 4);
+    MipGenerator::Downsample(stripes.data(), 32, 8, dst.data(), MipGenerator::Filter::Kaiser);
+    for (uint32_t y = 0; y < 4; ++y) {
+        for (uint32_t x = 1; x < 15; ++x) {
+            CHECK_NEAR(dst[(y * 16 + x) * 4], 127.5, 1.0);
+        }
+    }
+
+    // 横方向の傾斜は, 出力の中心(入力 2 ピクセルの境界)での値になる.
+    auto ramp = MakeImage(32, 4, [](uint32_t x, uint32_t, uint32_t) { return uint8_t(x * 8); });
+    MipGenerator::Downsample(ramp.data(), 32, 4, dst.data(), MipGenerator::Filter::Kaiser);
+    for (uint32_t x = 2; x < 14; ++x) {
+        CHECK_NEAR(dst[x * 4], x * 16 + 4, 1.0);
+    }
+
+    // ボックスフィルタより鋭い: 段差の手前では元の値に近いまま.
+    auto edge = MakeImage(32, 2, [](uint32_t x, uint32_t, uint32_t) { return uint8_t(x < 16 ? 0 : 200); });
+    std::vector<uint8_t> box(16 * 4), kaiser(16 * 4);
+    MipGenerator::Downsample(edge.data(), 32, 2, box.data(), MipGenerator::Filter::Box);
+    MipGenerator::Downsample(edge.data(), 32, 2, kaiser.data(), MipGenerator::Filter::Kaiser);
+    CHECK(box[7 * 4] == 0 && box[8 * 4] == 200);
+    CHECK(kaiser[4 * 4] == 0);
+    CHECK(kaiser[11 * 4] == 200);
+    CHECK(kaiser[7 * 4] < 20);
+    CHECK(kaiser[8 * 4] > 180);
+}
+
+UNIT_TEST(MipGenerator_Chain)
+{
+    auto src = MakeImage(16, 4, [](uint32_t x, uint32_t y, uint32_t) { return uint8_t(x + y); });
+    const MipGenerator::Filter filters[] = { MipGenerator::Filter::Box, MipGenerator::Filter::Kaiser };
+    for (auto filter : filters) {
+        auto chain = MipGenerator::GenerateChain(src.data(), 16, 4, filter);
+        // 8x2, 4x1, 2x1, 1x1.
+        CHECK(chain.size() == 4);
+        if (chain.size() == 4) {
+            CHECK(chain[0].size() == 8 * 2 * 4);
+            CHECK(chain[1].size() == 4 * 1 * 4);
+            CHECK(chain[2].size() == 2 * 1 * 4);
+            CHECK(chain[3].size() == 1 * 1 * 4);
+        }
+    }
+    CHECK(MipGenerator::GenerateChain(src.data(), 1, 1).empty());
+}
@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <cmath>
+#include <vector>
+
+// 外部のテストフレームワークを使わない最小限のテスト登録とチェック.
+//  UNIT_TEST で定義した関数は Main.cpp から順に実行される.
+namespace unittest {
+    using TestFunc = void(*)();
+    struct TestEntry {
+        const char* name;
+        TestFunc func;
+    };
+    std::vector<TestEntry>& GetTests();
+
+    struct Registrar {
+        Registrar(const char* name, TestFunc func) { GetTests().push_back({ name, func }); }
+    };
+
+    void ReportFailure(const char* expr, const char* file, int line);
+}
+
+#define UNIT_TEST(name) \
+    static void name(); \
+    static unittest::Registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(expr) \
+    do { if (!(expr)) { unittest::ReportFailure(#expr, __FILE__, __LINE__); } } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+    do { if (!(std::fabs(double(a) - double(b)) <= double(eps))) { unittest::ReportFailure(#a " ~= " #b, __FILE__, __LINE__); } } while (0)